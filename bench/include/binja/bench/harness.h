@@ -0,0 +1,82 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Binja::Bench {
+
+/// Work done by one call of a benchmark body. Throughput is derived from
+/// the totals over all calls, bytes may be left zero where a byte rate
+/// is meaningless
+struct Work {
+    uint64_t ops = 0;
+    uint64_t bytes = 0;
+};
+
+/// Body of a benchmark, called repeatedly until the minimum run time is
+/// reached. Returned by the setup function so that input generation is
+/// not measured
+using BenchmarkBody = std::function<Work()>;
+using BenchmarkSetup = std::function<BenchmarkBody()>;
+
+struct BenchmarkResult {
+    std::string name;
+    uint64_t calls;
+    double seconds;
+    uint64_t ops;
+    uint64_t bytes;
+
+    [[nodiscard]] double OpsPerSecond() const { return ops / seconds; }
+    [[nodiscard]] double BytesPerSecond() const { return bytes / seconds; }
+};
+
+struct RunnerOptions {
+    // Only benchmarks whose name contains filter are run
+    std::string filter;
+    std::chrono::milliseconds minTime{500};
+};
+
+class Runner {
+public:
+    void Add(std::string name, BenchmarkSetup setup);
+    std::vector<BenchmarkResult> Run(const RunnerOptions &options) const;
+
+private:
+    std::vector<std::pair<std::string, BenchmarkSetup>> benchmarks_;
+};
+
+std::string FormatTable(const std::vector<BenchmarkResult> &results);
+std::string FormatCSV(const std::vector<BenchmarkResult> &results);
+
+/// Keeps the compiler from discarding the computation of value
+template<class T>
+inline void DoNotOptimize(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+}// namespace Binja::Bench
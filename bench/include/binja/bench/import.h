@@ -0,0 +1,79 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace Binja::Bench {
+
+enum class ImportSink {
+    // Records are counted and dropped
+    Headless,
+    // Records are added to the Binary Ninja debug info of the view
+    BinaryNinja,
+};
+
+struct ImportConfig {
+    std::filesystem::path binary;
+    std::filesystem::path symbols;
+    // Manifest is used as the import cache when set
+    std::filesystem::path manifestDirectory;
+    size_t numThreads = 1;
+    bool useCache = false;
+    ImportSink sink = ImportSink::Headless;
+};
+
+struct ImportPhaseResult {
+    std::string name;
+    uint64_t calls;
+    double wallSeconds;
+    double cpuSeconds;
+    uint64_t typesBuilt;
+    uint64_t symbolsAdded;
+};
+
+struct ImportResult {
+    std::vector<ImportPhaseResult> phases;
+    double wallSeconds;
+    double cpuSeconds;
+    size_t numTypes;
+    size_t numFunctions;
+    size_t numDataVariables;
+    uint64_t peakRSSBytes;
+};
+
+/// Loads the dSYMs of `config.binary` through the DWARF import pipeline
+/// the plugin uses. Binary Ninja must be initialized and the shared
+/// executor not yet created, since it is sized with `config.numThreads`.
+/// Peak RSS is a process high water mark, so callers run one import per
+/// process to compare configurations
+ImportResult RunImport(const ImportConfig &config);
+
+const char *ImportSinkName(ImportSink sink);
+
+std::string FormatImportCSVHeader();
+std::string FormatImportCSV(const ImportConfig &config, size_t run, const ImportResult &result);
+
+}// namespace Binja::Bench
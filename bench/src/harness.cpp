@@ -0,0 +1,98 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <fmt/format.h>
+
+#include "harness.h"
+
+using namespace Binja;
+using namespace Bench;
+
+namespace {
+
+std::string FormatRate(double value, std::string_view unit) {
+    constexpr std::string_view kPrefixes[] = {"", "K", "M", "G", "T"};
+    size_t prefix = 0;
+    while (value >= 1000 && prefix + 1 < std::size(kPrefixes)) {
+        value /= 1000;
+        ++prefix;
+    }
+    return fmt::format("{:.2f} {}{}", value, kPrefixes[prefix], unit);
+}
+
+}// namespace
+
+
+/// Runner
+
+void Runner::Add(std::string name, BenchmarkSetup setup) {
+    benchmarks_.emplace_back(std::move(name), std::move(setup));
+}
+
+std::vector<BenchmarkResult> Runner::Run(const RunnerOptions &options) const {
+    using Clock = std::chrono::steady_clock;
+    std::vector<BenchmarkResult> results;
+    for (const auto &[name, setup]: benchmarks_) {
+        if (name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        BenchmarkBody body = setup();
+        // Warm up caches and lazily initialized state
+        body();
+
+        BenchmarkResult result{name, 0, 0, 0, 0};
+        auto start = Clock::now();
+        auto elapsed = Clock::duration::zero();
+        do {
+            Work work = body();
+            result.ops += work.ops;
+            result.bytes += work.bytes;
+            ++result.calls;
+            elapsed = Clock::now() - start;
+        } while (elapsed < options.minTime);
+        result.seconds = std::chrono::duration<double>(elapsed).count();
+        results.push_back(std::move(result));
+    }
+    return results;
+}
+
+
+/// Reports
+
+std::string Bench::FormatTable(const std::vector<BenchmarkResult> &results) {
+    std::string table = fmt::format("{:<36} {:>10} {:>12} {:>16} {:>14}", "benchmark", "calls", "ns/op", "ops/s", "bytes/s");
+    for (const auto &result: results) {
+        double nanosPerOp = result.ops ? result.seconds * 1e9 / result.ops : 0;
+        table += fmt::format("\n{:<36} {:>10} {:>12.2f} {:>16} {:>14}", result.name, result.calls, nanosPerOp,
+                             FormatRate(result.OpsPerSecond(), "op/s"),
+                             result.bytes ? FormatRate(result.BytesPerSecond(), "B/s") : "-");
+    }
+    return table;
+}
+
+std::string Bench::FormatCSV(const std::vector<BenchmarkResult> &results) {
+    std::string csv = "benchmark,calls,seconds,ops,bytes,ops_per_second,bytes_per_second";
+    for (const auto &result: results) {
+        csv += fmt::format("\n{},{},{:.6f},{},{},{:.2f},{:.2f}", result.name, result.calls, result.seconds,
+                           result.ops, result.bytes, result.OpsPerSecond(), result.BytesPerSecond());
+    }
+    return csv;
+}
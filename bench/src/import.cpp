@@ -0,0 +1,174 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <chrono>
+#include <ctime>
+#include <memory>
+
+#include <sys/resource.h>
+
+#include <binaryninjaapi.h>
+#include <fmt/format.h>
+
+#include <binja/debuginfo/lazy_function.h>
+#include <binja/debuginfo/plugin_dsym.h>
+#include <binja/debuginfo/sink.h>
+#include <binja/types/errors.h>
+#include <binja/utils/binary_view.h>
+#include <binja/utils/executor.h>
+#include <binja/utils/metrics.h>
+
+#include "import.h"
+
+using namespace Binja;
+using namespace Bench;
+
+using BinaryNinja::BinaryView;
+using BinaryNinja::Ref;
+
+namespace {
+
+struct NullProgressMonitor : DebugInfo::DwarfImportProgressMonitor {
+    bool operator()(DebugInfo::DwarfImportPhase, size_t, size_t) override {
+        return true;
+    }
+};
+
+uint64_t GetPeakRSSBytes() {
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    // Linux reports kilobytes
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+double GetCPUSeconds() {
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+}
+
+std::vector<ImportPhaseResult> CollectPhases() {
+    Json::Value report = Utils::Metrics::Instance().ToJson();
+    std::vector<ImportPhaseResult> phases;
+    for (const auto &entry: report["phases"]) {
+        const Json::Value &counters = entry["counters"];
+        phases.push_back(ImportPhaseResult{
+            .name = entry["name"].asString(),
+            .calls = entry["calls"].asUInt64(),
+            .wallSeconds = entry["wallSeconds"].asDouble(),
+            .cpuSeconds = entry["cpuSeconds"].asDouble(),
+            .typesBuilt = counters[Utils::CounterName(Utils::Counter::TypesBuilt)].asUInt64(),
+            .symbolsAdded = counters[Utils::CounterName(Utils::Counter::SymbolsAdded)].asUInt64(),
+        });
+    }
+    return phases;
+}
+
+std::string FormatRow(const ImportConfig &config, size_t run, std::string_view phase,
+                      uint64_t calls, double wallSeconds, double cpuSeconds,
+                      uint64_t types, uint64_t symbols, uint64_t peakRSSBytes) {
+    double typesPerSecond = wallSeconds > 0 ? types / wallSeconds : 0;
+    return fmt::format("{},{},{},{},{},{},{:.6f},{:.6f},{},{},{:.1f},{}\n",
+                       ImportSinkName(config.sink), config.useCache ? "on" : "off",
+                       config.numThreads, run, phase, calls, wallSeconds, cpuSeconds,
+                       types, symbols, typesPerSecond, peakRSSBytes);
+}
+
+}// namespace
+
+const char *Bench::ImportSinkName(ImportSink sink) {
+    switch (sink) {
+        case ImportSink::Headless:
+            return "headless";
+        case ImportSink::BinaryNinja:
+            return "binja";
+    }
+    return "unknown";
+}
+
+ImportResult Bench::RunImport(const ImportConfig &config) {
+    Utils::SetSharedExecutorThreadCount(config.numThreads);
+
+    Json::Value options{Json::objectValue};
+    options["binjaKC.debugInfo.symbolsDirectory"] = config.symbols.string();
+    options["binjaKC.debugInfo.useManifest"] = config.useCache;
+    if (!config.manifestDirectory.empty()) {
+        options["binjaKC.debugInfo.manifestDirectory"] = config.manifestDirectory.string();
+    }
+    Ref<BinaryView> bv = Utils::OpenBinaryView(config.binary.string(), false, nullptr, nullptr, options);
+    if (!bv) {
+        throw Types::GenericException{"failed to open binary view for {}", config.binary.string()};
+    }
+
+    // Opening the view is not part of the import
+    Utils::Metrics::Instance().Reset();
+
+    NullProgressMonitor monitor;
+    DebugInfo::PluginDSYM plugin{*bv};
+    Ref<BinaryNinja::DebugInfo> debugInfo;
+    std::unique_ptr<DebugInfo::BinaryNinjaDebugInfoSink> binjaSink;
+    if (config.sink == ImportSink::BinaryNinja) {
+        debugInfo = bv->GetDebugInfo();
+        binjaSink = std::make_unique<DebugInfo::BinaryNinjaDebugInfoSink>(*debugInfo);
+    }
+    DebugInfo::CountingDebugInfoSink sink{binjaSink.get()};
+
+    double cpuStart = GetCPUSeconds();
+    auto wallStart = std::chrono::steady_clock::now();
+    plugin.Load(sink, monitor);
+    auto wallEnd = std::chrono::steady_clock::now();
+    double cpuEnd = GetCPUSeconds();
+    // Functions left to decode lazily are not part of the import, and
+    // warming must not outlive Binary Ninja
+    DebugInfo::LazyFunctionImporter::Detach(*bv);
+
+    return ImportResult{
+        .phases = CollectPhases(),
+        .wallSeconds = std::chrono::duration<double>(wallEnd - wallStart).count(),
+        .cpuSeconds = cpuEnd - cpuStart,
+        .numTypes = sink.GetTypeCount(),
+        .numFunctions = sink.GetFunctionCount(),
+        .numDataVariables = sink.GetDataVariableCount(),
+        .peakRSSBytes = GetPeakRSSBytes(),
+    };
+}
+
+std::string Bench::FormatImportCSVHeader() {
+    return "sink,cache,threads,run,phase,calls,wall_seconds,cpu_seconds,"
+           "types,symbols,types_per_second,peak_rss_bytes\n";
+}
+
+std::string Bench::FormatImportCSV(const ImportConfig &config, size_t run, const ImportResult &result) {
+    std::string csv;
+    for (const auto &phase: result.phases) {
+        csv += FormatRow(config, run, phase.name, phase.calls, phase.wallSeconds, phase.cpuSeconds,
+                         phase.typesBuilt, phase.symbolsAdded, result.peakRSSBytes);
+    }
+    // Totals count the records that reached the sink
+    csv += FormatRow(config, run, "total", 1, result.wallSeconds, result.cpuSeconds,
+                     result.numTypes, result.numFunctions + result.numDataVariables,
+                     result.peakRSSBytes);
+    return csv;
+}
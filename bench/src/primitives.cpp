@@ -0,0 +1,446 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <cstring>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+
+#include <fmt/format.h>
+#include <llvm/DebugInfo/DWARF/DWARFContext.h>
+#include <llvm/Object/ObjectFile.h>
+
+#include <binja/debuginfo/scanner.h>
+#include <binja/debuginfo/slider.h>
+#include <binja/kcview/pac.h>
+#include <binja/kcview/range.h>
+#include <binja/macho/macho.h>
+#include <binja/synth/dsym.h>
+#include <binja/synth/kernelcache.h>
+#include <binja/synth/writer.h>
+#include <binja/types/errors.h>
+#include <binja/utils/demangle.h>
+#include <binja/utils/interval_map.h>
+#include <binja/utils/span_reader.h>
+
+#include "harness.h"
+#include "primitives.h"
+
+using namespace Binja;
+using namespace Bench;
+
+namespace {
+
+constexpr uint64_t kSeed = 0x62656e6368;
+constexpr size_t kQueriesPerCall = 4096;
+constexpr size_t kNumIntervals = 1 << 16;
+constexpr uint64_t kIntervalBase = 0xfffffe0007004000ULL;
+constexpr uint64_t kIntervalStride = 0x1000;
+constexpr size_t kReaderBufferSize = 1 << 20;
+constexpr size_t kNumULEB128Values = 1 << 16;
+constexpr size_t kNumMangledNames = 4096;
+
+std::vector<uint64_t> RandomKeys(uint64_t base, uint64_t length, uint64_t seed) {
+    std::mt19937_64 random{seed};
+    std::vector<uint64_t> keys(kQueriesPerCall);
+    for (auto &key: keys) {
+        key = base + random() % length;
+    }
+    return keys;
+}
+
+std::shared_ptr<std::vector<char>> RandomBuffer(size_t size) {
+    std::mt19937_64 random{kSeed};
+    auto buffer = std::make_shared<std::vector<char>>(size);
+    for (auto &byte: *buffer) {
+        byte = static_cast<char>(random());
+    }
+    return buffer;
+}
+
+/// Kernelcache shared by the Mach-O benchmarks, sized so that decoding it
+/// takes long enough to measure but generating it stays quick
+const Synth::SyntheticKernelCache &KernelCache() {
+    static const Synth::SyntheticKernelCache kc = [] {
+        Synth::KernelCacheOptions options;
+        options.numFilesets = 32;
+        options.dataSegmentsPerFileset = 2;
+        options.pagesPerSegment = 8;
+        options.symbolsPerFileset = 2048;
+        options.functionStartsPerFileset = 4096;
+        options.chainedPointersPerPage = 128;
+        options.pacPointersPerPage = 128;
+        options.seed = kSeed;
+        return Synth::GenerateKernelCache(options);
+    }();
+    return kc;
+}
+
+
+/// Lookup structures
+
+void RegisterLookupBenchmarks(Runner &runner) {
+    // Half of every interval is mapped, so about half of the queries miss
+    uint64_t range = kNumIntervals * kIntervalStride;
+
+    runner.Add("interval_map.find", [=] {
+        auto map = std::make_shared<Utils::IntervalMap<uint64_t, uint64_t>>();
+        for (size_t i = 0; i < kNumIntervals; ++i) {
+            uint64_t start = kIntervalBase + i * kIntervalStride;
+            map->insert({start, start + kIntervalStride / 2}, i);
+        }
+        auto keys = RandomKeys(kIntervalBase, range, kSeed);
+        return [map, keys] {
+            size_t hits = 0;
+            for (uint64_t key: keys) {
+                hits += map->find(key) != map->end();
+            }
+            DoNotOptimize(hits);
+            return Work{keys.size(), 0};
+        };
+    });
+
+    runner.Add("range_map.query", [=] {
+        auto map = std::make_shared<KCView::RangeMap<uint64_t, uint64_t>>();
+        for (size_t i = 0; i < kNumIntervals; ++i) {
+            uint64_t start = kIntervalBase + i * kIntervalStride;
+            map->Insert({start, start + kIntervalStride / 2}, i);
+        }
+        auto keys = RandomKeys(kIntervalBase, range, kSeed);
+        return [map, keys] {
+            size_t hits = 0;
+            for (uint64_t key: keys) {
+                hits += map->Query(key) != nullptr;
+            }
+            DoNotOptimize(hits);
+            return Work{keys.size(), 0};
+        };
+    });
+
+    runner.Add("address_slider.slide", [] {
+        // Segment sized mappings, like the ones built from dSYM segments
+        constexpr size_t kNumSegments = 256;
+        constexpr uint64_t kSegmentSize = 0x100000;
+        constexpr uint64_t kSlide = 0x20000;
+        auto slider = std::make_shared<DebugInfo::AddressSlider>();
+        for (size_t i = 0; i < kNumSegments; ++i) {
+            uint64_t start = kIntervalBase + i * kSegmentSize;
+            slider->Map({start, start + kSegmentSize}, {start + kSlide, start + kSlide + kSegmentSize});
+        }
+        auto keys = RandomKeys(kIntervalBase, kNumSegments * kSegmentSize, kSeed);
+        return [slider, keys] {
+            uint64_t sum = 0;
+            for (uint64_t key: keys) {
+                sum += slider->SlideAddress(key).value_or(0);
+            }
+            DoNotOptimize(sum);
+            return Work{keys.size(), 0};
+        };
+    });
+}
+
+
+/// Readers
+
+void RegisterReaderBenchmarks(Runner &runner) {
+    runner.Add("data_reader.read_u64", [] {
+        auto buffer = RandomBuffer(kReaderBufferSize);
+        auto backend = std::make_shared<MachO::MachSpanDataBackend>(std::span<const char>{*buffer});
+        return [buffer, backend] {
+            MachO::Detail::DataReader reader{backend.get(), 0};
+            uint64_t sum = 0;
+            size_t count = buffer->size() / sizeof(uint64_t);
+            for (size_t i = 0; i < count; ++i) {
+                sum += reader.Read<uint64_t>();
+            }
+            DoNotOptimize(sum);
+            return Work{count, count * sizeof(uint64_t)};
+        };
+    });
+
+    runner.Add("span_reader.read_u64", [] {
+        auto buffer = RandomBuffer(kReaderBufferSize);
+        return [buffer] {
+            Utils::SpanReader reader{std::span<const char>{*buffer}};
+            uint64_t sum = 0;
+            size_t count = buffer->size() / sizeof(uint64_t);
+            for (size_t i = 0; i < count; ++i) {
+                sum += *reader.Read<uint64_t>();
+            }
+            DoNotOptimize(sum);
+            return Work{count, count * sizeof(uint64_t)};
+        };
+    });
+
+    runner.Add("macho.decode_uleb128", [] {
+        // Mostly short values like function start deltas with a tail of
+        // values spanning up to 8 bytes
+        std::mt19937_64 random{kSeed};
+        auto buffer = std::make_shared<std::vector<char>>();
+        Synth::ByteWriter writer{*buffer, 0};
+        for (size_t i = 0; i < kNumULEB128Values; ++i) {
+            writer.WriteULEB128(random() >> (8 + random() % 56));
+        }
+        auto backend = std::make_shared<MachO::MachSpanDataBackend>(std::span<const char>{*buffer});
+        return [buffer, backend] {
+            MachO::Detail::DataReader reader{backend.get(), 0};
+            uint64_t sum = 0;
+            for (size_t i = 0; i < kNumULEB128Values; ++i) {
+                sum += MachO::Detail::DecodeULEB128(reader);
+            }
+            DoNotOptimize(sum);
+            return Work{kNumULEB128Values, buffer->size()};
+        };
+    });
+}
+
+
+/// Mach-O decoders
+
+void RegisterMachOBenchmarks(Runner &runner) {
+    auto backend = [] {
+        const auto &kc = KernelCache();
+        return std::make_shared<MachO::MachSpanDataBackend>(std::span<const char>{kc.data});
+    };
+
+    // Runs decode on the parser of every fileset
+    auto addFilesetBenchmark = [&](std::string name, auto decode) {
+        runner.Add(std::move(name), [=] {
+            auto data = backend();
+            auto filesets = MachO::MachHeaderParser{*data, 0}.DecodeFilesets();
+            return [data, filesets, decode] {
+                size_t count = 0;
+                for (const auto &fileset: filesets) {
+                    MachO::MachHeaderParser parser{*data, fileset.fileOffset};
+                    count += decode(parser).size();
+                }
+                return Work{count, 0};
+            };
+        });
+    };
+
+    runner.Add("macho.decode_filesets", [=] {
+        auto data = backend();
+        return [data] {
+            auto filesets = MachO::MachHeaderParser{*data, 0}.DecodeFilesets();
+            return Work{filesets.size(), 0};
+        };
+    });
+    addFilesetBenchmark("macho.decode_segments", [](MachO::MachHeaderParser &parser) {
+        return parser.DecodeSegments();
+    });
+    addFilesetBenchmark("macho.decode_symbols", [](MachO::MachHeaderParser &parser) {
+        return parser.DecodeSymbols();
+    });
+    addFilesetBenchmark("macho.decode_function_starts", [](MachO::MachHeaderParser &parser) {
+        return parser.DecodeFunctionStarts();
+    });
+
+    runner.Add("macho.decode_chained_fixups", [=] {
+        auto data = backend();
+        // Chains are walked through every page of the data segments
+        uint64_t dataBytes = 0;
+        for (const auto &segment: MachO::MachHeaderParser{*data, 0}.DecodeSegments()) {
+            if (segment.name.starts_with("__DATA")) {
+                dataBytes += segment.dataLength;
+            }
+        }
+        return [data, dataBytes] {
+            auto pointers = MachO::MachHeaderParser{*data, 0}.DecodeDyldChainedPtrs();
+            return Work{pointers.size(), dataBytes};
+        };
+    });
+
+    runner.Add("kcview.scan_pac_pointers", [] {
+        // Same checks as the PAC stripping pass of the kernelcache view
+        // over the data segments of the image
+        const auto &kc = KernelCache();
+        MachO::MachSpanDataBackend data{std::span<const char>{kc.data}};
+        auto segments = std::make_shared<KCView::RangeMap<uint64_t, uint64_t>>();
+        auto words = std::make_shared<std::vector<uint64_t>>();
+        for (const auto &segment: MachO::MachHeaderParser{data, 0}.DecodeSegments()) {
+            segments->Insert({segment.vaStart, segment.vaStart + segment.vaLength}, segment.dataStart);
+            if (segment.name.starts_with("__DATA")) {
+                size_t start = words->size();
+                words->resize(start + segment.dataLength / sizeof(uint64_t));
+                memcpy(words->data() + start, kc.data.data() + segment.dataStart, segment.dataLength);
+            }
+        }
+        uint64_t vaStart = kc.vmBase;
+        uint64_t vaEnd = kc.vmBase + kc.data.size();
+        return [segments, words, vaStart, vaEnd] {
+            size_t numPointers = 0;
+            for (uint64_t word: *words) {
+                auto address = KCView::StripPointerAuth(word);
+                if (address && *address >= vaStart && *address < vaEnd && segments->Query(*address)) {
+                    ++numPointers;
+                }
+            }
+            DoNotOptimize(numPointers);
+            return Work{words->size(), words->size() * sizeof(uint64_t)};
+        };
+    });
+}
+
+
+/// DWARF scanning
+
+struct DwarfObject {
+    std::vector<char> data;
+    std::unique_ptr<llvm::object::ObjectFile> object;
+};
+
+std::shared_ptr<DwarfObject> OpenDwarfObject() {
+    Synth::DSYMOptions options;
+    options.unitsPerObject = 16;
+    options.structsPerUnit = 128;
+    options.seed = kSeed;
+    auto dsyms = Synth::GenerateDSYMs(KernelCache(), options);
+
+    auto result = std::make_shared<DwarfObject>();
+    result->data = std::move(dsyms.front().data);
+    llvm::MemoryBufferRef buffer{llvm::StringRef{result->data.data(), result->data.size()}, dsyms.front().name};
+    auto object = llvm::object::ObjectFile::createObjectFile(buffer);
+    if (!object) {
+        llvm::consumeError(object.takeError());
+        throw Types::GenericException{"failed to open synthetic dSYM {}", dsyms.front().name};
+    }
+    result->object = std::move(*object);
+    return result;
+}
+
+void RegisterDwarfBenchmarks(Runner &runner) {
+    // Both read the tag and name of every DIE the way the name indexing
+    // pass does, from a fresh context so that llvm DIE extraction is paid
+    runner.Add("dwarf.scan_units", [] {
+        auto object = OpenDwarfObject();
+        return [object] {
+            auto context = llvm::DWARFContext::create(*object->object);
+            DebugInfo::DwarfScanner scanner{DebugInfo::DieScanFields{.name = true, .references = true}};
+            size_t numDies = 0;
+            size_t numNamed = 0;
+            for (const auto &unit: context->normal_units()) {
+                auto scanned = scanner.Scan(DebugInfo::DwarfUnitWrapper{*unit, 0});
+                if (!scanned) {
+                    continue;
+                }
+                numDies += scanned->Size();
+                for (auto name: scanned->names) {
+                    numNamed += !name.empty();
+                }
+            }
+            DoNotOptimize(numNamed);
+            return Work{numDies, 0};
+        };
+    });
+    runner.Add("dwarf.llvm_units", [] {
+        auto object = OpenDwarfObject();
+        return [object] {
+            auto context = llvm::DWARFContext::create(*object->object);
+            size_t numDies = 0;
+            size_t numNamed = 0;
+            for (const auto &unit: context->normal_units()) {
+                for (const auto &entry: unit->dies()) {
+                    llvm::DWARFDie die{unit.get(), &entry};
+                    ++numDies;
+                    if (die.getTag() != llvm::dwarf::DW_TAG_null) {
+                        numNamed += die.find(llvm::dwarf::DW_AT_name).hasValue();
+                    }
+                }
+            }
+            DoNotOptimize(numNamed);
+            return Work{numDies, 0};
+        };
+    });
+}
+
+
+/// Demangling
+
+std::vector<std::string> MangledNames() {
+    // Itanium encodings of kernel style C++ methods
+    const std::vector<std::string_view> classes{"IOService", "IOUserClient", "OSObject", "IOMemoryDescriptor",
+                                                "IOWorkLoop", "AppleARMIODevice", "IOPCIDevice", "OSDictionary"};
+    const std::vector<std::string_view> methods{"start", "stop", "init", "free", "getProperty", "setProperty",
+                                                "externalMethod", "registerService", "newUserClient"};
+    const std::vector<std::string_view> parameters{"v", "P9IOService", "PK8OSSymbol", "jPv", "P8OSObjectj",
+                                                   "PKcb", "mP12IOUserClient", "RK9OSMetaClassm"};
+    std::mt19937_64 random{kSeed};
+    std::vector<std::string> names;
+    for (size_t i = 0; i < kNumMangledNames; ++i) {
+        std::string_view cls = classes[random() % classes.size()];
+        std::string method = fmt::format("{}{}", methods[random() % methods.size()], i);
+        names.push_back(fmt::format("_ZN{}{}{}{}E{}", random() % 2 ? "K" : "", cls.size(), cls, method.size(),
+                                    method, parameters[random() % parameters.size()]));
+    }
+    return names;
+}
+
+void RegisterDemangleBenchmarks(Runner &runner) {
+    auto totalSize = [](const std::vector<std::string> &names) {
+        uint64_t size = 0;
+        for (const auto &name: names) {
+            size += name.size();
+        }
+        return size;
+    };
+
+    runner.Add("utils.demangle", [=] {
+        auto names = MangledNames();
+        uint64_t bytes = totalSize(names);
+        return [names, bytes] {
+            size_t length = 0;
+            for (const auto &name: names) {
+                length += Utils::Demangle(name).size();
+            }
+            DoNotOptimize(length);
+            return Work{names.size(), bytes};
+        };
+    });
+
+    runner.Add("utils.demangle_cached", [=] {
+        auto names = MangledNames();
+        uint64_t bytes = totalSize(names);
+        auto cache = std::make_shared<Utils::DemangleCache>();
+        return [names, bytes, cache] {
+            size_t length = 0;
+            for (const auto &name: names) {
+                if (auto result = Utils::DemangleName(name, cache.get())) {
+                    length += result->fullName.size();
+                }
+            }
+            DoNotOptimize(length);
+            return Work{names.size(), bytes};
+        };
+    });
+}
+
+}// namespace
+
+
+void Bench::RegisterPrimitiveBenchmarks(Runner &runner) {
+    RegisterLookupBenchmarks(runner);
+    RegisterReaderBenchmarks(runner);
+    RegisterMachOBenchmarks(runner);
+    RegisterDwarfBenchmarks(runner);
+    RegisterDemangleBenchmarks(runner);
+}
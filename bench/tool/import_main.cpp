@@ -0,0 +1,340 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <binaryninjaapi.h>
+#include <binaryninjacore.h>
+#include <fmt/format.h>
+
+#include <binja/bench/import.h>
+#include <binja/kcview/lib.h>
+#include <binja/synth/dsym.h>
+#include <binja/synth/kernelcache.h>
+#include <binja/types/errors.h>
+#include <binja/utils/settings.h>
+
+extern char **environ;
+
+using namespace Binja;
+namespace fs = std::filesystem;
+namespace BN = BinaryNinja;
+
+namespace {
+
+// Invalid command line, reported together with the usage
+class ArgumentError : public Types::GenericException {
+    using Types::GenericException::GenericException;
+};
+
+struct DriverOptions {
+    fs::path binary;
+    fs::path symbols;
+    fs::path synthetic;
+    fs::path workDirectory = fs::temp_directory_path() / "binja_kc_bench_import";
+    fs::path output;
+    std::vector<size_t> threads;
+    std::vector<bool> caches{true, false};
+    std::vector<Bench::ImportSink> sinks{Bench::ImportSink::Headless, Bench::ImportSink::BinaryNinja};
+    size_t repeat = 1;
+    size_t numFilesets = 4;
+    size_t unitsPerObject = 4;
+
+    // Set when running a single configuration on behalf of the driver
+    fs::path childResult;
+    size_t childRun = 0;
+};
+
+void PrintUsage(const char *program) {
+    std::cerr << "USAGE: " << program << " (--binary <kernelcache> --symbols <KDK> | --synthetic <directory>) [--<option> <value>]...\n"
+              << "options:\n"
+              << "  --threads <n,...>          worker thread counts, default powers of two up to the core count\n"
+              << "  --cache <on|off,...>       import with the KDK manifest, default on,off\n"
+              << "  --sink <headless|binja,...> destination of imported records, default headless,binja\n"
+              << "  --repeat <n>               runs per configuration, default 1\n"
+              << "  --work-dir <directory>     directory holding manifests, default under the temp directory\n"
+              << "  --output <file>            CSV output, default stdout\n"
+              << "  --filesets <n>             filesets of the --synthetic corpus, default 4\n"
+              << "  --units <n>                compile units per dSYM of the --synthetic corpus, default 4\n";
+}
+
+size_t ParseSize(std::string_view option, std::string_view value) {
+    size_t result = 0;
+    auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (error != std::errc{} || end != value.data() + value.size()) {
+        throw ArgumentError{"invalid value {} for option {}", value, option};
+    }
+    return result;
+}
+
+std::vector<std::string_view> SplitList(std::string_view value) {
+    std::vector<std::string_view> items;
+    while (true) {
+        size_t comma = value.find(',');
+        items.push_back(value.substr(0, comma));
+        if (comma == std::string_view::npos) {
+            return items;
+        }
+        value.remove_prefix(comma + 1);
+    }
+}
+
+bool ParseCache(std::string_view option, std::string_view value) {
+    if (value == "on") {
+        return true;
+    }
+    if (value == "off") {
+        return false;
+    }
+    throw ArgumentError{"invalid value {} for option {}", value, option};
+}
+
+Bench::ImportSink ParseSink(std::string_view option, std::string_view value) {
+    if (value == "headless") {
+        return Bench::ImportSink::Headless;
+    }
+    if (value == "binja") {
+        return Bench::ImportSink::BinaryNinja;
+    }
+    throw ArgumentError{"invalid value {} for option {}", value, option};
+}
+
+DriverOptions ParseArguments(int argc, const char **argv) {
+    DriverOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view option = argv[i];
+        if (i + 1 >= argc) {
+            throw ArgumentError{"missing value for option {}", option};
+        }
+        std::string_view value = argv[++i];
+        if (option == "--binary") {
+            options.binary = value;
+        } else if (option == "--symbols") {
+            options.symbols = value;
+        } else if (option == "--synthetic") {
+            options.synthetic = value;
+        } else if (option == "--work-dir") {
+            options.workDirectory = value;
+        } else if (option == "--output") {
+            options.output = value;
+        } else if (option == "--threads") {
+            options.threads.clear();
+            for (auto item: SplitList(value)) {
+                options.threads.push_back(ParseSize(option, item));
+            }
+        } else if (option == "--cache") {
+            options.caches.clear();
+            for (auto item: SplitList(value)) {
+                options.caches.push_back(ParseCache(option, item));
+            }
+        } else if (option == "--sink") {
+            options.sinks.clear();
+            for (auto item: SplitList(value)) {
+                options.sinks.push_back(ParseSink(option, item));
+            }
+        } else if (option == "--repeat") {
+            options.repeat = ParseSize(option, value);
+        } else if (option == "--filesets") {
+            options.numFilesets = ParseSize(option, value);
+        } else if (option == "--units") {
+            options.unitsPerObject = ParseSize(option, value);
+        } else if (option == "--child-result") {
+            options.childResult = value;
+        } else if (option == "--child-run") {
+            options.childRun = ParseSize(option, value);
+        } else {
+            throw ArgumentError{"unknown option {}", option};
+        }
+    }
+
+    if (options.threads.empty()) {
+        size_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+        for (size_t count = 1; count < hardwareThreads; count *= 2) {
+            options.threads.push_back(count);
+        }
+        options.threads.push_back(hardwareThreads);
+    }
+    if (options.synthetic.empty() && (options.binary.empty() || options.symbols.empty())) {
+        throw ArgumentError{"missing option --binary and --symbols or --synthetic"};
+    }
+    return options;
+}
+
+void GenerateCorpus(DriverOptions &options) {
+    Synth::KernelCacheOptions kcOptions;
+    kcOptions.numFilesets = options.numFilesets;
+    Synth::DSYMOptions dsymOptions;
+    dsymOptions.unitsPerObject = options.unitsPerObject;
+
+    std::error_code ec;
+    fs::create_directories(options.synthetic / "KDK", ec);
+    if (ec) {
+        throw Types::GenericException{"failed to create directory {}, error: {}", options.synthetic.string(), ec.message()};
+    }
+
+    auto kc = Synth::GenerateKernelCache(kcOptions);
+    Synth::WriteImage(options.synthetic / "kernelcache", kc.data);
+    for (const auto &dsym: Synth::GenerateDSYMs(kc, dsymOptions)) {
+        Synth::WriteDSYMBundle(options.synthetic / "KDK", dsym);
+    }
+    options.binary = options.synthetic / "kernelcache";
+    options.symbols = options.synthetic / "KDK";
+}
+
+/// Runs one configuration in a fresh process, so that the shared executor
+/// is sized for it and peak RSS is not inherited from earlier runs
+void SpawnRun(const char *program, const DriverOptions &options, const Bench::ImportConfig &config,
+              size_t run, const fs::path &result) {
+    std::vector<std::string> args{
+        program,
+        "--binary", options.binary.string(),
+        "--symbols", options.symbols.string(),
+        "--work-dir", options.workDirectory.string(),
+        "--threads", std::to_string(config.numThreads),
+        "--cache", config.useCache ? "on" : "off",
+        "--sink", Bench::ImportSinkName(config.sink),
+        "--child-run", std::to_string(run),
+        "--child-result", result.string(),
+    };
+    std::vector<char *> argPointers;
+    for (auto &arg: args) {
+        argPointers.push_back(arg.data());
+    }
+    argPointers.push_back(nullptr);
+
+    pid_t pid = 0;
+    if (int error = posix_spawnp(&pid, program, nullptr, nullptr, argPointers.data(), environ)) {
+        throw Types::GenericException{"failed to spawn {}, error: {}", program, strerror(error)};
+    }
+    int status = 0;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        throw Types::GenericException{"import with {} threads, cache {}, sink {} failed",
+                                      config.numThreads, config.useCache ? "on" : "off",
+                                      Bench::ImportSinkName(config.sink)};
+    }
+}
+
+int RunChild(const DriverOptions &options) {
+    BN::SetBundledPluginDirectory(BNGetBundledPluginDirectory());
+    BN::InitPlugins(true);
+    Utils::BinjaSettings::Register();
+    KCView::CorePluginInit();
+
+    Bench::ImportConfig config{
+        .binary = options.binary,
+        .symbols = options.symbols,
+        .manifestDirectory = options.workDirectory / "manifest",
+        .numThreads = options.threads.front(),
+        .useCache = options.caches.front(),
+        .sink = options.sinks.front(),
+    };
+    auto result = Bench::RunImport(config);
+
+    std::ofstream stream{options.childResult, std::ios::trunc};
+    stream << Bench::FormatImportCSV(config, options.childRun, result);
+    BNShutdown();
+    return stream ? 0 : 1;
+}
+
+int RunDriver(const char *program, DriverOptions &options) {
+    if (!options.synthetic.empty()) {
+        GenerateCorpus(options);
+    }
+
+    // Manifests of earlier invocations would hide the cost of building one
+    std::error_code ec;
+    fs::remove_all(options.workDirectory, ec);
+    fs::create_directories(options.workDirectory, ec);
+    if (ec) {
+        throw Types::GenericException{"failed to create directory {}, error: {}", options.workDirectory.string(), ec.message()};
+    }
+    fs::path result = options.workDirectory / "result.csv";
+
+    std::ostringstream csv;
+    csv << Bench::FormatImportCSVHeader();
+    bool manifestBuilt = false;
+    for (bool useCache: options.caches) {
+        for (auto sink: options.sinks) {
+            for (size_t numThreads: options.threads) {
+                Bench::ImportConfig config{.numThreads = numThreads, .useCache = useCache, .sink = sink};
+                if (useCache && !manifestBuilt) {
+                    // Unmeasured run building the manifest, so that cached runs measure hits
+                    SpawnRun(program, options, config, 0, result);
+                    manifestBuilt = true;
+                }
+                for (size_t run = 1; run <= options.repeat; ++run) {
+                    SpawnRun(program, options, config, run, result);
+                    std::ifstream stream{result};
+                    csv << stream.rdbuf();
+                    std::cerr << fmt::format("finished run {} with {} threads, cache {}, sink {}\n",
+                                             run, numThreads, useCache ? "on" : "off",
+                                             Bench::ImportSinkName(sink));
+                }
+            }
+        }
+    }
+
+    if (options.output.empty()) {
+        std::cout << csv.str();
+        return 0;
+    }
+    std::ofstream stream{options.output, std::ios::trunc};
+    stream << csv.str();
+    return stream ? 0 : 1;
+}
+
+}// namespace
+
+int main(int argc, const char **argv) {
+    DriverOptions options;
+    try {
+        options = ParseArguments(argc, argv);
+    } catch (const ArgumentError &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    try {
+        if (!options.childResult.empty()) {
+            return RunChild(options);
+        }
+        return RunDriver(argv[0], options);
+    } catch (const fs::filesystem_error &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
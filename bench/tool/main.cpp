@@ -0,0 +1,70 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <charconv>
+#include <iostream>
+#include <string_view>
+
+#include <fmt/format.h>
+
+#include <binja/bench/harness.h>
+#include <binja/bench/primitives.h>
+
+using namespace Binja;
+
+namespace {
+
+void PrintUsage(const char *program) {
+    std::cerr << "USAGE: " << program << " [--filter <substring>] [--min-time <ms>] [--csv]\n";
+}
+
+}// namespace
+
+int main(int argc, const char **argv) {
+    Bench::RunnerOptions options;
+    bool csv = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--csv") {
+            csv = true;
+        } else if (arg == "--filter" && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            std::string_view value = argv[++i];
+            uint64_t millis = 0;
+            auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), millis);
+            if (error != std::errc{} || end != value.data() + value.size()) {
+                std::cerr << "Error: invalid value " << value << " for option --min-time\n";
+                return 1;
+            }
+            options.minTime = std::chrono::milliseconds{millis};
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    Bench::Runner runner;
+    Bench::RegisterPrimitiveBenchmarks(runner);
+    auto results = runner.Run(options);
+    fmt::print("{}\n", csv ? Bench::FormatCSV(results) : Bench::FormatTable(results));
+    return 0;
+}
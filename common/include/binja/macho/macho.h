@@ -71,7 +71,7 @@ private:
 
 class MachSpanDataBackend : public MachDataBackend {
 public:
-    explicit MachSpanDataBackend(const std::span<char>& base) : base_{base} {}
+    explicit MachSpanDataBackend(std::span<const char> base) : base_{base} {}
 
     size_t GetStart() const override {
         return 0;
@@ -91,7 +91,7 @@ public:
     }
 
 private:
-    const std::span<char>& base_;
+    std::span<const char> base_;
 };
 
 }// namespace Binja::MachO
@@ -166,6 +166,8 @@ private:
     uint64_t offset_;
 };
 
+uint64_t DecodeULEB128(DataReader &reader);
+
 }// namespace Binja::MachO::Detail
 
 namespace Binja::MachO {
@@ -237,6 +239,20 @@ private:
 };
 
 
+struct MachObjectInfo {
+    uint32_t cpuType;
+    uint32_t fileType;
+    std::optional<Types::UUID> uuid;
+    std::vector<Segment> segments;
+};
+
+/// Decodes LC_UUID and segments of a thin Mach-O, or of the slice matching
+/// cpuType in a fat Mach-O, touching only the headers and load commands.
+/// Returns nullopt if data is not a native byte order 64-bit Mach-O with the
+/// requested CPU type.
+std::optional<MachObjectInfo> ProbeMachObject(std::span<const char> data, uint32_t cpuType);
+
+
 class MachBinaryView {
 public:
     MachBinaryView(BinaryNinja::BinaryView &binaryView) : binaryView_{binaryView} {}
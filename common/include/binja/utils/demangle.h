@@ -21,10 +21,70 @@
 
 #pragma once
 
+#include <array>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace Binja::Utils {
 
+struct DemangledName {
+    /// Demangled name without parameters or return type (for example
+    /// `IOService::start`). Equal to `fullName` if the symbol is not a
+    /// function encoding.
+    std::string shortName;
+    /// Complete demangled name (for example `IOService::start(IOService*)`)
+    std::string fullName;
+    bool isFunction;
+};
+
+/// Thread safe memo of demangling results keyed by mangled name. The same
+/// mangled names appear in several filesets of a kernel collection, so a
+/// single cache may be shared by multiple `DemangleBatch` calls.
+class DemangleCache {
+public:
+    std::optional<std::optional<DemangledName>> Find(std::string_view name) const;
+    void Insert(std::string_view name, const std::optional<DemangledName> &result);
+
+    size_t Size() const;
+
+private:
+    struct StringHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view value) const { return std::hash<std::string_view>{}(value); }
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, std::optional<DemangledName>, StringHash, std::equal_to<>> entries;
+    };
+
+    static constexpr size_t kShardCount = 32;
+
+    Shard &ShardFor(std::string_view name);
+    const Shard &ShardFor(std::string_view name) const;
+
+    std::array<Shard, kShardCount> shards_;
+};
+
+/// Parses an Itanium mangled name once and renders both the short and full
+/// names from the same AST. Parser state and output buffer are reused per
+/// thread. Returns `std::nullopt` if `name` cannot be demangled.
+std::optional<DemangledName> DemangleName(std::string_view name);
+
+/// Same as `DemangleName`, consulting and updating `cache` when it is not null
+std::optional<DemangledName> DemangleName(std::string_view name, DemangleCache *cache);
+
+/// Demangles `names` in parallel. Result at index `i` corresponds to
+/// `names[i]`. When `cache` is not null, it is consulted before parsing
+/// and updated with new results.
+std::vector<std::optional<DemangledName>> DemangleBatch(std::span<const std::string_view> names, DemangleCache *cache = nullptr);
+
+/// Returns the full demangled name, or `name` if it cannot be demangled
 std::string Demangle(const std::string &name);
 
 }
@@ -0,0 +1,43 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <taskflow/taskflow.hpp>
+
+namespace Binja::Utils {
+
+/// Returns the executor shared by every parallel path of the plugin. It is
+/// created on first use with the number of threads configured by the
+/// `binjaKC.workerThreadCount` setting.
+tf::Executor &GetSharedExecutor();
+
+/// Sizes the shared executor with `numThreads` workers instead of the
+/// `binjaKC.workerThreadCount` setting. Only effective before the first
+/// call to `GetSharedExecutor`, used by the benchmark drivers.
+void SetSharedExecutorThreadCount(size_t numThreads);
+
+/// Runs `taskflow` on the shared executor and waits for it to complete.
+/// When called from a worker of the shared executor, the worker keeps
+/// executing other tasks while waiting instead of blocking.
+void RunAndWait(tf::Taskflow &taskflow);
+
+}// namespace Binja::Utils
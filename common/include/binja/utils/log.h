@@ -21,29 +21,88 @@
 
 #pragma once
 
+#include <atomic>
+
 #include <binaryninjaapi.h>
 #include <fmt/format.h>
 
-#define BDLogDebug(...)                                                                  \
-    do {                                                                                 \
-        auto msg = fmt::format(__VA_ARGS__);                                             \
-        BinaryNinja::LogDebug("binja_dwarf: %s:%d %s", __FILE__, __LINE__, msg.c_str()); \
-    } while (0)
+namespace Binja::Utils {
+
+/// Minimum level of messages logged through the BDLog macros. Binary
+/// Ninja does not expose the level of its log listeners, so the level is
+/// taken from the `binjaKC.logLevel` setting.
+extern std::atomic<BNLogLevel> gLogLevel;
+
+inline bool IsLogLevelEnabled(BNLogLevel level) {
+    return level >= gLogLevel.load(std::memory_order_relaxed);
+}
+
+/// Reads the log level from settings
+void ReloadLogLevel();
+
+/// State of a single BDLog call site. After `kBurst` messages from a site
+/// further messages are not formatted, only counted, until the next call to
+/// `FlushSuppressedLogs`.
+class LogSite {
+public:
+    static constexpr uint64_t kBurst = 32;
+
+    LogSite(BNLogLevel level, const char *file, int line);
+
+    bool Admit() {
+        uint64_t count = count_.fetch_add(1, std::memory_order_relaxed);
+        if (count < kBurst) {
+            return true;
+        }
+        if (count == kBurst) {
+            NotifySuppressed();
+        }
+        return false;
+    }
+
+private:
+    void NotifySuppressed() const;
 
-#define BDLogWarn(...)                                                                  \
+    friend void FlushSuppressedLogs();
+
+private:
+    BNLogLevel level_;
+    const char *file_;
+    int line_;
+    std::atomic<uint64_t> count_{0};
+    LogSite *next_;
+};
+
+/// Logs the number of messages suppressed at every rate limited call site
+/// and resets the limits
+void FlushSuppressedLogs();
+
+}// namespace Binja::Utils
+
+// Arguments are only evaluated when the message is logged
+#define BD_LOG_IMPL(level, logFunction, ...)                                            \
     do {                                                                                \
-        auto msg = fmt::format(__VA_ARGS__);                                            \
-        BinaryNinja::LogWarn("binja_dwarf: %s:%d %s", __FILE__, __LINE__, msg.c_str()); \
+        if (::Binja::Utils::IsLogLevelEnabled(level)) {                                 \
+            auto msg = fmt::format(__VA_ARGS__);                                        \
+            logFunction("binja_dwarf: %s:%d %s", __FILE__, __LINE__, msg.c_str());      \
+        }                                                                               \
     } while (0)
 
-#define BDLogInfo(...)                                                                  \
+#define BD_LOG_RATE_LIMITED_IMPL(level, logFunction, ...)                               \
     do {                                                                                \
-        auto msg = fmt::format(__VA_ARGS__);                                            \
-        BinaryNinja::LogInfo("binja_dwarf: %s:%d %s", __FILE__, __LINE__, msg.c_str()); \
+        if (::Binja::Utils::IsLogLevelEnabled(level)) {                                 \
+            static ::Binja::Utils::LogSite bdLogSite{level, __FILE__, __LINE__};        \
+            if (bdLogSite.Admit()) {                                                    \
+                auto msg = fmt::format(__VA_ARGS__);                                    \
+                logFunction("binja_dwarf: %s:%d %s", __FILE__, __LINE__, msg.c_str());  \
+            }                                                                           \
+        }                                                                               \
     } while (0)
 
-#define BDLogError(...)                                                                  \
-    do {                                                                                 \
-        auto msg = fmt::format(__VA_ARGS__);                                             \
-        BinaryNinja::LogError("binja_dwarf: %s:%d %s", __FILE__, __LINE__, msg.c_str()); \
-    } while (0)
+#define BDLogDebug(...) BD_LOG_RATE_LIMITED_IMPL(BNLogLevel::DebugLog, BinaryNinja::LogDebug, __VA_ARGS__)
+
+#define BDLogWarn(...) BD_LOG_RATE_LIMITED_IMPL(BNLogLevel::WarningLog, BinaryNinja::LogWarn, __VA_ARGS__)
+
+#define BDLogInfo(...) BD_LOG_IMPL(BNLogLevel::InfoLog, BinaryNinja::LogInfo, __VA_ARGS__)
+
+#define BDLogError(...) BD_LOG_IMPL(BNLogLevel::ErrorLog, BinaryNinja::LogError, __VA_ARGS__)
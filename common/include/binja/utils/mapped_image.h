@@ -0,0 +1,142 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <mio/mmap.hpp>
+
+#include "../types/errors.h"
+
+namespace Binja::Utils {
+
+/// Bytes of a serialized image that is used in place, either built in
+/// memory or memory mapped from a file. An image is a header starting with
+/// an 8 byte magic and a 32 bit version, followed by sections aligned to
+/// kAlignment so that arrays of words are read without copying. Views into
+/// the image stay valid when the owning MappedImage is moved.
+class MappedImage {
+public:
+    class ImageError : public Types::DecodeError {
+        using Types::DecodeError::DecodeError;
+    };
+
+    static constexpr size_t kAlignment = 8;
+
+    /// Appends the header and sections of an image
+    class Writer {
+    public:
+        template<class Header>
+        explicit Writer(const Header &header) { Append(&header, sizeof(header)); }
+
+        /// Appends the elements of a contiguous range as the next section
+        template<class Range>
+        void AppendSection(const Range &values) {
+            Append(std::data(values), std::size(values) * sizeof(*std::data(values)));
+        }
+        void Append(const void *bytes, size_t size);
+
+        [[nodiscard]] MappedImage Finish() &&;
+
+    private:
+        std::vector<char> image_;
+    };
+
+    /// Reads the header and the sections of an image in the order they were
+    /// appended, every read is bounds checked
+    class Reader {
+    public:
+        /// `kind` names the image in errors
+        Reader(std::span<const char> image, std::string_view kind)
+            : image_{image}, kind_{kind} {}
+
+        /// Reads the header and verifies its magic and version
+        template<class Header>
+        Header ReadHeader(const char (&magic)[8], uint32_t version);
+        template<class T>
+        std::span<const T> ReadSection(uint64_t count);
+
+    private:
+        std::span<const char> ReadBytes(uint64_t count, size_t elementSize);
+
+    private:
+        std::span<const char> image_;
+        std::string kind_;
+        size_t offset_ = 0;
+    };
+
+public:
+    MappedImage() = default;
+
+    /// Maps the image saved at `path`, `kind` names it in errors
+    static MappedImage Open(const std::filesystem::path &path, std::string_view kind);
+    /// Writes the image next to `path` and renames it into place, so that
+    /// a partially written image is never opened. Returns false when the
+    /// image could not be written.
+    bool Save(const std::filesystem::path &path, std::string_view kind) const;
+
+    [[nodiscard]] std::span<const char> GetImage() const { return image_; }
+    [[nodiscard]] size_t GetSize() const { return image_.size(); }
+
+private:
+    static size_t AlignSize(size_t size) { return (size + kAlignment - 1) & ~(kAlignment - 1); }
+
+private:
+    std::vector<char> buffer_;
+    mio::mmap_source file_;
+    std::span<const char> image_;
+};
+
+template<class Header>
+Header MappedImage::Reader::ReadHeader(const char (&magic)[8], uint32_t version) {
+    static_assert(offsetof(Header, version) == 8, "image headers start with the magic and the version");
+    if (image_.size() < sizeof(Header)) {
+        throw ImageError{"{} too small, size: {}", kind_, image_.size()};
+    }
+    Header header;
+    memcpy(&header, image_.data(), sizeof(header));
+    if (memcmp(header.magic, magic, sizeof(magic)) != 0) {
+        throw ImageError{"invalid {} magic", kind_};
+    }
+    if (header.version != version) {
+        throw ImageError{"unsupported {} version {}", kind_, header.version};
+    }
+    offset_ = std::min(AlignSize(sizeof(header)), image_.size());
+    return header;
+}
+
+template<class T>
+std::span<const T> MappedImage::Reader::ReadSection(uint64_t count) {
+    std::span<const char> bytes = ReadBytes(count, sizeof(T));
+    return {reinterpret_cast<const T *>(bytes.data()), count};
+}
+
+}// namespace Binja::Utils
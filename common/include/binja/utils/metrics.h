@@ -0,0 +1,131 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include <binaryninjaapi.h>
+
+namespace Binja::Utils {
+
+enum class Counter {
+    DiesVisited,
+    TypesBuilt,
+    CacheHits,
+    SymbolsAdded,
+    BytesRead,
+    Max,
+};
+
+const char *CounterName(Counter counter);
+
+/// Accumulated measurements of every run of a named import phase
+struct PhaseStats {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> wallNanos{0};
+    std::atomic<uint64_t> cpuNanos{0};
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::Max)> counters{};
+
+    void Reset();
+};
+
+/// Process wide registry of import phase measurements. Entries are never
+/// removed, so references returned by `GetPhase` stay valid for the lifetime
+/// of the plugin.
+class Metrics {
+public:
+    static Metrics &Instance();
+
+    PhaseStats &GetPhase(std::string_view name);
+    void Reset();
+
+    Json::Value ToJson() const;
+    bool WriteReport(const std::filesystem::path &path) const;
+
+private:
+    mutable std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<PhaseStats>, std::less<>> phases_;
+};
+
+/// Records wall time and CPU time of the enclosing scope under the phase
+/// `name`. Counters added through `CountMetric` on the same thread while the
+/// scope is active are attributed to the innermost phase.
+///
+/// CPU time is the CPU time of the thread the phase was opened on, so phases
+/// opened by concurrent tasks do not count each other's work. Work a phase
+/// hands to other threads is only counted by the phases opened there, and
+/// tasks the thread runs while a `PausePhase` is active are not counted.
+class ScopedPhase {
+public:
+    explicit ScopedPhase(std::string_view name);
+    ~ScopedPhase();
+
+    ScopedPhase(const ScopedPhase &) = delete;
+    ScopedPhase &operator=(const ScopedPhase &) = delete;
+
+    void Add(Counter counter, uint64_t value = 1) {
+        stats_.counters[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+    }
+
+private:
+    friend class PausePhase;
+
+    void Pause();
+    void Resume();
+
+    PhaseStats &stats_;
+    ScopedPhase *parent_;
+    std::chrono::steady_clock::time_point wallStart_;
+    uint64_t cpuStartNanos_;
+};
+
+/// Stops charging CPU time and counters to the phases active on the calling
+/// thread while in scope. Used while a thread waits on a taskflow,
+/// since the executor runs other tasks on the waiting thread.
+class PausePhase {
+public:
+    PausePhase();
+    ~PausePhase();
+
+    PausePhase(const PausePhase &) = delete;
+    PausePhase &operator=(const PausePhase &) = delete;
+
+private:
+    ScopedPhase *phase_;
+};
+
+/// Adds `value` to `counter` of the innermost phase active on the calling
+/// thread. Does nothing if no phase is active.
+void CountMetric(Counter counter, uint64_t value = 1);
+
+/// Writes the metrics collected so far to the path configured by the
+/// `binjaKC.metricsReportPath` setting. Does nothing if no path is configured.
+void WriteMetricsReport(BinaryNinja::BinaryView &bv);
+
+}// namespace Binja::Utils
@@ -0,0 +1,72 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <binaryninjaapi.h>
+
+namespace Binja::Utils {
+
+struct SegmentRange {
+    uint64_t start;
+    uint64_t end;
+    uint32_t flags;
+
+    bool Contains(uint64_t addr) const {
+        return addr >= start && addr < end;
+    }
+
+    bool ContainsCode() const {
+        return flags & BNSegmentFlag::SegmentContainsCode;
+    }
+};
+
+/// Snapshot of the segments of a binary view as a flat sorted interval table.
+/// Lookups do not cross the Binary Ninja API, so the table is cheap to query
+/// for every symbol of a kernel collection.
+class SegmentTable {
+public:
+    SegmentTable() = default;
+    explicit SegmentTable(std::vector<SegmentRange> ranges);
+
+    static SegmentTable FromBinaryView(BinaryNinja::BinaryView &binaryView);
+
+    /// Returns the segment containing `addr` or null if there is none
+    const SegmentRange *Find(uint64_t addr) const;
+
+    /// Classifies `addresses`, which are expected to be sorted in ascending
+    /// order, in a single merge pass. Entry `i` of the result is the segment
+    /// containing `addresses[i]` or null if there is none.
+    std::vector<const SegmentRange *> FindSorted(std::span<const uint64_t> addresses) const;
+
+    const std::vector<SegmentRange> &Ranges() const {
+        return ranges_;
+    }
+
+private:
+    std::vector<SegmentRange> ranges_;
+};
+
+}// namespace Binja::Utils
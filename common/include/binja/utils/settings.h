@@ -13,6 +13,11 @@ public:
     explicit BinjaSettings(BNBinaryView* bvObj, BNSettings* settingsObj)
         : bvObj_{bvObj}, settingsObj_{settingsObj} {}
 
+    const uint64_t WorkerThreadCount() const;
+    const std::optional<std::string> MetricsReportPath() const;
+    const std::optional<std::string> TraceEventPath() const;
+    const BNLogLevel LogLevel() const;
+
     const bool KCApplyDyldChainedFixups() const;
     const bool KCStripPAC() const;
     const std::vector<std::string> KCExcludedFilesets() const;
@@ -20,11 +25,16 @@ public:
     const bool KCSymbolicateKallocTypes() const;
 
     const std::optional<std::string> DebugInfoSymbolsSearchPath() const;
+    const bool DebugInfoUseManifest() const;
+    const std::optional<std::string> DebugInfoManifestDirectory() const;
+    const bool DebugInfoCombinedImport() const;
 
     const bool DWARFEnabled() const;
     const bool DWARFLoadTypes() const;
     const bool DWARFLoadDataVariables() const;
     const bool DWARFLoadFunctions() const;
+    const bool DWARFLazyFunctions() const;
+    const bool DWARFParallelTypes() const;
 
     const bool MachoEnabled() const;
     const bool MachoLoadDataVariables() const;
@@ -0,0 +1,124 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+#include <taskflow/taskflow.hpp>
+
+namespace Binja::Utils {
+
+/// Collects spans in the Chrome trace event format, which can be opened in
+/// chrome://tracing or https://ui.perfetto.dev. Recording is enabled by the
+/// `binjaKC.traceEventPath` setting when the plugin is loaded.
+class TraceRecorder {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Event {
+        std::string name;
+        std::string_view category;
+        Clock::time_point start;
+        Clock::duration duration;
+        uint32_t threadId;
+    };
+
+    static TraceRecorder &Instance();
+
+    bool IsEnabled() const { return path_.has_value(); }
+
+    void Record(Event event);
+    void NameThread(uint32_t threadId, std::string name);
+    void Reset();
+    bool Write(const std::filesystem::path &path) const;
+
+    const std::optional<std::filesystem::path> &GetPath() const { return path_; }
+
+    /// Small sequential id of the calling thread, stable for its lifetime
+    static uint32_t CurrentThreadId();
+
+private:
+    TraceRecorder();
+
+private:
+    std::optional<std::filesystem::path> path_;
+    Clock::time_point epoch_;
+    mutable std::mutex mutex_;
+    std::vector<Event> events_;
+    std::vector<std::pair<uint32_t, std::string>> threadNames_;
+};
+
+/// Records a span covering the enclosing scope. The name is only formatted
+/// when recording is enabled.
+class ScopedTrace {
+public:
+    template<class... Args>
+    ScopedTrace(std::string_view category, fmt::format_string<Args...> format, Args &&...args) {
+        if (TraceRecorder::Instance().IsEnabled()) {
+            event_.emplace(TraceRecorder::Event{
+                .name = fmt::format(format, std::forward<Args>(args)...),
+                .category = category,
+                .start = TraceRecorder::Clock::now(),
+                .duration = {},
+                .threadId = TraceRecorder::CurrentThreadId()});
+        }
+    }
+
+    ~ScopedTrace() {
+        if (event_) {
+            event_->duration = TraceRecorder::Clock::now() - event_->start;
+            TraceRecorder::Instance().Record(std::move(*event_));
+        }
+    }
+
+    ScopedTrace(const ScopedTrace &) = delete;
+    ScopedTrace &operator=(const ScopedTrace &) = delete;
+
+private:
+    std::optional<TraceRecorder::Event> event_;
+};
+
+/// Records a span for every task run by the executor it is attached to
+class TaskflowTraceObserver : public tf::ObserverInterface {
+public:
+    void set_up(size_t numWorkers) override;
+    void on_entry(tf::WorkerView worker, tf::TaskView task) override;
+    void on_exit(tf::WorkerView worker, tf::TaskView task) override;
+
+private:
+    // Tasks of a worker nest when it runs other tasks while waiting on a
+    // taskflow, so the start times form a stack
+    std::vector<std::vector<TraceRecorder::Clock::time_point>> starts_;
+    std::vector<uint8_t> named_;
+};
+
+/// Writes the spans recorded so far to the path configured by the
+/// `binjaKC.traceEventPath` setting. Does nothing if recording is disabled.
+void WriteTraceEvents();
+
+}// namespace Binja::Utils
@@ -20,6 +20,7 @@
 
 
 #include <llvm/Object/MachO.h>
+#include <llvm/Support/SwapByteOrder.h>
 
 #include "macho/macho.h"
 #include "utils/demangle.h"
@@ -358,22 +359,18 @@ std::vector<Symbol> MachHeaderParser::DecodeSymbols() {
     return result;
 }
 
-namespace {
-
-uint64_t DecodeULEB128(Detail::DataReader &reader) {
+uint64_t Detail::DecodeULEB128(Detail::DataReader &reader) {
     uint64_t result = 0;
     uint64_t shift = 0;
     uint8_t byte = 0;
     do {
         byte = reader.Read<uint8_t>();
-        result |= ((byte & 0x7f) << shift);
+        result |= static_cast<uint64_t>(byte & 0x7f) << shift;
         shift += 7;
     } while ((byte & 0x80) != 0);
     return result;
 }
 
-}// namespace
-
 std::vector<uint64_t> MachHeaderParser::DecodeFunctionStarts() {
     std::vector<uint64_t> result;
     if (auto cmd = FindCommand<linkedit_data_command>(LC_FUNCTION_STARTS)) {
@@ -381,7 +378,7 @@ std::vector<uint64_t> MachHeaderParser::DecodeFunctionStarts() {
         uint64_t cursor = *FindVMBase();
         size_t end = dataReader.Offset() + cmd->datasize;
         while (dataReader.Offset() < end) {
-            uint64_t value = DecodeULEB128(dataReader);
+            uint64_t value = Detail::DecodeULEB128(dataReader);
             cursor += value;
             result.push_back(cursor);
         }
@@ -431,51 +428,27 @@ std::vector<DyldChainedPtr> MachHeaderParser::DecodeDyldChainedPtrs() {
             }
             switch (startsInSegmentHeader.pointer_format) {
                 case DYLD_CHAINED_PTR_64_KERNEL_CACHE: {
-                    union PtrARM64e {
-                        uint64_t raw;
-                        dyld_chained_ptr_arm64e_rebase rebase;
-                        dyld_chained_ptr_arm64e_bind bind;
-                        dyld_chained_ptr_arm64e_auth_rebase auth_rebase;
-                        dyld_chained_ptr_arm64e_auth_bind auth_bind;
-                    };
                     Detail::DataReader ptrReader{
                         &data_,
                         startsInSegmentHeader.segment_offset + pageIndex * startsInSegmentHeader.page_size + offsetInPage};
                     while (true) {
-                        auto ptr = ptrReader.Peek<PtrARM64e>();
-                        bool auth = ptr.rebase.auth;
-                        bool bind = ptr.rebase.bind;
-                        auto next = ptr.rebase.next;
-
-                        if (auth && bind) {
-                            BDLogWarn("Cannot fixup chained pointer with both auth and bind set "
-                                      "at offset {:#016x}", ptrReader.Offset());
-                        } else if (auth) {
-                            auto address = vmBase + ptr.auth_rebase.target;
-                            result.emplace_back(DyldChainedPtr{
-                                .fileOffset = ptrReader.Offset(),
-                                .value = address,
-                            });
-                        } else if (bind) {
-                            BDLogWarn("Cannot chained pointer with bind set "
-                                      "at offset {:#016x}", ptrReader.Offset());
+                        // Authenticated and plain rebases both hold the offset
+                        // of the target from the cache level base
+                        auto ptr = ptrReader.Peek<dyld_chained_ptr_64_kernel_cache_rebase>();
+                        if (ptr.cacheLevel != 0) {
+                            BDLogWarn("Cannot fixup chained pointer to cache level {} "
+                                      "at offset {:#016x}", static_cast<uint32_t>(ptr.cacheLevel), ptrReader.Offset());
                         } else {
-                            auto top8Bits = (ptr.raw >> 43) & 0xFFL;
-                            auto bottom43Bits = ptr.raw & 0x000007FFFFFFFFFFL;
-                            if (top8Bits == 0x80) {
-                                top8Bits = 0;
-                            }
-                            auto address = vmBase + ((top8Bits << 56) | bottom43Bits);
                             result.emplace_back(DyldChainedPtr{
                                 .fileOffset = ptrReader.Offset(),
-                                .value = address,
+                                .value = vmBase + ptr.target,
                             });
                         }
 
-                        if (next == 0) {
+                        if (ptr.next == 0) {
                             break;
                         }
-                        ptrReader.Seek(next * 4);
+                        ptrReader.Seek(ptr.next * 4);
                     }
                     break;
                 }
@@ -522,6 +495,53 @@ std::optional<uint64_t> MachHeaderParser::FindVMBase() {
     return std::nullopt;
 }
 
+/// Mach object probe
+
+std::optional<MachObjectInfo> MachO::ProbeMachObject(std::span<const char> data, uint32_t cpuType) {
+    MachSpanDataBackend backend{data};
+    Detail::DataReader reader{&backend, 0};
+    uint32_t magic = reader.Peek<uint32_t>();
+
+    uint64_t sliceOffset = 0;
+    if (magic == FAT_CIGAM || magic == FAT_CIGAM_64) {
+        auto header = reader.Read<fat_header>();
+        uint32_t numArchs = llvm::sys::getSwappedBytes(header.nfat_arch);
+        std::optional<uint64_t> matchingOffset;
+        for (uint32_t i = 0; i < numArchs && !matchingOffset; ++i) {
+            if (magic == FAT_CIGAM_64) {
+                auto arch = reader.Read<fat_arch_64>();
+                if (llvm::sys::getSwappedBytes(arch.cputype) == cpuType) {
+                    matchingOffset = llvm::sys::getSwappedBytes(arch.offset);
+                }
+            } else {
+                auto arch = reader.Read<fat_arch>();
+                if (llvm::sys::getSwappedBytes(arch.cputype) == cpuType) {
+                    matchingOffset = llvm::sys::getSwappedBytes(arch.offset);
+                }
+            }
+        }
+        if (!matchingOffset) {
+            return std::nullopt;
+        }
+        sliceOffset = *matchingOffset;
+    }
+
+    auto header = Detail::DataReader{&backend, sliceOffset}.Peek<mach_header_64>();
+    // Load commands are decoded in host byte order, so byte swapped objects are not supported
+    if (header.magic != MH_MAGIC_64 || header.cputype != cpuType) {
+        return std::nullopt;
+    }
+
+    MachHeaderParser parser{backend, sliceOffset};
+    return MachObjectInfo{
+        .cpuType = header.cputype,
+        .fileType = header.filetype,
+        .uuid = parser.DecodeUUID(),
+        .segments = parser.DecodeSegments(),
+    };
+}
+
+
 /// Mach binary view
 
 std::vector<uint64_t> MachBinaryView::ReadMachOHeaderOffsets() {
@@ -19,18 +19,262 @@
 // SOFTWARE.
 
 
-#include <cxxabi.h>
+#include <cstdlib>
+#include <functional>
+
+#include <llvm/Demangle/ItaniumDemangle.h>
+#include <taskflow/taskflow.hpp>
 
 #include "utils/demangle.h"
+#include "utils/executor.h"
+#include "utils/metrics.h"
+
+using namespace Binja;
+using namespace Utils;
+
+namespace LD = llvm::itanium_demangle;
+
+/// LLVM demangler
+
+namespace {
+
+// Arena used by the thread local parser. Unlike the allocator bundled with
+// LLVM, blocks grown while parsing a name are retained across `reset` so that
+// demangling a stream of names does not go back to malloc for each of them.
+class BumpPointerAllocator {
+    struct BlockMeta {
+        BlockMeta *next;
+        size_t current;
+    };
+
+    static constexpr size_t kAllocSize = 16384;
+    static constexpr size_t kUsableAllocSize = kAllocSize - sizeof(BlockMeta);
+    static constexpr size_t kMaxSpareBlocks = 8;
+
+    alignas(long double) char initialBuffer_[kAllocSize];
+    BlockMeta *blockList_ = nullptr;
+    BlockMeta *spareList_ = nullptr;
+    size_t spareCount_ = 0;
+
+    void Grow() {
+        char *newMeta;
+        if (spareList_) {
+            newMeta = reinterpret_cast<char *>(spareList_);
+            spareList_ = spareList_->next;
+            --spareCount_;
+        } else {
+            newMeta = static_cast<char *>(std::malloc(kAllocSize));
+            if (newMeta == nullptr)
+                std::terminate();
+        }
+        blockList_ = new (newMeta) BlockMeta{blockList_, 0};
+    }
+
+    void *AllocateMassive(size_t size) {
+        size += sizeof(BlockMeta);
+        auto *newMeta = reinterpret_cast<BlockMeta *>(std::malloc(size));
+        if (newMeta == nullptr)
+            std::terminate();
+        // Massive blocks are marked with `SIZE_MAX` so that `reset` does not
+        // recycle them as regular blocks
+        blockList_->next = new (newMeta) BlockMeta{blockList_->next, SIZE_MAX};
+        return static_cast<void *>(newMeta + 1);
+    }
+
+public:
+    BumpPointerAllocator()
+        : blockList_(new (initialBuffer_) BlockMeta{nullptr, 0}) {}
+
+    BumpPointerAllocator(const BumpPointerAllocator &) = delete;
+    BumpPointerAllocator &operator=(const BumpPointerAllocator &) = delete;
+
+    void *allocate(size_t size) {
+        size = (size + 15u) & ~15u;
+        if (size + blockList_->current >= kUsableAllocSize) {
+            if (size > kUsableAllocSize)
+                return AllocateMassive(size);
+            Grow();
+        }
+        blockList_->current += size;
+        return static_cast<void *>(reinterpret_cast<char *>(blockList_ + 1) + blockList_->current - size);
+    }
+
+    void reset() {
+        while (blockList_) {
+            BlockMeta *block = blockList_;
+            blockList_ = blockList_->next;
+            if (reinterpret_cast<char *>(block) == initialBuffer_) {
+                continue;
+            }
+            if (block->current != SIZE_MAX && spareCount_ < kMaxSpareBlocks) {
+                block->next = spareList_;
+                spareList_ = block;
+                ++spareCount_;
+            } else {
+                std::free(block);
+            }
+        }
+        blockList_ = new (initialBuffer_) BlockMeta{nullptr, 0};
+    }
+
+    ~BumpPointerAllocator() {
+        reset();
+        while (spareList_) {
+            BlockMeta *block = spareList_;
+            spareList_ = spareList_->next;
+            std::free(block);
+        }
+    }
+};
+
+class DefaultAllocator {
+    BumpPointerAllocator alloc_;
+
+public:
+    void reset() { alloc_.reset(); }
+
+    template<typename T, typename... Args>
+    T *makeNode(Args &&...args) {
+        return new (alloc_.allocate(sizeof(T))) T(std::forward<Args>(args)...);
+    }
+
+    void *allocateNodeArray(size_t size) {
+        return alloc_.allocate(sizeof(LD::Node *) * size);
+    }
+};
+
+// Parser and output buffer owned by a single thread. Both are reset before
+// demangling each name instead of being constructed again.
+class ThreadDemangler {
+public:
+    ThreadDemangler() : parser_{nullptr, nullptr} {
+        if (!LD::initializeOutputBuffer(nullptr, nullptr, output_, 1024)) {
+            std::terminate();
+        }
+    }
 
-std::string Binja::Utils::Demangle(const std::string& name) {
-    int status = 0;
-    char* ret = abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status);
-    if (status) {
-        return name;
+    ThreadDemangler(const ThreadDemangler &) = delete;
+    ThreadDemangler &operator=(const ThreadDemangler &) = delete;
+
+    ~ThreadDemangler() {
+        std::free(output_.getBuffer());
+    }
+
+    std::optional<DemangledName> Demangle(std::string_view name) {
+        parser_.reset(name.data(), name.data() + name.size());
+        LD::Node *root = parser_.parse();
+        if (!root) {
+            return std::nullopt;
+        }
+
+        DemangledName result;
+        result.fullName = Print(root);
+        result.isFunction = root->getKind() == LD::Node::KFunctionEncoding;
+        if (result.isFunction) {
+            result.shortName = Print(static_cast<LD::FunctionEncoding *>(root)->getName());
+        } else {
+            result.shortName = result.fullName;
+        }
+        return result;
+    }
+
+private:
+    std::string Print(const LD::Node *node) {
+        output_.setCurrentPosition(0);
+        node->print(output_);
+        return std::string{output_.getBuffer(), output_.getCurrentPosition()};
+    }
+
+    LD::ManglingParser<DefaultAllocator> parser_;
+    LD::OutputBuffer output_;
+};
+
+ThreadDemangler &GetThreadDemangler() {
+    thread_local ThreadDemangler demangler;
+    return demangler;
+}
+
+}// namespace
+
+/// DemangleCache
+
+DemangleCache::Shard &DemangleCache::ShardFor(std::string_view name) {
+    return shards_[StringHash{}(name) % kShardCount];
+}
+
+const DemangleCache::Shard &DemangleCache::ShardFor(std::string_view name) const {
+    return shards_[StringHash{}(name) % kShardCount];
+}
+
+std::optional<std::optional<DemangledName>> DemangleCache::Find(std::string_view name) const {
+    const Shard &shard = ShardFor(name);
+    std::lock_guard lock{shard.mutex};
+    auto it = shard.entries.find(name);
+    if (it == shard.entries.end()) {
+        return std::nullopt;
     }
+    return it->second;
+}
 
-    std::string result{ret};
-    free(ret);
+void DemangleCache::Insert(std::string_view name, const std::optional<DemangledName> &result) {
+    Shard &shard = ShardFor(name);
+    std::lock_guard lock{shard.mutex};
+    shard.entries.try_emplace(std::string{name}, result);
+}
+
+size_t DemangleCache::Size() const {
+    size_t size = 0;
+    for (const Shard &shard: shards_) {
+        std::lock_guard lock{shard.mutex};
+        size += shard.entries.size();
+    }
+    return size;
+}
+
+/// Demangling
+
+std::optional<DemangledName> Utils::DemangleName(std::string_view name) {
+    return GetThreadDemangler().Demangle(name);
+}
+
+std::optional<DemangledName> Utils::DemangleName(std::string_view name, DemangleCache *cache) {
+    if (!cache) {
+        return DemangleName(name);
+    }
+    if (auto cached = cache->Find(name)) {
+        CountMetric(Counter::CacheHits);
+        return std::move(*cached);
+    }
+    auto result = DemangleName(name);
+    cache->Insert(name, result);
     return result;
-}
\ No newline at end of file
+}
+
+std::vector<std::optional<DemangledName>> Utils::DemangleBatch(std::span<const std::string_view> names, DemangleCache *cache) {
+    std::vector<std::optional<DemangledName>> results(names.size());
+
+    auto demangle = [&](size_t i) {
+        results[i] = DemangleName(names[i], cache);
+    };
+
+    // Spinning up workers is not worth it for a handful of names
+    static constexpr size_t kSerialThreshold = 256;
+    if (names.size() < kSerialThreshold) {
+        for (size_t i = 0; i < names.size(); ++i) {
+            demangle(i);
+        }
+        return results;
+    }
+
+    tf::Taskflow taskflow;
+    taskflow.for_each_index(size_t{0}, names.size(), size_t{1}, demangle);
+    Utils::RunAndWait(taskflow);
+    return results;
+}
+
+std::string Utils::Demangle(const std::string &name) {
+    if (auto result = DemangleName(name)) {
+        return std::move(result->fullName);
+    }
+    return name;
+}
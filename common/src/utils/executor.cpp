@@ -0,0 +1,89 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <binaryninjaapi.h>
+
+#include "utils/executor.h"
+#include "utils/log.h"
+#include "utils/metrics.h"
+#include "utils/settings.h"
+#include "utils/trace.h"
+
+using namespace Binja;
+using namespace Utils;
+
+namespace {
+
+std::atomic<size_t> sharedExecutorThreadCount{0};
+
+size_t GetWorkerThreadCount() {
+    if (size_t count = sharedExecutorThreadCount.load()) {
+        return count;
+    }
+
+    auto bnSettings = BinaryNinja::Settings::Instance();
+    BinjaSettings settings{nullptr, bnSettings->GetObject()};
+    if (uint64_t count = settings.WorkerThreadCount()) {
+        return count;
+    }
+
+    // Leave the threads used by Binary Ninja analysis workers to them
+    size_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    size_t analysisThreads = BinaryNinja::GetWorkerThreadCount();
+    size_t spareThreads = hardwareThreads > analysisThreads ? hardwareThreads - analysisThreads : 0;
+    return std::max(spareThreads, size_t{1});
+}
+
+}// namespace
+
+tf::Executor &Utils::GetSharedExecutor() {
+    static std::once_flag once;
+    static std::unique_ptr<tf::Executor> executor;
+    std::call_once(once, [] {
+        size_t numThreads = GetWorkerThreadCount();
+        BDLogInfo("creating shared executor with {} worker threads", numThreads);
+        executor = std::make_unique<tf::Executor>(numThreads);
+        if (TraceRecorder::Instance().IsEnabled()) {
+            executor->make_observer<TaskflowTraceObserver>();
+        }
+    });
+    return *executor;
+}
+
+void Utils::SetSharedExecutorThreadCount(size_t numThreads) {
+    sharedExecutorThreadCount = numThreads;
+}
+
+void Utils::RunAndWait(tf::Taskflow &taskflow) {
+    tf::Executor &executor = GetSharedExecutor();
+    PausePhase pause;
+    if (executor.this_worker_id() >= 0) {
+        executor.corun(taskflow);
+    } else {
+        executor.run(taskflow).wait();
+    }
+}
@@ -0,0 +1,64 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "utils/log.h"
+#include "utils/settings.h"
+
+using namespace Binja;
+using namespace Utils;
+
+namespace {
+
+// Call sites register themselves on first use and are never removed
+std::atomic<LogSite *> logSites{nullptr};
+
+}// namespace
+
+// Everything is logged until settings are registered
+std::atomic<BNLogLevel> Utils::gLogLevel{BNLogLevel::DebugLog};
+
+void Utils::ReloadLogLevel() {
+    auto bnSettings = BinaryNinja::Settings::Instance();
+    BinjaSettings settings{nullptr, bnSettings->GetObject()};
+    gLogLevel.store(settings.LogLevel(), std::memory_order_relaxed);
+}
+
+/// Log site
+
+LogSite::LogSite(BNLogLevel level, const char *file, int line)
+    : level_{level}, file_{file}, line_{line}, next_{logSites.load(std::memory_order_relaxed)} {
+    while (!logSites.compare_exchange_weak(next_, this, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+void LogSite::NotifySuppressed() const {
+    BinaryNinja::Log(level_, "binja_dwarf: %s:%d suppressing further messages, repeats will be counted",
+                     file_, line_);
+}
+
+void Utils::FlushSuppressedLogs() {
+    for (LogSite *site = logSites.load(std::memory_order_acquire); site; site = site->next_) {
+        uint64_t count = site->count_.exchange(0, std::memory_order_relaxed);
+        if (count > LogSite::kBurst) {
+            BinaryNinja::Log(site->level_, "binja_dwarf: %s:%d suppressed %llu repeated messages",
+                             site->file_, site->line_, static_cast<unsigned long long>(count - LogSite::kBurst));
+        }
+    }
+}
@@ -0,0 +1,96 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <fstream>
+
+#include "utils/files.h"
+#include "utils/log.h"
+#include "utils/mapped_image.h"
+
+using namespace Binja;
+using namespace Utils;
+
+namespace fs = std::filesystem;
+
+
+/// Writer
+
+void MappedImage::Writer::Append(const void *bytes, size_t size) {
+    image_.insert(image_.end(), static_cast<const char *>(bytes), static_cast<const char *>(bytes) + size);
+    image_.resize(AlignSize(image_.size()));
+}
+
+MappedImage MappedImage::Writer::Finish() && {
+    MappedImage image;
+    image.buffer_ = std::move(image_);
+    image.image_ = {image.buffer_.data(), image.buffer_.size()};
+    return image;
+}
+
+
+/// Reader
+
+std::span<const char> MappedImage::Reader::ReadBytes(uint64_t count, size_t elementSize) {
+    if (count > (image_.size() - offset_) / elementSize) {
+        throw ImageError{"{} section at {:#x} out of bounds", kind_, offset_};
+    }
+    std::span<const char> result = image_.subspan(offset_, count * elementSize);
+    offset_ = std::min(AlignSize(offset_ + count * elementSize), image_.size());
+    return result;
+}
+
+
+/// Mapped image
+
+MappedImage MappedImage::Open(const fs::path &path, std::string_view kind) {
+    std::error_code ec;
+    MappedImage image;
+    image.file_.map(path.string(), ec);
+    if (ec) {
+        throw ImageError{"failed to open {} {}, error: {}", kind, path.string(), ec.message()};
+    }
+    image.image_ = {image.file_.data(), image.file_.size()};
+    return image;
+}
+
+bool MappedImage::Save(const fs::path &path, std::string_view kind) const {
+    // Concurrent saves of the same image each write their own file
+    fs::path temporaryPath = MakeTemporaryPath(path);
+    std::error_code ec;
+    {
+        std::ofstream stream{temporaryPath, std::ios::binary | std::ios::trunc};
+        if (stream) {
+            stream.write(image_.data(), static_cast<std::streamsize>(image_.size()));
+        }
+        if (!stream) {
+            BDLogWarn("failed to write {} {}", kind, path.string());
+            fs::remove(temporaryPath, ec);
+            return false;
+        }
+    }
+    fs::rename(temporaryPath, path, ec);
+    if (ec) {
+        BDLogWarn("failed to write {} {}, error: {}", kind, path.string(), ec.message());
+        fs::remove(temporaryPath, ec);
+        return false;
+    }
+    return true;
+}
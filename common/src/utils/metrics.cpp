@@ -0,0 +1,215 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <ctime>
+#include <fstream>
+
+#include "utils/log.h"
+#include "utils/metrics.h"
+#include "utils/settings.h"
+
+using namespace Binja;
+using namespace Utils;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int kReportVersion = 1;
+
+thread_local ScopedPhase *currentPhase = nullptr;
+
+uint64_t GetThreadCPUNanos() {
+    timespec time{};
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0) {
+        return 0;
+    }
+    return static_cast<uint64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+double NanosToSeconds(uint64_t nanos) {
+    return static_cast<double>(nanos) / 1e9;
+}
+
+}// namespace
+
+const char *Utils::CounterName(Counter counter) {
+    switch (counter) {
+        case Counter::DiesVisited:
+            return "diesVisited";
+        case Counter::TypesBuilt:
+            return "typesBuilt";
+        case Counter::CacheHits:
+            return "cacheHits";
+        case Counter::SymbolsAdded:
+            return "symbolsAdded";
+        case Counter::BytesRead:
+            return "bytesRead";
+        case Counter::Max:
+            break;
+    }
+    return "unknown";
+}
+
+/// Phase stats
+
+void PhaseStats::Reset() {
+    calls = 0;
+    wallNanos = 0;
+    cpuNanos = 0;
+    for (auto &counter: counters) {
+        counter = 0;
+    }
+}
+
+/// Metrics
+
+Metrics &Metrics::Instance() {
+    static Metrics instance;
+    return instance;
+}
+
+PhaseStats &Metrics::GetPhase(std::string_view name) {
+    std::lock_guard lock{mutex_};
+    auto it = phases_.find(name);
+    if (it == phases_.end()) {
+        it = phases_.emplace(std::string{name}, std::make_unique<PhaseStats>()).first;
+    }
+    return *it->second;
+}
+
+void Metrics::Reset() {
+    std::lock_guard lock{mutex_};
+    for (auto &[_, stats]: phases_) {
+        stats->Reset();
+    }
+}
+
+Json::Value Metrics::ToJson() const {
+    Json::Value root;
+    root["version"] = kReportVersion;
+
+    Json::Value phases{Json::arrayValue};
+    std::lock_guard lock{mutex_};
+    for (const auto &[name, stats]: phases_) {
+        uint64_t calls = stats->calls.load(std::memory_order_relaxed);
+        if (calls == 0) {
+            continue;
+        }
+        Json::Value entry;
+        entry["name"] = name;
+        entry["calls"] = Json::UInt64{calls};
+        entry["wallSeconds"] = NanosToSeconds(stats->wallNanos.load(std::memory_order_relaxed));
+        entry["cpuSeconds"] = NanosToSeconds(stats->cpuNanos.load(std::memory_order_relaxed));
+        Json::Value counters{Json::objectValue};
+        for (size_t i = 0; i < stats->counters.size(); ++i) {
+            counters[CounterName(static_cast<Counter>(i))] =
+                Json::UInt64{stats->counters[i].load(std::memory_order_relaxed)};
+        }
+        entry["counters"] = counters;
+        phases.append(entry);
+    }
+    root["phases"] = phases;
+    return root;
+}
+
+bool Metrics::WriteReport(const fs::path &path) const {
+    Json::Value root = ToJson();
+
+    fs::path temporaryPath = path;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream stream{temporaryPath, std::ios::trunc};
+        if (!stream) {
+            BDLogWarn("failed to write metrics report {}", path.string());
+            return false;
+        }
+        Json::StreamWriterBuilder builder;
+        builder["indentation"] = "  ";
+        stream << Json::writeString(builder, root);
+    }
+
+    std::error_code ec;
+    fs::rename(temporaryPath, path, ec);
+    if (ec) {
+        BDLogWarn("failed to write metrics report {}, error: {}", path.string(), ec.message());
+        return false;
+    }
+    BDLogInfo("saved metrics report {} with {} phases", path.string(), root["phases"].size());
+    return true;
+}
+
+/// Scoped phase
+
+ScopedPhase::ScopedPhase(std::string_view name)
+    : stats_{Metrics::Instance().GetPhase(name)},
+      parent_{currentPhase},
+      wallStart_{std::chrono::steady_clock::now()},
+      cpuStartNanos_{GetThreadCPUNanos()} {
+    currentPhase = this;
+}
+
+ScopedPhase::~ScopedPhase() {
+    auto wallNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - wallStart_);
+    uint64_t cpuNanos = GetThreadCPUNanos() - cpuStartNanos_;
+    stats_.calls.fetch_add(1, std::memory_order_relaxed);
+    stats_.wallNanos.fetch_add(wallNanos.count(), std::memory_order_relaxed);
+    stats_.cpuNanos.fetch_add(cpuNanos, std::memory_order_relaxed);
+    currentPhase = parent_;
+}
+
+void ScopedPhase::Pause() {
+    stats_.cpuNanos.fetch_add(GetThreadCPUNanos() - cpuStartNanos_, std::memory_order_relaxed);
+}
+
+void ScopedPhase::Resume() {
+    cpuStartNanos_ = GetThreadCPUNanos();
+}
+
+void Utils::CountMetric(Counter counter, uint64_t value) {
+    if (currentPhase) {
+        currentPhase->Add(counter, value);
+    }
+}
+
+/// Paused phase
+
+PausePhase::PausePhase() : phase_{currentPhase} {
+    for (ScopedPhase *phase = phase_; phase; phase = phase->parent_) {
+        phase->Pause();
+    }
+    currentPhase = nullptr;
+}
+
+PausePhase::~PausePhase() {
+    for (ScopedPhase *phase = phase_; phase; phase = phase->parent_) {
+        phase->Resume();
+    }
+    currentPhase = phase_;
+}
+
+void Utils::WriteMetricsReport(BinaryNinja::BinaryView &bv) {
+    auto bnSettings = BinaryNinja::Settings::Instance();
+    BinjaSettings settings{bv.GetObject(), bnSettings->GetObject()};
+    if (auto path = settings.MetricsReportPath()) {
+        Metrics::Instance().WriteReport(*path);
+    }
+}
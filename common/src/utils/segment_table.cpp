@@ -0,0 +1,94 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+
+#include "utils/log.h"
+#include "utils/segment_table.h"
+
+using namespace Binja;
+using namespace Utils;
+
+SegmentTable::SegmentTable(std::vector<SegmentRange> ranges) {
+    std::sort(ranges.begin(), ranges.end(), [](const SegmentRange &a, const SegmentRange &b) {
+        return a.start < b.start;
+    });
+
+    // Ranges must be disjoint for the binary searches, so an overlapping
+    // segment only keeps the part past the end of the segment before it
+    ranges_.reserve(ranges.size());
+    size_t numOverlaps = 0;
+    for (SegmentRange &range: ranges) {
+        if (!ranges_.empty() && range.start < ranges_.back().end) {
+            range.start = ranges_.back().end;
+            ++numOverlaps;
+        }
+        if (range.start >= range.end) {
+            continue;
+        }
+        ranges_.push_back(range);
+    }
+    if (numOverlaps) {
+        BDLogDebug("trimmed {} overlapping segments of {}", numOverlaps, ranges.size());
+    }
+}
+
+SegmentTable SegmentTable::FromBinaryView(BinaryNinja::BinaryView &binaryView) {
+    std::vector<SegmentRange> ranges;
+    for (const auto &segment: binaryView.GetSegments()) {
+        ranges.push_back(SegmentRange{
+            .start = segment->GetStart(),
+            .end = segment->GetEnd(),
+            .flags = segment->GetFlags(),
+        });
+    }
+    return SegmentTable{std::move(ranges)};
+}
+
+const SegmentRange *SegmentTable::Find(uint64_t addr) const {
+    auto it = std::upper_bound(ranges_.begin(), ranges_.end(), addr, [](uint64_t addr, const SegmentRange &range) {
+        return addr < range.start;
+    });
+    if (it == ranges_.begin()) {
+        return nullptr;
+    }
+    --it;
+    return it->Contains(addr) ? &*it : nullptr;
+}
+
+std::vector<const SegmentRange *> SegmentTable::FindSorted(std::span<const uint64_t> addresses) const {
+    std::vector<const SegmentRange *> result(addresses.size(), nullptr);
+    auto range = ranges_.begin();
+    for (size_t i = 0; i < addresses.size(); ++i) {
+        uint64_t addr = addresses[i];
+        if (i > 0 && addr < addresses[i - 1]) {
+            // Tolerate malformed input by restarting the merge
+            range = ranges_.begin();
+        }
+        while (range != ranges_.end() && range->end <= addr) {
+            ++range;
+        }
+        if (range != ranges_.end() && range->Contains(addr)) {
+            result[i] = &*range;
+        }
+    }
+    return result;
+}
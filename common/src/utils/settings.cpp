@@ -4,6 +4,7 @@
 
 #include <binaryninjaapi.h>
 
+#include "binja/utils/log.h"
 #include "binja/utils/settings.h"
 
 using namespace Binja;
@@ -22,14 +23,24 @@ using SettingsRef = BN::Ref<BN::Settings>;
 #define KC_SETTING_STRIP_PAC KC_SETTINGS_GROUP ".stripPAC"
 #define KC_SETTING_SYMBOLICATE_KALLOC_TYPES KC_SETTINGS_GROUP ".symbolicateKallocTypes"
 
+#define MAIN_SETTING_WORKER_THREAD_COUNT MAIN_SETTINGS_GROUP ".workerThreadCount"
+#define MAIN_SETTING_METRICS_REPORT_PATH MAIN_SETTINGS_GROUP ".metricsReportPath"
+#define MAIN_SETTING_TRACE_EVENT_PATH MAIN_SETTINGS_GROUP ".traceEventPath"
+#define MAIN_SETTING_LOG_LEVEL MAIN_SETTINGS_GROUP ".logLevel"
+
 #define DEBUGINFO_SETTINGS_GROUP MAIN_SETTINGS_GROUP ".debugInfo"
 #define DEBUGINFO_SETTING_SYMBOLS_DIRECTORY DEBUGINFO_SETTINGS_GROUP ".symbolsDirectory"
+#define DEBUGINFO_SETTING_USE_MANIFEST DEBUGINFO_SETTINGS_GROUP ".useManifest"
+#define DEBUGINFO_SETTING_MANIFEST_DIRECTORY DEBUGINFO_SETTINGS_GROUP ".manifestDirectory"
+#define DEBUGINFO_SETTING_COMBINED_IMPORT DEBUGINFO_SETTINGS_GROUP ".combinedImport"
 
 #define DWARF_SETTINGS_GROUP MAIN_SETTINGS_GROUP ".dwarf"
 #define DWARF_SETTINGS_ENABLE_DWARF DWARF_SETTINGS_GROUP ".enableDWARF"
 #define DWARF_SETTINGS_LOAD_TYPES DWARF_SETTINGS_GROUP ".loadTypes"
 #define DWARF_SETTINGS_LOAD_DATA_VARIABLES DWARF_SETTINGS_GROUP ".loadDataVariables"
 #define DWARF_SETTINGS_LOAD_FUNCTIONS DWARF_SETTINGS_GROUP ".loadFunctions"
+#define DWARF_SETTINGS_LAZY_FUNCTIONS DWARF_SETTINGS_GROUP ".lazyFunctions"
+#define DWARF_SETTINGS_PARALLEL_TYPES DWARF_SETTINGS_GROUP ".parallelTypes"
 
 #define MACHO_SETTINGS_GROUP MAIN_SETTINGS_GROUP ".machoDebugInfo"
 #define MACHO_SETTINGS_ENABLE_MACHO MACHO_SETTINGS_GROUP ".enableMacho"
@@ -46,6 +57,49 @@ using SettingsRef = BN::Ref<BN::Settings>;
 
 namespace {
 
+void RegisterMainSettings(SettingsRef settings) {
+    settings->RegisterSetting(
+        MAIN_SETTING_WORKER_THREAD_COUNT,
+        R"({
+            "default": 0,
+            "description": "Number of threads used by the plugin for parallel work. If 0, the number of hardware threads not used by Binary Ninja analysis workers is used, at least one. Takes effect after restart",
+            "title": "Worker thread count",
+            "type": "number",
+            "minValue": 0,
+            "maxValue": 256
+        })");
+
+    settings->RegisterSetting(
+        MAIN_SETTING_METRICS_REPORT_PATH,
+        R""({
+            "default": "",
+            "description": "Absolute path of a JSON file to which wall time, CPU time and counters of every import phase are written at the end of kernelcache and debug info loads. If empty, no report is written",
+            "title": "Import metrics report path",
+            "type": "string",
+            "optional": true
+        })"");
+
+    settings->RegisterSetting(
+        MAIN_SETTING_TRACE_EVENT_PATH,
+        R""({
+            "default": "",
+            "description": "Absolute path of a JSON file to which kernelcache load and debug info import spans are written in the Chrome trace event format. The file can be opened in Perfetto or chrome://tracing. If empty, no spans are recorded. Takes effect after restart",
+            "title": "Trace event path",
+            "type": "string",
+            "optional": true
+        })"");
+
+    settings->RegisterSetting(
+        MAIN_SETTING_LOG_LEVEL,
+        R"({
+            "default": "info",
+            "description": "Minimum level of messages logged by the plugin. Messages below this level are not formatted. Repeated debug and warning messages from the same place are counted instead of logged after the first few",
+            "title": "Log level",
+            "type": "string",
+            "enum": ["debug", "info", "warning", "error"]
+        })");
+}
+
 void RegisterKCSettings(SettingsRef settings) {
     settings->RegisterSetting(
         KC_SETTING_EXCLUDED_FILESETS,
@@ -105,6 +159,34 @@ void RegisterDebugInfoSettings(SettingsRef settings) {
             "type": "string",
             "optional": true
         })"");
+
+    settings->RegisterSetting(
+        DEBUGINFO_SETTING_USE_MANIFEST,
+        R"({
+            "default": true,
+            "description": "Cache the UUID, architecture and segments of every object in the symbols directory in a manifest file and reuse it on later loads",
+            "title": "Use symbols manifest",
+            "type": "boolean"
+        })");
+
+    settings->RegisterSetting(
+        DEBUGINFO_SETTING_MANIFEST_DIRECTORY,
+        R""({
+            "default": "",
+            "description": "Absolute path to directory in which symbols manifests are stored. If empty, manifests are stored in the Binary Ninja user directory",
+            "title": "Symbols manifest directory",
+            "type": "string",
+            "optional": true
+        })"");
+
+    settings->RegisterSetting(
+        DEBUGINFO_SETTING_COMBINED_IMPORT,
+        R"({
+            "default": false,
+            "description": "Import DWARF, Mach-O, symbol table and LC_FUNCTION_STARTS debug info in a single pass which keeps only the highest priority symbol at each address. Individual debug info parsers are disabled when enabled",
+            "title": "Combined debug info import",
+            "type": "boolean"
+        })");
 }
 
 void RegisterDWARFSettings(SettingsRef settings) {
@@ -143,6 +225,24 @@ void RegisterDWARFSettings(SettingsRef settings) {
             "title":"Load function info",
             "type":"boolean"
         })");
+
+    settings->RegisterSetting(
+        DWARF_SETTINGS_LAZY_FUNCTIONS,
+        R"({
+            "default": false,
+            "description":"Only index DWARF function addresses during load. Function names and types are decoded when analysis adds a function, remaining functions are decoded in the background",
+            "title":"Lazy function info",
+            "type":"boolean"
+        })");
+
+    settings->RegisterSetting(
+        DWARF_SETTINGS_PARALLEL_TYPES,
+        R"({
+            "default": false,
+            "description":"Build DWARF types in parallel, ordered by the dependencies between anonymous types. Cycles are broken deterministically with named type references",
+            "title":"Parallel type import",
+            "type":"boolean"
+        })");
 }
 
 void RegisterMachoSettings(SettingsRef settings) {
@@ -220,12 +320,14 @@ void RegisterFunctionStartsSettings(SettingsRef settings) {
 void BinjaSettings::Register() {
     auto settings = BN::Settings::Instance();
     settings->RegisterGroup(MAIN_SETTINGS_GROUP, "Binja KC");
+    RegisterMainSettings(settings);
     RegisterKCSettings(settings);
     RegisterDebugInfoSettings(settings);
     RegisterDWARFSettings(settings);
     RegisterMachoSettings(settings);
     RegisterSymtabSettings(settings);
     RegisterFunctionStartsSettings(settings);
+    ReloadLogLevel();
 }
 
 
@@ -240,6 +342,16 @@ bool BinjaSettings::GetSetting(const std::string &key) const {
         nullptr);
 }
 
+template<>
+uint64_t BinjaSettings::GetSetting(const std::string &key) const {
+    return BNSettingsGetUInt64(
+        settingsObj_,
+        key.c_str(),
+        bvObj_,
+        nullptr,
+        nullptr);
+}
+
 template<>
 std::string BinjaSettings::GetSetting(const std::string &key) const {
     const SettingsRef settings = BinaryNinja::Settings::Instance();
@@ -266,6 +378,40 @@ std::vector<std::string> BinjaSettings::GetSetting(const std::string &key) const
     return result;
 }
 
+const uint64_t BinjaSettings::WorkerThreadCount() const {
+    return GetSetting<uint64_t>(MAIN_SETTING_WORKER_THREAD_COUNT);
+}
+
+const std::optional<std::string> BinjaSettings::MetricsReportPath() const {
+    std::string result = GetSetting<std::string>(MAIN_SETTING_METRICS_REPORT_PATH);
+    if (!result.empty()) {
+        return result;
+    }
+    return std::nullopt;
+}
+
+const std::optional<std::string> BinjaSettings::TraceEventPath() const {
+    std::string result = GetSetting<std::string>(MAIN_SETTING_TRACE_EVENT_PATH);
+    if (!result.empty()) {
+        return result;
+    }
+    return std::nullopt;
+}
+
+const BNLogLevel BinjaSettings::LogLevel() const {
+    std::string result = GetSetting<std::string>(MAIN_SETTING_LOG_LEVEL);
+    if (result == "debug") {
+        return BNLogLevel::DebugLog;
+    }
+    if (result == "warning") {
+        return BNLogLevel::WarningLog;
+    }
+    if (result == "error") {
+        return BNLogLevel::ErrorLog;
+    }
+    return BNLogLevel::InfoLog;
+}
+
 const bool BinjaSettings::KCApplyDyldChainedFixups() const {
     return GetSetting<bool>(KC_SETTING_APPLY_DYLD_CHAINED_FIXUPS);
 }
@@ -294,6 +440,22 @@ const std::optional<std::string> BinjaSettings::DebugInfoSymbolsSearchPath() con
     return std::nullopt;
 }
 
+const bool BinjaSettings::DebugInfoUseManifest() const {
+    return GetSetting<bool>(DEBUGINFO_SETTING_USE_MANIFEST);
+}
+
+const std::optional<std::string> BinjaSettings::DebugInfoManifestDirectory() const {
+    std::string result = GetSetting<std::string>(DEBUGINFO_SETTING_MANIFEST_DIRECTORY);
+    if (!result.empty()) {
+        return result;
+    }
+    return std::nullopt;
+}
+
+const bool BinjaSettings::DebugInfoCombinedImport() const {
+    return GetSetting<bool>(DEBUGINFO_SETTING_COMBINED_IMPORT);
+}
+
 const bool BinjaSettings::DWARFEnabled() const {
     return GetSetting<bool>(DWARF_SETTINGS_ENABLE_DWARF);
 }
@@ -310,6 +472,14 @@ const bool BinjaSettings::DWARFLoadFunctions() const {
     return GetSetting<bool>(DWARF_SETTINGS_LOAD_FUNCTIONS);
 }
 
+const bool BinjaSettings::DWARFLazyFunctions() const {
+    return GetSetting<bool>(DWARF_SETTINGS_LAZY_FUNCTIONS);
+}
+
+const bool BinjaSettings::DWARFParallelTypes() const {
+    return GetSetting<bool>(DWARF_SETTINGS_PARALLEL_TYPES);
+}
+
 const bool BinjaSettings::MachoEnabled() const {
     return GetSetting<bool>(MACHO_SETTINGS_ENABLE_MACHO);
 }
@@ -0,0 +1,172 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <atomic>
+#include <fstream>
+
+#include <binaryninjaapi.h>
+
+#include "utils/log.h"
+#include "utils/settings.h"
+#include "utils/trace.h"
+
+using namespace Binja;
+using namespace Utils;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int kProcessId = 1;
+
+double ToMicroseconds(TraceRecorder::Clock::duration duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+}// namespace
+
+/// Trace recorder
+
+TraceRecorder::TraceRecorder() : epoch_{Clock::now()} {
+    auto bnSettings = BinaryNinja::Settings::Instance();
+    BinjaSettings settings{nullptr, bnSettings->GetObject()};
+    if (auto path = settings.TraceEventPath()) {
+        BDLogInfo("recording trace events to {}", *path);
+        path_ = *path;
+    }
+}
+
+TraceRecorder &TraceRecorder::Instance() {
+    static TraceRecorder instance;
+    return instance;
+}
+
+uint32_t TraceRecorder::CurrentThreadId() {
+    static std::atomic<uint32_t> nextId = 1;
+    thread_local uint32_t id = nextId.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+void TraceRecorder::Record(Event event) {
+    std::lock_guard lock{mutex_};
+    events_.push_back(std::move(event));
+}
+
+void TraceRecorder::NameThread(uint32_t threadId, std::string name) {
+    std::lock_guard lock{mutex_};
+    threadNames_.emplace_back(threadId, std::move(name));
+}
+
+void TraceRecorder::Reset() {
+    std::lock_guard lock{mutex_};
+    events_.clear();
+}
+
+bool TraceRecorder::Write(const fs::path &path) const {
+    Json::Value events{Json::arrayValue};
+    {
+        std::lock_guard lock{mutex_};
+        for (const auto &[threadId, name]: threadNames_) {
+            Json::Value entry;
+            entry["name"] = "thread_name";
+            entry["ph"] = "M";
+            entry["pid"] = kProcessId;
+            entry["tid"] = threadId;
+            entry["args"]["name"] = name;
+            events.append(entry);
+        }
+        for (const auto &event: events_) {
+            Json::Value entry;
+            entry["name"] = event.name;
+            entry["cat"] = std::string{event.category};
+            entry["ph"] = "X";
+            entry["ts"] = ToMicroseconds(event.start - epoch_);
+            entry["dur"] = ToMicroseconds(event.duration);
+            entry["pid"] = kProcessId;
+            entry["tid"] = event.threadId;
+            events.append(entry);
+        }
+    }
+
+    Json::Value root;
+    root["traceEvents"] = events;
+    root["displayTimeUnit"] = "ms";
+
+    fs::path temporaryPath = path;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream stream{temporaryPath, std::ios::trunc};
+        if (!stream) {
+            BDLogWarn("failed to write trace events {}", path.string());
+            return false;
+        }
+        Json::StreamWriterBuilder builder;
+        builder["indentation"] = "";
+        stream << Json::writeString(builder, root);
+    }
+
+    std::error_code ec;
+    fs::rename(temporaryPath, path, ec);
+    if (ec) {
+        BDLogWarn("failed to write trace events {}, error: {}", path.string(), ec.message());
+        return false;
+    }
+    BDLogInfo("saved {} trace events to {}", events.size(), path.string());
+    return true;
+}
+
+/// Taskflow observer
+
+void TaskflowTraceObserver::set_up(size_t numWorkers) {
+    starts_.resize(numWorkers);
+    named_.resize(numWorkers);
+}
+
+void TaskflowTraceObserver::on_entry(tf::WorkerView worker, tf::TaskView task) {
+    size_t id = worker.id();
+    if (!named_[id]) {
+        TraceRecorder::Instance().NameThread(TraceRecorder::CurrentThreadId(), fmt::format("taskflow worker {}", id));
+        named_[id] = true;
+    }
+    starts_[id].push_back(TraceRecorder::Clock::now());
+}
+
+void TaskflowTraceObserver::on_exit(tf::WorkerView worker, tf::TaskView task) {
+    auto &starts = starts_[worker.id()];
+    if (starts.empty()) {
+        return;
+    }
+    auto start = starts.back();
+    starts.pop_back();
+    const std::string &name = task.name();
+    TraceRecorder::Instance().Record(TraceRecorder::Event{
+        .name = name.empty() ? "unnamed task" : name,
+        .category = "taskflow",
+        .start = start,
+        .duration = TraceRecorder::Clock::now() - start,
+        .threadId = TraceRecorder::CurrentThreadId()});
+}
+
+void Utils::WriteTraceEvents() {
+    const TraceRecorder &recorder = TraceRecorder::Instance();
+    if (const auto &path = recorder.GetPath()) {
+        recorder.Write(*path);
+    }
+}
@@ -0,0 +1,96 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <binaryninjaapi.h>
+
+#include "sink.h"
+#include "symbol_registry.h"
+
+namespace Binja::DebugInfo {
+
+/// Sources of symbols, declared from the highest to the lowest priority
+enum class SymbolSourceKind : int {
+    Dwarf,
+    KextSymtab,
+    KCSymtab,
+    FunctionStarts,
+    Max
+};
+
+/// Gathers candidate records from every source and emits only the
+/// highest priority symbol at each address. Unnamed candidates, such as
+/// the placeholders of lazily decoded DWARF functions, only win addresses
+/// no source has a name for. Types are not keyed by address and are
+/// forwarded as is.
+class SymbolArbiter {
+public:
+    SymbolArbiter();
+
+    /// Returns the sink collecting candidates for `source`. Sinks of
+    /// different sources may be used concurrently.
+    DebugInfoSink &GetSink(SymbolSourceKind source);
+
+    /// Resolves conflicts between collected candidates and emits the
+    /// collected types followed by the winning symbols to `sink`
+    void Emit(DebugInfoSink &sink);
+
+private:
+    struct Candidate {
+        uint64_t address;
+        std::optional<BinaryNinja::DebugFunctionInfo> function;
+        BinaryNinja::Ref<BinaryNinja::Type> type;
+        std::string name;
+
+        [[nodiscard]] bool IsNamed() const;
+    };
+
+    class SourceSink : public DebugInfoSink {
+    public:
+        void AddType(const std::string &name, BinaryNinja::Ref<BinaryNinja::Type> type) override;
+        void AddFunction(const BinaryNinja::DebugFunctionInfo &info) override;
+        void AddDataVariable(uint64_t address, BinaryNinja::Ref<BinaryNinja::Type> type, const std::string &name) override;
+
+    private:
+        friend class SymbolArbiter;
+
+        std::mutex mutex_;
+        std::vector<std::pair<std::string, BinaryNinja::Ref<BinaryNinja::Type>>> types_;
+        std::vector<Candidate> candidates_;
+    };
+
+    static constexpr size_t kNumSources = static_cast<size_t>(SymbolSourceKind::Max);
+
+    static SymbolRegistry::OwnerId MakeOwnerId(size_t sourceIndex, size_t candidateIndex, bool named);
+    static std::string_view SourceName(size_t sourceIndex);
+
+private:
+    std::array<std::unique_ptr<SourceSink>, kNumSources> sinks_;
+};
+
+}// namespace Binja::DebugInfo
@@ -0,0 +1,92 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "dwarf.h"
+
+namespace Binja::DebugInfo {
+
+enum class DiagnosticKind {
+    UnsupportedTypeModifier,
+    TypedefWithoutType,
+    TypedefWithoutName,
+    UnsupportedArray,
+    ArrayWithoutType,
+    InvalidArrayBounds,
+    InvalidFunctionParameter,
+    InvalidEnumBaseType,
+    InvalidEnumerator,
+    UnexpectedChildTag,
+    ContainerWithoutSize,
+    MemberWithoutType,
+    MemberWithoutLocation,
+    InvalidAccessibility,
+    BitfieldLayout,
+    InvalidPointerToMember,
+    UnknownTypeTag,
+    FunctionAddressNotSlid,
+    VariableAddressNotSlid,
+    VariableWithoutName,
+    VariableWithoutType,
+    SegmentLengthMismatch,
+    SymbolAddressNotSlid,
+    SymbolShadowed,
+    Max,
+};
+
+std::string_view DiagnosticKindDescription(DiagnosticKind kind);
+
+/// Counts problems found while importing debug info, keeping the first few
+/// DIE offsets or addresses of every kind as samples, so that a single
+/// summary can be logged at the end of an import. Safe to use from
+/// multiple threads.
+class Diagnostics {
+public:
+    static constexpr size_t kMaxSamples = 8;
+
+    void Report(DiagnosticKind kind, DwarfOffset die);
+    void Report(DiagnosticKind kind, uint64_t address);
+
+    uint64_t Count(DiagnosticKind kind) const;
+    void LogSummary(std::string_view importName) const;
+
+private:
+    template<class Sample>
+    void Record(DiagnosticKind kind, const Sample &sample);
+
+private:
+    struct Entry {
+        std::atomic<uint64_t> count{0};
+        mutable std::mutex mutex;
+        std::vector<std::string> samples;
+    };
+
+    std::array<Entry, static_cast<size_t>(DiagnosticKind::Max)> entries_;
+};
+
+}// namespace Binja::DebugInfo
@@ -0,0 +1,148 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "dwarf.h"
+
+namespace Binja::DebugInfo {
+
+namespace Detail {
+
+/// Slots of each binary are split into lazily allocated pages, reading a
+/// slot on a missing page returns the fill value without allocating
+template<class T>
+class DiePageTable {
+public:
+    static constexpr size_t kPageShift = 12;
+    static constexpr size_t kPageSize = size_t{1} << kPageShift;
+
+    explicit DiePageTable(T fill)
+        : fill_{std::move(fill)} {}
+
+    [[nodiscard]] const T &Get(BinaryId binaryId, size_t slot) const {
+        if (binaryId >= pages_.size()) {
+            return fill_;
+        }
+        const auto &pages = pages_[binaryId];
+        size_t pageIndex = slot >> kPageShift;
+        if (pageIndex >= pages.size() || !pages[pageIndex]) {
+            return fill_;
+        }
+        return pages[pageIndex][slot & (kPageSize - 1)];
+    }
+
+    T &At(BinaryId binaryId, size_t slot) {
+        if (binaryId >= pages_.size()) {
+            pages_.resize(binaryId + 1);
+        }
+        auto &pages = pages_[binaryId];
+        size_t pageIndex = slot >> kPageShift;
+        if (pageIndex >= pages.size()) {
+            pages.resize(pageIndex + 1);
+        }
+        auto &page = pages[pageIndex];
+        if (!page) {
+            page = std::make_unique<T[]>(kPageSize);
+            std::fill_n(page.get(), kPageSize, fill_);
+        }
+        return page[slot & (kPageSize - 1)];
+    }
+
+private:
+    T fill_;
+    std::vector<std::vector<std::unique_ptr<T[]>>> pages_;
+};
+
+}// namespace Detail
+
+/// Per DIE value, unset entries read as the fill value
+template<class T>
+class DieArray {
+public:
+    explicit DieArray(DwarfContextWrapper &dwarfContext, T fill = T{})
+        : dwarfContext_{dwarfContext}, table_{std::move(fill)} {}
+
+    [[nodiscard]] const T &Get(DieId id) const {
+        return table_.Get(id.binaryId, dwarfContext_.GetDieLayout().GetFlatIndex(id));
+    }
+
+    T &At(DieId id) {
+        return table_.At(id.binaryId, dwarfContext_.GetDieLayout().GetFlatIndex(id));
+    }
+
+    void Set(DieId id, T value) {
+        At(id) = std::move(value);
+    }
+
+private:
+    DwarfContextWrapper &dwarfContext_;
+    Detail::DiePageTable<T> table_;
+};
+
+/// One bit per DIE
+class DieBitset {
+private:
+    using Word = uint64_t;
+    static constexpr size_t kWordBits = sizeof(Word) * 8;
+
+public:
+    explicit DieBitset(DwarfContextWrapper &dwarfContext)
+        : dwarfContext_{dwarfContext}, words_{0} {}
+
+    [[nodiscard]] bool Test(DieId id) const {
+        size_t index = dwarfContext_.GetDieLayout().GetFlatIndex(id);
+        return words_.Get(id.binaryId, index / kWordBits) & Mask(index);
+    }
+
+    /// Returns false if the bit was already set
+    bool Set(DieId id) {
+        size_t index = dwarfContext_.GetDieLayout().GetFlatIndex(id);
+        Word &word = words_.At(id.binaryId, index / kWordBits);
+        if (word & Mask(index)) {
+            return false;
+        }
+        word |= Mask(index);
+        return true;
+    }
+
+    /// Returns false if the bit was not set
+    bool Reset(DieId id) {
+        size_t index = dwarfContext_.GetDieLayout().GetFlatIndex(id);
+        if (!(words_.Get(id.binaryId, index / kWordBits) & Mask(index))) {
+            return false;
+        }
+        words_.At(id.binaryId, index / kWordBits) &= ~Mask(index);
+        return true;
+    }
+
+private:
+    static Word Mask(size_t index) { return Word{1} << (index % kWordBits); }
+
+    DwarfContextWrapper &dwarfContext_;
+    Detail::DiePageTable<Word> words_;
+};
+
+}// namespace Binja::DebugInfo
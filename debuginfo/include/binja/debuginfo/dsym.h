@@ -40,6 +40,7 @@ public:
 
     static std::vector<std::filesystem::path> DsymFindObjects(
         const std::filesystem::path &symbolsPath);
+    static std::optional<MachO::MachObjectInfo> Probe(const std::filesystem::path &objectPath);
 
     std::optional<Types::UUID> DecodeUUID() const;
     std::vector<MachO::Segment> DecodeSegments() const;
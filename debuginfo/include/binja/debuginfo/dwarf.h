@@ -22,7 +22,10 @@
 #pragma once
 
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <string_view>
 
 #include <fmt/format.h>
 #include <llvm/DebugInfo/DWARF/DWARFDie.h>
@@ -74,6 +77,15 @@ namespace Binja::DebugInfo {
 
 using BinaryId = uint16_t;
 
+/// Dense DIE address, the unit is numbered within its binary and the DIE
+/// by its position in the unit's DIE vector
+struct DieId {
+    BinaryId binaryId;
+    uint32_t unitIndex;
+    uint32_t dieIndex;
+    auto operator<=>(const DieId &oth) const = default;
+};
+
 class DwarfDebugInfoEntryWrapper {
 public:
     DwarfDebugInfoEntryWrapper(llvm::DWARFDebugInfoEntry entry, BinaryId binaryId)
@@ -94,6 +106,8 @@ public:
     [[nodiscard]] uint8_t GetAddressByteSize() const;
     [[nodiscard]] std::vector<DwarfDebugInfoEntryWrapper> Dies() const;
     [[nodiscard]] const llvm::dwarf::FormParams GetFormParams();
+    [[nodiscard]] BinaryId GetBinaryId() const { return binaryId_; }
+    [[nodiscard]] llvm::DWARFUnit &GetUnit() const { return unit_; }
 
 private:
     llvm::DWARFUnit &unit_;
@@ -140,10 +154,53 @@ public:
     void Dump(llvm::raw_ostream &ss, uint32_t indent = 0, llvm::DIDumpOptions opts = llvm::DIDumpOptions{});
 
 private:
+    friend class DwarfContextWrapper;
+
     llvm::DWARFDie die_;
     DwarfOffset offset_;
 };
 
+/// Numbers the DIEs of every unit consecutively per binary, so that side
+/// tables can be indexed by DieId instead of hashing DwarfOffset.
+///
+/// Side table access by DieId is O(1). Deriving the DieId of a DWARFDie is
+/// not: it binary searches the units of the binary by unit pointer, O(log
+/// units), before the O(1) index arithmetic within the unit. Deriving it
+/// from a DwarfOffset additionally pays for getDIEForOffset. Callers on hot
+/// paths should carry DieIds instead of converting repeatedly.
+class DieLayout {
+public:
+    explicit DieLayout(const std::vector<std::vector<llvm::DWARFUnit *>> &units);
+
+    [[nodiscard]] std::optional<DieId> GetId(BinaryId binaryId, const llvm::DWARFDie &die) const;
+    [[nodiscard]] llvm::DWARFDie GetDie(DieId id) const;
+    [[nodiscard]] size_t GetBinaryCount() const { return binaries_.size(); }
+    [[nodiscard]] size_t GetDieCount(BinaryId binaryId) const { return binaries_[binaryId].numDies; }
+    [[nodiscard]] size_t GetFlatIndex(DieId id) const {
+        return binaries_[id.binaryId].units[id.unitIndex].firstDie + id.dieIndex;
+    }
+
+private:
+    struct UnitSpan {
+        llvm::DWARFUnit *unit;
+        size_t firstDie;
+    };
+
+    struct UnitKey {
+        const llvm::DWARFUnit *unit;
+        uint32_t unitIndex;
+    };
+
+    struct Binary {
+        std::vector<UnitSpan> units;
+        // Sorted by unit address for lookups from a DWARFDie
+        std::vector<UnitKey> unitKeys;
+        size_t numDies = 0;
+    };
+
+    std::vector<Binary> binaries_;
+};
+
 class DwarfContextWrapper {
 public:
     struct Entry {
@@ -162,20 +219,40 @@ public:
     [[nodiscard]] std::optional<uint64_t> GetSlidAddress(DwarfOffset offset, uint64_t source);
     [[nodiscard]] size_t GetDwarfObjectCount() const { return entries_.size(); }
 
+    /// Built once on first use by whichever thread gets there first, extracts
+    /// the DIEs and decodes the base address of all units. Once it returned,
+    /// DIE and unit reads are read-only and may run concurrently.
+    [[nodiscard]] const DieLayout &GetDieLayout();
+    /// Decodes everything llvm otherwise decodes lazily on first access, so
+    /// that units can be visited concurrently afterwards
+    void PrepareConcurrentReads() { (void) GetDieLayout(); }
+    [[nodiscard]] std::optional<DieId> GetDieId(const DwarfDieWrapper &die);
+    [[nodiscard]] std::optional<DieId> GetDieId(DwarfOffset offset);
+    [[nodiscard]] DwarfDieWrapper GetDIEForId(DieId id);
+
 private:
     std::vector<Entry> entries_;
+    // Held by pointer so that the wrapper stays movable
+    std::unique_ptr<std::once_flag> dieLayoutOnce_ = std::make_unique<std::once_flag>();
+    std::unique_ptr<DieLayout> dieLayout_;
 };
 
+/// The *View readers return views into the string sections of the
+/// DwarfObjectFile owning the DIE, they stay valid for as long as the
+/// DwarfContextWrapper holding that object is alive
 class AttributeReader {
 public:
     explicit AttributeReader(DwarfDieWrapper &die) : die_{die} {}
     [[nodiscard]] std::optional<uint64_t> ReadUInt(llvm::dwarf::Attribute attribute, bool recursive = false) const;
     [[nodiscard]] std::optional<uint64_t> ReadInt(llvm::dwarf::Attribute attribute, bool recursive = false) const;
     [[nodiscard]] std::string ReadString(llvm::dwarf::Attribute attribute, const char *defaultValue = "", bool recursive = false) const;
+    [[nodiscard]] std::string_view ReadStringView(llvm::dwarf::Attribute attribute, std::string_view defaultValue = {}, bool recursive = false) const;
     [[nodiscard]] std::string ReadName(const char *defaultName = "", bool recursive = false) const;
+    [[nodiscard]] std::string_view ReadNameView(std::string_view defaultName = {}, bool recursive = false) const;
     [[nodiscard]] std::optional<DwarfDieWrapper> ReadReference(llvm::dwarf::Attribute attribute, bool recursive = false) const;
     [[nodiscard]] bool HasAttribute(llvm::dwarf::Attribute attribute, bool recursive = false) const;
     [[nodiscard]] std::string ReadLinkageName(const char *defaultName = "", bool recursive = false) const;
+    [[nodiscard]] std::string_view ReadLinkageNameView(std::string_view defaultName = {}, bool recursive = false) const;
     [[nodiscard]] std::optional<llvm::DWARFFormValue> FindAttribute(llvm::dwarf::Attribute attr, bool recursive) const;
     [[nodiscard]] std::optional<uint64_t> ReadLocationAddress() const;
 
@@ -22,8 +22,13 @@
 #pragma once
 
 #include <llvm/DebugInfo/DWARF/DWARFContext.h>
+#include <taskflow/taskflow.hpp>
 
+#include "diagnostics.h"
 #include "dwarf.h"
+#include "lazy_function.h"
+#include "name_index.h"
+#include "sink.h"
 
 namespace Binja::DebugInfo {
 
@@ -31,6 +36,10 @@ struct ImportOptions {
     bool importTypes;
     bool importFunctions;
     bool importGlobals;
+    // Functions are only indexed, see LazyFunctionImporter
+    bool lazyFunctions = false;
+    // Types are built in dependency waves on the shared executor, see ParallelTypeBuilder
+    bool parallelTypes = false;
 };
 
 enum class DwarfImportPhase : int {
@@ -50,28 +59,43 @@ class DwarfImportTask {
 public:
     DwarfImportTask(const std::vector<std::filesystem::path> &dwarfObjects,
                     BinaryNinja::BinaryView &binaryView,
-                    BinaryNinja::DebugInfo &debugInfo,
+                    DebugInfoSink &sink,
                     ImportOptions options,
                     DwarfImportProgressMonitor &monitor)
         : dwarfObjects_{dwarfObjects},
           binaryView_{binaryView},
-          debugInfo_{debugInfo},
+          sink_{sink},
           options_{options},
           monitor_{monitor} {}
 
     const ImportOptions &GetImportOptions() { return options_; }
-    void Import();
+    /// Adds the import phases to `subflow` and joins it
+    void Import(tf::Subflow &subflow);
     static bool IsNamedTypeTag(llvm::dwarf::Tag tag);
+    /// Opens `dwarfObjects` with their segments mapped onto the matching
+    /// Mach-O headers of `binaryView`
+    static DwarfContextWrapper BuildDwarfContext(const std::vector<std::filesystem::path> &dwarfObjects,
+                                                 BinaryNinja::BinaryView &binaryView,
+                                                 Diagnostics *diagnostics = nullptr);
+    /// Same as above for the Mach-O headers of `targets`, keyed by their UUID
+    static DwarfContextWrapper BuildDwarfContext(const std::vector<std::filesystem::path> &dwarfObjects,
+                                                 const std::map<Types::UUID, std::vector<MachO::Segment>> &targets,
+                                                 Diagnostics *diagnostics = nullptr);
 
 private:
-    DwarfContextWrapper BuildDwarfContext();
+    void IndexQualifiedNames(DwarfContextWrapper &dwarfContext, NameIndex &nameIndex);
+    void ImportTypes(DwarfContextWrapper &dwarfContext, NameIndex &nameIndex);
+    void ImportTypesParallel(DwarfContextWrapper &dwarfContext, NameIndex &nameIndex);
+    void ImportFunctionsAndGlobals(DwarfContextWrapper &dwarfContext, NameIndex &nameIndex,
+                                   std::vector<LazyFunctionImporter::Entry> &lazyFunctions);
 
 private:
     const std::vector<std::filesystem::path> &dwarfObjects_;
     BinaryNinja::BinaryView &binaryView_;
-    BinaryNinja::DebugInfo &debugInfo_;
+    DebugInfoSink &sink_;
     ImportOptions options_;
     DwarfImportProgressMonitor &monitor_;
+    Diagnostics diagnostics_;
 };
 
 }// namespace Binja::DebugInfo
\ No newline at end of file
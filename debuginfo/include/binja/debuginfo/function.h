@@ -43,6 +43,7 @@ public:
         : ctx_{ctx}, die_{die}, dieReader_{die_} {}
 
     std::optional<DwarfFunctionInfo> Decode();
+    std::optional<uint64_t> DecodeSlidEntryPoint();
 
 private:
     std::optional<uint64_t> DecodeEntryPoint();
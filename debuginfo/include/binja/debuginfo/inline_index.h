@@ -0,0 +1,100 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <binja/utils/mapped_image.h>
+
+#include "dwarf.h"
+
+namespace Binja::DebugInfo {
+
+struct InlineFrame {
+    // Point into the index, valid for as long as the index is alive
+    std::string_view function;
+    // Empty when the call site is unknown
+    std::string_view callFile;
+    uint32_t callLine;
+};
+
+/// Slid address -> chain of inlined subroutines decoded from the
+/// DW_TAG_inlined_subroutine ranges of a DWARF context. Inline frames form
+/// a tree through their enclosing frame, and the address space is split
+/// into disjoint ranges pointing at the innermost frame covering them. A
+/// lookup binary searches the ranges and walks the parents, so it costs
+/// O(log n) plus the inline depth. Like LineIndex, the serialized form is
+/// used as is and a saved index is memory mapped.
+class InlineIndex {
+public:
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kNoFrame = UINT32_MAX;
+
+    /// Serialized inline frame
+    struct FrameRecord {
+        // Offsets into the string table, kNoFrame for the file of an unknown call site
+        uint32_t function;
+        uint32_t callFile;
+        uint32_t callLine;
+        uint32_t parent;
+    };
+
+public:
+    /// Decodes the units in parallel on the shared executor
+    static InlineIndex Build(DwarfContextWrapper &dwarfContext);
+    static InlineIndex Open(const std::filesystem::path &path);
+    /// Returns false when the index could not be written
+    bool Save(const std::filesystem::path &path) const;
+
+    /// Replaces `frames` with the inline frames covering `address`,
+    /// innermost first. Reusing `frames` across lookups avoids allocations.
+    void Lookup(uint64_t address, std::vector<InlineFrame> &frames) const;
+    /// Visits the start of every inlined range overlapping [begin, end),
+    /// clamped to begin, with the frames covering it innermost first
+    void VisitRange(uint64_t begin, uint64_t end,
+                    const std::function<void(uint64_t, const std::vector<InlineFrame> &)> &visitor) const;
+
+    [[nodiscard]] size_t GetRangeCount() const { return rangeStarts_.size(); }
+    [[nodiscard]] size_t GetFrameCount() const { return frames_.size(); }
+    [[nodiscard]] size_t GetSizeInBytes() const { return image_.GetSize(); }
+
+private:
+    InlineIndex() = default;
+
+    void Attach(Utils::MappedImage image);
+    void CollectFrames(uint32_t frame, std::vector<InlineFrame> &frames) const;
+    [[nodiscard]] std::string_view GetString(uint32_t offset) const;
+
+private:
+    Utils::MappedImage image_;
+    std::span<const uint64_t> rangeStarts_;
+    std::span<const uint64_t> rangeEnds_;
+    std::span<const uint32_t> rangeFrames_;
+    std::span<const FrameRecord> frames_;
+    std::span<const char> strings_;
+};
+
+}// namespace Binja::DebugInfo
@@ -0,0 +1,144 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <binaryninjaapi.h>
+
+#include "diagnostics.h"
+#include "dwarf.h"
+#include "name_index.h"
+
+namespace Binja::DebugInfo {
+
+/// DWARF objects of an import, heap allocated so that they can outlive the
+/// import task when function info is decoded lazily
+struct DwarfImportState {
+    explicit DwarfImportState(DwarfContextWrapper context)
+        : dwarfContext{std::move(context)}, nameIndex{dwarfContext} {}
+
+    DwarfImportState(const DwarfImportState &) = delete;
+    DwarfImportState &operator=(const DwarfImportState &) = delete;
+
+    DwarfContextWrapper dwarfContext;
+    NameIndex nameIndex;
+};
+
+/// Applies DWARF function names and types when Binary Ninja analysis adds
+/// a function, instead of decoding every function during the import. The
+/// functions not requested yet are decoded in the background, in chunks
+/// that requeue themselves on the shared executor, and applied to the
+/// functions already present at their address. Later requests only apply
+/// cached results.
+class LazyFunctionImporter : public BinaryNinja::BinaryDataNotification,
+                             public std::enable_shared_from_this<LazyFunctionImporter> {
+public:
+    struct Entry {
+        // Slid entry point
+        uint64_t address;
+        DwarfOffset die;
+    };
+
+    LazyFunctionImporter(std::unique_ptr<DwarfImportState> state, std::vector<Entry> entries);
+    ~LazyFunctionImporter() override;
+
+    void OnAnalysisFunctionAdded(BinaryNinja::BinaryView *view, BinaryNinja::Function *function) override;
+
+    [[nodiscard]] size_t GetEntryCount() const { return entries_.size(); }
+
+    /// Registers `importer` for the analysis notifications of `view` and
+    /// starts warming it, beginning with the entries of the functions `view`
+    /// already has. Warming references the view only while a chunk runs and
+    /// stops once the view is closed, the importer is released with the view.
+    static void Attach(BinaryNinja::BinaryView &view, std::shared_ptr<LazyFunctionImporter> importer);
+
+    /// Unregisters the importers attached to `view` and waits until their
+    /// warming stopped. Not to be called from a worker of the shared
+    /// executor, which may have to run the warming chunk waited for.
+    static void Detach(BinaryNinja::BinaryView &view);
+
+private:
+    struct DecodedFunction {
+        std::string shortName;
+        std::string fullName;
+        std::string rawName;
+        BinaryNinja::Ref<BinaryNinja::Type> type;
+    };
+
+    enum class EntryState : uint8_t {
+        Pending,
+        Decoded,
+        Failed,
+    };
+
+    static constexpr size_t kWarmChunkSize = 256;
+
+    std::optional<size_t> FindEntry(uint64_t address) const;
+    // Sets `decodedNow` when this call decoded the entry
+    const DecodedFunction *Decode(size_t index, bool *decodedNow = nullptr);
+    // Applies the name and type of entry `index` to `functions`, the
+    // functions of `view` starting at its address
+    void Apply(BinaryNinja::BinaryView &view, size_t index,
+               const std::vector<BinaryNinja::Ref<BinaryNinja::Function>> &functions);
+    void StartWarming(BinaryNinja::BinaryView &view, std::vector<size_t> existing);
+    void StopWarming();
+    // The warmed view if its file still holds it, null once it was closed
+    BinaryNinja::Ref<BinaryNinja::BinaryView> AcquireWarmView() const;
+    void ScheduleWarming(size_t position);
+    void Warm(size_t position);
+    void FinishWarming();
+
+private:
+    std::unique_ptr<DwarfImportState> state_;
+    Diagnostics diagnostics_;
+    OrderedTypeBuilderContext context_;
+    // Sorted by address
+    std::vector<Entry> entries_;
+
+    // Decoding updates the entry states, the decoded functions and the
+    // type builder context with its diagnostics, so it is serialized
+    std::mutex mutex_;
+    std::vector<EntryState> states_;
+    std::vector<std::unique_ptr<DecodedFunction>> decoded_;
+
+    // Warming visits the entries of the functions present at attach time,
+    // then every entry. Only the warming chain touches these. The view is
+    // looked up through its file per chunk, so that warming does not keep
+    // a closed view alive
+    BinaryNinja::Ref<BinaryNinja::FileMetadata> warmFile_;
+    std::string warmViewType_;
+    BNBinaryView *warmViewObject_ = nullptr;
+    std::vector<size_t> warmFirst_;
+
+    std::atomic<bool> stopWarming_{false};
+    std::promise<void> warmed_;
+    std::future<void> warmer_;
+};
+
+}// namespace Binja::DebugInfo
@@ -0,0 +1,91 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <binja/utils/mapped_image.h>
+
+#include "dwarf.h"
+
+namespace Binja::DebugInfo {
+
+struct LineLocation {
+    // Points into the index, valid for as long as the index is alive
+    std::string_view file;
+    uint32_t line;
+};
+
+/// Slid address -> source line table decoded from the .debug_line programs
+/// of a DWARF context. Rows are sorted by address and stored in blocks of
+/// delta encoded varints, a lookup binary searches the first address of the
+/// blocks and decodes a single block. The serialized form is used as is, so
+/// an index saved to disk is memory mapped instead of being read.
+class LineIndex {
+public:
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kBlockRows = 64;
+
+public:
+    /// Decodes the line programs of all units in parallel on the shared
+    /// executor. Rows that do not slide into the target binary are dropped.
+    static LineIndex Build(DwarfContextWrapper &dwarfContext);
+    static LineIndex Open(const std::filesystem::path &path);
+    /// Returns false when the index could not be written
+    bool Save(const std::filesystem::path &path) const;
+
+    [[nodiscard]] std::optional<LineLocation> Lookup(uint64_t address) const;
+    /// Visits the rows starting a new location in [begin, end), plus the
+    /// location covering begin
+    void VisitRange(uint64_t begin, uint64_t end,
+                    const std::function<void(uint64_t, const LineLocation &)> &visitor) const;
+
+    [[nodiscard]] uint64_t GetRowCount() const { return rowCount_; }
+    [[nodiscard]] size_t GetFileCount() const { return fileOffsets_.size(); }
+    [[nodiscard]] size_t GetSizeInBytes() const { return image_.GetSize(); }
+
+private:
+    LineIndex() = default;
+
+    void Attach(Utils::MappedImage image);
+    [[nodiscard]] std::optional<LineLocation> MakeLocation(uint64_t file, uint64_t line) const;
+    template<class Visitor>
+    void DecodeBlock(size_t block, Visitor &&visitor) const;
+
+private:
+    Utils::MappedImage image_;
+    uint64_t rowCount_ = 0;
+    uint32_t blockRows_ = kBlockRows;
+    std::span<const uint64_t> blockAddresses_;
+    std::span<const uint64_t> blockOffsets_;
+    std::span<const uint64_t> fileOffsets_;
+    std::span<const char> strings_;
+    std::span<const uint8_t> data_;
+};
+
+}// namespace Binja::DebugInfo
@@ -22,14 +22,19 @@
 #pragma once
 
 #include <filesystem>
+#include <optional>
 #include <vector>
 
 #include <binaryninjaapi.h>
+#include <taskflow/taskflow.hpp>
 
 #include <binja/macho/macho.h>
 #include <binja/types/uuid.h>
 
+#include "diagnostics.h"
+#include "sink.h"
 #include "slider.h"
+#include "symbol_registry.h"
 
 namespace Binja::DebugInfo {
 
@@ -45,23 +50,41 @@ struct MachOImportOptions {
 class MachOImportTask {
 public:
     MachOImportTask(std::vector<std::filesystem::path> sources,
-                    BinaryNinja::BinaryView &binaryView, BinaryNinja::DebugInfo &debugInfo,
+                    BinaryNinja::BinaryView &binaryView, DebugInfoSink &sink,
                     MachOImportOptions options,
                     MachOImportProgressMonitor &monitor);
-    void Import();
+    /// Adds the import stages to `subflow` and joins it
+    void Import(tf::Subflow &subflow);
 
 private:
+    struct SymbolRecord {
+        BNSymbolType type;
+        uint64_t address;
+        SymbolNameInterner::NameId shortName;
+        SymbolNameInterner::NameId fullName;
+        SymbolNameInterner::NameId rawName;
+    };
+
     BinaryNinja::Ref<BinaryNinja::BinaryView> OpenMachO(const std::filesystem::path &path);
-    bool AddSymbol(const BinaryNinja::Symbol &symbol, AddressSlider &slider);
+    void CollectSymbols(size_t sourceIndex);
+    std::optional<SymbolRecord> DecodeSymbol(const BinaryNinja::Symbol &symbol, AddressSlider &slider);
+    void EmitSymbols(const SymbolRegistry &registry);
+    void AddSymbol(const SymbolRecord &record);
+    std::string DescribeOwner(SymbolRegistry::OwnerId owner, uint64_t address);
+
+    static SymbolRegistry::OwnerId MakeOwnerId(size_t sourceIndex, size_t symbolIndex);
 
 private:
     BinaryNinja::BinaryView &binaryView_;
-    BinaryNinja::DebugInfo &debugInfo_;
+    DebugInfoSink &sink_;
     std::vector<std::filesystem::path> sources_;
-    std::map<uint64_t, std::string> registeredSymbols_;
+    std::vector<uint64_t> existingSymbols_;
+    std::vector<std::vector<SymbolRecord>> collectedSymbols_;
+    SymbolNameInterner names_;
     MachOImportOptions options_;
     MachOImportProgressMonitor &monitor_;
     std::map<Types::UUID, std::vector<MachO::Segment>> targetSegments_;
+    Diagnostics diagnostics_;
 };
 
 }// namespace Binja::DebugInfo
@@ -0,0 +1,81 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <vector>
+
+#include <binja/macho/macho.h>
+#include <binja/types/uuid.h>
+
+namespace Binja::DebugInfo {
+
+enum class KDKObjectKind {
+    MachO,
+    DwarfObject,
+};
+
+struct KDKObject {
+    std::filesystem::path path;
+    KDKObjectKind kind;
+    std::optional<Types::UUID> uuid;
+    uint32_t cpuType;
+    std::vector<MachO::Segment> segments;
+    int64_t modificationTime;
+    uint64_t size;
+};
+
+/// Persistent index of the objects in a KDK. Every object is recorded
+/// together with the file time and size it was probed at, so a reload only
+/// probes objects that were added or changed since the manifest was saved.
+class KDKManifest {
+public:
+    static constexpr int kVersion = 1;
+
+public:
+    static KDKManifest Open(const std::filesystem::path &kdkPath,
+                            const std::filesystem::path &manifestDirectory);
+    static std::filesystem::path DefaultDirectory();
+
+    std::vector<std::filesystem::path> ResolveObjects(
+        KDKObjectKind kind,
+        const std::map<Types::UUID, std::vector<MachO::Segment>> &targets) const;
+
+    const std::vector<KDKObject> &GetObjects() const { return objects_; }
+
+private:
+    explicit KDKManifest(std::filesystem::path kdkPath) : kdkPath_{std::move(kdkPath)} {}
+
+    bool Load(const std::filesystem::path &manifestPath);
+    void Save(const std::filesystem::path &manifestPath) const;
+    bool IsUpToDate() const;
+    void Refresh();
+
+private:
+    std::filesystem::path kdkPath_;
+    std::map<std::filesystem::path, int64_t> directoryTimes_;
+    std::vector<KDKObject> objects_;
+};
+
+}// namespace Binja::DebugInfo
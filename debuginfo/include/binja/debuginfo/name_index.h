@@ -22,11 +22,12 @@
 #pragma once
 
 #include <limits>
-#include <unordered_map>
+#include <map>
 
 #include <llvm/DebugInfo/DWARF/DWARFContext.h>
 #include <llvm/DebugInfo/DWARF/DWARFDie.h>
 
+#include "die_table.h"
 #include "dwarf.h"
 #include "types.h"
 
@@ -38,7 +39,7 @@ private:
 
     using QualfiedName = BinaryNinja::QualifiedName;
     using NodeInfoVectorIndex = size_t;
-    using NodeEntryMap = std::map<std::string, Node>;
+    using NodeEntryMap = std::map<std::string, Node, std::less<>>;
 
     struct Node {
         NodeInfoVectorIndex info;
@@ -58,24 +59,27 @@ private:
     };
 
     using NodeInfoVector = std::vector<NodeInfo>;
-    using AliasMap = std::unordered_map<DwarfOffset, NodeInfoVectorIndex>;
+    using AliasMap = DieArray<NodeInfoVectorIndex>;
 
 private:
     const NodeInfoVectorIndex kRootNodeIndex_ = std::numeric_limits<NodeInfoVectorIndex>::max();
 
 public:
-    NameIndex(DwarfContextWrapper &dwarfContext) : dwarfContext_{dwarfContext} {}
+    NameIndex(DwarfContextWrapper &dwarfContext)
+        : dwarfContext_{dwarfContext}, aliasMap_{dwarfContext, kRootNodeIndex_} {}
     void IndexDie(DwarfDieWrapper &die);
     QualfiedName DecodeQualifiedName(DwarfDieWrapper &die);
     DwarfDieWrapper ResolveDieOffset(DwarfOffset offset);
+    DwarfDieWrapper ResolveDie(const DwarfDieWrapper &die);
     void VisitEntries(std::function<void(const std::vector<std::string> &, DwarfOffset)> cb);
     size_t NumEntries() const { return nodeCount_; }
     std::vector<DwarfOffset> DecodeHierarchy(DwarfOffset offset);
 
 private:
     void InsertHierarchy(const std::vector<DwarfOffset> &hierarchy);
+    void InsertAlias(DwarfOffset offset, NodeInfoVectorIndex info);
     NodeMergeStrategy EvaluateMergeStrategy(DwarfOffset currentDieOffset, DwarfOffset newDieOffset);
-    NameIndex::Node *MergeNode(Node &parentNode, std::string name, DwarfOffset newDieOffset);
+    NameIndex::Node *MergeNode(Node &parentNode, std::string_view name, DwarfOffset newDieOffset);
     NameIndex::Node *InsertNode(Node &parent, std::string name, DwarfOffset dieOffset);
     const NameIndex::Node *FindChild(const Node &parent, DwarfOffset dieOffset);
 
@@ -90,4 +94,22 @@ private:
     size_t nodeCount_ = 0;
 };
 
+/// Type builder context naming and deduplicating DIEs through a NameIndex
+class OrderedTypeBuilderContext : public TypeBuilderContext {
+public:
+    OrderedTypeBuilderContext(DwarfContextWrapper &dwarfContext, NameIndex &index, Diagnostics &diagnostics)
+        : TypeBuilderContext{dwarfContext, &diagnostics}, index_{index} {}
+
+    QualifiedName DecodeQualifiedName(DwarfDieWrapper &die) override {
+        return index_.DecodeQualifiedName(die);
+    }
+
+    DwarfDieWrapper ResolveDie(DwarfDieWrapper &die) override {
+        return index_.ResolveDie(die);
+    }
+
+private:
+    NameIndex &index_;
+};
+
 }// namespace Binja::DebugInfo
\ No newline at end of file
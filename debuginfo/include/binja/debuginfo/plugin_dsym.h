@@ -22,11 +22,16 @@
 #pragma once
 
 #include <filesystem>
+#include <optional>
+#include <vector>
 
 #include <binaryninjaapi.h>
+#include <taskflow/taskflow.hpp>
 
 #include "dsym.h"
 #include "dwarf_task.h"
+#include "manifest.h"
+#include "sink.h"
 
 namespace Binja::DebugInfo {
 
@@ -38,10 +43,19 @@ public:
     PluginDSYM(BinaryNinja::BinaryView &binaryView)
         : binaryView_{binaryView} {}
 
-    void Load(BinaryNinja::DebugInfo &debugInfo, DwarfImportProgressMonitor &monitor);
+    void Load(DebugInfoSink &sink, DwarfImportProgressMonitor &monitor);
+    /// Objects are resolved from `manifest` when given, instead of opening
+    /// the manifest of the symbol source
+    void Load(tf::Subflow &subflow, DebugInfoSink &sink, DwarfImportProgressMonitor &monitor,
+              const KDKManifest *manifest = nullptr);
 
     static void RegisterPlugin();
     std::optional<std::filesystem::path> GetSymbolSource();
+    /// DWARF objects in `source` matching the Mach-O headers of the view,
+    /// nullopt if the symbol source could not be read. `manifest`, when
+    /// given, must be the manifest of `source`.
+    std::optional<std::vector<std::filesystem::path>> FindDwarfObjects(const std::filesystem::path &source,
+                                                                       const KDKManifest *manifest = nullptr);
 
 private:
     BinaryNinja::BinaryView &binaryView_;
@@ -21,7 +21,12 @@
 
 #pragma once
 
+#include <functional>
+
 #include <binaryninjaapi.h>
+#include <taskflow/taskflow.hpp>
+
+#include "sink.h"
 
 namespace Binja::DebugInfo {
 
@@ -30,7 +35,16 @@ public:
     static constexpr auto kPluginName = "macho_kc_function_starts_debug_info";
 
 public:
+    PluginFunctionStarts(BinaryNinja::BinaryView &binaryView)
+        : binaryView_{binaryView} {}
+
+    void Load(DebugInfoSink &sink, const std::function<bool(size_t, size_t)> &progress);
+    void Load(tf::Subflow &subflow, DebugInfoSink &sink, const std::function<bool(size_t, size_t)> &progress);
+
     static void RegisterPlugin();
+
+private:
+    BinaryNinja::BinaryView &binaryView_;
 };
 
 }// namespace Binja::DebugInfo
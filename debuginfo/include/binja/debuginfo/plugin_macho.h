@@ -24,9 +24,12 @@
 #include <filesystem>
 
 #include <binaryninjaapi.h>
+#include <taskflow/taskflow.hpp>
 
 #include "dsym.h"
 #include "macho_task.h"
+#include "manifest.h"
+#include "sink.h"
 
 namespace Binja::DebugInfo {
 
@@ -38,7 +41,11 @@ public:
     PluginMacho(BinaryNinja::BinaryView &binaryView)
         : binaryView_{binaryView} {}
 
-    void Load(BinaryNinja::DebugInfo &debugInfo, MachOImportProgressMonitor &monitor);
+    void Load(DebugInfoSink &sink, MachOImportProgressMonitor &monitor);
+    /// Objects are resolved from `manifest` when given, instead of opening
+    /// the manifest of the symbol source
+    void Load(tf::Subflow &subflow, DebugInfoSink &sink, MachOImportProgressMonitor &monitor,
+              const KDKManifest *manifest = nullptr);
 
     static void RegisterPlugin();
     std::optional<std::filesystem::path> GetSymbolSource();
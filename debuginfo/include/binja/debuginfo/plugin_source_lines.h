@@ -0,0 +1,58 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <filesystem>
+#include <memory>
+
+#include <binaryninjaapi.h>
+
+#include "inline_index.h"
+#include "line_index.h"
+
+namespace Binja::DebugInfo {
+
+/// Source line and inline info from the .debug_line programs and inlined
+/// subroutines of the dSYMs matching a view. Nothing is decoded during the
+/// debug info import, each index is built or loaded from the cache the
+/// first time a command needs it. Commands run on a background thread, so
+/// that building an index does not block the UI.
+class PluginSourceLines {
+public:
+    /// Stages of loading an index are reported to `task` when given
+    PluginSourceLines(BinaryNinja::BinaryView &binaryView, BinaryNinja::BackgroundTask *task = nullptr)
+        : binaryView_{binaryView}, task_{task} {}
+
+    /// Line index of the view, opened from the manifest directory when it
+    /// was saved for the same DWARF objects and segments before. Blocks
+    /// while the index is built.
+    std::shared_ptr<const LineIndex> GetLineIndex();
+    /// Inline index of the view, cached next to the line index
+    std::shared_ptr<const InlineIndex> GetInlineIndex();
+
+    static void RegisterPlugin();
+
+private:
+    BinaryNinja::BinaryView &binaryView_;
+    BinaryNinja::BackgroundTask *task_;
+};
+
+}// namespace Binja::DebugInfo
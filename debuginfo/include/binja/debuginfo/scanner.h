@@ -0,0 +1,111 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include <llvm/BinaryFormat/Dwarf.h>
+
+#include "dwarf.h"
+
+namespace Binja::DebugInfo {
+
+/// Attributes copied into the columns of a ScannedUnit. Columns of fields
+/// that are not requested are left empty
+struct DieScanFields {
+    // DW_AT_name
+    bool name = false;
+    // DW_AT_specification and DW_AT_abstract_origin
+    bool references = false;
+    // DW_AT_low_pc, and whether DW_AT_ranges or DW_AT_entry_pc is present
+    bool entryPoint = false;
+    // Operand of a location expression starting with DW_OP_addr
+    bool locationAddress = false;
+};
+
+/// DIEs of one unit in DIE order, null entries included
+struct ScannedUnit {
+    static constexpr uint64_t kNone = std::numeric_limits<uint64_t>::max();
+    static constexpr uint32_t kNoParent = std::numeric_limits<uint32_t>::max();
+
+    enum Flag : uint8_t {
+        HasRanges = 1 << 0,
+        HasEntryPC = 1 << 1,
+    };
+
+    BinaryId binaryId;
+    std::vector<uint64_t> offsets;
+    std::vector<llvm::dwarf::Tag> tags;
+    std::vector<uint32_t> parents;
+    std::vector<std::string_view> names;
+    // Section offsets of the referenced DIEs, or kNone
+    std::vector<uint64_t> specifications;
+    std::vector<uint64_t> abstractOrigins;
+    // Unslid addresses, or kNone
+    std::vector<uint64_t> lowPCs;
+    std::vector<uint64_t> locationAddresses;
+    std::vector<uint8_t> flags;
+
+    [[nodiscard]] size_t Size() const { return offsets.size(); }
+    [[nodiscard]] DwarfOffset GetOffset(size_t index) const { return DwarfOffset{binaryId, offsets[index]}; }
+    [[nodiscard]] bool HasReference(size_t index) const {
+        return specifications[index] != kNone || abstractOrigins[index] != kNone;
+    }
+};
+
+/// Decodes the requested attributes of every DIE straight from the raw
+/// .debug_info and .debug_abbrev bytes, for passes that only look at a
+/// handful of attributes per DIE. Each abbreviation is compiled once into
+/// a plan of fixed size skips and reads, so DIEs are never materialized
+/// through the llvm DWARFDie API, which remains in use for type decoding.
+class DwarfScanner {
+public:
+    explicit DwarfScanner(DieScanFields fields);
+    ~DwarfScanner();
+
+    /// Returns std::nullopt when the unit uses a form or an encoding the
+    /// scanner does not handle, callers then fall back to the llvm DIEs
+    std::optional<ScannedUnit> Scan(const DwarfUnitWrapper &unit);
+
+private:
+    struct AbbreviationPlan;
+    struct AbbreviationTable;
+
+    const AbbreviationTable *GetAbbreviationTable(const DwarfUnitWrapper &unit);
+    void ScanDies(const DwarfUnitWrapper &unit, const AbbreviationTable &table, ScannedUnit &result);
+
+private:
+    // Abbreviation set offset and the unit parameters fixed form sizes depend on
+    using TableKey = std::tuple<const llvm::DWARFContext *, uint64_t, uint16_t, uint8_t, uint8_t>;
+
+    DieScanFields fields_;
+    // Units of a binary often share one abbreviation set
+    std::map<TableKey, std::unique_ptr<AbbreviationTable>> tables_;
+};
+
+}// namespace Binja::DebugInfo
@@ -0,0 +1,103 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include <binaryninjaapi.h>
+
+namespace Binja::DebugInfo {
+
+/// Destination for records decoded by the import tasks
+class DebugInfoSink {
+public:
+    virtual ~DebugInfoSink() = default;
+
+    virtual void AddType(const std::string &name, BinaryNinja::Ref<BinaryNinja::Type> type) = 0;
+    virtual void AddFunction(const BinaryNinja::DebugFunctionInfo &info) = 0;
+    virtual void AddDataVariable(uint64_t address, BinaryNinja::Ref<BinaryNinja::Type> type, const std::string &name) = 0;
+};
+
+/// Sink forwarding every record to a Binary Ninja debug info object
+class BinaryNinjaDebugInfoSink : public DebugInfoSink {
+public:
+    explicit BinaryNinjaDebugInfoSink(BinaryNinja::DebugInfo &debugInfo)
+        : debugInfo_{debugInfo} {}
+
+    void AddType(const std::string &name, BinaryNinja::Ref<BinaryNinja::Type> type) override {
+        debugInfo_.AddType(name, type);
+    }
+
+    void AddFunction(const BinaryNinja::DebugFunctionInfo &info) override {
+        debugInfo_.AddFunction(info);
+    }
+
+    void AddDataVariable(uint64_t address, BinaryNinja::Ref<BinaryNinja::Type> type, const std::string &name) override {
+        debugInfo_.AddDataVariable(address, type, name);
+    }
+
+private:
+    BinaryNinja::DebugInfo &debugInfo_;
+};
+
+/// Sink counting every record before forwarding it to `next`. Without a
+/// `next` sink records are dropped, which runs the import headless so that
+/// decoding can be measured apart from Binary Ninja debug info bookkeeping
+class CountingDebugInfoSink : public DebugInfoSink {
+public:
+    explicit CountingDebugInfoSink(DebugInfoSink *next = nullptr)
+        : next_{next} {}
+
+    void AddType(const std::string &name, BinaryNinja::Ref<BinaryNinja::Type> type) override {
+        numTypes_.fetch_add(1, std::memory_order_relaxed);
+        if (next_) {
+            next_->AddType(name, type);
+        }
+    }
+
+    void AddFunction(const BinaryNinja::DebugFunctionInfo &info) override {
+        numFunctions_.fetch_add(1, std::memory_order_relaxed);
+        if (next_) {
+            next_->AddFunction(info);
+        }
+    }
+
+    void AddDataVariable(uint64_t address, BinaryNinja::Ref<BinaryNinja::Type> type, const std::string &name) override {
+        numDataVariables_.fetch_add(1, std::memory_order_relaxed);
+        if (next_) {
+            next_->AddDataVariable(address, type, name);
+        }
+    }
+
+    size_t GetTypeCount() const { return numTypes_.load(std::memory_order_relaxed); }
+    size_t GetFunctionCount() const { return numFunctions_.load(std::memory_order_relaxed); }
+    size_t GetDataVariableCount() const { return numDataVariables_.load(std::memory_order_relaxed); }
+
+private:
+    DebugInfoSink *next_;
+    std::atomic<size_t> numTypes_{0};
+    std::atomic<size_t> numFunctions_{0};
+    std::atomic<size_t> numDataVariables_{0};
+};
+
+}// namespace Binja::DebugInfo
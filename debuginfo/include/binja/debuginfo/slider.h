@@ -26,6 +26,8 @@
 
 namespace Binja::DebugInfo {
 
+class Diagnostics;
+
 class AddressSlider {
 private:
     using Interval = Utils::Interval<uint64_t>;
@@ -35,7 +37,8 @@ public:
     std::optional<uint64_t> SlideAddress(uint64_t address);
 
     static AddressSlider CreateFromMachOSegments(const std::vector<MachO::Segment> &from,
-                                                 const std::vector<MachO::Segment> &to);
+                                                 const std::vector<MachO::Segment> &to,
+                                                 Diagnostics *diagnostics = nullptr);
 
 private:
     Utils::IntervalMap<uint64_t, uint64_t> s1map_;
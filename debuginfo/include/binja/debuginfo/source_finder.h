@@ -23,6 +23,7 @@
 
 #include <filesystem>
 #include <map>
+#include <optional>
 #include <set>
 
 #include <binaryninjaapi.h>
@@ -38,6 +39,13 @@ class KDKError : public Types::DecodeError {
     using Types::DecodeError::DecodeError;
 };
 
+struct KDKContents {
+    std::set<std::filesystem::path> dsymObjects;
+    std::set<std::filesystem::path> machoObjects;
+    std::set<std::filesystem::path> kernelExtensions;
+    std::map<std::filesystem::path, int64_t> directoryTimes;
+};
+
 class SymbolSourceFinder {
 public:
     explicit SymbolSourceFinder(std::filesystem::path path) : path_{std::move(path)} { VerifyKDK(); }
@@ -45,11 +53,14 @@ public:
     std::set<std::filesystem::path> FindAllMachoObjects();
     std::set<std::filesystem::path> FindAllKernelExtensions();
 
+    const KDKContents &Scan();
+
 private:
     void VerifyKDK();
 
 private:
     std::filesystem::path path_;
+    std::optional<KDKContents> contents_;
 };
 
 }// namespace Binja::DebugInfo
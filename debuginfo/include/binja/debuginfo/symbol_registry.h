@@ -0,0 +1,91 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace Binja::DebugInfo {
+
+/// Stores each distinct symbol name once and hands out compact ids for it.
+/// Names are sharded by hash so that concurrent importers rarely contend
+/// on the same lock.
+class SymbolNameInterner {
+public:
+    using NameId = uint32_t;
+
+public:
+    NameId Intern(std::string_view name);
+    std::string_view Get(NameId id) const;
+
+private:
+    static constexpr size_t kShardBits = 6;
+    static constexpr size_t kShardCount = 1 << kShardBits;
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string_view, NameId> index;
+        std::deque<std::string> names;
+    };
+
+    std::array<Shard, kShardCount> shards_;
+};
+
+/// Fixed capacity address to owner table. Workers claim an address with
+/// compare-and-swap instead of taking a global lock. When multiple owners
+/// claim the same address the numerically smallest owner wins, which keeps
+/// the outcome independent of thread scheduling.
+class SymbolRegistry {
+public:
+    using OwnerId = uint64_t;
+
+    static constexpr OwnerId kExistingSymbol = 0;
+
+public:
+    explicit SymbolRegistry(size_t expectedSymbols);
+
+    OwnerId Claim(uint64_t address, OwnerId owner);
+    std::optional<OwnerId> Owner(uint64_t address) const;
+
+private:
+    static constexpr uint64_t kEmptyAddress = UINT64_MAX;
+    static constexpr OwnerId kNoOwner = UINT64_MAX;
+
+    struct Slot {
+        std::atomic<uint64_t> address{kEmptyAddress};
+        std::atomic<OwnerId> owner{kNoOwner};
+    };
+
+    size_t SlotIndex(uint64_t address) const;
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t mask_;
+};
+
+}// namespace Binja::DebugInfo
@@ -0,0 +1,133 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include <binaryninjaapi.h>
+
+#include "diagnostics.h"
+#include "die_table.h"
+#include "dwarf.h"
+#include "name_index.h"
+
+namespace Binja::DebugInfo {
+
+/// Dependency graph over the type DIEs the named types of a NameIndex are
+/// built from. Builders only reference named types by name, so edges lead to
+/// the anonymous types and type modifiers that are decoded inline. Strongly
+/// connected components of the graph are grouped into waves, a component
+/// only depends on components of earlier waves.
+class TypeGraph {
+public:
+    using NodeIndex = uint32_t;
+    using ComponentIndex = uint32_t;
+
+    static constexpr NodeIndex kNoNode = std::numeric_limits<NodeIndex>::max();
+
+    struct Node {
+        DwarfOffset die;
+        std::vector<NodeIndex> edges;
+        ComponentIndex component;
+        // Named type decoded with its full definition
+        bool root;
+    };
+
+    struct Component {
+        // Sorted by DIE offset, which is also the build order
+        std::vector<NodeIndex> nodes;
+        uint32_t wave;
+        // Types reached again while building a cyclic component are emitted
+        // as named references
+        bool cyclic;
+    };
+
+public:
+    TypeGraph(DwarfContextWrapper &dwarfContext, NameIndex &nameIndex)
+        : dwarfContext_{dwarfContext}, nameIndex_{nameIndex}, nodeIndices_{dwarfContext, kNoNode} {}
+
+    NodeIndex AddRoot(DwarfOffset die);
+
+    /// Discovers the types reachable from the roots and computes the build
+    /// waves. Must be called once, after all the roots are added.
+    void Schedule();
+
+    [[nodiscard]] const Node &GetNode(NodeIndex index) const { return nodes_[index]; }
+    [[nodiscard]] size_t GetNodeCount() const { return nodes_.size(); }
+    [[nodiscard]] const Component &GetComponent(ComponentIndex index) const { return components_[index]; }
+    [[nodiscard]] size_t GetComponentCount() const { return components_.size(); }
+    [[nodiscard]] const std::vector<ComponentIndex> &GetWave(size_t wave) const { return waves_[wave]; }
+    [[nodiscard]] size_t GetWaveCount() const { return waves_.size(); }
+
+    /// Node of a type decoded inline, kNoNode for roots and unknown DIEs
+    [[nodiscard]] NodeIndex FindNode(const DwarfDieWrapper &die) const;
+
+private:
+    void Expand();
+    void ComputeComponents();
+    void AddComponent(std::vector<NodeIndex> nodes);
+    void AddEdge(NodeIndex from, std::optional<DwarfDieWrapper> target, std::vector<NodeIndex> &pending);
+    static bool IsInlineType(DwarfDieWrapper &die);
+
+private:
+    DwarfContextWrapper &dwarfContext_;
+    NameIndex &nameIndex_;
+    DieArray<NodeIndex> nodeIndices_;
+    std::vector<Node> nodes_;
+    std::vector<Component> components_;
+    std::vector<std::vector<ComponentIndex>> waves_;
+};
+
+/// Builds the named types of a TypeGraph wave by wave on the shared
+/// executor. Every worker uses its own builder context, and types of
+/// components from earlier waves are reused instead of being decoded again,
+/// which also keeps the builder recursion shallow.
+///
+/// The DWARF objects are only read while building, DIEs of all units must
+/// already be extracted.
+class ParallelTypeBuilder {
+public:
+    using TypeRef = BinaryNinja::Ref<BinaryNinja::Type>;
+
+public:
+    ParallelTypeBuilder(DwarfContextWrapper &dwarfContext, NameIndex &nameIndex,
+                        Diagnostics &diagnostics, const TypeGraph &graph)
+        : dwarfContext_{dwarfContext}, nameIndex_{nameIndex}, diagnostics_{diagnostics}, graph_{graph} {}
+
+    /// Called on the thread running Build after every wave, with the number
+    /// of nodes built so far and the number of nodes of the graph
+    using WaveCallback = std::function<void(size_t done, size_t total)>;
+
+    /// Returns the built type of every node, indexed by NodeIndex
+    std::vector<TypeRef> Build(const WaveCallback &onWave = {});
+
+private:
+    DwarfContextWrapper &dwarfContext_;
+    NameIndex &nameIndex_;
+    Diagnostics &diagnostics_;
+    const TypeGraph &graph_;
+};
+
+}// namespace Binja::DebugInfo
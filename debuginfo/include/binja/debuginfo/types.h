@@ -23,11 +23,12 @@
 
 #include <string>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 #include <binaryninjaapi.h>
 
+#include "diagnostics.h"
+#include "die_table.h"
 #include "dwarf.h"
 
 namespace Binja::DebugInfo {
@@ -39,17 +40,28 @@ public:
     using QualifiedName = BinaryNinja::QualifiedName;
 
 public:
-    TypeBuilderContext(DwarfContextWrapper &dwarfContext) : dwarfContext_{dwarfContext} {}
+    TypeBuilderContext(DwarfContextWrapper &dwarfContext, Diagnostics *diagnostics = nullptr)
+        : dwarfContext_{dwarfContext}, diagnostics_{diagnostics}, workingSet_{dwarfContext} {}
     virtual ~TypeBuilderContext() = default;
     virtual BinaryNinja::QualifiedName DecodeQualifiedName(DwarfDieWrapper &die) = 0;
     virtual DwarfDieWrapper ResolveDie(DwarfDieWrapper &die) = 0;
     virtual bool TagDieAsProcessing(DwarfDieWrapper &die);
     virtual void UntagDieAsProcessing(DwarfDieWrapper &die);
     virtual std::optional<uint64_t> SlideAddress(DwarfOffset die, uint64_t address);
+    /// Previously built type to reuse for a resolved DIE, if any
+    virtual TypeRef FindBuiltType(DwarfDieWrapper &die) { return nullptr; }
+
+    /// Diagnostics are dropped when the context has no collector
+    void ReportDiagnostic(DiagnosticKind kind, DwarfOffset die) {
+        if (diagnostics_) {
+            diagnostics_->Report(kind, die);
+        }
+    }
 
 protected:
     DwarfContextWrapper &dwarfContext_;
-    std::unordered_set<DwarfOffset> workingSet_;
+    Diagnostics *diagnostics_;
+    DieBitset workingSet_;
 };
 
 class TypeBuilder {
@@ -0,0 +1,163 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <taskflow/taskflow.hpp>
+
+#include <binja/utils/debug.h>
+#include <binja/utils/executor.h>
+#include <binja/utils/log.h>
+#include <binja/utils/metrics.h>
+
+#include "arbiter.h"
+
+using namespace Binja;
+using namespace DebugInfo;
+using namespace BinaryNinja;
+
+
+/// Candidate
+
+bool SymbolArbiter::Candidate::IsNamed() const {
+    if (function) {
+        return !function->rawName.empty() || !function->fullName.empty() || !function->shortName.empty();
+    }
+    return !name.empty();
+}
+
+
+/// Source sink
+
+void SymbolArbiter::SourceSink::AddType(const std::string &name, Ref<Type> type) {
+    std::lock_guard lock{mutex_};
+    types_.emplace_back(name, type);
+}
+
+void SymbolArbiter::SourceSink::AddFunction(const DebugFunctionInfo &info) {
+    std::lock_guard lock{mutex_};
+    candidates_.push_back(Candidate{
+        .address = info.address,
+        .function = info,
+    });
+}
+
+void SymbolArbiter::SourceSink::AddDataVariable(uint64_t address, Ref<Type> type, const std::string &name) {
+    std::lock_guard lock{mutex_};
+    candidates_.push_back(Candidate{
+        .address = address,
+        .type = type,
+        .name = name,
+    });
+}
+
+
+/// Symbol arbiter
+
+SymbolArbiter::SymbolArbiter() {
+    for (auto &sink: sinks_) {
+        sink = std::make_unique<SourceSink>();
+    }
+}
+
+DebugInfoSink &SymbolArbiter::GetSink(SymbolSourceKind source) {
+    auto index = static_cast<size_t>(source);
+    BDVerify(index < kNumSources);
+    return *sinks_[index];
+}
+
+void SymbolArbiter::Emit(DebugInfoSink &sink) {
+    Utils::ScopedPhase phase{"arbiter.emit"};
+    size_t numCandidates = 0;
+    for (const auto &source: sinks_) {
+        numCandidates += source->candidates_.size();
+    }
+
+    SymbolRegistry registry{numCandidates};
+    tf::Taskflow taskflow;
+    taskflow.for_each_index(size_t{0}, kNumSources, size_t{1}, [&](size_t sourceIndex) {
+        Utils::ScopedPhase claimPhase{"arbiter.claim"};
+        const auto &candidates = sinks_[sourceIndex]->candidates_;
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            registry.Claim(candidates[i].address, MakeOwnerId(sourceIndex, i, candidates[i].IsNamed()));
+        }
+    });
+    Utils::RunAndWait(taskflow);
+
+    for (const auto &source: sinks_) {
+        for (const auto &[name, type]: source->types_) {
+            sink.AddType(name, type);
+        }
+    }
+
+    for (size_t sourceIndex = 0; sourceIndex < kNumSources; ++sourceIndex) {
+        const auto &candidates = sinks_[sourceIndex]->candidates_;
+        size_t numEmitted = 0;
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            const Candidate &candidate = candidates[i];
+            auto owner = registry.Owner(candidate.address);
+            BDVerify(owner);
+            if (*owner != MakeOwnerId(sourceIndex, i, candidate.IsNamed())) {
+                continue;
+            }
+            if (candidate.function) {
+                sink.AddFunction(*candidate.function);
+            } else {
+                sink.AddDataVariable(candidate.address, candidate.type, candidate.name);
+            }
+            numEmitted++;
+        }
+        phase.Add(Utils::Counter::SymbolsAdded, numEmitted);
+        if (!candidates.empty()) {
+            BDLogInfo("emitted {} symbols from {}, {} were shadowed by higher priority sources",
+                      numEmitted, SourceName(sourceIndex), candidates.size() - numEmitted);
+        }
+    }
+
+    for (auto &source: sinks_) {
+        source = std::make_unique<SourceSink>();
+    }
+}
+
+SymbolRegistry::OwnerId SymbolArbiter::MakeOwnerId(size_t sourceIndex, size_t candidateIndex, bool named) {
+    // Lower owner ids win, so the rank goes to the high bits and earlier
+    // candidates of the same source win over later ones. Unnamed candidates
+    // rank below the named candidates of every source, so that a higher
+    // priority source without a name does not hide the name of a lower one.
+    BDVerify(candidateIndex < (uint64_t{1} << 48));
+    uint64_t rank = sourceIndex + 1 + (named ? 0 : kNumSources);
+    return (rank << 48) | candidateIndex;
+}
+
+std::string_view SymbolArbiter::SourceName(size_t sourceIndex) {
+    switch (static_cast<SymbolSourceKind>(sourceIndex)) {
+        case SymbolSourceKind::Dwarf:
+            return "DWARF";
+        case SymbolSourceKind::KextSymtab:
+            return "kext symbol tables";
+        case SymbolSourceKind::KCSymtab:
+            return "kernel cache symbol table";
+        case SymbolSourceKind::FunctionStarts:
+            return "LC_FUNCTION_STARTS";
+        case SymbolSourceKind::Max:
+            break;
+    }
+    BDVerify(false);
+    return {};
+}
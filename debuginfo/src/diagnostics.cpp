@@ -0,0 +1,138 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <type_traits>
+
+#include <fmt/format.h>
+
+#include <binja/utils/debug.h>
+#include <binja/utils/log.h>
+
+#include "diagnostics.h"
+
+using namespace Binja;
+using namespace DebugInfo;
+
+std::string_view DebugInfo::DiagnosticKindDescription(DiagnosticKind kind) {
+    switch (kind) {
+        case DiagnosticKind::UnsupportedTypeModifier:
+            return "unsupported type modifier";
+        case DiagnosticKind::TypedefWithoutType:
+            return "typedef without DW_AT_type";
+        case DiagnosticKind::TypedefWithoutName:
+            return "typedef without DW_AT_name";
+        case DiagnosticKind::UnsupportedArray:
+            return "unsupported array";
+        case DiagnosticKind::ArrayWithoutType:
+            return "array without DW_AT_type";
+        case DiagnosticKind::InvalidArrayBounds:
+            return "invalid array bounds";
+        case DiagnosticKind::InvalidFunctionParameter:
+            return "invalid function parameter";
+        case DiagnosticKind::InvalidEnumBaseType:
+            return "enum with invalid base type";
+        case DiagnosticKind::InvalidEnumerator:
+            return "enumerator without name or value";
+        case DiagnosticKind::UnexpectedChildTag:
+            return "unexpected child tag";
+        case DiagnosticKind::ContainerWithoutSize:
+            return "container without DW_AT_byte_size";
+        case DiagnosticKind::MemberWithoutType:
+            return "member without DW_AT_type";
+        case DiagnosticKind::MemberWithoutLocation:
+            return "member without DW_AT_data_member_location";
+        case DiagnosticKind::InvalidAccessibility:
+            return "invalid DW_AT_accessibility";
+        case DiagnosticKind::BitfieldLayout:
+            return "unsupported bitfield layout";
+        case DiagnosticKind::InvalidPointerToMember:
+            return "invalid pointer to member type";
+        case DiagnosticKind::UnknownTypeTag:
+            return "unknown type tag";
+        case DiagnosticKind::FunctionAddressNotSlid:
+            return "function address not in any segment";
+        case DiagnosticKind::VariableAddressNotSlid:
+            return "variable address not in any segment";
+        case DiagnosticKind::VariableWithoutName:
+            return "variable without DW_AT_name";
+        case DiagnosticKind::VariableWithoutType:
+            return "variable without DW_AT_type";
+        case DiagnosticKind::SegmentLengthMismatch:
+            return "segment length mismatch";
+        case DiagnosticKind::SymbolAddressNotSlid:
+            return "symbol address not in any segment";
+        case DiagnosticKind::SymbolShadowed:
+            return "symbol shadowed by existing symbol";
+        case DiagnosticKind::Max:
+            break;
+    }
+    BDVerify(false);
+    return {};
+}
+
+template<class Sample>
+void Diagnostics::Record(DiagnosticKind kind, const Sample &sample) {
+    Entry &entry = entries_[static_cast<size_t>(kind)];
+    if (entry.count.fetch_add(1, std::memory_order_relaxed) >= kMaxSamples) {
+        return;
+    }
+    std::string formatted;
+    if constexpr (std::is_same_v<Sample, DwarfOffset>) {
+        formatted = fmt::format("{}", sample);
+    } else {
+        formatted = fmt::format("{:#x}", sample);
+    }
+    std::lock_guard lock{entry.mutex};
+    entry.samples.push_back(std::move(formatted));
+}
+
+void Diagnostics::Report(DiagnosticKind kind, DwarfOffset die) {
+    Record(kind, die);
+}
+
+void Diagnostics::Report(DiagnosticKind kind, uint64_t address) {
+    Record(kind, address);
+}
+
+uint64_t Diagnostics::Count(DiagnosticKind kind) const {
+    return entries_[static_cast<size_t>(kind)].count.load(std::memory_order_relaxed);
+}
+
+void Diagnostics::LogSummary(std::string_view importName) const {
+    std::string table;
+    uint64_t total = 0;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        const Entry &entry = entries_[i];
+        uint64_t count = entry.count.load(std::memory_order_relaxed);
+        if (count == 0) {
+            continue;
+        }
+        total += count;
+        std::lock_guard lock{entry.mutex};
+        table += fmt::format("\n  {:<44} {:>8}  {}", DiagnosticKindDescription(static_cast<DiagnosticKind>(i)),
+                             count, fmt::join(entry.samples, ", "));
+    }
+    if (total == 0) {
+        BDLogInfo("{} finished without diagnostics", importName);
+        return;
+    }
+    BDLogWarn("{} finished with {} diagnostics:\n  {:<44} {:>8}  {}{}",
+              importName, total, "kind", "count", "samples", table);
+}
@@ -23,9 +23,11 @@
 #include <llvm/Object/MachO.h>
 #include <llvm/Object/MachOUniversal.h>
 #include <llvm/Support/Error.h>
+#include <mio/mmap.hpp>
 
 #include <binja/types/errors.h>
 #include <binja/utils/debug.h>
+#include <binja/utils/metrics.h>
 
 #include "debug.h"
 #include "dsym.h"
@@ -66,6 +68,7 @@ DwarfObjectFile::DwarfObjectFile(const std::filesystem::path &objectPath) {
                              LLVMErrorToString(buff.getError())};
         }
         buffer_ = std::move(buff.get());
+        Utils::CountMetric(Utils::Counter::BytesRead, buffer_->getBufferSize());
     }
 
     {
@@ -124,6 +127,16 @@ std::vector<fs::path> DwarfObjectFile::DsymFindObjects(const fs::path &symbolsPa
     return objectPaths;
 }
 
+std::optional<Binja::MachO::MachObjectInfo> DwarfObjectFile::Probe(const fs::path &objectPath) {
+    std::error_code ec;
+    mio::mmap_source file;
+    file.map(objectPath.string(), ec);
+    if (ec) {
+        throw DwarfError{"failed to open file {}, error: {}", objectPath.string(), ec.message()};
+    }
+    return Binja::MachO::ProbeMachObject({file.data(), file.size()}, llvm::MachO::CPU_TYPE_ARM64);
+}
+
 std::optional<Types::UUID> DwarfObjectFile::DecodeUUID() const {
     auto *macho = llvm::dyn_cast<llvm::object::MachOObjectFile>(dwarfContext_->getDWARFObj().getFile());
     BDVerify(macho);
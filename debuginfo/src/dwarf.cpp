@@ -19,6 +19,8 @@
 // SOFTWARE.
 
 
+#include <algorithm>
+
 #include <llvm/DebugInfo/DWARF/DWARFContext.h>
 #include <llvm/DebugInfo/DWARF/DWARFExpression.h>
 #include <llvm/DebugInfo/DWARF/DWARFUnit.h>
@@ -48,15 +50,15 @@ std::string LLVMErrorToString(llvm::Error error) {
     return out;
 }
 
-std::string LLVMFormValueToString(const Optional<DWARFFormValue> &value, const char *defaultValue) {
+std::string_view LLVMFormValueToStringView(const Optional<DWARFFormValue> &value, std::string_view defaultValue) {
     if (value) {
         Expected<const char *> cstr = value->getAsCString();
         if (cstr) {
-            return std::string(cstr.get());
+            return std::string_view{cstr.get()};
         }
         LLVMErrorToString(cstr.takeError());
     }
-    return std::string(defaultValue);
+    return defaultValue;
 }
 
 }// namespace
@@ -162,6 +164,75 @@ std::optional<uint64_t> DwarfContextWrapper::GetSlidAddress(DwarfOffset offset,
     return std::nullopt;
 }
 
+const DieLayout &DwarfContextWrapper::GetDieLayout() {
+    std::call_once(*dieLayoutOnce_, [this] {
+        std::vector<std::vector<DWARFUnit *>> units(entries_.size());
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            for (const auto &unit: entries_[i].object.GetDWARFContext().getNormalUnitsVector()) {
+                // Cached by the unit on first access
+                (void) unit->getBaseAddress();
+                units[i].push_back(unit.get());
+            }
+        }
+        dieLayout_ = std::make_unique<DieLayout>(units);
+    });
+    return *dieLayout_;
+}
+
+std::optional<DieId> DwarfContextWrapper::GetDieId(const DwarfDieWrapper &die) {
+    if (!die.die_.isValid()) {
+        return std::nullopt;
+    }
+    return GetDieLayout().GetId((BinaryId) die.offset_.binaryId, die.die_);
+}
+
+std::optional<DieId> DwarfContextWrapper::GetDieId(DwarfOffset offset) {
+    return GetDieId(GetDIEForOffset(offset));
+}
+
+DwarfDieWrapper DwarfContextWrapper::GetDIEForId(DieId id) {
+    return DwarfDieWrapper{GetDieLayout().GetDie(id), id.binaryId};
+}
+
+
+/// Die layout
+
+DieLayout::DieLayout(const std::vector<std::vector<DWARFUnit *>> &units)
+    : binaries_(units.size()) {
+    for (size_t i = 0; i < units.size(); ++i) {
+        Binary &binary = binaries_[i];
+        BDVerify(units[i].size() <= std::numeric_limits<uint32_t>::max());
+        for (DWARFUnit *unit: units[i]) {
+            binary.unitKeys.push_back(UnitKey{unit, (uint32_t) binary.units.size()});
+            binary.units.push_back(UnitSpan{unit, binary.numDies});
+            binary.numDies += unit->getNumDIEs();
+        }
+        std::sort(binary.unitKeys.begin(), binary.unitKeys.end(), [](const UnitKey &lhs, const UnitKey &rhs) {
+            return std::less<const DWARFUnit *>{}(lhs.unit, rhs.unit);
+        });
+    }
+}
+
+std::optional<DieId> DieLayout::GetId(BinaryId binaryId, const DWARFDie &die) const {
+    if (binaryId >= binaries_.size()) {
+        return std::nullopt;
+    }
+    const Binary &binary = binaries_[binaryId];
+    const DWARFUnit *unit = die.getDwarfUnit();
+    auto it = std::lower_bound(binary.unitKeys.begin(), binary.unitKeys.end(), unit, [](const UnitKey &key, const DWARFUnit *unit) {
+        return std::less<const DWARFUnit *>{}(key.unit, unit);
+    });
+    if (it == binary.unitKeys.end() || it->unit != unit) {
+        return std::nullopt;
+    }
+    uint32_t dieIndex = binary.units[it->unitIndex].unit->getDIEIndex(die);
+    return DieId{binaryId, it->unitIndex, dieIndex};
+}
+
+DWARFDie DieLayout::GetDie(DieId id) const {
+    return binaries_[id.binaryId].units[id.unitIndex].unit->getDIEAtIndex(id.dieIndex);
+}
+
 
 /// Attribute reader
 
@@ -184,10 +255,14 @@ std::optional<uint64_t> AttributeReader::ReadInt(Attribute attribute, bool recur
 }
 
 std::string AttributeReader::ReadString(Attribute attribute, const char *defaultValue, bool recursive) const {
+    return std::string{ReadStringView(attribute, defaultValue, recursive)};
+}
+
+std::string_view AttributeReader::ReadStringView(Attribute attribute, std::string_view defaultValue, bool recursive) const {
     if (recursive) {
-        return LLVMFormValueToString(die_.FindRecursively(attribute), defaultValue);
+        return LLVMFormValueToStringView(die_.FindRecursively(attribute), defaultValue);
     }
-    return LLVMFormValueToString(die_.Find(attribute), defaultValue);
+    return LLVMFormValueToStringView(die_.Find(attribute), defaultValue);
 }
 
 std::optional<DwarfDieWrapper> AttributeReader::ReadReference(Attribute attribute, bool recursive) const {
@@ -201,6 +276,10 @@ std::string AttributeReader::ReadName(const char *defaultName, bool recursive) c
     return ReadString(llvm::dwarf::DW_AT_name, defaultName, recursive);
 }
 
+std::string_view AttributeReader::ReadNameView(std::string_view defaultName, bool recursive) const {
+    return ReadStringView(llvm::dwarf::DW_AT_name, defaultName, recursive);
+}
+
 bool AttributeReader::HasAttribute(Attribute attribute, bool recursive) const {
     if (auto ref = FindAttribute(attribute, recursive)) {
         return true;
@@ -212,6 +291,10 @@ std::string AttributeReader::ReadLinkageName(const char *defaultName, bool recur
     return ReadString(dwarf::DW_AT_linkage_name, defaultName, recursive);
 }
 
+std::string_view AttributeReader::ReadLinkageNameView(std::string_view defaultName, bool recursive) const {
+    return ReadStringView(dwarf::DW_AT_linkage_name, defaultName, recursive);
+}
+
 std::optional<llvm::DWARFFormValue> AttributeReader::FindAttribute(
     llvm::dwarf::Attribute attr, bool recursive) const {
     if (recursive) {
@@ -295,11 +378,7 @@ public:
             case DW_TAG_base_type:
             case DW_TAG_subroutine_type:
             case DW_TAG_unspecified_type: {
-                auto name = reader.ReadString(DW_AT_name);
-                if (name.empty()) {
-                    name = GetAnonymousName(die_);
-                }
-                qf_.push_back(name);
+                PushName(reader.ReadStringView(DW_AT_name), die_);
                 DwarfDieWrapper parent = die_.GetParent();
                 ScanContainer(parent);
                 break;
@@ -323,21 +402,17 @@ private:
 
         auto tag = die.GetTag();
         AttributeReader reader{die};
-        std::string name = reader.ReadString(DW_AT_name, "", true);
+        std::string_view name = reader.ReadStringView(DW_AT_name, "", true);
 
         switch (tag) {
             case llvm::dwarf::DW_TAG_compile_unit:
                 return;
             case DW_TAG_namespace: {
-                if (name.empty()) {
-                    name = GetAnonymousName(die);
-                }
-                qf_.push_back(name);
+                PushName(name, die);
                 break;
             }
             case DW_TAG_lexical_block: {
-                name = GetAnonymousName(die);
-                qf_.push_back(name);
+                qf_.push_back(GetAnonymousName(die));
                 break;
             }
             case DW_TAG_enumeration_type: {
@@ -350,10 +425,7 @@ private:
             case DW_TAG_typedef:
             case DW_TAG_template_alias: {
                 VerifyDebugDumpDie(!name.empty(), die);
-                if (name.empty()) {
-                    name = GetAnonymousName(die);
-                }
-                qf_.push_back(name);
+                PushName(name, die);
                 break;
             }
             case DW_TAG_class_type: {
@@ -366,10 +438,7 @@ private:
             case DW_TAG_structure_type:
             case DW_TAG_union_type: {
                 if (!reader.HasAttribute(DW_AT_export_symbols)) {
-                    if (name.empty()) {
-                        name = GetAnonymousName(die);
-                    }
-                    qf_.push_back(name);
+                    PushName(name, die);
                 }
                 break;
             }
@@ -388,10 +457,7 @@ private:
                     ScanContainer(*base);
                     return;
                 }
-                if (name.empty()) {
-                    name = GetAnonymousName(die);
-                }
-                qf_.push_back(name);
+                PushName(name, die);
                 break;
             }
             default: {
@@ -404,6 +470,14 @@ private:
         ScanContainer(parent);
     }
 
+    void PushName(std::string_view name, DwarfDieWrapper &die) {
+        if (name.empty()) {
+            qf_.push_back(GetAnonymousName(die));
+        } else {
+            qf_.emplace_back(name);
+        }
+    }
+
     static const char *GetAnonymousNameSuffix(dwarf::Tag tag) {
         switch (tag) {
             case dwarf::DW_TAG_namespace:
@@ -23,13 +23,19 @@
 
 #include <llvm/DebugInfo/DWARF/DWARFDie.h>
 
+#include <taskflow/taskflow.hpp>
+
 #include <binja/utils/debug.h>
 #include <binja/utils/log.h>
+#include <binja/utils/metrics.h>
+#include <binja/utils/trace.h>
 
 #include "debug.h"
 #include "dwarf_task.h"
 #include "function.h"
 #include "name_index.h"
+#include "scanner.h"
+#include "type_graph.h"
 #include "types.h"
 #include "variable.h"
 
@@ -40,156 +46,291 @@ using namespace BinaryNinja;
 
 namespace {
 
-class OrderedTypeBuilderContext : public TypeBuilderContext {
-public:
-    OrderedTypeBuilderContext(DwarfContextWrapper &dwarfContext, NameIndex &index)
-        : TypeBuilderContext{dwarfContext}, index_{index} {}
-
-    QualifiedName DecodeQualifiedName(DwarfDieWrapper &die) {
-        return index_.DecodeQualifiedName(die);
+// Exceptions must not escape a task, so a failed phase is logged and the
+// remaining phases are skipped
+template<class Phase>
+void RunPhase(bool &failed, Phase &&phase) {
+    if (failed) {
+        return;
     }
+    try {
+        phase();
+    } catch (const Types::DecodeError &e) {
+        BDLogError("Failed to load symbols, error: {}", e.what());
+        failed = true;
+    }
+}
 
-    DwarfDieWrapper ResolveDie(DwarfDieWrapper &die) {
-        return index_.ResolveDieOffset(die.GetOffset());
+// Offsets of the DIEs of unit accepted by select from the scanned columns.
+// Units the scanner cannot handle yield every DIE, the checks callers run on
+// the llvm DIE then do the filtering
+template<class Select>
+std::vector<DwarfOffset> SelectDies(DwarfScanner &scanner, const DwarfUnitWrapper &unit,
+                                    Utils::ScopedPhase &phase, Select &&select) {
+    std::vector<DwarfOffset> offsets;
+    if (auto scanned = scanner.Scan(unit)) {
+        phase.Add(Utils::Counter::DiesVisited, scanned->Size());
+        for (size_t i = 0; i < scanned->Size(); ++i) {
+            if (select(*scanned, i)) {
+                offsets.push_back(scanned->GetOffset(i));
+            }
+        }
+        return offsets;
     }
 
-private:
-    NameIndex index_;
-};
+    auto dies = unit.Dies();
+    phase.Add(Utils::Counter::DiesVisited, dies.size());
+    for (const auto &dieInfo: dies) {
+        offsets.push_back(dieInfo.GetOffset());
+    }
+    return offsets;
+}
 
 }// namespace
 
-void DwarfImportTask::Import() {
-    DwarfContextWrapper dwarfContext = BuildDwarfContext();
+void DwarfImportTask::Import(tf::Subflow &subflow) {
+    auto state = std::make_unique<DwarfImportState>(BuildDwarfContext(dwarfObjects_, binaryView_, &diagnostics_));
+    DwarfContextWrapper &dwarfContext = state->dwarfContext;
+    NameIndex &nameIndex = state->nameIndex;
     BDLogInfo("importing symbols from {} dwarf objects",
               dwarfContext.GetDwarfObjectCount());
 
-    NameIndex nameIndex{dwarfContext};
+    // The phases are chained because each consumes the results of the one
+    // before it. The DWARF objects may be read concurrently only once
+    // GetDieLayout() extracted the DIEs of every unit, after which phases
+    // and the lazy importer use them read-only.
+    std::vector<LazyFunctionImporter::Entry> lazyFunctions;
+    bool failed = false;
+    tf::Task indexNames = subflow.emplace([&] {
+        RunPhase(failed, [&] { IndexQualifiedNames(dwarfContext, nameIndex); });
+    }).name("dwarf_index_names");
+    tf::Task importTypes = subflow.emplace([&] {
+        RunPhase(failed, [&] { ImportTypes(dwarfContext, nameIndex); });
+    }).name("dwarf_import_types");
+    tf::Task importSymbols = subflow.emplace([&] {
+        RunPhase(failed, [&] { ImportFunctionsAndGlobals(dwarfContext, nameIndex, lazyFunctions); });
+    }).name("dwarf_import_functions_and_globals");
+    indexNames.precede(importTypes);
+    importTypes.precede(importSymbols);
+    subflow.join();
+    diagnostics_.LogSummary("dwarf import");
 
-    // phase 1
-    {
-        const auto &units = dwarfContext.GetNormalUnitsVector();
-        size_t numUnits = units.size();
-        BDLogInfo("indexing types from {} units", numUnits);
-
-        for (size_t i = 0; i < numUnits; ++i) {
-            for (const auto &dieInfo: units[i].Dies()) {
-                DwarfDieWrapper die = dwarfContext.GetDIEForOffset(dieInfo.GetOffset());
-                if (!IsNamedTypeTag(die.GetTag())) {
-                    continue;
-                }
-                if (AttributeReader{die}.ReadName("", true).empty()) {
-                    continue;
-                }
-                nameIndex.IndexDie(die);
+    if (!failed && !lazyFunctions.empty()) {
+        // The importer takes over the DWARF objects to decode functions later
+        auto importer = std::make_shared<LazyFunctionImporter>(std::move(state), std::move(lazyFunctions));
+        LazyFunctionImporter::Attach(binaryView_, std::move(importer));
+    }
+}
+
+void DwarfImportTask::IndexQualifiedNames(DwarfContextWrapper &dwarfContext, NameIndex &nameIndex) {
+    Utils::ScopedPhase phase{"dwarf.index_names"};
+    Utils::ScopedTrace trace{"dwarf", "index_names"};
+    const auto &units = dwarfContext.GetNormalUnitsVector();
+    size_t numUnits = units.size();
+    BDLogInfo("indexing types from {} units", numUnits);
+
+    // Names may come from the DIE a specification or origin refers to
+    DwarfScanner scanner{DieScanFields{.name = true, .references = true}};
+    for (size_t i = 0; i < numUnits; ++i) {
+        Utils::ScopedTrace unitTrace{"dwarf", "index_names unit {}", i};
+        auto offsets = SelectDies(scanner, units[i], phase, [](const ScannedUnit &unit, size_t index) {
+            return IsNamedTypeTag(unit.tags[index]) && (!unit.names[index].empty() || unit.HasReference(index));
+        });
+        for (DwarfOffset offset: offsets) {
+            DwarfDieWrapper die = dwarfContext.GetDIEForOffset(offset);
+            if (!IsNamedTypeTag(die.GetTag())) {
+                continue;
+            }
+            if (AttributeReader{die}.ReadNameView("", true).empty()) {
+                continue;
             }
-            monitor_(DwarfImportPhase::IndexingQualifiedNames, i, numUnits);
+            nameIndex.IndexDie(die);
         }
+        monitor_(DwarfImportPhase::IndexingQualifiedNames, i, numUnits);
+    }
+}
+
+void DwarfImportTask::ImportTypes(DwarfContextWrapper &dwarfContext, NameIndex &nameIndex) {
+    if (!options_.importTypes) {
+        BDLogInfo("skipping type import");
+        return;
+    }
+
+    if (options_.parallelTypes) {
+        ImportTypesParallel(dwarfContext, nameIndex);
+        return;
     }
 
-    if (options_.importTypes) {
-        // phase 2
-        size_t numNamedNodes = nameIndex.NumEntries();
-        OrderedTypeBuilderContext context{dwarfContext, nameIndex};
-        BDLogInfo("indexed {} named entities", numNamedNodes);
-        size_t index = 0;
+    Utils::ScopedPhase phase{"dwarf.import_types"};
+    Utils::ScopedTrace trace{"dwarf", "import_types"};
+    size_t numNamedNodes = nameIndex.NumEntries();
+    OrderedTypeBuilderContext context{dwarfContext, nameIndex, diagnostics_};
+    BDLogInfo("indexed {} named entities", numNamedNodes);
+    size_t index = 0;
+    nameIndex.VisitEntries([&](const std::vector<std::string> &qualifiedName, DwarfOffset dieOffset) {
+        DwarfDieWrapper die = dwarfContext.GetDIEForOffset(dieOffset);
+        phase.Add(Utils::Counter::DiesVisited);
+        if (IsNamedTypeTag(die.GetTag()) && !AttributeReader{die}.ReadNameView("", true).empty()) {
+            auto type = GenericTypeBuilder{context, die, true}.Build();
+            auto name = QualifiedName{qualifiedName};
+            sink_.AddType(name.GetString(), type);
+            phase.Add(Utils::Counter::SymbolsAdded);
+        }
+        monitor_(DwarfImportPhase::DecodingTypes, ++index, ++numNamedNodes);
+    });
+    BDLogInfo("imported {} named types to binary view", numNamedNodes);
+}
+
+void DwarfImportTask::ImportTypesParallel(DwarfContextWrapper &dwarfContext, NameIndex &nameIndex) {
+    Utils::ScopedPhase phase{"dwarf.import_types"};
+    Utils::ScopedTrace trace{"dwarf", "import_types"};
+    BDLogInfo("indexed {} named entities", nameIndex.NumEntries());
+
+    std::vector<std::string> names;
+    TypeGraph graph{dwarfContext, nameIndex};
+    {
+        Utils::ScopedPhase schedulePhase{"dwarf.schedule_types"};
         nameIndex.VisitEntries([&](const std::vector<std::string> &qualifiedName, DwarfOffset dieOffset) {
             DwarfDieWrapper die = dwarfContext.GetDIEForOffset(dieOffset);
-            if (IsNamedTypeTag(die.GetTag()) && !AttributeReader{die}.ReadName("", true).empty()) {
-                auto type = GenericTypeBuilder{context, die, true}.Build();
-                auto name = QualifiedName{qualifiedName};
-                debugInfo_.AddType(name.GetString(), type);
+            phase.Add(Utils::Counter::DiesVisited);
+            if (IsNamedTypeTag(die.GetTag()) && !AttributeReader{die}.ReadNameView("", true).empty()) {
+                graph.AddRoot(dieOffset);
+                names.push_back(QualifiedName{qualifiedName}.GetString());
             }
-            monitor_(DwarfImportPhase::DecodingTypes, ++index, ++numNamedNodes);
         });
-        BDLogInfo("imported {} named types to binary view", numNamedNodes);
-    } else {
-        BDLogInfo("skipping type import");
+        graph.Schedule();
     }
 
-    // phase 3
-    {
-        const auto &units = dwarfContext.GetNormalUnitsVector();
-        size_t numUnits = units.size();
-        BDLogInfo("importing functions and globals from {} units", numUnits);
-
-        OrderedTypeBuilderContext context{dwarfContext, nameIndex};
-        std::set<uint64_t> importedFunctions;
-        std::set<uint64_t> importedGlobals;
-        for (size_t i = 0; i < numUnits; ++i) {
-            for (const auto &dieInfo: units[i].Dies()) {
-                DwarfDieWrapper die = dwarfContext.GetDIEForOffset(dieInfo.GetOffset());
-                switch (die.GetTag()) {
-                    case dwarf::DW_TAG_subprogram: {
-                        if (!options_.importFunctions) {
-                            break;
-                        }
+    ParallelTypeBuilder builder{dwarfContext, nameIndex, diagnostics_, graph};
+    auto types = builder.Build([&](size_t done, size_t total) {
+        monitor_(DwarfImportPhase::DecodingTypes, done, total);
+    });
 
-                        auto info = FunctionDecoder{context, die}.Decode();
-                        if (!info) {
-                            break;
-                        }
-                        auto [_, ok] = importedFunctions.insert(info->entryPoint);
-                        if (!ok) {
-                            continue;
-                        }
+    // Roots are the first nodes of the graph, added in name index order
+    for (size_t i = 0; i < names.size(); ++i) {
+        sink_.AddType(names[i], types[i]);
+        phase.Add(Utils::Counter::SymbolsAdded);
+        monitor_(DwarfImportPhase::AddingTypesToBinaryView, i + 1, names.size());
+    }
+    BDLogInfo("imported {} named types to binary view", names.size());
+}
+
+void DwarfImportTask::ImportFunctionsAndGlobals(DwarfContextWrapper &dwarfContext, NameIndex &nameIndex,
+                                                std::vector<LazyFunctionImporter::Entry> &lazyFunctions) {
+    Utils::ScopedPhase phase{"dwarf.import_functions_and_globals"};
+    Utils::ScopedTrace trace{"dwarf", "import_functions_and_globals"};
+    const auto &units = dwarfContext.GetNormalUnitsVector();
+    size_t numUnits = units.size();
+    BDLogInfo("importing functions and globals from {} units", numUnits);
 
-                        QualifiedName name = nameIndex.DecodeQualifiedName(die);
-                        std::string rawName = AttributeReader{die}.ReadLinkageName(
-                            name.GetString().c_str(),
-                            true);
-
-                        DebugFunctionInfo symbol{
-                            name.back(),
-                            name.GetString(),
-                            rawName,
-                            info->entryPoint,
-                            info->type,
-                            binaryView_.GetDefaultPlatform(),
-                            {},
-                            {}
-                        };
-                        symbol.type = info->type;
-
-                        debugInfo_.AddFunction(symbol);
+    OrderedTypeBuilderContext context{dwarfContext, nameIndex, diagnostics_};
+    std::set<uint64_t> importedFunctions;
+    std::set<uint64_t> importedGlobals;
+    // Functions without an entry point and variables without a static
+    // address are rejected by the decoders, so they are skipped unread
+    DwarfScanner scanner{DieScanFields{.entryPoint = true, .locationAddress = true}};
+    for (size_t i = 0; i < numUnits; ++i) {
+        Utils::ScopedTrace unitTrace{"dwarf", "import_functions_and_globals unit {}", i};
+        auto offsets = SelectDies(scanner, units[i], phase, [](const ScannedUnit &unit, size_t index) {
+            switch (unit.tags[index]) {
+                case dwarf::DW_TAG_subprogram:
+                    return unit.lowPCs[index] != ScannedUnit::kNone
+                           || (unit.flags[index] & (ScannedUnit::HasRanges | ScannedUnit::HasEntryPC));
+                case dwarf::DW_TAG_constant:
+                case dwarf::DW_TAG_variable:
+                    return unit.locationAddresses[index] != ScannedUnit::kNone;
+                default:
+                    return false;
+            }
+        });
+        for (DwarfOffset offset: offsets) {
+            DwarfDieWrapper die = dwarfContext.GetDIEForOffset(offset);
+            switch (die.GetTag()) {
+                case dwarf::DW_TAG_subprogram: {
+                    if (!options_.importFunctions) {
                         break;
                     }
-                    case dwarf::DW_TAG_constant:
-                    case dwarf::DW_TAG_variable: {
-                        if (!options_.importGlobals) {
-                            break;
-                        }
-                        auto info = VariableDecoder{context, die}.Decode();
-                        if (!info) {
+
+                    if (options_.lazyFunctions) {
+                        auto entryPoint = FunctionDecoder{context, die}.DecodeSlidEntryPoint();
+                        if (!entryPoint || !importedFunctions.insert(*entryPoint).second) {
                             break;
                         }
+                        lazyFunctions.push_back({*entryPoint, die.GetOffset()});
+                        // Unnamed so that analysis still creates the function,
+                        // name and type are applied once it does
+                        sink_.AddFunction(DebugFunctionInfo{
+                            "", "", "", *entryPoint, nullptr, binaryView_.GetDefaultPlatform(), {}, {}});
+                        phase.Add(Utils::Counter::SymbolsAdded);
+                        break;
+                    }
 
-                        auto [_, ok] = importedGlobals.insert(info->location);
-                        if (!ok) {
-                            continue;
-                        }
+                    auto info = FunctionDecoder{context, die}.Decode();
+                    if (!info) {
+                        break;
+                    }
+                    auto [_, ok] = importedFunctions.insert(info->entryPoint);
+                    if (!ok) {
+                        continue;
+                    }
 
-                        Ref<Symbol> symbol = new Symbol{
-                            BNSymbolType::DataSymbol,
-                            info->qualifiedName.back(),
-                            info->qualifiedName.GetString(),
-                            fmt::format("data_{:#016x}", info->location),
-                            info->location,
-                        };
-                        debugInfo_.AddDataVariable(info->location, info->type, info->qualifiedName.GetString());
+                    QualifiedName name = nameIndex.DecodeQualifiedName(die);
+                    std::string rawName = AttributeReader{die}.ReadLinkageName(
+                        name.GetString().c_str(),
+                        true);
+
+                    DebugFunctionInfo symbol{
+                        name.back(),
+                        name.GetString(),
+                        rawName,
+                        info->entryPoint,
+                        info->type,
+                        binaryView_.GetDefaultPlatform(),
+                        {},
+                        {}
+                    };
+                    symbol.type = info->type;
+
+                    sink_.AddFunction(symbol);
+                    phase.Add(Utils::Counter::SymbolsAdded);
+                    break;
+                }
+                case dwarf::DW_TAG_constant:
+                case dwarf::DW_TAG_variable: {
+                    if (!options_.importGlobals) {
                         break;
                     }
-                    default: {
+                    auto info = VariableDecoder{context, die}.Decode();
+                    if (!info) {
                         break;
                     }
+
+                    auto [_, ok] = importedGlobals.insert(info->location);
+                    if (!ok) {
+                        continue;
+                    }
+
+                    Ref<Symbol> symbol = new Symbol{
+                        BNSymbolType::DataSymbol,
+                        info->qualifiedName.back(),
+                        info->qualifiedName.GetString(),
+                        fmt::format("data_{:#016x}", info->location),
+                        info->location,
+                    };
+                    sink_.AddDataVariable(info->location, info->type, info->qualifiedName.GetString());
+                    phase.Add(Utils::Counter::SymbolsAdded);
+                    break;
+                }
+                default: {
+                    break;
                 }
             }
-            monitor_(DwarfImportPhase::ImportingFunctionsAndGlobals, i, numUnits);
         }
-
-        BDLogInfo("imported {} functions", importedFunctions.size());
-        BDLogInfo("imported {} globals", importedGlobals.size());
+        monitor_(DwarfImportPhase::ImportingFunctionsAndGlobals, i, numUnits);
     }
+
+    BDLogInfo("imported {} functions", importedFunctions.size());
+    BDLogInfo("imported {} globals", importedGlobals.size());
 }
 
 bool DwarfImportTask::IsNamedTypeTag(dwarf::Tag tag) {
@@ -209,19 +350,29 @@ bool DwarfImportTask::IsNamedTypeTag(dwarf::Tag tag) {
     }
 }
 
-DwarfContextWrapper DwarfImportTask::BuildDwarfContext() {
-    auto targetObjects = MachO::MachBinaryView{binaryView_}.ReadMachOHeaders();
+DwarfContextWrapper DwarfImportTask::BuildDwarfContext(const std::vector<std::filesystem::path> &dwarfObjects,
+                                                       BinaryNinja::BinaryView &binaryView,
+                                                       Diagnostics *diagnostics) {
+    return BuildDwarfContext(dwarfObjects, MachO::MachBinaryView{binaryView}.ReadMachOHeaders(), diagnostics);
+}
+
+DwarfContextWrapper DwarfImportTask::BuildDwarfContext(const std::vector<std::filesystem::path> &dwarfObjects,
+                                                       const std::map<Types::UUID, std::vector<MachO::Segment>> &targets,
+                                                       Diagnostics *diagnostics) {
+    Utils::ScopedPhase phase{"dwarf.build_context"};
+    Utils::ScopedTrace trace{"dwarf", "build_context"};
     std::vector<DwarfContextWrapper::Entry> entries;
-    for (const auto &sourceObject: dwarfObjects_) {
+    for (const auto &sourceObject: dwarfObjects) {
         DwarfObjectFile object{sourceObject};
         auto uuid = object.DecodeUUID();
         BDVerify(uuid);
-        BDVerify(targetObjects.contains(*uuid));
+        auto target = targets.find(*uuid);
+        BDVerify(target != targets.end());
         auto symbolSegments = object.DecodeSegments();
         entries.emplace_back(DwarfContextWrapper::Entry{
             .object = std::move(object),
             .slider = AddressSlider::CreateFromMachOSegments(
-                symbolSegments, targetObjects[*uuid])});
+                symbolSegments, target->second, diagnostics)});
     }
     return DwarfContextWrapper{std::move(entries)};
 }
@@ -33,20 +33,12 @@ namespace DW = llvm::dwarf;
 
 std::optional<DwarfFunctionInfo> FunctionDecoder::Decode() {
     DwarfFunctionInfo info;
-    if (auto entry = DecodeEntryPoint()) {
+    if (auto entry = DecodeSlidEntryPoint()) {
         info.entryPoint = *entry;
     } else {
         return std::nullopt;
     }
 
-    if (auto slidAddress = ctx_.SlideAddress(die_.GetOffset(), info.entryPoint)) {
-        info.entryPoint = *slidAddress;
-    } else {
-        BDLogWarn("cannot slide address {:#016x} using binary {}",
-                  info.entryPoint, die_.GetOffset().binaryId);
-        return std::nullopt;
-    }
-
     info.qualifiedName = ctx_.DecodeQualifiedName(die_);
     info.type = FunctionTypeBuilder{ctx_, die_}.Build();
     info.isNoReturn = DecodeIsNoReturn();
@@ -54,6 +46,21 @@ std::optional<DwarfFunctionInfo> FunctionDecoder::Decode() {
     return info;
 }
 
+std::optional<uint64_t> FunctionDecoder::DecodeSlidEntryPoint() {
+    auto entry = DecodeEntryPoint();
+    if (!entry) {
+        return std::nullopt;
+    }
+
+    if (auto slidAddress = ctx_.SlideAddress(die_.GetOffset(), *entry)) {
+        return slidAddress;
+    }
+    ctx_.ReportDiagnostic(DiagnosticKind::FunctionAddressNotSlid, die_.GetOffset());
+    BDLogDebug("cannot slide address {:#016x} using binary {}",
+               *entry, die_.GetOffset().binaryId);
+    return std::nullopt;
+}
+
 std::optional<uint64_t> FunctionDecoder::DecodeEntryPoint() {
     const AttributeReader &attributeReader = dieReader_.AttrReader();
     if (auto value = attributeReader.ReadUInt(DW::DW_AT_low_pc)) {
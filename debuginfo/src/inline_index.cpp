@@ -0,0 +1,480 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cstring>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+
+#include <llvm/DebugInfo/DIContext.h>
+#include <llvm/DebugInfo/DWARF/DWARFContext.h>
+#include <llvm/DebugInfo/DWARF/DWARFDebugLine.h>
+#include <llvm/DebugInfo/DWARF/DWARFDie.h>
+#include <llvm/DebugInfo/DWARF/DWARFUnit.h>
+
+#include <taskflow/algorithm/sort.hpp>
+#include <taskflow/taskflow.hpp>
+
+#include <binja/utils/debug.h>
+#include <binja/utils/demangle.h>
+#include <binja/utils/executor.h>
+#include <binja/utils/log.h>
+#include <binja/utils/metrics.h>
+#include <binja/utils/trace.h>
+
+#include "errors.h"
+#include "inline_index.h"
+
+using namespace Binja;
+using namespace DebugInfo;
+
+namespace DW = llvm::dwarf;
+namespace fs = std::filesystem;
+
+
+/// Encoding
+
+namespace {
+
+constexpr char kMagic[8] = {'B', 'K', 'C', 'I', 'N', 'L', 'N', 'E'};
+
+struct InlineIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t rangeCount;
+    uint64_t frameCount;
+    uint64_t stringsSize;
+};
+
+struct InlineRange {
+    uint64_t begin;
+    uint64_t end;
+    uint32_t frame;
+};
+
+Utils::MappedImage EncodeInlineIndex(const std::vector<InlineRange> &ranges,
+                                     const std::vector<InlineIndex::FrameRecord> &frames,
+                                     const std::string &strings) {
+    std::vector<uint64_t> starts;
+    std::vector<uint64_t> ends;
+    std::vector<uint32_t> rangeFrames;
+    starts.reserve(ranges.size());
+    ends.reserve(ranges.size());
+    rangeFrames.reserve(ranges.size());
+    for (const auto &range: ranges) {
+        starts.push_back(range.begin);
+        ends.push_back(range.end);
+        rangeFrames.push_back(range.frame);
+    }
+
+    InlineIndexHeader header{};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = InlineIndex::kVersion;
+    header.rangeCount = ranges.size();
+    header.frameCount = frames.size();
+    header.stringsSize = strings.size();
+
+    Utils::MappedImage::Writer writer{header};
+    writer.AppendSection(starts);
+    writer.AppendSection(ends);
+    writer.AppendSection(rangeFrames);
+    writer.AppendSection(frames);
+    writer.AppendSection(strings);
+    return std::move(writer).Finish();
+}
+
+}// namespace
+
+
+/// Unit decoding
+
+namespace {
+
+struct UnitFrame {
+    std::string function;
+    std::string callFile;
+    uint32_t callLine;
+    // Index into the frames of the unit
+    uint32_t parent;
+};
+
+struct UnitRange {
+    uint64_t begin;
+    uint64_t end;
+    uint32_t frame;
+    uint32_t depth;
+};
+
+struct UnitInlines {
+    std::vector<UnitFrame> frames;
+    // Disjoint, sorted by address
+    std::vector<InlineRange> ranges;
+};
+
+std::string DecodeFunctionName(const llvm::DWARFDie &die, Utils::DemangleCache &demangleCache) {
+    const char *name = die.getSubroutineName(llvm::DINameKind::LinkageName);
+    if (!name) {
+        return {};
+    }
+    std::string_view view{name};
+    if (view.starts_with("_Z")) {
+        if (auto demangled = Utils::DemangleName(view, &demangleCache)) {
+            return demangled->shortName;
+        }
+    }
+    return std::string{view};
+}
+
+// Splits nested and overlapping ranges into disjoint ranges of the deepest
+// frame covering them
+std::vector<InlineRange> ResolveInnermost(std::vector<UnitRange> ranges) {
+    std::sort(ranges.begin(), ranges.end(), [](const UnitRange &lhs, const UnitRange &rhs) {
+        return lhs.begin < rhs.begin;
+    });
+    std::vector<uint64_t> points;
+    points.reserve(ranges.size() * 2);
+    for (const auto &range: ranges) {
+        points.push_back(range.begin);
+        points.push_back(range.end);
+    }
+    std::sort(points.begin(), points.end());
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+
+    // Deepest first, frames decoded later are nested in earlier ones on ties
+    using Active = std::tuple<uint32_t, uint32_t, uint64_t>;
+    std::priority_queue<Active> active;
+    std::vector<InlineRange> result;
+    size_t next = 0;
+    for (size_t i = 0; i + 1 < points.size(); ++i) {
+        uint64_t point = points[i];
+        for (; next < ranges.size() && ranges[next].begin <= point; ++next) {
+            active.emplace(ranges[next].depth, ranges[next].frame, ranges[next].end);
+        }
+        while (!active.empty() && std::get<2>(active.top()) <= point) {
+            active.pop();
+        }
+        if (active.empty()) {
+            continue;
+        }
+        uint32_t frame = std::get<1>(active.top());
+        if (!result.empty() && result.back().end == point && result.back().frame == frame) {
+            result.back().end = points[i + 1];
+        } else {
+            result.push_back(InlineRange{point, points[i + 1], frame});
+        }
+    }
+    return result;
+}
+
+class UnitInlineDecoder {
+public:
+    UnitInlineDecoder(DwarfContextWrapper &dwarfContext, const DwarfUnitWrapper &unit,
+                      Utils::DemangleCache &demangleCache)
+        : dwarfContext_{dwarfContext}, unit_{unit.GetUnit()},
+          binary_{.binaryId = unit.GetBinaryId(), .offset = 0}, demangleCache_{demangleCache} {}
+
+    UnitInlines Decode() {
+        struct Pending {
+            llvm::DWARFDie die;
+            uint32_t frame;
+            uint32_t depth;
+        };
+
+        // Explicit stack, inline trees can be deep
+        std::vector<Pending> pending{{unit_.getUnitDIE(false), InlineIndex::kNoFrame, 0}};
+        while (!pending.empty()) {
+            Pending current = pending.back();
+            pending.pop_back();
+            for (llvm::DWARFDie child = current.die.getFirstChild(); child && !child.isNULL(); child = child.getSibling()) {
+                switch (child.getTag()) {
+                    case DW::DW_TAG_inlined_subroutine: {
+                        uint32_t frame = AddFrame(child, current.frame, current.depth + 1);
+                        pending.push_back({child, frame, current.depth + 1});
+                        break;
+                    }
+                    case DW::DW_TAG_subprogram:
+                    case DW::DW_TAG_lexical_block:
+                    case DW::DW_TAG_namespace:
+                        pending.push_back({child, current.frame, current.depth});
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+
+        UnitInlines result;
+        result.frames = std::move(frames_);
+        result.ranges = ResolveInnermost(std::move(ranges_));
+        return result;
+    }
+
+private:
+    uint32_t AddFrame(const llvm::DWARFDie &die, uint32_t parent, uint32_t depth) {
+        auto frame = static_cast<uint32_t>(frames_.size());
+        UnitFrame unitFrame{.function = DecodeFunctionName(die, demangleCache_), .callLine = 0, .parent = parent};
+        if (auto callFile = DW::toUnsigned(die.find(DW::DW_AT_call_file))) {
+            unitFrame.callFile = DecodeFileName(*callFile);
+        }
+        if (auto callLine = DW::toUnsigned(die.find(DW::DW_AT_call_line))) {
+            unitFrame.callLine = static_cast<uint32_t>(*callLine);
+        }
+        frames_.push_back(std::move(unitFrame));
+
+        auto ranges = die.getAddressRanges();
+        if (!ranges) {
+            BDLogDebug("failed to decode ranges of inlined subroutine at {:#x}, error: {}",
+                       die.getOffset(), llvm::toString(ranges.takeError()));
+            return frame;
+        }
+        for (const auto &range: *ranges) {
+            if (range.LowPC >= range.HighPC) {
+                continue;
+            }
+            // Ranges end past their last byte, which may be the end of a segment
+            auto begin = dwarfContext_.GetSlidAddress(binary_, range.LowPC);
+            auto last = dwarfContext_.GetSlidAddress(binary_, range.HighPC - 1);
+            if (!begin || !last || *last - *begin != range.HighPC - 1 - range.LowPC) {
+                continue;
+            }
+            ranges_.push_back(UnitRange{*begin, *last + 1, frame, depth});
+        }
+        return frame;
+    }
+
+    std::string DecodeFileName(uint64_t fileIndex) {
+        if (!prologueDecoded_) {
+            prologueDecoded_ = true;
+            DecodePrologue();
+        }
+        std::string name;
+        if (!prologue_ || !prologue_->getFileNameByIndex(
+                              fileIndex, unit_.getCompilationDir() ? unit_.getCompilationDir() : "",
+                              llvm::DILineInfoSpecifier::FileLineInfoKind::AbsoluteFilePath, name)) {
+            return {};
+        }
+        return fs::path{name}.lexically_normal().string();
+    }
+
+    void DecodePrologue() {
+        auto offset = DW::toSectionOffset(unit_.getUnitDIE().find(DW::DW_AT_stmt_list));
+        if (!offset) {
+            return;
+        }
+        const llvm::DWARFContext &context = unit_.getContext();
+        const llvm::DWARFObject &object = context.getDWARFObj();
+        llvm::DWARFDataExtractor data{object, object.getLineSection(), context.isLittleEndian(),
+                                      unit_.getAddressByteSize()};
+        llvm::DWARFDebugLine::Prologue prologue;
+        uint64_t cursor = *offset;
+        llvm::Error error = prologue.parse(data, &cursor, [](llvm::Error recoverable) {
+            llvm::consumeError(std::move(recoverable));
+        }, context, &unit_);
+        if (error) {
+            BDLogDebug("failed to parse line program prologue at {:#x}, error: {}",
+                       *offset, llvm::toString(std::move(error)));
+            return;
+        }
+        prologue_ = std::move(prologue);
+    }
+
+private:
+    DwarfContextWrapper &dwarfContext_;
+    llvm::DWARFUnit &unit_;
+    DwarfOffset binary_;
+    Utils::DemangleCache &demangleCache_;
+    std::vector<UnitFrame> frames_;
+    std::vector<UnitRange> ranges_;
+    bool prologueDecoded_ = false;
+    std::optional<llvm::DWARFDebugLine::Prologue> prologue_;
+};
+
+}// namespace
+
+
+/// Inline index
+
+InlineIndex InlineIndex::Build(DwarfContextWrapper &dwarfContext) {
+    Utils::ScopedPhase phase{"dwarf.inline_index"};
+    Utils::ScopedTrace trace{"dwarf", "inline_index"};
+    std::vector<DwarfUnitWrapper> units = dwarfContext.GetNormalUnitsVector();
+
+    dwarfContext.PrepareConcurrentReads();
+
+    Utils::DemangleCache demangleCache;
+    std::vector<UnitInlines> unitInlines(units.size());
+    tf::Taskflow taskflow;
+    taskflow.for_each_index(size_t{0}, units.size(), size_t{1}, [&](size_t i) {
+        Utils::ScopedPhase unitPhase{"dwarf.decode_inlines"};
+        unitInlines[i] = UnitInlineDecoder{dwarfContext, units[i], demangleCache}.Decode();
+    });
+    Utils::RunAndWait(taskflow);
+
+    // Merge the frames of all units, interning their strings
+    std::string strings;
+    std::unordered_map<std::string, uint32_t> stringOffsets;
+    auto intern = [&](const std::string &value) {
+        auto [it, inserted] = stringOffsets.try_emplace(value, static_cast<uint32_t>(strings.size()));
+        if (inserted) {
+            strings.append(value);
+            strings.push_back('\0');
+            if (strings.size() >= kNoFrame) {
+                throw DwarfError{"inline index string table too large"};
+            }
+        }
+        return it->second;
+    };
+
+    std::vector<FrameRecord> frames;
+    std::vector<InlineRange> ranges;
+    for (auto &unit: unitInlines) {
+        size_t base = frames.size();
+        if (base + unit.frames.size() >= kNoFrame) {
+            throw DwarfError{"too many inline frames"};
+        }
+        for (const auto &frame: unit.frames) {
+            frames.push_back(FrameRecord{
+                .function = intern(frame.function),
+                .callFile = frame.callFile.empty() ? kNoFrame : intern(frame.callFile),
+                .callLine = frame.callLine,
+                .parent = frame.parent == kNoFrame ? kNoFrame : static_cast<uint32_t>(base + frame.parent)});
+        }
+        for (const auto &range: unit.ranges) {
+            ranges.push_back(InlineRange{range.begin, range.end, static_cast<uint32_t>(base + range.frame)});
+        }
+        unit = UnitInlines{};
+    }
+
+    tf::Taskflow sortflow;
+    sortflow.sort(ranges.begin(), ranges.end(), [](const InlineRange &lhs, const InlineRange &rhs) {
+        return std::tie(lhs.begin, lhs.end, lhs.frame) < std::tie(rhs.begin, rhs.end, rhs.frame);
+    });
+    Utils::RunAndWait(sortflow);
+
+    // Units rarely overlap, the range found first keeps the addresses
+    std::vector<InlineRange> disjoint;
+    disjoint.reserve(ranges.size());
+    for (InlineRange range: ranges) {
+        if (!disjoint.empty() && range.begin < disjoint.back().end) {
+            range.begin = disjoint.back().end;
+        }
+        if (range.begin < range.end) {
+            disjoint.push_back(range);
+        }
+    }
+    ranges = {};
+
+    InlineIndex index;
+    index.Attach(EncodeInlineIndex(disjoint, frames, strings));
+    phase.Add(Utils::Counter::SymbolsAdded, frames.size());
+    BDLogInfo("built inline index with {} frames and {} ranges from {} units, {} bytes",
+              frames.size(), disjoint.size(), units.size(), index.GetSizeInBytes());
+    return index;
+}
+
+InlineIndex InlineIndex::Open(const fs::path &path) {
+    InlineIndex index;
+    index.Attach(Utils::MappedImage::Open(path, "inline index"));
+    return index;
+}
+
+bool InlineIndex::Save(const fs::path &path) const {
+    if (!image_.Save(path, "inline index")) {
+        return false;
+    }
+    BDLogInfo("saved inline index {} with {} frames", path.string(), frames_.size());
+    return true;
+}
+
+void InlineIndex::Attach(Utils::MappedImage image) {
+    image_ = std::move(image);
+    Utils::MappedImage::Reader reader{image_.GetImage(), "inline index"};
+    auto header = reader.ReadHeader<InlineIndexHeader>(kMagic, kVersion);
+    rangeStarts_ = reader.ReadSection<uint64_t>(header.rangeCount);
+    rangeEnds_ = reader.ReadSection<uint64_t>(header.rangeCount);
+    rangeFrames_ = reader.ReadSection<uint32_t>(header.rangeCount);
+    frames_ = reader.ReadSection<FrameRecord>(header.frameCount);
+    strings_ = reader.ReadSection<char>(header.stringsSize);
+
+    if (!strings_.empty() && strings_.back() != '\0') {
+        throw DwarfError{"unterminated inline index string table"};
+    }
+    for (size_t i = 0; i < frames_.size(); ++i) {
+        const FrameRecord &frame = frames_[i];
+        // Parents are decoded before their children, which also rules out cycles
+        bool valid = frame.function < strings_.size() &&
+                     (frame.callFile == kNoFrame || frame.callFile < strings_.size()) &&
+                     (frame.parent == kNoFrame || frame.parent < i);
+        if (!valid) {
+            throw DwarfError{"invalid inline index frame {}", i};
+        }
+    }
+    for (uint32_t frame: rangeFrames_) {
+        if (frame >= frames_.size()) {
+            throw DwarfError{"inline index range frame {} out of bounds", frame};
+        }
+    }
+}
+
+std::string_view InlineIndex::GetString(uint32_t offset) const {
+    return std::string_view{strings_.data() + offset};
+}
+
+void InlineIndex::CollectFrames(uint32_t frame, std::vector<InlineFrame> &frames) const {
+    while (frame != kNoFrame) {
+        const FrameRecord &record = frames_[frame];
+        frames.push_back(InlineFrame{
+            .function = GetString(record.function),
+            .callFile = record.callFile == kNoFrame ? std::string_view{} : GetString(record.callFile),
+            .callLine = record.callLine});
+        frame = record.parent;
+    }
+}
+
+void InlineIndex::Lookup(uint64_t address, std::vector<InlineFrame> &frames) const {
+    frames.clear();
+    auto it = std::upper_bound(rangeStarts_.begin(), rangeStarts_.end(), address);
+    if (it == rangeStarts_.begin()) {
+        return;
+    }
+    size_t range = it - rangeStarts_.begin() - 1;
+    if (address < rangeEnds_[range]) {
+        CollectFrames(rangeFrames_[range], frames);
+    }
+}
+
+void InlineIndex::VisitRange(uint64_t begin, uint64_t end,
+                             const std::function<void(uint64_t, const std::vector<InlineFrame> &)> &visitor) const {
+    std::vector<InlineFrame> frames;
+    auto it = std::upper_bound(rangeStarts_.begin(), rangeStarts_.end(), begin);
+    size_t range = it - rangeStarts_.begin();
+    if (range > 0 && begin < rangeEnds_[range - 1]) {
+        frames.clear();
+        CollectFrames(rangeFrames_[range - 1], frames);
+        visitor(begin, frames);
+    }
+    for (; range < rangeStarts_.size() && rangeStarts_[range] < end; ++range) {
+        frames.clear();
+        CollectFrames(rangeFrames_[range], frames);
+        visitor(rangeStarts_[range], frames);
+    }
+}
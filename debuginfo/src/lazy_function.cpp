@@ -0,0 +1,288 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <map>
+
+#include <binja/utils/executor.h>
+#include <binja/utils/log.h>
+#include <binja/utils/metrics.h>
+#include <binja/utils/trace.h>
+
+#include "function.h"
+#include "lazy_function.h"
+
+using namespace Binja;
+using namespace DebugInfo;
+
+using BinaryNinja::Ref;
+using BinaryNinja::Symbol;
+
+
+/// Importer registry
+
+namespace {
+
+/// Keeps importers alive for as long as the view they are attached to
+class ImporterRegistry : public BinaryNinja::ObjectDestructionNotification {
+public:
+    static ImporterRegistry &Instance() {
+        // Views may be destroyed during shutdown, after static destructors ran
+        static auto *registry = new ImporterRegistry;
+        return *registry;
+    }
+
+    void Add(BNBinaryView *view, std::shared_ptr<LazyFunctionImporter> importer) {
+        std::lock_guard lock{mutex_};
+        importers_[view].push_back(std::move(importer));
+    }
+
+    std::vector<std::shared_ptr<LazyFunctionImporter>> Remove(BNBinaryView *view) {
+        std::lock_guard lock{mutex_};
+        auto node = importers_.extract(view);
+        if (node.empty()) {
+            return {};
+        }
+        return std::move(node.mapped());
+    }
+
+    void DestructBinaryView(BinaryNinja::BinaryView *view) override {
+        for (const auto &importer: Remove(view->GetObject())) {
+            view->UnregisterNotification(importer.get());
+        }
+    }
+
+private:
+    ImporterRegistry() {
+        BinaryNinja::RegisterObjectDestructionNotification(this);
+    }
+
+    std::mutex mutex_;
+    std::map<BNBinaryView *, std::vector<std::shared_ptr<LazyFunctionImporter>>> importers_;
+};
+
+}// namespace
+
+
+/// Lazy function importer
+
+LazyFunctionImporter::LazyFunctionImporter(std::unique_ptr<DwarfImportState> state, std::vector<Entry> entries)
+    : state_{std::move(state)},
+      context_{state_->dwarfContext, state_->nameIndex, diagnostics_},
+      entries_{std::move(entries)} {
+    std::stable_sort(entries_.begin(), entries_.end(), [](const Entry &lhs, const Entry &rhs) {
+        return lhs.address < rhs.address;
+    });
+    // Same as the eager import, the first DIE found for an address wins
+    auto last = std::unique(entries_.begin(), entries_.end(), [](const Entry &lhs, const Entry &rhs) {
+        return lhs.address == rhs.address;
+    });
+    entries_.erase(last, entries_.end());
+    entries_.shrink_to_fit();
+    states_.resize(entries_.size(), EntryState::Pending);
+    decoded_.resize(entries_.size());
+}
+
+LazyFunctionImporter::~LazyFunctionImporter() {
+    StopWarming();
+    diagnostics_.LogSummary("dwarf lazy function import");
+}
+
+void LazyFunctionImporter::OnAnalysisFunctionAdded(BinaryNinja::BinaryView *view, BinaryNinja::Function *function) {
+    if (auto index = FindEntry(function->GetStart())) {
+        Apply(*view, *index, {function});
+    }
+}
+
+std::optional<size_t> LazyFunctionImporter::FindEntry(uint64_t address) const {
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), address, [](const Entry &entry, uint64_t address) {
+        return entry.address < address;
+    });
+    if (it == entries_.end() || it->address != address) {
+        return std::nullopt;
+    }
+    return it - entries_.begin();
+}
+
+void LazyFunctionImporter::Apply(BinaryNinja::BinaryView &view, size_t index,
+                                 const std::vector<Ref<BinaryNinja::Function>> &functions) {
+    if (functions.empty()) {
+        return;
+    }
+    const DecodedFunction *decoded = Decode(index);
+    if (!decoded) {
+        return;
+    }
+    uint64_t address = entries_[index].address;
+    if (decoded->type) {
+        for (const auto &function: functions) {
+            function->SetAutoType(decoded->type);
+        }
+    }
+    Ref<Symbol> symbol = new Symbol{
+        BNSymbolType::FunctionSymbol,
+        decoded->shortName,
+        decoded->fullName,
+        decoded->rawName,
+        address,
+    };
+    view.DefineAutoSymbol(symbol);
+}
+
+const LazyFunctionImporter::DecodedFunction *LazyFunctionImporter::Decode(size_t index, bool *decodedNow) {
+    std::lock_guard lock{mutex_};
+    switch (states_[index]) {
+        case EntryState::Decoded:
+            return decoded_[index].get();
+        case EntryState::Failed:
+            return nullptr;
+        case EntryState::Pending:
+            break;
+    }
+
+    Utils::ScopedPhase phase{"dwarf.lazy_functions"};
+    states_[index] = EntryState::Failed;
+    // Called from analysis notifications, exceptions must not escape
+    try {
+        DwarfDieWrapper die = state_->dwarfContext.GetDIEForOffset(entries_[index].die);
+        auto info = FunctionDecoder{context_, die}.Decode();
+        if (!info) {
+            return nullptr;
+        }
+        std::string fullName = info->qualifiedName.GetString();
+        std::string rawName = AttributeReader{die}.ReadLinkageName(fullName.c_str(), true);
+        decoded_[index] = std::make_unique<DecodedFunction>(DecodedFunction{
+            .shortName = info->qualifiedName.back(),
+            .fullName = std::move(fullName),
+            .rawName = std::move(rawName),
+            .type = info->type,
+        });
+    } catch (const std::exception &e) {
+        BDLogWarn("failed to decode function at {:#016x}, error: {}", entries_[index].address, e.what());
+        return nullptr;
+    }
+    states_[index] = EntryState::Decoded;
+    if (decodedNow) {
+        *decodedNow = true;
+    }
+    phase.Add(Utils::Counter::SymbolsAdded);
+    return decoded_[index].get();
+}
+
+void LazyFunctionImporter::StartWarming(BinaryNinja::BinaryView &view, std::vector<size_t> existing) {
+    warmFile_ = view.GetFile();
+    warmViewType_ = view.GetTypeName();
+    warmViewObject_ = view.GetObject();
+    warmFirst_ = std::move(existing);
+    warmer_ = warmed_.get_future();
+    ScheduleWarming(0);
+}
+
+void LazyFunctionImporter::StopWarming() {
+    stopWarming_ = true;
+    if (warmer_.valid()) {
+        warmer_.wait();
+    }
+}
+
+Ref<BinaryNinja::BinaryView> LazyFunctionImporter::AcquireWarmView() const {
+    // Closing the file releases its views, a view of the same type opened
+    // later is a different one
+    Ref<BinaryNinja::BinaryView> view = warmFile_->GetViewOfType(warmViewType_);
+    if (!view || view->GetObject() != warmViewObject_) {
+        return nullptr;
+    }
+    return view;
+}
+
+void LazyFunctionImporter::ScheduleWarming(size_t position) {
+    // Chunks are queued one at a time instead of holding a worker until
+    // every entry is decoded, so that warming never delays the import or
+    // other parallel work by more than a chunk. Chunks keep the importer
+    // alive, since the view they reference may be released by the chunk
+    Utils::GetSharedExecutor().silent_async([importer = shared_from_this(), position] {
+        importer->Warm(position);
+    });
+}
+
+void LazyFunctionImporter::Warm(size_t position) {
+    Utils::ScopedTrace trace{"dwarf", "warm_lazy_functions {}", position};
+    Ref<BinaryNinja::BinaryView> view = AcquireWarmView();
+    size_t numPositions = warmFirst_.size() + entries_.size();
+    size_t end = std::min(position + kWarmChunkSize, numPositions);
+    // The lock is taken per function, so requests from analysis interleave
+    // with warming instead of waiting for it
+    for (; view && position < end && !stopWarming_; ++position) {
+        size_t index = position < warmFirst_.size() ? warmFirst_[position] : position - warmFirst_.size();
+        bool decodedNow = false;
+        Decode(index, &decodedNow);
+        // Functions added after the entry was decoded get it from the
+        // analysis notification, the ones present already only get it here
+        if (decodedNow && !stopWarming_) {
+            Apply(*view, index, view->GetAnalysisFunctionsForAddress(entries_[index].address));
+        }
+    }
+
+    bool done = !view || position == numPositions || stopWarming_;
+    // Released before the chain goes on or completes, so that nothing waiting
+    // on the chain sees the view still referenced
+    view = nullptr;
+    if (!done) {
+        ScheduleWarming(position);
+        return;
+    }
+    FinishWarming();
+}
+
+void LazyFunctionImporter::FinishWarming() {
+    size_t numDecoded;
+    {
+        std::lock_guard lock{mutex_};
+        numDecoded = std::count(states_.begin(), states_.end(), EntryState::Decoded);
+    }
+    BDLogInfo("decoded {} of {} lazy DWARF functions", numDecoded, entries_.size());
+
+    warmFirst_ = {};
+    warmFile_ = nullptr;
+    warmed_.set_value();
+}
+
+void LazyFunctionImporter::Attach(BinaryNinja::BinaryView &view, std::shared_ptr<LazyFunctionImporter> importer) {
+    BDLogInfo("indexed {} DWARF functions for lazy import", importer->GetEntryCount());
+    view.RegisterNotification(importer.get());
+    // Functions created before the notification was registered, for example
+    // when importing into an analyzed view, are warmed first
+    std::vector<size_t> existing;
+    for (const auto &function: view.GetAnalysisFunctionList()) {
+        if (auto index = importer->FindEntry(function->GetStart())) {
+            existing.push_back(*index);
+        }
+    }
+    importer->StartWarming(view, std::move(existing));
+    ImporterRegistry::Instance().Add(view.GetObject(), std::move(importer));
+}
+
+void LazyFunctionImporter::Detach(BinaryNinja::BinaryView &view) {
+    for (const auto &importer: ImporterRegistry::Instance().Remove(view.GetObject())) {
+        view.UnregisterNotification(importer.get());
+        importer->StopWarming();
+    }
+}
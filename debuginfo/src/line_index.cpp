@@ -0,0 +1,465 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+#include <unordered_map>
+
+#include <llvm/DebugInfo/DIContext.h>
+#include <llvm/DebugInfo/DWARF/DWARFContext.h>
+#include <llvm/DebugInfo/DWARF/DWARFDebugLine.h>
+#include <llvm/DebugInfo/DWARF/DWARFUnit.h>
+
+#include <taskflow/algorithm/sort.hpp>
+#include <taskflow/taskflow.hpp>
+
+#include <binja/utils/debug.h>
+#include <binja/utils/executor.h>
+#include <binja/utils/log.h>
+#include <binja/utils/metrics.h>
+#include <binja/utils/trace.h>
+
+#include "errors.h"
+#include "line_index.h"
+
+using namespace Binja;
+using namespace DebugInfo;
+
+namespace DW = llvm::dwarf;
+namespace fs = std::filesystem;
+
+
+/// Encoding
+
+namespace {
+
+constexpr char kMagic[8] = {'B', 'K', 'C', 'L', 'I', 'N', 'E', 'S'};
+
+struct LineIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t blockRows;
+    uint64_t rowCount;
+    uint64_t blockCount;
+    uint64_t fileCount;
+    uint64_t stringsSize;
+    uint64_t dataSize;
+};
+
+struct LineRow {
+    uint64_t address;
+    // Index into the file table plus one, zero for addresses without a location
+    uint32_t file;
+    uint32_t line;
+};
+
+void WriteVarint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+uint64_t ReadVarint(const uint8_t *&cursor, const uint8_t *end) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (cursor == end) {
+            break;
+        }
+        uint8_t byte = *cursor++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    throw DwarfError{"truncated varint in line index"};
+}
+
+uint64_t ZigZag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t UnZigZag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+Utils::MappedImage EncodeLineIndex(const std::vector<LineRow> &rows, const std::vector<std::string> &files) {
+    const uint32_t blockRows = LineIndex::kBlockRows;
+    std::vector<uint64_t> blockAddresses;
+    std::vector<uint64_t> blockOffsets;
+    std::vector<uint8_t> data;
+    for (size_t start = 0; start < rows.size(); start += blockRows) {
+        blockAddresses.push_back(rows[start].address);
+        blockOffsets.push_back(data.size());
+        WriteVarint(data, rows[start].file);
+        WriteVarint(data, rows[start].line);
+        size_t end = std::min<size_t>(start + blockRows, rows.size());
+        for (size_t i = start + 1; i < end; ++i) {
+            const LineRow &previous = rows[i - 1];
+            WriteVarint(data, rows[i].address - previous.address);
+            WriteVarint(data, ZigZag(int64_t{rows[i].file} - int64_t{previous.file}));
+            WriteVarint(data, ZigZag(int64_t{rows[i].line} - int64_t{previous.line}));
+        }
+    }
+
+    std::vector<uint64_t> fileOffsets;
+    std::string strings;
+    for (const auto &file: files) {
+        fileOffsets.push_back(strings.size());
+        strings.append(file);
+        strings.push_back('\0');
+    }
+
+    LineIndexHeader header{};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = LineIndex::kVersion;
+    header.blockRows = blockRows;
+    header.rowCount = rows.size();
+    header.blockCount = blockAddresses.size();
+    header.fileCount = fileOffsets.size();
+    header.stringsSize = strings.size();
+    header.dataSize = data.size();
+
+    Utils::MappedImage::Writer writer{header};
+    writer.AppendSection(blockAddresses);
+    writer.AppendSection(blockOffsets);
+    writer.AppendSection(fileOffsets);
+    writer.AppendSection(strings);
+    writer.AppendSection(data);
+    return std::move(writer).Finish();
+}
+
+}// namespace
+
+
+/// Line table decoding
+
+namespace {
+
+struct UnitLines {
+    std::vector<LineRow> rows;
+    // Local to the unit, rows index this table
+    std::vector<std::string> files;
+};
+
+struct LineProgram {
+    uint64_t offset;
+    const char *compilationDirectory;
+};
+
+UnitLines DecodeUnitLines(DwarfContextWrapper &dwarfContext, const DwarfUnitWrapper &unitWrapper,
+                          const LineProgram &program) {
+    llvm::DWARFUnit &unit = unitWrapper.GetUnit();
+    const llvm::DWARFContext &context = unit.getContext();
+    const llvm::DWARFObject &object = context.getDWARFObj();
+    llvm::DWARFDataExtractor data{object, object.getLineSection(), context.isLittleEndian(),
+                                  unit.getAddressByteSize()};
+
+    UnitLines result;
+    llvm::DWARFDebugLine::LineTable table;
+    uint64_t offset = program.offset;
+    llvm::Error error = table.parse(data, &offset, context, &unit, [](llvm::Error recoverable) {
+        llvm::consumeError(std::move(recoverable));
+    });
+    if (error) {
+        BDLogDebug("failed to parse line program at {:#x}, error: {}",
+                   program.offset, llvm::toString(std::move(error)));
+        return result;
+    }
+
+    std::unordered_map<uint64_t, uint32_t> fileIds;
+    auto mapFile = [&](uint64_t fileIndex) -> uint32_t {
+        if (auto it = fileIds.find(fileIndex); it != fileIds.end()) {
+            return it->second;
+        }
+        std::string name;
+        uint32_t id = 0;
+        if (table.getFileNameByIndex(fileIndex, program.compilationDirectory ? program.compilationDirectory : "",
+                                     llvm::DILineInfoSpecifier::FileLineInfoKind::AbsoluteFilePath, name)) {
+            // Units spell the same header differently, e.g. through ".."
+            result.files.push_back(fs::path{name}.lexically_normal().string());
+            id = static_cast<uint32_t>(result.files.size());
+        }
+        fileIds[fileIndex] = id;
+        return id;
+    };
+
+    DwarfOffset binary{.binaryId = unitWrapper.GetBinaryId(), .offset = 0};
+    size_t sequenceStart = 0;
+    for (const auto &row: table.Rows) {
+        // Sequences end past their last instruction, which may be the end of a segment
+        std::optional<uint64_t> address;
+        if (row.EndSequence) {
+            if (row.Address.Address > 0) {
+                if (auto slid = dwarfContext.GetSlidAddress(binary, row.Address.Address - 1)) {
+                    address = *slid + 1;
+                }
+            }
+        } else {
+            address = dwarfContext.GetSlidAddress(binary, row.Address.Address);
+        }
+
+        if (address) {
+            LineRow entry{.address = *address, .file = 0, .line = 0};
+            if (!row.EndSequence && row.Line != 0) {
+                entry.file = mapFile(row.File);
+                entry.line = entry.file ? row.Line : 0;
+            }
+            // The last row for an address wins, same as llvm lookups
+            if (result.rows.size() > sequenceStart && result.rows.back().address == entry.address) {
+                result.rows.back() = entry;
+            } else {
+                result.rows.push_back(entry);
+            }
+        }
+
+        if (row.EndSequence) {
+            sequenceStart = result.rows.size();
+        }
+    }
+    return result;
+}
+
+}// namespace
+
+
+/// Line index
+
+LineIndex LineIndex::Build(DwarfContextWrapper &dwarfContext) {
+    Utils::ScopedPhase phase{"dwarf.line_index"};
+    Utils::ScopedTrace trace{"dwarf", "line_index"};
+    std::vector<DwarfUnitWrapper> units = dwarfContext.GetNormalUnitsVector();
+
+    // Unit DIEs are extracted lazily, so they are read before the line
+    // programs are parsed concurrently
+    std::vector<std::optional<LineProgram>> programs(units.size());
+    for (size_t i = 0; i < units.size(); ++i) {
+        llvm::DWARFUnit &unit = units[i].GetUnit();
+        if (auto offset = DW::toSectionOffset(unit.getUnitDIE().find(DW::DW_AT_stmt_list))) {
+            programs[i] = LineProgram{*offset, unit.getCompilationDir()};
+        }
+    }
+
+    std::vector<UnitLines> unitLines(units.size());
+    tf::Taskflow taskflow;
+    taskflow.for_each_index(size_t{0}, units.size(), size_t{1}, [&](size_t i) {
+        Utils::ScopedPhase unitPhase{"dwarf.decode_lines"};
+        if (programs[i]) {
+            unitLines[i] = DecodeUnitLines(dwarfContext, units[i], *programs[i]);
+        }
+    });
+    Utils::RunAndWait(taskflow);
+
+    // Merge the file tables of all units
+    std::vector<std::string> files;
+    std::unordered_map<std::string, uint32_t> fileIds;
+    std::vector<LineRow> rows;
+    size_t numRows = 0;
+    for (const auto &lines: unitLines) {
+        numRows += lines.rows.size();
+    }
+    rows.reserve(numRows);
+    for (auto &lines: unitLines) {
+        std::vector<uint32_t> remap(lines.files.size());
+        for (size_t i = 0; i < lines.files.size(); ++i) {
+            auto [it, inserted] = fileIds.try_emplace(lines.files[i], static_cast<uint32_t>(files.size() + 1));
+            if (inserted) {
+                files.push_back(lines.files[i]);
+            }
+            remap[i] = it->second;
+        }
+        for (LineRow row: lines.rows) {
+            row.file = row.file ? remap[row.file - 1] : 0;
+            rows.push_back(row);
+        }
+        lines = UnitLines{};
+    }
+
+    // Rows without a location sort first, so a sequence starting where
+    // another one ends takes over the address
+    tf::Taskflow sortflow;
+    sortflow.sort(rows.begin(), rows.end(), [](const LineRow &lhs, const LineRow &rhs) {
+        return std::tie(lhs.address, lhs.file, lhs.line) < std::tie(rhs.address, rhs.file, rhs.line);
+    });
+    Utils::RunAndWait(sortflow);
+
+    // Only rows changing the location are kept
+    std::vector<LineRow> compacted;
+    auto sameLocation = [](const LineRow &lhs, const LineRow &rhs) {
+        return lhs.file == rhs.file && lhs.line == rhs.line;
+    };
+    for (const LineRow &row: rows) {
+        if (!compacted.empty() && compacted.back().address == row.address) {
+            compacted.back() = row;
+            if (compacted.size() > 1 && sameLocation(compacted[compacted.size() - 2], row)) {
+                compacted.pop_back();
+            }
+        } else if (compacted.empty() ? row.file == 0 : sameLocation(compacted.back(), row)) {
+            continue;
+        } else {
+            compacted.push_back(row);
+        }
+    }
+    rows = {};
+
+    LineIndex index;
+    index.Attach(EncodeLineIndex(compacted, files));
+    phase.Add(Utils::Counter::SymbolsAdded, compacted.size());
+    BDLogInfo("built line index with {} rows and {} files from {} units, {} bytes",
+              compacted.size(), files.size(), units.size(), index.GetSizeInBytes());
+    return index;
+}
+
+LineIndex LineIndex::Open(const fs::path &path) {
+    LineIndex index;
+    index.Attach(Utils::MappedImage::Open(path, "line index"));
+    return index;
+}
+
+bool LineIndex::Save(const fs::path &path) const {
+    if (!image_.Save(path, "line index")) {
+        return false;
+    }
+    BDLogInfo("saved line index {} with {} rows", path.string(), rowCount_);
+    return true;
+}
+
+void LineIndex::Attach(Utils::MappedImage image) {
+    image_ = std::move(image);
+    Utils::MappedImage::Reader reader{image_.GetImage(), "line index"};
+    auto header = reader.ReadHeader<LineIndexHeader>(kMagic, kVersion);
+    if (header.blockRows == 0 || header.blockCount != (header.rowCount + header.blockRows - 1) / header.blockRows) {
+        throw DwarfError{"invalid line index block count {}", header.blockCount};
+    }
+
+    blockAddresses_ = reader.ReadSection<uint64_t>(header.blockCount);
+    blockOffsets_ = reader.ReadSection<uint64_t>(header.blockCount);
+    fileOffsets_ = reader.ReadSection<uint64_t>(header.fileCount);
+    strings_ = reader.ReadSection<char>(header.stringsSize);
+    data_ = reader.ReadSection<uint8_t>(header.dataSize);
+
+    if (!strings_.empty() && strings_.back() != '\0') {
+        throw DwarfError{"unterminated line index string table"};
+    }
+    for (uint64_t fileOffset: fileOffsets_) {
+        if (fileOffset >= strings_.size()) {
+            throw DwarfError{"line index file offset {:#x} out of bounds", fileOffset};
+        }
+    }
+    for (uint64_t blockOffset: blockOffsets_) {
+        if (blockOffset >= data_.size()) {
+            throw DwarfError{"line index block offset {:#x} out of bounds", blockOffset};
+        }
+    }
+
+    rowCount_ = header.rowCount;
+    blockRows_ = header.blockRows;
+}
+
+template<class Visitor>
+void LineIndex::DecodeBlock(size_t block, Visitor &&visitor) const {
+    const uint8_t *cursor = data_.data() + blockOffsets_[block];
+    const uint8_t *end = data_.data() + data_.size();
+    uint64_t numRows = std::min<uint64_t>(blockRows_, rowCount_ - block * blockRows_);
+
+    uint64_t address = blockAddresses_[block];
+    uint64_t file = ReadVarint(cursor, end);
+    uint64_t line = ReadVarint(cursor, end);
+    if (!visitor(address, file, line)) {
+        return;
+    }
+    for (uint64_t i = 1; i < numRows; ++i) {
+        address += ReadVarint(cursor, end);
+        file += UnZigZag(ReadVarint(cursor, end));
+        line += UnZigZag(ReadVarint(cursor, end));
+        if (!visitor(address, file, line)) {
+            return;
+        }
+    }
+}
+
+std::optional<LineLocation> LineIndex::MakeLocation(uint64_t file, uint64_t line) const {
+    if (file == 0 || file > fileOffsets_.size()) {
+        return std::nullopt;
+    }
+    return LineLocation{
+        .file = std::string_view{strings_.data() + fileOffsets_[file - 1]},
+        .line = static_cast<uint32_t>(line)};
+}
+
+std::optional<LineLocation> LineIndex::Lookup(uint64_t address) const {
+    auto it = std::upper_bound(blockAddresses_.begin(), blockAddresses_.end(), address);
+    if (it == blockAddresses_.begin()) {
+        return std::nullopt;
+    }
+
+    uint64_t file = 0;
+    uint64_t line = 0;
+    DecodeBlock(it - blockAddresses_.begin() - 1, [&](uint64_t rowAddress, uint64_t rowFile, uint64_t rowLine) {
+        if (rowAddress > address) {
+            return false;
+        }
+        file = rowFile;
+        line = rowLine;
+        return true;
+    });
+    return MakeLocation(file, line);
+}
+
+void LineIndex::VisitRange(uint64_t begin, uint64_t end,
+                           const std::function<void(uint64_t, const LineLocation &)> &visitor) const {
+    auto it = std::upper_bound(blockAddresses_.begin(), blockAddresses_.end(), begin);
+    size_t block = it == blockAddresses_.begin() ? 0 : it - blockAddresses_.begin() - 1;
+
+    uint64_t coveringFile = 0;
+    uint64_t coveringLine = 0;
+    bool coveringVisited = false;
+    auto visitCovering = [&] {
+        if (!coveringVisited) {
+            coveringVisited = true;
+            if (auto location = MakeLocation(coveringFile, coveringLine)) {
+                visitor(begin, *location);
+            }
+        }
+    };
+
+    bool done = false;
+    for (; block < blockAddresses_.size() && !done; ++block) {
+        DecodeBlock(block, [&](uint64_t address, uint64_t file, uint64_t line) {
+            if (address >= end) {
+                done = true;
+                return false;
+            }
+            if (address <= begin) {
+                coveringFile = file;
+                coveringLine = line;
+                return true;
+            }
+            visitCovering();
+            if (auto location = MakeLocation(file, line)) {
+                visitor(address, *location);
+            }
+            return true;
+        });
+    }
+    visitCovering();
+}
@@ -19,6 +19,7 @@
 // SOFTWARE.
 
 
+#include <atomic>
 #include <filesystem>
 #include <mutex>
 
@@ -30,6 +31,8 @@
 #include <binja/utils/binary_view.h>
 #include <binja/utils/debug.h>
 #include <binja/utils/log.h>
+#include <binja/utils/metrics.h>
+#include <binja/utils/trace.h>
 
 #include "macho_task.h"
 
@@ -42,55 +45,123 @@ namespace fs = std::filesystem;
 /// MachO import task
 
 MachOImportTask::MachOImportTask(std::vector<fs::path> sources, BinaryView &binaryView,
-                                 BinaryNinja::DebugInfo &debugInfo,
+                                 DebugInfoSink &sink,
                                  MachOImportOptions options, MachOImportProgressMonitor &monitor)
-    : binaryView_{binaryView}, debugInfo_{debugInfo}, sources_{sources},
-      options_{options}, monitor_{monitor},
+    : binaryView_{binaryView}, sink_{sink}, sources_{sources},
+      collectedSymbols_(sources_.size()), options_{options}, monitor_{monitor},
       targetSegments_{MachO::MachBinaryView{binaryView}.ReadMachOHeaders()} {
     for (const auto &symbol: binaryView.GetSymbols()) {
-        registeredSymbols_[symbol->GetAddress()] = symbol->GetFullName();
+        existingSymbols_.push_back(symbol->GetAddress());
     }
 }
 
-void MachOImportTask::Import() {
-    tf::Taskflow taskflow;
-    tf::Executor executor;
+void MachOImportTask::Import(tf::Subflow &subflow) {
+    std::mutex monitorMutex;
+    std::atomic<size_t> completed = 0;
+    tf::Task collect = subflow.for_each_index(size_t{0}, sources_.size(), size_t{1}, [&](size_t sourceIndex) {
+        CollectSymbols(sourceIndex);
+        std::lock_guard lock{monitorMutex};
+        monitor_(++completed, sources_.size());
+    }).name("macho_collect_symbols");
+
+    std::optional<SymbolRegistry> registry;
+    tf::Task claimExisting = subflow.emplace([&] {
+        size_t numCollected = 0;
+        for (const auto &symbols: collectedSymbols_) {
+            numCollected += symbols.size();
+        }
 
-    std::mutex mtx;
-    size_t numAdded = 0;
-    std::atomic<size_t> completed;
-    taskflow.for_each(sources_.begin(), sources_.end(), [&](const auto &source) {
-        auto binary = OpenMachO(source);
-        completed++;
-        if (!binary) {
-            return;
+        registry.emplace(existingSymbols_.size() + numCollected);
+        for (uint64_t address: existingSymbols_) {
+            registry->Claim(address, SymbolRegistry::kExistingSymbol);
         }
+    }).name("macho_claim_existing_symbols");
 
-        BDLogDebug("importing symbols from macho {}", binary->GetFile()->GetOriginalFilename());
-        MachO::MachBinaryViewDataBackend dataBackend{*binary};
-        auto uuid = MachO::MachHeaderParser{dataBackend, binary->GetStart()}.DecodeUUID();
-        BDVerify(uuid);
-        auto targetSegments = targetSegments_[*uuid];
+    tf::Task claim = subflow.for_each_index(size_t{0}, sources_.size(), size_t{1}, [&](size_t sourceIndex) {
+        const auto &symbols = collectedSymbols_[sourceIndex];
+        for (size_t i = 0; i < symbols.size(); ++i) {
+            registry->Claim(symbols[i].address, MakeOwnerId(sourceIndex, i));
+        }
+    }).name("macho_claim_symbols");
 
-        AddressSlider slider = AddressSlider::CreateFromMachOSegments(
-            MachO::MachHeaderParser{dataBackend, binary->GetStart()}.DecodeSegments(),
-            targetSegments);
+    tf::Task emit = subflow.emplace([&] {
+        EmitSymbols(*registry);
+    }).name("macho_emit_symbols");
 
-        std::vector<Ref<Symbol>> symbols = binary->GetSymbols();
-        std::lock_guard lock{mtx};
-        monitor_(completed, sources_.size());
+    collect.precede(claimExisting);
+    claimExisting.precede(claim);
+    claim.precede(emit);
+    subflow.join();
+    diagnostics_.LogSummary("macho import");
+}
 
-        for (Ref<Symbol> symbol: symbols) {
-            if (AddSymbol(*symbol, slider)) {
-                numAdded++;
+void MachOImportTask::EmitSymbols(const SymbolRegistry &registry) {
+    Utils::ScopedPhase phase{"macho.emit_symbols"};
+    Utils::ScopedTrace trace{"macho", "emit_symbols"};
+    size_t numAdded = 0;
+    for (size_t sourceIndex = 0; sourceIndex < sources_.size(); ++sourceIndex) {
+        const auto &symbols = collectedSymbols_[sourceIndex];
+        for (size_t i = 0; i < symbols.size(); ++i) {
+            const SymbolRecord &record = symbols[i];
+            auto owner = registry.Owner(record.address);
+            BDVerify(owner);
+            if (*owner != MakeOwnerId(sourceIndex, i)) {
+                diagnostics_.Report(DiagnosticKind::SymbolShadowed, record.address);
+                BDLogDebug("skipping symbol {} since another symbol {} already exist at address {:#016x}",
+                           names_.Get(record.fullName), DescribeOwner(*owner, record.address), record.address);
+                continue;
             }
+            AddSymbol(record);
+            numAdded++;
         }
-    });
+    }
+    collectedSymbols_.clear();
+    phase.Add(Utils::Counter::SymbolsAdded, numAdded);
 
-    executor.run(taskflow).wait();
     BDLogInfo("Imported {} symbols from {} macho sources", numAdded, sources_.size());
 }
 
+void MachOImportTask::CollectSymbols(size_t sourceIndex) {
+    Utils::ScopedPhase phase{"macho.collect_symbols"};
+    Utils::ScopedTrace trace{"macho", "collect {}", sources_[sourceIndex].filename().string()};
+    auto binary = OpenMachO(sources_[sourceIndex]);
+    if (!binary) {
+        return;
+    }
+    phase.Add(Utils::Counter::BytesRead, binary->GetLength());
+
+    BDLogDebug("importing symbols from macho {}", binary->GetFile()->GetOriginalFilename());
+    MachO::MachBinaryViewDataBackend dataBackend{*binary};
+    auto uuid = MachO::MachHeaderParser{dataBackend, binary->GetStart()}.DecodeUUID();
+    BDVerify(uuid);
+    const auto &targetSegments = targetSegments_.at(*uuid);
+
+    AddressSlider slider = AddressSlider::CreateFromMachOSegments(
+        MachO::MachHeaderParser{dataBackend, binary->GetStart()}.DecodeSegments(),
+        targetSegments, &diagnostics_);
+
+    auto &records = collectedSymbols_[sourceIndex];
+    for (const Ref<Symbol> &symbol: binary->GetSymbols()) {
+        if (auto record = DecodeSymbol(*symbol, slider)) {
+            records.push_back(*record);
+        }
+    }
+}
+
+SymbolRegistry::OwnerId MachOImportTask::MakeOwnerId(size_t sourceIndex, size_t symbolIndex) {
+    BDVerify(symbolIndex <= UINT32_MAX);
+    return (static_cast<uint64_t>(sourceIndex + 1) << 32) | symbolIndex;
+}
+
+std::string MachOImportTask::DescribeOwner(SymbolRegistry::OwnerId owner, uint64_t address) {
+    if (owner == SymbolRegistry::kExistingSymbol) {
+        Ref<Symbol> symbol = binaryView_.GetSymbolByAddress(address);
+        return symbol ? symbol->GetFullName() : std::string{};
+    }
+    const auto &record = collectedSymbols_[(owner >> 32) - 1][owner & UINT32_MAX];
+    return std::string{names_.Get(record.fullName)};
+}
+
 Ref<BinaryView> MachOImportTask::OpenMachO(const fs::path &path) {
     Json::Value options;
     Json::Value preferredArchs;
@@ -118,63 +189,57 @@ Ref<BinaryView> MachOImportTask::OpenMachO(const fs::path &path) {
     return bv;
 }
 
-bool MachOImportTask::AddSymbol(const Symbol &symbol, AddressSlider &slider) {
-    std::string qualifiedName = symbol.GetFullName();
+std::optional<MachOImportTask::SymbolRecord> MachOImportTask::DecodeSymbol(const Symbol &symbol, AddressSlider &slider) {
     uint64_t address = symbol.GetAddress();
 
     if (symbol.GetType() != BNSymbolType::FunctionSymbol && symbol.GetType() != BNSymbolType::DataSymbol) {
         BDLogDebug("ignoring external symbol {} at {}",
                    symbol.GetFullName(), symbol.GetAddress());
-        return false;
+        return std::nullopt;
     }
 
     if (symbol.GetType() == BNSymbolType::FunctionSymbol && !options_.importFunctions) {
-        return false;
+        return std::nullopt;
     }
 
     if (symbol.GetType() == BNSymbolType::DataSymbol && !options_.importDataVariables) {
-        return false;
+        return std::nullopt;
     }
 
     if (auto slidAddress = slider.SlideAddress(address)) {
         address = *slidAddress;
     } else {
-        BDLogWarn("failed to slide address {}", address);
-        return false;
-    }
-
-    if (registeredSymbols_.contains(address)) {
-        BDLogWarn("skipping symbol {} since another symbol {} already exist at address {:#016x}",
-                  qualifiedName, registeredSymbols_[address], address);
-        return false;
+        diagnostics_.Report(DiagnosticKind::SymbolAddressNotSlid, address);
+        BDLogDebug("failed to slide address {}", address);
+        return std::nullopt;
     }
 
-    Ref<Symbol> newSymbol = new Symbol{
-        symbol.GetType(),
-        qualifiedName,
-        address,
-        symbol.GetBinding(),
-        symbol.GetNameSpace()};
-
-    registeredSymbols_[address] = qualifiedName;
+    return SymbolRecord{
+        .type = symbol.GetType(),
+        .address = address,
+        .shortName = names_.Intern(symbol.GetShortName()),
+        .fullName = names_.Intern(symbol.GetFullName()),
+        .rawName = names_.Intern(symbol.GetRawName())};
+}
 
-    switch (symbol.GetType()) {
+void MachOImportTask::AddSymbol(const SymbolRecord &record) {
+    switch (record.type) {
         case FunctionSymbol: {
             DebugFunctionInfo info{
-                symbol.GetShortName(),
-                symbol.GetFullName(),
-                symbol.GetRawName(),
-                address,
+                std::string{names_.Get(record.shortName)},
+                std::string{names_.Get(record.fullName)},
+                std::string{names_.Get(record.rawName)},
+                record.address,
                 nullptr,
                 binaryView_.GetDefaultPlatform(),
                 {},
                 {}
             };
-            debugInfo_.AddFunction(info);
+            sink_.AddFunction(info);
             break;
         }
         case DataSymbol: {
-            debugInfo_.AddDataVariable(address, Type::VoidType(), symbol.GetFullName());
+            sink_.AddDataVariable(record.address, Type::VoidType(), std::string{names_.Get(record.fullName)});
             break;
         }
         case ImportAddressSymbol:
@@ -186,5 +251,4 @@ bool MachOImportTask::AddSymbol(const Symbol &symbol, AddressSlider &slider) {
         case LocalLabelSymbol:
             BDVerify(false);
     }
-    return true;
 }
@@ -0,0 +1,388 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <fstream>
+
+#include <binaryninjaapi.h>
+#include <fmt/format.h>
+#include <taskflow/taskflow.hpp>
+
+#include <binja/utils/debug.h>
+#include <binja/utils/executor.h>
+#include <binja/utils/files.h>
+#include <binja/utils/log.h>
+#include <binja/utils/metrics.h>
+
+#include "dsym.h"
+#include "errors.h"
+#include "manifest.h"
+#include "source_finder.h"
+
+using namespace Binja;
+using namespace DebugInfo;
+
+namespace fs = std::filesystem;
+
+
+/// Serialization helpers
+
+namespace {
+
+const char *KindToString(KDKObjectKind kind) {
+    switch (kind) {
+        case KDKObjectKind::MachO:
+            return "macho";
+        case KDKObjectKind::DwarfObject:
+            return "dwarf";
+    }
+    throw FatalError{"unknown KDK object kind {}", static_cast<int>(kind)};
+}
+
+std::optional<KDKObjectKind> KindFromString(const std::string &value) {
+    if (value == "macho") {
+        return KDKObjectKind::MachO;
+    }
+    if (value == "dwarf") {
+        return KDKObjectKind::DwarfObject;
+    }
+    return std::nullopt;
+}
+
+std::string UUIDToString(const Types::UUID &uuid) {
+    return fmt::format("{:02x}", fmt::join(uuid.data, ""));
+}
+
+std::optional<Types::UUID> UUIDFromString(const std::string &value) {
+    Types::UUID uuid{};
+    if (value.size() != sizeof(uuid.data) * 2) {
+        return std::nullopt;
+    }
+    for (size_t i = 0; i < sizeof(uuid.data); ++i) {
+        unsigned int byte;
+        if (sscanf(value.c_str() + i * 2, "%2x", &byte) != 1) {
+            return std::nullopt;
+        }
+        uuid.data[i] = static_cast<uint8_t>(byte);
+    }
+    return uuid;
+}
+
+std::string ManifestFileName(const fs::path &kdkPath) {
+    // FNV-1a keeps the file name stable across builds and platforms
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (char c: kdkPath.string()) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3ULL;
+    }
+    return fmt::format("{}-{:016x}.json", kdkPath.filename().string(), hash);
+}
+
+bool StatFile(const fs::path &path, int64_t &modificationTime, uint64_t &size) {
+    std::error_code ec;
+    auto time = fs::last_write_time(path, ec);
+    if (ec) {
+        return false;
+    }
+    size = fs::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+    modificationTime = time.time_since_epoch().count();
+    return true;
+}
+
+KDKObject ProbeObject(const fs::path &path, KDKObjectKind kind, int64_t modificationTime, uint64_t size) {
+    KDKObject object{
+        .path = path,
+        .kind = kind,
+        .uuid = std::nullopt,
+        .cpuType = 0,
+        .segments = {},
+        .modificationTime = modificationTime,
+        .size = size};
+    try {
+        if (auto info = DwarfObjectFile::Probe(path)) {
+            object.uuid = info->uuid;
+            object.cpuType = info->cpuType;
+            object.segments = std::move(info->segments);
+        }
+    } catch (const DwarfError &e) {
+        BDLogWarn("failed to probe object {}, error: {}", path.string(), e.what());
+    } catch (const Types::DecodeError &e) {
+        BDLogWarn("failed to probe object {}, error: {}", path.string(), e.what());
+    }
+    return object;
+}
+
+}// namespace
+
+
+/// KDK manifest
+
+fs::path KDKManifest::DefaultDirectory() {
+    return fs::path{BinaryNinja::GetUserDirectory()} / "binja_kc" / "manifests";
+}
+
+KDKManifest KDKManifest::Open(const fs::path &kdkPath, const fs::path &manifestDirectory) {
+    Utils::ScopedPhase phase{"manifest.open"};
+    KDKManifest manifest{kdkPath};
+    fs::path manifestPath = manifestDirectory / ManifestFileName(kdkPath);
+
+    if (manifest.Load(manifestPath) && manifest.IsUpToDate()) {
+        phase.Add(Utils::Counter::CacheHits, manifest.objects_.size());
+        BDLogInfo("using up to date KDK manifest {} with {} objects",
+                  manifestPath.string(), manifest.objects_.size());
+        return manifest;
+    }
+
+    manifest.Refresh();
+
+    try {
+        fs::create_directories(manifestDirectory);
+        manifest.Save(manifestPath);
+    } catch (const fs::filesystem_error &e) {
+        BDLogWarn("failed to save KDK manifest {}, error: {}", manifestPath.string(), e.what());
+    }
+    return manifest;
+}
+
+std::vector<fs::path> KDKManifest::ResolveObjects(
+    KDKObjectKind kind,
+    const std::map<Types::UUID, std::vector<MachO::Segment>> &targets) const {
+    std::vector<fs::path> result;
+    for (const auto &object: objects_) {
+        if (object.kind != kind || !object.uuid) {
+            continue;
+        }
+        if (!targets.contains(*object.uuid)) {
+            BDLogDebug("ignoring object {} since its uuid does not match with "
+                       "any macho headers in binary view",
+                       object.path.string());
+            continue;
+        }
+        result.push_back(object.path);
+    }
+    return result;
+}
+
+bool KDKManifest::Load(const fs::path &manifestPath) {
+    std::ifstream stream{manifestPath};
+    if (!stream) {
+        BDLogDebug("KDK manifest {} does not exist", manifestPath.string());
+        return false;
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    std::string errors;
+    if (!Json::parseFromStream(builder, stream, &root, &errors)) {
+        BDLogWarn("ignoring invalid KDK manifest {}, error: {}", manifestPath.string(), errors);
+        return false;
+    }
+
+    if (root["version"].asInt() != kVersion || root["root"].asString() != kdkPath_.string()) {
+        BDLogInfo("ignoring stale KDK manifest {}", manifestPath.string());
+        return false;
+    }
+
+    for (const auto &name: root["directories"].getMemberNames()) {
+        directoryTimes_[kdkPath_ / name] = root["directories"][name].asInt64();
+    }
+
+    for (const auto &entry: root["objects"]) {
+        auto kind = KindFromString(entry["kind"].asString());
+        if (!kind) {
+            BDLogWarn("ignoring invalid KDK manifest {}, unknown object kind {}",
+                      manifestPath.string(), entry["kind"].asString());
+            directoryTimes_.clear();
+            objects_.clear();
+            return false;
+        }
+
+        KDKObject object{
+            .path = kdkPath_ / entry["path"].asString(),
+            .kind = *kind,
+            .uuid = entry.isMember("uuid") ? UUIDFromString(entry["uuid"].asString()) : std::nullopt,
+            .cpuType = entry["cpuType"].asUInt(),
+            .segments = {},
+            .modificationTime = entry["mtime"].asInt64(),
+            .size = entry["size"].asUInt64()};
+        for (const auto &segmentEntry: entry["segments"]) {
+            object.segments.push_back(MachO::Segment{
+                .name = segmentEntry["name"].asString(),
+                .vaStart = segmentEntry["vaStart"].asUInt64(),
+                .vaLength = segmentEntry["vaLength"].asUInt64(),
+                .dataStart = segmentEntry["dataStart"].asUInt64(),
+                .dataLength = segmentEntry["dataLength"].asUInt64(),
+                .flags = segmentEntry["flags"].asUInt(),
+                .sections = {}});
+        }
+        objects_.push_back(std::move(object));
+    }
+    return true;
+}
+
+void KDKManifest::Save(const fs::path &manifestPath) const {
+    std::error_code ec;
+    Json::Value root;
+    root["version"] = kVersion;
+    root["root"] = kdkPath_.string();
+
+    Json::Value directories{Json::objectValue};
+    for (const auto &[path, time]: directoryTimes_) {
+        directories[path.lexically_relative(kdkPath_).string()] = Json::Int64{time};
+    }
+    root["directories"] = directories;
+
+    Json::Value objects{Json::arrayValue};
+    for (const auto &object: objects_) {
+        Json::Value entry;
+        entry["path"] = object.path.lexically_relative(kdkPath_).string();
+        entry["kind"] = KindToString(object.kind);
+        if (object.uuid) {
+            entry["uuid"] = UUIDToString(*object.uuid);
+        }
+        entry["cpuType"] = object.cpuType;
+        entry["mtime"] = Json::Int64{object.modificationTime};
+        entry["size"] = Json::UInt64{object.size};
+
+        Json::Value segments{Json::arrayValue};
+        for (const auto &segment: object.segments) {
+            Json::Value segmentEntry;
+            segmentEntry["name"] = segment.name;
+            segmentEntry["vaStart"] = Json::UInt64{segment.vaStart};
+            segmentEntry["vaLength"] = Json::UInt64{segment.vaLength};
+            segmentEntry["dataStart"] = Json::UInt64{segment.dataStart};
+            segmentEntry["dataLength"] = Json::UInt64{segment.dataLength};
+            segmentEntry["flags"] = segment.flags;
+            segments.append(segmentEntry);
+        }
+        entry["segments"] = segments;
+        objects.append(entry);
+    }
+    root["objects"] = objects;
+
+    // Imports of the same KDK may save concurrently, each writes its own
+    // temporary file and the last rename wins
+    fs::path temporaryPath = Utils::MakeTemporaryPath(manifestPath);
+    {
+        std::ofstream stream{temporaryPath, std::ios::trunc};
+        if (stream) {
+            Json::StreamWriterBuilder builder;
+            builder["indentation"] = "";
+            stream << Json::writeString(builder, root);
+        }
+        if (!stream) {
+            BDLogWarn("failed to write KDK manifest {}", manifestPath.string());
+            fs::remove(temporaryPath, ec);
+            return;
+        }
+    }
+    fs::rename(temporaryPath, manifestPath, ec);
+    if (ec) {
+        BDLogWarn("failed to save KDK manifest {}, error: {}", manifestPath.string(), ec.message());
+        fs::remove(temporaryPath, ec);
+        return;
+    }
+    BDLogInfo("saved KDK manifest {} with {} objects", manifestPath.string(), objects_.size());
+}
+
+bool KDKManifest::IsUpToDate() const {
+    std::error_code ec;
+    for (const auto &[path, time]: directoryTimes_) {
+        auto currentTime = fs::last_write_time(path, ec);
+        if (ec || currentTime.time_since_epoch().count() != time) {
+            BDLogDebug("KDK directory {} changed since manifest was saved", path.string());
+            return false;
+        }
+    }
+
+    for (const auto &object: objects_) {
+        int64_t modificationTime;
+        uint64_t size;
+        if (!StatFile(object.path, modificationTime, size) ||
+            modificationTime != object.modificationTime || size != object.size) {
+            BDLogDebug("KDK object {} changed since manifest was saved", object.path.string());
+            return false;
+        }
+    }
+    return true;
+}
+
+void KDKManifest::Refresh() {
+    SymbolSourceFinder sourceFinder{kdkPath_};
+    const KDKContents &contents = sourceFinder.Scan();
+
+    std::vector<std::pair<fs::path, KDKObjectKind>> candidates;
+    for (const auto &path: contents.machoObjects) {
+        candidates.emplace_back(path, KDKObjectKind::MachO);
+    }
+    for (const auto &dSYMFile: contents.dsymObjects) {
+        try {
+            for (const auto &path: DwarfObjectFile::DsymFindObjects(dSYMFile)) {
+                candidates.emplace_back(path, KDKObjectKind::DwarfObject);
+            }
+        } catch (const DwarfError &e) {
+            BDLogWarn("failed to open symbols file {}, error: {}", dSYMFile.string(), e.what());
+        }
+    }
+
+    std::map<std::pair<fs::path, KDKObjectKind>, const KDKObject *> cached;
+    for (const auto &object: objects_) {
+        cached[{object.path, object.kind}] = &object;
+    }
+
+    std::vector<std::optional<KDKObject>> refreshed(candidates.size());
+    std::atomic<size_t> numProbed = 0;
+
+    tf::Taskflow taskflow;
+    taskflow.for_each_index(size_t{0}, candidates.size(), size_t{1}, [&](size_t i) {
+        Utils::ScopedPhase phase{"manifest.probe"};
+        const auto &[path, kind] = candidates[i];
+        int64_t modificationTime;
+        uint64_t size;
+        if (!StatFile(path, modificationTime, size)) {
+            BDLogWarn("failed to stat KDK object {}", path.string());
+            return;
+        }
+        if (auto it = cached.find(candidates[i]); it != cached.end() &&
+                                                   it->second->modificationTime == modificationTime &&
+                                                   it->second->size == size) {
+            refreshed[i] = *it->second;
+            return;
+        }
+        refreshed[i] = ProbeObject(path, kind, modificationTime, size);
+        numProbed++;
+    });
+    Utils::RunAndWait(taskflow);
+
+    std::vector<KDKObject> objects;
+    for (auto &object: refreshed) {
+        if (object) {
+            objects.push_back(std::move(*object));
+        }
+    }
+    Utils::CountMetric(Utils::Counter::CacheHits, objects.size() - numProbed.load());
+    BDLogInfo("refreshed KDK manifest for {}, probed {} of {} objects",
+              kdkPath_.string(), numProbed.load(), objects.size());
+
+    objects_ = std::move(objects);
+    directoryTimes_ = contents.directoryTimes;
+}
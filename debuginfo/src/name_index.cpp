@@ -65,7 +65,7 @@ void NameIndex::IndexDie(DwarfDieWrapper &die) {
     Verify(TypeBuilder::IsTypeTag(tag), FatalError);
 
     AttributeReader attributeReader{die};
-    Verify(!attributeReader.ReadName("", true).empty(), FatalError);
+    Verify(!attributeReader.ReadNameView("", true).empty(), FatalError);
 
     std::vector<DwarfOffset> hierarchy = DecodeHierarchy(die.GetOffset());
     InsertHierarchy(hierarchy);
@@ -76,9 +76,11 @@ void NameIndex::InsertHierarchy(const std::vector<DwarfOffset> &hierarchy) {
     for (DwarfOffset newDieOffset: hierarchy) {
         DwarfDieWrapper newDie = ResolveDieOffset(newDieOffset);
 
-        std::string name = AttributeReader{newDie}.ReadName("", true);
+        std::string anonymousName;
+        std::string_view name = AttributeReader{newDie}.ReadNameView("", true);
         if (name.empty()) {
-            name = GetAnonymousName(newDie);
+            anonymousName = GetAnonymousName(newDie);
+            name = anonymousName;
         }
 
         auto it = node->children.find(name);
@@ -89,7 +91,7 @@ void NameIndex::InsertHierarchy(const std::vector<DwarfOffset> &hierarchy) {
                 node = &it->second;
             }
         } else {
-            node = InsertNode(*node, name, newDie.GetOffset());
+            node = InsertNode(*node, std::string{name}, newDie.GetOffset());
         }
     }
 }
@@ -102,7 +104,7 @@ std::vector<DwarfOffset> NameIndex::DecodeHierarchy(DwarfOffset offset) {
     std::function<void(DwarfDieWrapper &)> scanContainer = [&](DwarfDieWrapper &die) {
         auto tag = die.GetTag();
         AttributeReader reader{die};
-        std::string name = reader.ReadString(DW_AT_name, "", true);
+        std::string_view name = reader.ReadStringView(DW_AT_name, "", true);
 
         switch (tag) {
             case DW_TAG_compile_unit:
@@ -182,7 +184,7 @@ std::vector<DwarfOffset> NameIndex::DecodeHierarchy(DwarfOffset offset) {
     return result;
 }
 
-NameIndex::Node *NameIndex::MergeNode(Node &parentNode, std::string name, DwarfOffset newDieOffset) {
+NameIndex::Node *NameIndex::MergeNode(Node &parentNode, std::string_view name, DwarfOffset newDieOffset) {
     Node &baseNode = parentNode.children.find(name)->second;
     NodeInfo &baseNodeInfo = nodeInfoVector_[baseNode.info];
     for (int i = 0; i <= baseNodeInfo.forkIndex; ++i) {
@@ -202,12 +204,12 @@ NameIndex::Node *NameIndex::MergeNode(Node &parentNode, std::string name, DwarfO
 
         switch (EvaluateMergeStrategy(childInfo.baseDie, newDieOffset)) {
             case NodeMergeStrategy::replace: {
-                aliasMap_.insert({childInfo.baseDie, child.info});
+                InsertAlias(childInfo.baseDie, child.info);
                 childInfo.baseDie = newDieOffset;
                 return &child;
             }
             case NodeMergeStrategy::alias: {
-                aliasMap_.insert({newDieOffset, child.info});
+                InsertAlias(newDieOffset, child.info);
                 return &child;
             }
             case NodeMergeStrategy::fork: {
@@ -220,12 +222,27 @@ NameIndex::Node *NameIndex::MergeNode(Node &parentNode, std::string name, DwarfO
     return InsertNode(parentNode, newName, newDieOffset);
 }
 
+void NameIndex::InsertAlias(DwarfOffset offset, NodeInfoVectorIndex info) {
+    auto id = dwarfContext_.GetDieId(offset);
+    BDVerify(id);
+    NodeInfoVectorIndex &alias = aliasMap_.At(*id);
+    if (alias == kRootNodeIndex_) {
+        alias = info;
+    }
+}
+
 DwarfDieWrapper NameIndex::ResolveDieOffset(DwarfOffset offset) {
-    auto it = aliasMap_.find(offset);
-    if (it != aliasMap_.end()) {
-        return dwarfContext_.GetDIEForOffset(nodeInfoVector_[it->second].baseDie);
+    return ResolveDie(dwarfContext_.GetDIEForOffset(offset));
+}
+
+DwarfDieWrapper NameIndex::ResolveDie(const DwarfDieWrapper &die) {
+    if (auto id = dwarfContext_.GetDieId(die)) {
+        NodeInfoVectorIndex alias = aliasMap_.Get(*id);
+        if (alias != kRootNodeIndex_) {
+            return dwarfContext_.GetDIEForOffset(nodeInfoVector_[alias].baseDie);
+        }
     }
-    return dwarfContext_.GetDIEForOffset(offset);
+    return die;
 }
 
 namespace {
@@ -387,11 +404,12 @@ QualifiedName NameIndex::DecodeQualifiedName(DwarfDieWrapper &die) {
             qualifiedName.push_back(info.name);
         } else {
             auto child = ResolveDieOffset(offset);
-            auto name = AttributeReader{child}.ReadName("", true);
+            auto name = AttributeReader{child}.ReadNameView("", true);
             if (name.empty()) {
-                name = GetAnonymousName(child);
+                qualifiedName.push_back(GetAnonymousName(child));
+            } else {
+                qualifiedName.push_back(std::string{name});
             }
-            qualifiedName.push_back(name);
         }
     }
     return qualifiedName;
@@ -399,9 +417,11 @@ QualifiedName NameIndex::DecodeQualifiedName(DwarfDieWrapper &die) {
 
 const NameIndex::Node *NameIndex::FindChild(const NameIndex::Node &parent, DwarfOffset dieOffset) {
     auto die = ResolveDieOffset(dieOffset);
-    std::string name = AttributeReader{die}.ReadName("", true);
+    std::string anonymousName;
+    std::string_view name = AttributeReader{die}.ReadNameView("", true);
     if (name.empty()) {
-        name = GetAnonymousName(die);
+        anonymousName = GetAnonymousName(die);
+        name = anonymousName;
     }
 
     auto it = parent.children.find(name);
@@ -414,7 +434,7 @@ const NameIndex::Node *NameIndex::FindChild(const NameIndex::Node &parent, Dwarf
     }
 
     for (int i = 0; i <= nodeInfoVector_[it->second.info].forkIndex; i++) {
-        std::string forkName = i == 0 ? name : fmt::format("{}__{}", name, i);
+        std::string forkName = i == 0 ? std::string{name} : fmt::format("{}__{}", name, i);
         auto forkIt = parent.children.find(forkName);
         const auto &info = nodeInfoVector_[forkIt->second.info];
         if (info.baseDie == dieOffset) {
@@ -0,0 +1,242 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+
+#include <binaryninjaapi.h>
+#include <binaryninjacore.h>
+#include <taskflow/taskflow.hpp>
+
+#include <binja/utils/executor.h>
+#include <binja/utils/log.h>
+#include <binja/utils/metrics.h>
+#include <binja/utils/trace.h>
+#include <binja/utils/settings.h>
+
+#include "arbiter.h"
+#include "manifest.h"
+#include "plugin_combined.h"
+#include "plugin_dsym.h"
+#include "plugin_function_starts.h"
+#include "plugin_macho.h"
+#include "plugin_symtab.h"
+
+using namespace Binja;
+using namespace DebugInfo;
+
+namespace BN = BinaryNinja;
+namespace fs = std::filesystem;
+
+
+/// Progress monitors
+
+namespace {
+
+using ProgressCallback = std::function<bool(size_t, size_t)>;
+
+class DwarfProgressMonitor : public DwarfImportProgressMonitor {
+public:
+    explicit DwarfProgressMonitor(const ProgressCallback &cb) : cb_{cb} {}
+
+    bool operator()(DwarfImportPhase phase, size_t done, size_t total) override {
+        return cb_(done, total);
+    }
+
+private:
+    const ProgressCallback &cb_;
+};
+
+class MachOProgressMonitor : public MachOImportProgressMonitor {
+public:
+    explicit MachOProgressMonitor(const ProgressCallback &cb) : cb_{cb} {}
+
+    bool operator()(size_t done, size_t total) override {
+        return cb_(done, total);
+    }
+
+private:
+    const ProgressCallback &cb_;
+};
+
+// Sums up the progress of sources which are loaded concurrently and
+// reports it as the progress of the combined import
+class CombinedProgress {
+public:
+    CombinedProgress(const ProgressCallback &progress, size_t numSources)
+        : progress_{progress}, sourceProgress_(numSources, 0) {}
+
+    bool Update(size_t sourceIndex, size_t done, size_t total) {
+        std::lock_guard lock{mutex_};
+        sourceProgress_[sourceIndex] = total ? std::min(done, total) * kScale / total : 0;
+        size_t combined = 0;
+        for (size_t value: sourceProgress_) {
+            combined += value;
+        }
+        return progress_(combined, sourceProgress_.size() * kScale);
+    }
+
+private:
+    static constexpr size_t kScale = 1000;
+
+    const ProgressCallback &progress_;
+    std::mutex mutex_;
+    std::vector<size_t> sourceProgress_;
+};
+
+}// namespace
+
+
+/// Combined import
+
+void PluginCombined::Load(DebugInfoSink &sink, const std::function<bool(size_t, size_t)> &progress) {
+    Utils::ReloadLogLevel();
+    Utils::Metrics::Instance().Reset();
+    auto bnSettings = BinaryNinja::Settings::Instance();
+    Utils::BinjaSettings settings {binaryView_.GetObject(), bnSettings->GetObject()};
+    BDVerify(settings.DebugInfoCombinedImport());
+
+    struct Source {
+        SymbolSourceKind kind;
+        const char *name;
+        std::function<void(tf::Subflow &, DebugInfoSink &, const ProgressCallback &)> load;
+    };
+
+    // The DWARF and Mach-O loaders usually read the same KDK. Its manifest
+    // is opened once here, instead of being scanned and saved by both
+    // loaders concurrently.
+    std::map<fs::path, std::optional<KDKManifest>> manifests;
+    auto openManifest = [&](const std::optional<fs::path> &source) -> const KDKManifest * {
+        if (!source || !settings.DebugInfoUseManifest()) {
+            return nullptr;
+        }
+        auto [it, inserted] = manifests.try_emplace(*source);
+        if (inserted) {
+            fs::path manifestDirectory = settings.DebugInfoManifestDirectory().value_or(KDKManifest::DefaultDirectory().string());
+            try {
+                it->second = KDKManifest::Open(*source, manifestDirectory);
+            } catch (const Types::DecodeError &e) {
+                BDLogError("failed to open KDK manifest for {}, error: {}", source->string(), e.what());
+            }
+        }
+        return it->second ? &*it->second : nullptr;
+    };
+
+    std::vector<Source> sources;
+    bool isKernelCache = binaryView_.GetTypeName() == "MachO-KC";
+    if (settings.DWARFEnabled()) {
+        const KDKManifest *manifest = openManifest(PluginDSYM{binaryView_}.GetSymbolSource());
+        sources.push_back({SymbolSourceKind::Dwarf, "combined_dwarf", [&, manifest](tf::Subflow &subflow, DebugInfoSink &sourceSink, const ProgressCallback &sourceProgress) {
+            DwarfProgressMonitor monitor{sourceProgress};
+            PluginDSYM{binaryView_}.Load(subflow, sourceSink, monitor, manifest);
+        }});
+    }
+    if (settings.MachoEnabled()) {
+        const KDKManifest *manifest = openManifest(PluginMacho{binaryView_}.GetSymbolSource());
+        sources.push_back({SymbolSourceKind::KextSymtab, "combined_macho", [&, manifest](tf::Subflow &subflow, DebugInfoSink &sourceSink, const ProgressCallback &sourceProgress) {
+            MachOProgressMonitor monitor{sourceProgress};
+            PluginMacho{binaryView_}.Load(subflow, sourceSink, monitor, manifest);
+        }});
+    }
+    if (isKernelCache && settings.SymtabEnabled()) {
+        sources.push_back({SymbolSourceKind::KCSymtab, "combined_symtab", [&](tf::Subflow &subflow, DebugInfoSink &sourceSink, const ProgressCallback &sourceProgress) {
+            PluginSymtab{binaryView_}.Load(subflow, sourceSink, sourceProgress);
+        }});
+    }
+    if (isKernelCache && settings.FunctionStartsEnabled()) {
+        sources.push_back({SymbolSourceKind::FunctionStarts, "combined_function_starts", [&](tf::Subflow &subflow, DebugInfoSink &sourceSink, const ProgressCallback &sourceProgress) {
+            PluginFunctionStarts{binaryView_}.Load(subflow, sourceSink, sourceProgress);
+        }});
+    }
+
+    // Sources are independent of each other and only join before the
+    // arbiter resolves conflicts between them
+    SymbolArbiter arbiter;
+    CombinedProgress combinedProgress{progress, sources.size()};
+    tf::Taskflow taskflow;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        taskflow.emplace([&, i](tf::Subflow &subflow) {
+            ProgressCallback sourceProgress = [&, i](size_t done, size_t total) {
+                return combinedProgress.Update(i, done, total);
+            };
+            sources[i].load(subflow, arbiter.GetSink(sources[i].kind), sourceProgress);
+        }).name(sources[i].name);
+    }
+    Utils::RunAndWait(taskflow);
+    arbiter.Emit(sink);
+    Utils::WriteMetricsReport(binaryView_);
+    Utils::WriteTraceEvents();
+    Utils::FlushSuppressedLogs();
+}
+
+
+/// Binary ninja plugin API
+
+namespace {
+
+bool IsValidForBinaryView(void *context, BNBinaryView *handle) {
+    BinaryNinja::BinaryView bv{handle};
+
+    auto bnSettings = BinaryNinja::Settings::Instance();
+    Utils::BinjaSettings settings {bv.GetObject(), bnSettings->GetObject()};
+    if (!settings.DebugInfoCombinedImport()) {
+        return false;
+    }
+
+    if (bv.GetTypeName() == "MachO-KC" && (settings.SymtabEnabled() || settings.FunctionStartsEnabled())) {
+        return true;
+    }
+    if (settings.DWARFEnabled() && PluginDSYM{bv}.GetSymbolSource()) {
+        return true;
+    }
+    if (settings.MachoEnabled() && PluginMacho{bv}.GetSymbolSource()) {
+        return true;
+    }
+
+    BDLogInfo("skipping combined debug info import since no enabled source is available");
+    return false;
+}
+
+template <typename ...Extra>
+struct DoParseDebugInfoImpl {
+    static bool Invoke(void *context, BNDebugInfo *debugInfoHandle, BNBinaryView *binaryViewHandle, Extra..., bool(progress)(void *, size_t, size_t), void *pctx) {
+        BN::BinaryView binaryView{binaryViewHandle};
+        BN::DebugInfo debugInfo{debugInfoHandle};
+        BinaryNinjaDebugInfoSink sink{debugInfo};
+
+        PluginCombined plugin{binaryView};
+        plugin.Load(sink, [&](size_t done, size_t total) {
+            return progress(pctx, done, total);
+        });
+        return true;
+    }
+};
+using DoParseDebugInfo = std::conditional_t<BN_CURRENT_CORE_ABI_VERSION >= 35, DoParseDebugInfoImpl<BNBinaryView *>, DoParseDebugInfoImpl<>>;
+
+}// namespace
+
+void PluginCombined::RegisterPlugin() {
+    BNRegisterDebugInfoParser(kPluginName, IsValidForBinaryView, DoParseDebugInfo::Invoke, nullptr);
+}
@@ -25,14 +25,19 @@
 #include <binaryninjaapi.h>
 #include <binaryninjacore.h>
 #include <fmt/format.h>
+#include <taskflow/taskflow.hpp>
 
 #include <binja/macho/macho.h>
+#include <binja/utils/executor.h>
 #include <binja/utils/log.h>
+#include <binja/utils/metrics.h>
+#include <binja/utils/trace.h>
 #include <binja/utils/settings.h>
 
 #include "debug.h"
 #include "dsym.h"
 #include "dwarf_task.h"
+#include "manifest.h"
 #include "plugin_dsym.h"
 #include "source_finder.h"
 
@@ -44,7 +49,21 @@ using namespace llvm;
 namespace fs = std::filesystem;
 
 
-void PluginDSYM::Load(BinaryNinja::DebugInfo &debugInfo, DwarfImportProgressMonitor &monitor) {
+void PluginDSYM::Load(DebugInfoSink &sink, DwarfImportProgressMonitor &monitor) {
+    Utils::ReloadLogLevel();
+    Utils::Metrics::Instance().Reset();
+    tf::Taskflow taskflow;
+    taskflow.emplace([&](tf::Subflow &subflow) {
+        Load(subflow, sink, monitor);
+    });
+    Utils::RunAndWait(taskflow);
+    Utils::WriteMetricsReport(binaryView_);
+    Utils::WriteTraceEvents();
+    Utils::FlushSuppressedLogs();
+}
+
+void PluginDSYM::Load(tf::Subflow &subflow, DebugInfoSink &sink, DwarfImportProgressMonitor &monitor,
+                      const KDKManifest *manifest) {
     auto source = GetSymbolSource();
     if (!source) {
         BDLogDebug("skipping dwarf symbols importing since no "
@@ -52,61 +71,98 @@ void PluginDSYM::Load(BinaryNinja::DebugInfo &debugInfo, DwarfImportProgressMoni
         return;
     }
 
-    SymbolSourceFinder sourceFinder{*source};
-
-    std::vector<fs::path> dwarfObjects;
-    for (const auto &dSYMFile: sourceFinder.FindAllDSYMObjects()) {
-        try {
-            auto objects = DwarfObjectFile::DsymFindObjects(dSYMFile);
-            dwarfObjects.insert(dwarfObjects.end(), objects.begin(), objects.end());
-        } catch (const DwarfError &e) {
-            BDLogError("failed to open symbols file {}, error: {}",
-                       dSYMFile.string(), e.what());
-            return;
-        }
-    }
-
-    auto targetObjects = MachO::MachBinaryView{binaryView_}.ReadMachOHeaders();
-    std::vector<fs::path> sourceObjects;
-
-    for (const auto &dwarfObject: dwarfObjects) {
-        DwarfObjectFile objectFile{dwarfObject};
-        auto uuid = objectFile.DecodeUUID();
-        if (!uuid) {
-            BDLogWarn("ignoring dwarf object {} since it does not have LC_UUID",
-                      dwarfObject.string());
-            continue;
-        }
-
-        if (!targetObjects.contains(*uuid)) {
-            BDLogWarn("ignoring dwarf object {} since its uuid does not match with "
-                      "any macho headers in binary view",
-                      dwarfObject.string());
-            continue;
-        }
-
-        sourceObjects.push_back(dwarfObject);
+    auto sourceObjects = FindDwarfObjects(*source, manifest);
+    if (!sourceObjects) {
+        return;
     }
 
     auto bnSettings = BinaryNinja::Settings::Instance();
     Utils::BinjaSettings settings {binaryView_.GetObject(), bnSettings->GetObject()};
-
     BDVerify(settings.DWARFEnabled());
     ImportOptions options{
         .importTypes = settings.DWARFLoadTypes(),
         .importFunctions = settings.DWARFLoadFunctions(),
         .importGlobals = settings.DWARFLoadDataVariables(),
+        .lazyFunctions = settings.DWARFLazyFunctions(),
+        .parallelTypes = settings.DWARFParallelTypes(),
     };
 
-    BDLogInfo("found {} dwarf symbols sources at {}", dwarfObjects.size(), source->string());
+    BDLogInfo("found {} matching dwarf symbols sources at {}", sourceObjects->size(), source->string());
     try {
-        DwarfImportTask task{sourceObjects, binaryView_, debugInfo, options, monitor};
-        task.Import();
+        DwarfImportTask task{*sourceObjects, binaryView_, sink, options, monitor};
+        task.Import(subflow);
     } catch (const Types::DecodeError &e) {
         BDLogError("Failed to load symbols, error: {}", e.what());
     }
 }
 
+std::optional<std::vector<fs::path>> PluginDSYM::FindDwarfObjects(const fs::path &source,
+                                                                  const KDKManifest *manifest) {
+    auto bnSettings = BinaryNinja::Settings::Instance();
+    Utils::BinjaSettings settings {binaryView_.GetObject(), bnSettings->GetObject()};
+
+    auto targetObjects = MachO::MachBinaryView{binaryView_}.ReadMachOHeaders();
+    std::vector<fs::path> sourceObjects;
+
+    if (manifest) {
+        sourceObjects = manifest->ResolveObjects(KDKObjectKind::DwarfObject, targetObjects);
+    } else if (settings.DebugInfoUseManifest()) {
+        fs::path manifestDirectory = settings.DebugInfoManifestDirectory().value_or(KDKManifest::DefaultDirectory().string());
+        try {
+            auto manifest = KDKManifest::Open(source, manifestDirectory);
+            sourceObjects = manifest.ResolveObjects(KDKObjectKind::DwarfObject, targetObjects);
+        } catch (const Types::DecodeError &e) {
+            BDLogError("failed to open KDK manifest for {}, error: {}", source.string(), e.what());
+            return std::nullopt;
+        }
+    } else {
+        SymbolSourceFinder sourceFinder{source};
+
+        std::vector<fs::path> dwarfObjects;
+        for (const auto &dSYMFile: sourceFinder.FindAllDSYMObjects()) {
+            try {
+                auto objects = DwarfObjectFile::DsymFindObjects(dSYMFile);
+                dwarfObjects.insert(dwarfObjects.end(), objects.begin(), objects.end());
+            } catch (const DwarfError &e) {
+                BDLogError("failed to open symbols file {}, error: {}",
+                           dSYMFile.string(), e.what());
+                return std::nullopt;
+            }
+        }
+
+        for (const auto &dwarfObject: dwarfObjects) {
+            std::optional<Types::UUID> uuid;
+            try {
+                if (auto info = DwarfObjectFile::Probe(dwarfObject)) {
+                    uuid = info->uuid;
+                }
+            } catch (const DwarfError &e) {
+                BDLogWarn("failed to probe dwarf object {}, error: {}", dwarfObject.string(), e.what());
+                continue;
+            } catch (const Types::DecodeError &e) {
+                BDLogWarn("failed to probe dwarf object {}, error: {}", dwarfObject.string(), e.what());
+                continue;
+            }
+            if (!uuid) {
+                BDLogWarn("ignoring dwarf object {} since it does not have LC_UUID",
+                          dwarfObject.string());
+                continue;
+            }
+
+            if (!targetObjects.contains(*uuid)) {
+                BDLogWarn("ignoring dwarf object {} since its uuid does not match with "
+                          "any macho headers in binary view",
+                          dwarfObject.string());
+                continue;
+            }
+
+            sourceObjects.push_back(dwarfObject);
+        }
+    }
+
+    return sourceObjects;
+}
+
 std::optional<fs::path> PluginDSYM::GetSymbolSource() {
     auto bnSettings = BinaryNinja::Settings::Instance();
     Utils::BinjaSettings settings {binaryView_.GetObject(), bnSettings->GetObject()};
@@ -175,6 +231,11 @@ bool IsValidForBinaryView(void *context, BNBinaryView *handle) {
         return false;
     }
 
+    if (settings.DebugInfoCombinedImport()) {
+        BDLogInfo("skipping dsym debug info import since combined debug info import is enabled");
+        return false;
+    }
+
     PluginDSYM plugin{bv};
     if (plugin.GetSymbolSource()) {
         return true;
@@ -190,9 +251,10 @@ struct DoParseDebugInfoImpl {
         BinaryNinja::DebugInfo debugInfo{debugInfoHandle};
         BinaryNinja::BinaryView binaryView{binaryViewHandle};
 
+        BinaryNinjaDebugInfoSink sink{debugInfo};
         ImportProgressMonitor monitor{progress, pctx};
         PluginDSYM plugin{binaryView};
-        plugin.Load(debugInfo, monitor);
+        plugin.Load(sink, monitor);
         return true;
     }
 };
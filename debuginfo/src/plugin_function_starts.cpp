@@ -22,8 +22,14 @@
 #include <mutex>
 #include <type_traits>
 
+#include <taskflow/taskflow.hpp>
+
 #include <binja/macho/macho.h>
+#include <binja/utils/executor.h>
 #include <binja/utils/log.h>
+#include <binja/utils/metrics.h>
+#include <binja/utils/trace.h>
+#include <binja/utils/segment_table.h>
 #include <binja/utils/settings.h>
 
 #include "plugin_function_starts.h"
@@ -33,61 +39,66 @@ using namespace DebugInfo;
 
 namespace BN = BinaryNinja;
 
-/// Binary ninja plugin API
-
-namespace {
-
-bool IsValidForBinaryView(void *context, BNBinaryView *handle) {
-    BinaryNinja::BinaryView bv{handle};
+void PluginFunctionStarts::Load(DebugInfoSink &sink, const std::function<bool(size_t, size_t)> &progress) {
+    Utils::ReloadLogLevel();
+    Utils::Metrics::Instance().Reset();
+    tf::Taskflow taskflow;
+    taskflow.emplace([&](tf::Subflow &subflow) {
+        Load(subflow, sink, progress);
+    });
+    Utils::RunAndWait(taskflow);
+    Utils::WriteMetricsReport(binaryView_);
+    Utils::WriteTraceEvents();
+    Utils::FlushSuppressedLogs();
+}
 
-    if (bv.GetTypeName() != "MachO-KC") {
-        return false;
-    }
+void PluginFunctionStarts::Load(tf::Subflow &subflow, DebugInfoSink &sink, const std::function<bool(size_t, size_t)> &progress) {
+    BN::Ref<BN::BinaryView> rawView = binaryView_.GetParentView();
 
     auto bnSettings = BinaryNinja::Settings::Instance();
-    Utils::BinjaSettings settings {bv.GetObject(), bnSettings->GetObject()};
-
-    if (!settings.FunctionStartsEnabled()) {
-        BDLogInfo("skipping LC_FUNCTION_STARTS debug info import since it is disabled");
-        return false;
-    }
-
-    return true;
-}
-
-template <typename ...Extra>
-struct DoParseDebugInfoImpl {
-    static bool Invoke(void *context, BNDebugInfo *debugInfoHandle, BNBinaryView *binaryViewHandle, Extra..., bool(progress)(void *, size_t, size_t), void *pctx) {
-        BN::BinaryView binaryView{binaryViewHandle};
-        BN::Ref<BN::BinaryView> rawView = binaryView.GetParentView();
+    Utils::BinjaSettings settings {binaryView_.GetObject(), bnSettings->GetObject()};
+    BDVerify(settings.FunctionStartsEnabled());
+
+    Utils::SegmentTable segmentTable = Utils::SegmentTable::FromBinaryView(binaryView_);
+    MachO::MachBinaryViewDataBackend dataBackend{*rawView};
+
+    struct FilesetFunctionStarts {
+        std::vector<uint64_t> starts;
+        std::vector<const Utils::SegmentRange *> segments;
+    };
+
+    std::vector<MachO::Fileset> filesets = MachO::MachHeaderParser{dataBackend, 0}.DecodeFilesets();
+    std::vector<FilesetFunctionStarts> filesetStarts(filesets.size());
+    tf::Task decode = subflow.for_each_index(size_t{0}, filesets.size(), size_t{1}, [&](size_t i) {
+        Utils::ScopedPhase phase{"function_starts.decode"};
+        MachO::Fileset &fileset = filesets[i];
+        uint64_t addr;
+        if (!binaryView_.GetAddressForDataOffset(fileset.fileOffset, addr)) {
+            return;
+        }
 
-        auto bnSettings = BinaryNinja::Settings::Instance();
-        Utils::BinjaSettings settings {binaryView.GetObject(), bnSettings->GetObject()};
-        BDVerify(settings.FunctionStartsEnabled());
+        MachO::MachHeaderParser parser{dataBackend, fileset.fileOffset};
+        FilesetFunctionStarts &result = filesetStarts[i];
+        result.starts = parser.DecodeFunctionStarts();
+        BDLogInfo("found {} entries from LC_FUNCTION_START in fileset {}", result.starts.size(), fileset.name);
 
-        BN::DebugInfo debugInfo{debugInfoHandle};
-        MachO::MachBinaryViewDataBackend dataBackend{*rawView};
+        // Function starts are decoded as ascending offsets, so the whole
+        // fileset is classified in a single pass over the segment table
+        result.segments = segmentTable.FindSorted(result.starts);
+    }).name("function_starts_decode");
 
-        std::vector<MachO::Fileset> filesets = MachO::MachHeaderParser{dataBackend, 0}.DecodeFilesets();
+    tf::Task emit = subflow.emplace([&] {
+        Utils::ScopedPhase phase{"function_starts.emit_symbols"};
         for (size_t i=0; i<filesets.size(); ++i) {
-            MachO::Fileset &fileset = filesets[i];
-            uint64_t addr;
-            if (!binaryView.GetAddressForDataOffset(fileset.fileOffset, addr)) {
-                continue;
-            }
-
-            MachO::MachHeaderParser parser{dataBackend, fileset.fileOffset};
-            std::vector<uint64_t> functionStarts = parser.DecodeFunctionStarts();
-            BDLogInfo("found {} entries from LC_FUNCTION_START in fileset {}", functionStarts.size(), fileset.name);
-
-            for (auto start: functionStarts) {
-                BN::Ref<BN::Segment> segment = binaryView.GetSegmentAt(start);
+            const FilesetFunctionStarts &fileset = filesetStarts[i];
+            for (size_t j = 0; j < fileset.starts.size(); ++j) {
+                uint64_t start = fileset.starts[j];
+                const Utils::SegmentRange *segment = fileset.segments[j];
                 if (!segment) {
                     BDLogDebug("ignoring LC_FUNCTION_START entry {:#016x} is not in any segment", start);
                     continue;
                 }
-                bool isFunction = segment->GetFlags() & BNSegmentFlag::SegmentContainsCode;
-                if (!isFunction) {
+                if (!segment->ContainsCode()) {
                     BDLogWarn("ignoring LC_FUNCTION_START entry {:#016x} since it is not in segment "
                               "with SegmentContainsCode", start);
                     continue;
@@ -104,10 +115,55 @@ struct DoParseDebugInfoImpl {
                     {},
                     {}
                 };
-                debugInfo.AddFunction(info);
+                sink.AddFunction(info);
+                phase.Add(Utils::Counter::SymbolsAdded);
             }
-            progress(pctx, i, filesets.size());
+            progress(i, filesets.size());
         }
+    }).name("function_starts_emit");
+
+    decode.precede(emit);
+    subflow.join();
+}
+
+/// Binary ninja plugin API
+
+namespace {
+
+bool IsValidForBinaryView(void *context, BNBinaryView *handle) {
+    BinaryNinja::BinaryView bv{handle};
+
+    if (bv.GetTypeName() != "MachO-KC") {
+        return false;
+    }
+
+    auto bnSettings = BinaryNinja::Settings::Instance();
+    Utils::BinjaSettings settings {bv.GetObject(), bnSettings->GetObject()};
+
+    if (!settings.FunctionStartsEnabled()) {
+        BDLogInfo("skipping LC_FUNCTION_STARTS debug info import since it is disabled");
+        return false;
+    }
+
+    if (settings.DebugInfoCombinedImport()) {
+        BDLogInfo("skipping LC_FUNCTION_STARTS debug info import since combined debug info import is enabled");
+        return false;
+    }
+
+    return true;
+}
+
+template <typename ...Extra>
+struct DoParseDebugInfoImpl {
+    static bool Invoke(void *context, BNDebugInfo *debugInfoHandle, BNBinaryView *binaryViewHandle, Extra..., bool(progress)(void *, size_t, size_t), void *pctx) {
+        BN::BinaryView binaryView{binaryViewHandle};
+        BN::DebugInfo debugInfo{debugInfoHandle};
+        BinaryNinjaDebugInfoSink sink{debugInfo};
+
+        PluginFunctionStarts plugin{binaryView};
+        plugin.Load(sink, [&](size_t done, size_t total) {
+            return progress(pctx, done, total);
+        });
         return true;
     }
 };
@@ -25,11 +25,16 @@
 #include <binaryninjaapi.h>
 #include <binaryninjacore.h>
 #include <fmt/format.h>
+#include <taskflow/taskflow.hpp>
 
+#include <binja/utils/executor.h>
 #include <binja/utils/log.h>
+#include <binja/utils/metrics.h>
+#include <binja/utils/trace.h>
 #include <binja/utils/settings.h>
 
 #include "macho_task.h"
+#include "manifest.h"
 #include "plugin_macho.h"
 #include "source_finder.h"
 
@@ -41,7 +46,21 @@ using namespace llvm;
 namespace fs = std::filesystem;
 
 
-void PluginMacho::Load(BinaryNinja::DebugInfo &debugInfo, MachOImportProgressMonitor &monitor) {
+void PluginMacho::Load(DebugInfoSink &sink, MachOImportProgressMonitor &monitor) {
+    Utils::ReloadLogLevel();
+    Utils::Metrics::Instance().Reset();
+    tf::Taskflow taskflow;
+    taskflow.emplace([&](tf::Subflow &subflow) {
+        Load(subflow, sink, monitor);
+    });
+    Utils::RunAndWait(taskflow);
+    Utils::WriteMetricsReport(binaryView_);
+    Utils::WriteTraceEvents();
+    Utils::FlushSuppressedLogs();
+}
+
+void PluginMacho::Load(tf::Subflow &subflow, DebugInfoSink &sink, MachOImportProgressMonitor &monitor,
+                       const KDKManifest *manifest) {
     auto source = GetSymbolSource();
     if (!source) {
         BDLogDebug("skipping macho symbols import since valid source cannot be found");
@@ -65,11 +84,26 @@ void PluginMacho::Load(BinaryNinja::DebugInfo &debugInfo, MachOImportProgressMon
         BDLogDebug("skipping macho data variable symbols import since import data variables is disabled");
     }
 
-    auto machoObjects = SymbolSourceFinder{*source}.FindAllMachoObjects();
+    std::vector<fs::path> machoObjects;
+    if (manifest) {
+        machoObjects = manifest->ResolveObjects(KDKObjectKind::MachO, MachO::MachBinaryView{binaryView_}.ReadMachOHeaders());
+    } else if (settings.DebugInfoUseManifest()) {
+        fs::path manifestDirectory = settings.DebugInfoManifestDirectory().value_or(KDKManifest::DefaultDirectory().string());
+        try {
+            auto manifest = KDKManifest::Open(*source, manifestDirectory);
+            machoObjects = manifest.ResolveObjects(KDKObjectKind::MachO, MachO::MachBinaryView{binaryView_}.ReadMachOHeaders());
+        } catch (const Types::DecodeError &e) {
+            BDLogError("failed to open KDK manifest for {}, error: {}", source->string(), e.what());
+            return;
+        }
+    } else {
+        auto objects = SymbolSourceFinder{*source}.FindAllMachoObjects();
+        machoObjects.assign(objects.begin(), objects.end());
+    }
+
     BDLogInfo("found {} macho symbol sources at {}", machoObjects.size(), source->string());
-    MachOImportTask task{std::vector<fs::path>{machoObjects.begin(), machoObjects.end()},
-                         binaryView_, debugInfo, options, monitor};
-    task.Import();
+    MachOImportTask task{machoObjects, binaryView_, sink, options, monitor};
+    task.Import(subflow);
 }
 
 std::optional<fs::path> PluginMacho::GetSymbolSource() {
@@ -134,6 +168,11 @@ bool IsValidForBinaryView(void *context, BNBinaryView *handle) {
         return false;
     }
 
+    if (settings.DebugInfoCombinedImport()) {
+        BDLogInfo("skipping Mach-O debug info import since combined debug info import is enabled");
+        return false;
+    }
+
     PluginMacho plugin{bv};
     if (plugin.GetSymbolSource()) {
         return true;
@@ -149,9 +188,10 @@ struct DoParseDebugInfoImpl {
         BinaryNinja::DebugInfo debugInfo{debugInfoHandle};
         BinaryNinja::BinaryView binaryView{binaryViewHandle};
 
+        BinaryNinjaDebugInfoSink sink{debugInfo};
         PluginMacho plugin{binaryView};
         ImportProgressMonitor monitor{progress, pctx};
-        plugin.Load(debugInfo, monitor);
+        plugin.Load(sink, monitor);
         return true;
     }
 };
@@ -0,0 +1,363 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <tuple>
+
+#include <fmt/format.h>
+
+#include <binja/macho/macho.h>
+#include <binja/utils/log.h>
+#include <binja/utils/metrics.h>
+#include <binja/utils/settings.h>
+
+#include "dwarf_task.h"
+#include "manifest.h"
+#include "plugin_dsym.h"
+#include "plugin_source_lines.h"
+
+using namespace Binja;
+using namespace DebugInfo;
+
+namespace fs = std::filesystem;
+
+
+/// Index registry
+
+namespace {
+
+/// Keeps line and inline indexes for as long as the view they were built for
+class IndexRegistry : public BinaryNinja::ObjectDestructionNotification {
+public:
+    static IndexRegistry &Instance() {
+        // Views may be destroyed during shutdown, after static destructors ran
+        static auto *registry = new IndexRegistry;
+        return *registry;
+    }
+
+    template<typename Index>
+    std::shared_ptr<const Index> Find(BNBinaryView *view) {
+        std::lock_guard lock{mutex_};
+        auto it = indexes_.find(view);
+        return it != indexes_.end() ? std::get<std::shared_ptr<const Index>>(it->second) : nullptr;
+    }
+
+    template<typename Index>
+    void Add(BNBinaryView *view, std::shared_ptr<const Index> index) {
+        std::lock_guard lock{mutex_};
+        std::get<std::shared_ptr<const Index>>(indexes_[view]) = std::move(index);
+    }
+
+    void DestructBinaryView(BinaryNinja::BinaryView *view) override {
+        std::lock_guard lock{mutex_};
+        indexes_.erase(view->GetObject());
+    }
+
+private:
+    IndexRegistry() {
+        BinaryNinja::RegisterObjectDestructionNotification(this);
+    }
+
+    using ViewIndexes = std::tuple<std::shared_ptr<const LineIndex>, std::shared_ptr<const InlineIndex>>;
+
+    std::mutex mutex_;
+    std::map<BNBinaryView *, ViewIndexes> indexes_;
+};
+
+// Hashes everything the slid addresses of an index depend on
+uint64_t HashIndexInputs(const std::vector<fs::path> &dwarfObjects,
+                         const std::map<Types::UUID, std::vector<MachO::Segment>> &targets) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    auto update = [&](const void *data, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ static_cast<const uint8_t *>(data)[i]) * 0x100000001b3ULL;
+        }
+    };
+    for (const auto &object: dwarfObjects) {
+        std::string path = object.string();
+        update(path.data(), path.size());
+        std::error_code ec;
+        uint64_t size = fs::file_size(object, ec);
+        int64_t modificationTime = fs::last_write_time(object, ec).time_since_epoch().count();
+        update(&size, sizeof(size));
+        update(&modificationTime, sizeof(modificationTime));
+    }
+    for (const auto &[uuid, segments]: targets) {
+        update(uuid.data, sizeof(uuid.data));
+        for (const auto &segment: segments) {
+            update(&segment.vaStart, sizeof(segment.vaStart));
+            update(&segment.vaLength, sizeof(segment.vaLength));
+        }
+    }
+    return hash;
+}
+
+struct IndexSource {
+    std::vector<fs::path> dwarfObjects;
+    fs::path cacheDirectory;
+    uint64_t hash;
+};
+
+std::optional<IndexSource> FindIndexSource(BinaryNinja::BinaryView &binaryView) {
+    auto bnSettings = BinaryNinja::Settings::Instance();
+    Utils::BinjaSettings settings {binaryView.GetObject(), bnSettings->GetObject()};
+    if (!settings.DWARFEnabled()) {
+        BDLogError("source lines need dwarf debug info to be enabled");
+        return std::nullopt;
+    }
+
+    PluginDSYM plugin{binaryView};
+    auto source = plugin.GetSymbolSource();
+    if (!source) {
+        BDLogError("no dwarf symbols source found for source lines");
+        return std::nullopt;
+    }
+    auto dwarfObjects = plugin.FindDwarfObjects(*source);
+    if (!dwarfObjects || dwarfObjects->empty()) {
+        BDLogError("no dwarf objects matching the binary view found at {}", source->string());
+        return std::nullopt;
+    }
+
+    auto targets = MachO::MachBinaryView{binaryView}.ReadMachOHeaders();
+    return IndexSource{
+        .dwarfObjects = *dwarfObjects,
+        .cacheDirectory = settings.DebugInfoManifestDirectory().value_or(KDKManifest::DefaultDirectory().string()),
+        .hash = HashIndexInputs(*dwarfObjects, targets)};
+}
+
+void ReportProgress(BinaryNinja::BackgroundTask *task, std::string_view text, std::string_view kind) {
+    if (task) {
+        task->SetProgressText(fmt::format("binja_kc: {} {}", text, kind));
+    }
+}
+
+// Opens the index cached in the manifest directory, or builds and saves it
+template<typename Index>
+std::shared_ptr<const Index> LoadIndex(BinaryNinja::BinaryView &binaryView, BinaryNinja::BackgroundTask *task,
+                                       std::string_view kind, std::string_view filePrefix) {
+    ReportProgress(task, "locating DWARF objects for", kind);
+    auto source = FindIndexSource(binaryView);
+    if (!source) {
+        return nullptr;
+    }
+    fs::path cachePath = source->cacheDirectory /
+                         fmt::format("{}-v{}-{:016x}.bin", filePrefix, Index::kVersion, source->hash);
+
+    Utils::ScopedPhase phase{"dwarf.source_lines"};
+    if (fs::exists(cachePath)) {
+        ReportProgress(task, "opening cached", kind);
+        try {
+            auto index = std::make_shared<Index>(Index::Open(cachePath));
+            phase.Add(Utils::Counter::CacheHits);
+            BDLogInfo("using {} {}, {} bytes", kind, cachePath.string(), index->GetSizeInBytes());
+            return index;
+        } catch (const Types::DecodeError &e) {
+            BDLogWarn("ignoring invalid {} {}, error: {}", kind, cachePath.string(), e.what());
+        } catch (const DwarfError &e) {
+            BDLogWarn("ignoring invalid {} {}, error: {}", kind, cachePath.string(), e.what());
+        }
+    }
+
+    std::shared_ptr<Index> index;
+    try {
+        ReportProgress(task, "reading DWARF objects for", kind);
+        DwarfContextWrapper dwarfContext = DwarfImportTask::BuildDwarfContext(source->dwarfObjects, binaryView);
+        ReportProgress(task, "building", kind);
+        index = std::make_shared<Index>(Index::Build(dwarfContext));
+    } catch (const Types::DecodeError &e) {
+        BDLogError("failed to build {}, error: {}", kind, e.what());
+        return nullptr;
+    } catch (const DwarfError &e) {
+        BDLogError("failed to build {}, error: {}", kind, e.what());
+        return nullptr;
+    }
+
+    ReportProgress(task, "saving", kind);
+    try {
+        fs::create_directories(source->cacheDirectory);
+        index->Save(cachePath);
+    } catch (const fs::filesystem_error &e) {
+        BDLogWarn("failed to save {} {}, error: {}", kind, cachePath.string(), e.what());
+    }
+    return index;
+}
+
+template<typename Index>
+std::shared_ptr<const Index> GetIndex(BinaryNinja::BinaryView &binaryView, BinaryNinja::BackgroundTask *task,
+                                      std::string_view kind, std::string_view filePrefix) {
+    if (auto index = IndexRegistry::Instance().Find<Index>(binaryView.GetObject())) {
+        return index;
+    }
+    // Commands issued while an index is built wait for it instead of
+    // building it again
+    static std::mutex buildMutex;
+    std::lock_guard lock{buildMutex};
+    if (auto index = IndexRegistry::Instance().Find<Index>(binaryView.GetObject())) {
+        return index;
+    }
+    auto index = LoadIndex<Index>(binaryView, task, kind, filePrefix);
+    if (index) {
+        IndexRegistry::Instance().Add<Index>(binaryView.GetObject(), index);
+    }
+    return index;
+}
+
+}// namespace
+
+
+/// Source lines plugin
+
+std::shared_ptr<const LineIndex> PluginSourceLines::GetLineIndex() {
+    return GetIndex<LineIndex>(binaryView_, task_, "line index", "lines");
+}
+
+std::shared_ptr<const InlineIndex> PluginSourceLines::GetInlineIndex() {
+    return GetIndex<InlineIndex>(binaryView_, task_, "inline index", "inlines");
+}
+
+
+/// Binary ninja plugin API
+
+namespace {
+
+std::string FormatInlineFrame(const InlineFrame &frame) {
+    if (frame.callFile.empty()) {
+        return fmt::format("inlined {}", frame.function);
+    }
+    return fmt::format("inlined {} at {}:{}", frame.function, frame.callFile, frame.callLine);
+}
+
+// Runs `command` on its own thread with a background task reporting the
+// progress, indexes may have to be built from the DWARF objects first
+void RunInBackground(BinaryNinja::BinaryView *view, const std::string &title,
+                     std::function<void(PluginSourceLines &)> command) {
+    BinaryNinja::Ref<BinaryNinja::BinaryView> viewRef = view;
+    BinaryNinja::Ref<BinaryNinja::BackgroundTask> task = new BinaryNinja::BackgroundTask{title, false};
+    std::thread{[viewRef, task, command = std::move(command)] {
+        // Exceptions must not escape the thread
+        try {
+            PluginSourceLines plugin{*viewRef, task.GetPtr()};
+            command(plugin);
+        } catch (const std::exception &e) {
+            BDLogError("source lines command failed, error: {}", e.what());
+        }
+        task->Finish();
+    }}.detach();
+}
+
+void ShowSourceLine(PluginSourceLines &plugin, uint64_t address) {
+    auto index = plugin.GetLineIndex();
+    if (!index) {
+        return;
+    }
+    if (auto location = index->Lookup(address)) {
+        BDLogInfo("{:#016x} {}:{}", address, location->file, location->line);
+    } else {
+        BDLogInfo("{:#016x} has no source line", address);
+    }
+}
+
+void ShowInlineFrames(PluginSourceLines &plugin, uint64_t address) {
+    auto index = plugin.GetInlineIndex();
+    if (!index) {
+        return;
+    }
+    std::vector<InlineFrame> frames;
+    index->Lookup(address, frames);
+    if (frames.empty()) {
+        BDLogInfo("{:#016x} is not in an inlined function", address);
+        return;
+    }
+    for (const auto &frame: frames) {
+        BDLogInfo("{:#016x} {}", address, FormatInlineFrame(frame));
+    }
+}
+
+void AnnotateFunction(PluginSourceLines &plugin, BinaryNinja::Function *function) {
+    auto lineIndex = plugin.GetLineIndex();
+    if (!lineIndex) {
+        return;
+    }
+    auto inlineIndex = plugin.GetInlineIndex();
+
+    // Comments of an address are collected from both indexes before they are set
+    std::map<uint64_t, std::string> comments;
+    for (const auto &block: function->GetBasicBlocks()) {
+        lineIndex->VisitRange(block->GetStart(), block->GetEnd(), [&](uint64_t address, const LineLocation &location) {
+            comments[address] = fmt::format("{}:{}", location.file, location.line);
+        });
+        if (!inlineIndex) {
+            continue;
+        }
+        inlineIndex->VisitRange(block->GetStart(), block->GetEnd(), [&](uint64_t address, const std::vector<InlineFrame> &frames) {
+            std::string &comment = comments[address];
+            for (const auto &frame: frames) {
+                if (!comment.empty()) {
+                    comment.push_back('\n');
+                }
+                comment.append(FormatInlineFrame(frame));
+            }
+        });
+    }
+
+    size_t numComments = 0;
+    for (const auto &[address, comment]: comments) {
+        // Existing comments are kept
+        if (!function->GetCommentForAddress(address).empty()) {
+            continue;
+        }
+        function->SetCommentForAddress(address, comment);
+        ++numComments;
+    }
+    BDLogInfo("added {} source line comments to function at {:#016x}", numComments, function->GetStart());
+}
+
+}// namespace
+
+void PluginSourceLines::RegisterPlugin() {
+    BinaryNinja::PluginCommand::RegisterForAddress(
+        "binja_kc\\Source Lines\\Show Source Line",
+        "Logs the DWARF source line of the address",
+        [](BinaryNinja::BinaryView *view, uint64_t address) {
+            RunInBackground(view, "binja_kc: looking up source line", [address](PluginSourceLines &plugin) {
+                ShowSourceLine(plugin, address);
+            });
+        });
+    BinaryNinja::PluginCommand::RegisterForFunction(
+        "binja_kc\\Source Lines\\Annotate Function",
+        "Adds comments with the DWARF source lines of the function",
+        [](BinaryNinja::BinaryView *view, BinaryNinja::Function *function) {
+            BinaryNinja::Ref<BinaryNinja::Function> functionRef = function;
+            RunInBackground(view, "binja_kc: annotating function", [functionRef](PluginSourceLines &plugin) {
+                AnnotateFunction(plugin, functionRef);
+            });
+        });
+    BinaryNinja::PluginCommand::RegisterForAddress(
+        "binja_kc\\Source Lines\\Show Inline Frames",
+        "Logs the DWARF inlined functions covering the address, innermost first",
+        [](BinaryNinja::BinaryView *view, uint64_t address) {
+            RunInBackground(view, "binja_kc: looking up inline frames", [address](PluginSourceLines &plugin) {
+                ShowInlineFrames(plugin, address);
+            });
+        });
+}
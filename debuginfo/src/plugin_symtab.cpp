@@ -19,12 +19,18 @@
 // SOFTWARE.
 
 
-#include <llvm/Demangle/ItaniumDemangle.h>
+#include <algorithm>
 #include <type_traits>
 
+#include <taskflow/taskflow.hpp>
+
 #include <binja/macho/macho.h>
 #include <binja/utils/demangle.h>
+#include <binja/utils/executor.h>
 #include <binja/utils/log.h>
+#include <binja/utils/metrics.h>
+#include <binja/utils/trace.h>
+#include <binja/utils/segment_table.h>
 #include <binja/utils/settings.h>
 
 #include "plugin_symtab.h"
@@ -33,84 +39,144 @@ using namespace Binja;
 using namespace DebugInfo;
 
 namespace BN = BinaryNinja;
-namespace LD = llvm::itanium_demangle;
-
-// LLVM demangler
 
 namespace {
-class BumpPointerAllocator {
-    struct BlockMeta {
-        BlockMeta* Next;
-        size_t Current;
-    };
 
-    static constexpr size_t AllocSize = 4096;
-    static constexpr size_t UsableAllocSize = AllocSize - sizeof(BlockMeta);
+// Names demangled per task, each task records its own metrics phase
+constexpr size_t kDemangleChunkSize = 1024;
+
+BN::DebugFunctionInfo ParseFunctionInfo(const MachO::Symbol &symbol, const std::optional<Utils::DemangledName> &demangled) {
+    if (demangled && demangled->isFunction) {
+        return BN::DebugFunctionInfo{
+            demangled->shortName,
+            demangled->fullName,
+            symbol.name,
+            symbol.addr,
+            nullptr,
+            nullptr,
+            {},
+            {}
+        };
+    }
 
-    alignas(long double) char InitialBuffer[AllocSize];
-    BlockMeta* BlockList = nullptr;
+    return BN::DebugFunctionInfo {
+        symbol.name,
+        symbol.name,
+        symbol.name,
+        symbol.addr,
+        nullptr,
+        nullptr,
+        {},
+        {}
+    };
+}
 
-    void grow() {
-        char* NewMeta = static_cast<char *>(std::malloc(AllocSize));
-        if (NewMeta == nullptr)
-            std::terminate();
-        BlockList = new (NewMeta) BlockMeta{BlockList, 0};
-    }
+}// namespace
 
-    void* allocateMassive(size_t NBytes) {
-        NBytes += sizeof(BlockMeta);
-        BlockMeta* NewMeta = reinterpret_cast<BlockMeta*>(std::malloc(NBytes));
-        if (NewMeta == nullptr)
-            std::terminate();
-        BlockList->Next = new (NewMeta) BlockMeta{BlockList->Next, 0};
-        return static_cast<void*>(NewMeta + 1);
-    }
+void PluginSymtab::Load(DebugInfoSink &sink, const std::function<bool(size_t, size_t)> &progress) {
+    Utils::ReloadLogLevel();
+    Utils::Metrics::Instance().Reset();
+    tf::Taskflow taskflow;
+    taskflow.emplace([&](tf::Subflow &subflow) {
+        Load(subflow, sink, progress);
+    });
+    Utils::RunAndWait(taskflow);
+    Utils::WriteMetricsReport(binaryView_);
+    Utils::WriteTraceEvents();
+    Utils::FlushSuppressedLogs();
+}
 
-public:
-    BumpPointerAllocator()
-        : BlockList(new (InitialBuffer) BlockMeta{nullptr, 0}) {}
+void PluginSymtab::Load(tf::Subflow &subflow, DebugInfoSink &sink, const std::function<bool(size_t, size_t)> &progress) {
+    BN::Ref<BN::BinaryView> rawView = binaryView_.GetParentView();
 
-    void* allocate(size_t N) {
-        N = (N + 15u) & ~15u;
-        if (N + BlockList->Current >= UsableAllocSize) {
-            if (N > UsableAllocSize)
-                return allocateMassive(N);
-            grow();
-        }
-        BlockList->Current += N;
-        return static_cast<void*>(reinterpret_cast<char*>(BlockList + 1) +
-                                   BlockList->Current - N);
-    }
+    auto bnSettings = BinaryNinja::Settings::Instance();
+    Utils::BinjaSettings settings {binaryView_.GetObject(), bnSettings->GetObject()};
+    bool loadFunctions = settings.SymtabLoadFunctions();
+    bool loadDataVariables = settings.SymtabLoadDataVariables();
 
-    void reset() {
-        while (BlockList) {
-            BlockMeta* Tmp = BlockList;
-            BlockList = BlockList->Next;
-            if (reinterpret_cast<char*>(Tmp) != InitialBuffer)
-                std::free(Tmp);
-        }
-        BlockList = new (InitialBuffer) BlockMeta{nullptr, 0};
+    if (!loadFunctions) {
+        BDLogInfo("functions debug info import from KC SYMTAB is disabled");
     }
 
-    ~BumpPointerAllocator() { reset(); }
-};
-
-class DefaultAllocator {
-    BumpPointerAllocator Alloc;
+    if (!loadDataVariables) {
+        BDLogInfo("data variables debug info import from KC SYMTAB is disabled");
+    }
 
-public:
-    void reset() { Alloc.reset(); }
+    Utils::SegmentTable segmentTable = Utils::SegmentTable::FromBinaryView(binaryView_);
+    MachO::MachBinaryViewDataBackend dataBackend{*rawView};
+
+    std::vector<MachO::Fileset> filesets = MachO::MachHeaderParser{dataBackend, 0}.DecodeFilesets();
+    std::vector<std::vector<MachO::Symbol>> filesetSymbols(filesets.size());
+    tf::Task decode = subflow.for_each_index(size_t{0}, filesets.size(), size_t{1}, [&](size_t i) {
+        Utils::ScopedPhase phase{"symtab.decode_symbols"};
+        MachO::MachHeaderParser parser{dataBackend, filesets[i].fileOffset};
+        filesetSymbols[i] = parser.DecodeSymbols();
+    }).name("symtab_decode_symbols");
+
+    // Demangle names of all filesets in a single pass so that the work is
+    // spread across threads and names shared between kexts are parsed once
+    std::vector<std::string_view> mangledNames;
+    std::vector<std::optional<Utils::DemangledName>> demangledNames;
+    Utils::DemangleCache demangleCache;
+    tf::Task collectNames = subflow.emplace([&] {
+        if (!loadFunctions) {
+            return;
+        }
+        for (const auto &symbols: filesetSymbols) {
+            for (const auto &symbol: symbols) {
+                if (symbol.name.starts_with("_Z")) {
+                    mangledNames.emplace_back(symbol.name);
+                }
+            }
+        }
+        demangledNames.resize(mangledNames.size());
+    }).name("symtab_collect_mangled_names");
+
+    tf::Task demangle = subflow.emplace([&](tf::Subflow &demangleFlow) {
+        demangleFlow.for_each_index(size_t{0}, mangledNames.size(), kDemangleChunkSize, [&](size_t begin) {
+            Utils::ScopedPhase phase{"symtab.demangle"};
+            size_t end = std::min(begin + kDemangleChunkSize, mangledNames.size());
+            for (size_t i = begin; i < end; ++i) {
+                demangledNames[i] = Utils::DemangleName(mangledNames[i], &demangleCache);
+            }
+        });
+        demangleFlow.join();
+        BDLogDebug("demangled {} symbol names, {} unique", mangledNames.size(), demangleCache.Size());
+    }).name("symtab_demangle");
+
+    tf::Task emit = subflow.emplace([&] {
+        Utils::ScopedPhase phase{"symtab.emit_symbols"};
+        size_t demangledIndex = 0;
+        for (size_t i=0; i<filesets.size(); ++i) {
+            for (auto &symbol: filesetSymbols[i]) {
+                std::optional<Utils::DemangledName> demangled;
+                if (loadFunctions && symbol.name.starts_with("_Z")) {
+                    demangled = std::move(demangledNames[demangledIndex++]);
+                }
 
-    template<typename T, typename ...Args> T *makeNode(Args &&...args) {
-        return new (Alloc.allocate(sizeof(T)))
-            T(std::forward<Args>(args)...);
-    }
+                const Utils::SegmentRange *segment = segmentTable.Find(symbol.addr);
+                if (!segment) {
+                    BDLogDebug("ignoring nlist_64 entry, n_value {:#016x} is not in any segment", symbol.addr);
+                    continue;
+                }
+                bool isFunction = segment->ContainsCode();
+                if (isFunction && loadFunctions) {
+                    sink.AddFunction(ParseFunctionInfo(symbol, demangled));
+                    phase.Add(Utils::Counter::SymbolsAdded);
+                } else if (loadDataVariables) {
+                    sink.AddDataVariable(symbol.addr, BN::Type::VoidType(), symbol.name);
+                    phase.Add(Utils::Counter::SymbolsAdded);
+                }
+            }
+            progress(i, filesets.size());
+        }
+    }).name("symtab_emit");
 
-    void *allocateNodeArray(size_t sz) {
-        return Alloc.allocate(sizeof(LD::Node *) * sz);
-    }
-};
-}  // unnamed namespace
+    decode.precede(collectNames);
+    collectNames.precede(demangle);
+    demangle.precede(emit);
+    subflow.join();
+}
 
 /// Binary ninja plugin API
 
@@ -131,114 +197,25 @@ bool IsValidForBinaryView(void *context, BNBinaryView *handle) {
         return false;
     }
 
-    return true;
-}
-
-std::string NodeToString(const LD::Node* node) {
-    LD::OutputBuffer buffer;
-    LD::initializeOutputBuffer(nullptr, nullptr, buffer, 512);
-    node->print(buffer);
-    std::string result {buffer.getBuffer(), buffer.getCurrentPosition()};
-    free(buffer.getBuffer());
-    return result;
-}
-
-std::optional<BN::DebugFunctionInfo> ParseMangledFunctionInfo(const MachO::Symbol& symbol) {
-    std::string name = symbol.name;
-
-    bool isMangled = name.starts_with("_Z");
-    if (!isMangled) {
-        return std::nullopt;
-    }
-
-    LD::ManglingParser<DefaultAllocator> parser{
-        name.c_str(),
-        name.c_str() + name.size()
-    };
-
-    LD::Node* root = parser.parse();
-    if (!root) {
-        return std::nullopt;
-    }
-
-    if (root->getKind() != LD::Node::KFunctionEncoding) {
-        return std::nullopt;
-    }
-
-    auto* func = static_cast<LD::FunctionEncoding*>(root);
-    std::string functionName = NodeToString(func->getName());
-    return BN::DebugFunctionInfo{
-        functionName,
-        Utils::Demangle(name),
-        name,
-        symbol.addr,
-        nullptr,
-        nullptr,
-        {},
-        {}
-    };
-}
-
-BN::DebugFunctionInfo ParseFunctionInfo(const MachO::Symbol& symbol) {
-    if (auto info = ParseMangledFunctionInfo(symbol)) {
-        return *info;
+    if (settings.DebugInfoCombinedImport()) {
+        BDLogInfo("skipping KC SYMTAB debug info import since combined debug info import is enabled");
+        return false;
     }
 
-    std::string name = symbol.name;
-
-    return BN::DebugFunctionInfo {
-        name,
-        name,
-        name,
-        symbol.addr,
-        nullptr,
-        nullptr,
-        {},
-        {}
-    };
+    return true;
 }
 
 template <typename ...Extra>
 struct DoParseDebugInfoImpl {
     static bool Invoke(void *context, BNDebugInfo *debugInfoHandle, BNBinaryView *binaryViewHandle, Extra..., bool(progress)(void *, size_t, size_t), void *pctx) {
         BN::BinaryView binaryView{binaryViewHandle};
-        BN::Ref<BN::BinaryView> rawView = binaryView.GetParentView();
-
-        auto bnSettings = BinaryNinja::Settings::Instance();
-        Utils::BinjaSettings settings {binaryView.GetObject(), bnSettings->GetObject()};
-
-        if (!settings.SymtabLoadFunctions()) {
-            BDLogInfo("functions debug info import from KC SYMTAB is disabled");
-        }
-
-        if (!settings.SymtabLoadDataVariables()) {
-            BDLogInfo("data variables debug info import from KC SYMTAB is disabled");
-        }
-
         BN::DebugInfo debugInfo{debugInfoHandle};
-        MachO::MachBinaryViewDataBackend dataBackend{*rawView};
-
-        std::vector<MachO::Fileset> filesets = MachO::MachHeaderParser{dataBackend, 0}.DecodeFilesets();
-        for (size_t i=0; i<filesets.size(); ++i) {
-            MachO::Fileset &fileset = filesets[i];
-            MachO::MachHeaderParser parser{dataBackend, fileset.fileOffset};
-            std::vector<MachO::Symbol> symbols = parser.DecodeSymbols();
+        BinaryNinjaDebugInfoSink sink{debugInfo};
 
-            for (auto &symbol: symbols) {
-                BN::Ref<BN::Segment> segment = binaryView.GetSegmentAt(symbol.addr);
-                if (!segment) {
-                    BDLogDebug("ignoring nlist_64 entry, n_value {:#016x} is not in any segment", symbol.addr);
-                    continue;
-                }
-                bool isFunction = segment->GetFlags() & BNSegmentFlag::SegmentContainsCode;
-                if (isFunction && settings.SymtabLoadFunctions()) {
-                    debugInfo.AddFunction(ParseFunctionInfo(symbol));
-                } else if (settings.SymtabLoadDataVariables()) {
-                    debugInfo.AddDataVariable(symbol.addr, BN::Type::VoidType(), symbol.name);
-                }
-            }
-            progress(pctx, i, filesets.size());
-        }
+        PluginSymtab plugin{binaryView};
+        plugin.Load(sink, [&](size_t done, size_t total) {
+            return progress(pctx, done, total);
+        });
         return true;
     }
 };
@@ -0,0 +1,563 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <cstring>
+
+#include <llvm/DebugInfo/DWARF/DWARFContext.h>
+#include <llvm/DebugInfo/DWARF/DWARFUnit.h>
+
+#include <binja/utils/log.h>
+
+#include "errors.h"
+#include "scanner.h"
+
+using namespace Binja;
+using namespace DebugInfo;
+
+namespace DW = llvm::dwarf;
+
+
+/// Raw section reader
+
+namespace {
+
+class ScanError : public DwarfError {
+    using DwarfError::DwarfError;
+};
+
+class Cursor {
+public:
+    Cursor(llvm::StringRef data, uint64_t offset, uint64_t end)
+        : data_{reinterpret_cast<const uint8_t *>(data.data())},
+          offset_{offset},
+          end_{std::min<uint64_t>(end, data.size())} {
+        if (offset_ > end_) {
+            throw ScanError{"offset {:#x} is past the end {:#x}", offset_, end_};
+        }
+    }
+
+    [[nodiscard]] uint64_t Offset() const { return offset_; }
+    [[nodiscard]] bool AtEnd() const { return offset_ >= end_; }
+
+    uint64_t ReadUInt(size_t size) {
+        VerifyAvailable(size);
+        uint64_t value = 0;
+        for (size_t i = 0; i < size; ++i) {
+            value |= uint64_t{data_[offset_ + i]} << (i * 8);
+        }
+        offset_ += size;
+        return value;
+    }
+
+    uint64_t ReadULEB128() {
+        uint64_t value = 0;
+        unsigned shift = 0;
+        while (true) {
+            VerifyAvailable(1);
+            uint8_t byte = data_[offset_++];
+            if (shift < 64) {
+                value |= uint64_t{byte & 0x7fu} << shift;
+            }
+            if (!(byte & 0x80)) {
+                return value;
+            }
+            shift += 7;
+        }
+    }
+
+    void SkipLEB128() {
+        while (true) {
+            VerifyAvailable(1);
+            if (!(data_[offset_++] & 0x80)) {
+                return;
+            }
+        }
+    }
+
+    void SkipCString() {
+        const void *terminator = std::memchr(data_ + offset_, 0, end_ - offset_);
+        if (!terminator) {
+            throw ScanError{"unterminated string at {:#x}", offset_};
+        }
+        offset_ = static_cast<const uint8_t *>(terminator) - data_ + 1;
+    }
+
+    void Skip(uint64_t size) {
+        VerifyAvailable(size);
+        offset_ += size;
+    }
+
+private:
+    void VerifyAvailable(uint64_t size) const {
+        if (size > end_ - offset_) {
+            throw ScanError{"read of {} bytes at {:#x} is past the end {:#x}", size, offset_, end_};
+        }
+    }
+
+    const uint8_t *data_;
+    uint64_t offset_;
+    uint64_t end_;
+};
+
+std::string_view ReadCString(llvm::StringRef section, uint64_t offset) {
+    if (offset >= section.size()) {
+        throw ScanError{"string offset {:#x} is past the end of the string section", offset};
+    }
+    const char *begin = section.data() + offset;
+    const void *terminator = std::memchr(begin, 0, section.size() - offset);
+    if (!terminator) {
+        throw ScanError{"unterminated string at {:#x}", offset};
+    }
+    return std::string_view{begin, static_cast<size_t>(static_cast<const char *>(terminator) - begin)};
+}
+
+enum class Column : uint8_t {
+    Name,
+    Specification,
+    AbstractOrigin,
+    LowPC,
+    Ranges,
+    EntryPC,
+    LocationAddress,
+};
+
+std::optional<Column> GetColumn(const DieScanFields &fields, DW::Attribute attribute) {
+    switch (attribute) {
+        case DW::DW_AT_name:
+            return fields.name ? std::optional{Column::Name} : std::nullopt;
+        case DW::DW_AT_specification:
+            return fields.references ? std::optional{Column::Specification} : std::nullopt;
+        case DW::DW_AT_abstract_origin:
+            return fields.references ? std::optional{Column::AbstractOrigin} : std::nullopt;
+        case DW::DW_AT_low_pc:
+            return fields.entryPoint ? std::optional{Column::LowPC} : std::nullopt;
+        case DW::DW_AT_ranges:
+            return fields.entryPoint ? std::optional{Column::Ranges} : std::nullopt;
+        case DW::DW_AT_entry_pc:
+            return fields.entryPoint ? std::optional{Column::EntryPC} : std::nullopt;
+        case DW::DW_AT_location:
+            return fields.locationAddress ? std::optional{Column::LocationAddress} : std::nullopt;
+        default:
+            return std::nullopt;
+    }
+}
+
+}// namespace
+
+
+/// Abbreviation plans
+
+struct DwarfScanner::AbbreviationPlan {
+    enum class StepKind : uint8_t {
+        // Skips a run of fixed size attributes
+        Skip,
+        // Skips one variable size attribute
+        SkipForm,
+        Read,
+    };
+
+    struct Step {
+        StepKind kind;
+        DW::Form form;
+        Column column;
+        uint32_t size;
+    };
+
+    DW::Tag tag;
+    bool hasChildren;
+    std::vector<Step> steps;
+};
+
+struct DwarfScanner::AbbreviationTable {
+    // Abbreviation codes are usually numbered from 1 without gaps
+    std::vector<AbbreviationPlan> dense;
+    std::map<uint64_t, AbbreviationPlan> sparse;
+
+    [[nodiscard]] const AbbreviationPlan &Find(uint64_t code) const {
+        if (code - 1 < dense.size()) {
+            return dense[code - 1];
+        }
+        auto it = sparse.find(code);
+        if (it == sparse.end()) {
+            throw ScanError{"undefined abbreviation code {}", code};
+        }
+        return it->second;
+    }
+};
+
+DwarfScanner::DwarfScanner(DieScanFields fields)
+    : fields_{fields} {}
+
+DwarfScanner::~DwarfScanner() = default;
+
+const DwarfScanner::AbbreviationTable *DwarfScanner::GetAbbreviationTable(const DwarfUnitWrapper &unit) {
+    llvm::DWARFUnit &llvmUnit = unit.GetUnit();
+    DW::FormParams params = llvmUnit.getFormParams();
+    TableKey key{&llvmUnit.getContext(), llvmUnit.getAbbreviationsOffset(),
+                 params.Version, params.AddrSize, static_cast<uint8_t>(params.Format)};
+    auto &table = tables_[key];
+    if (table) {
+        return table.get();
+    }
+
+    using StepKind = AbbreviationPlan::StepKind;
+    auto newTable = std::make_unique<AbbreviationTable>();
+    llvm::StringRef section = llvmUnit.getContext().getDWARFObj().getAbbrevSection();
+    Cursor cursor{section, llvmUnit.getAbbreviationsOffset(), section.size()};
+    while (uint64_t code = cursor.ReadULEB128()) {
+        AbbreviationPlan plan;
+        plan.tag = static_cast<DW::Tag>(cursor.ReadULEB128());
+        plan.hasChildren = cursor.ReadUInt(1) == DW::DW_CHILDREN_yes;
+
+        uint32_t pendingSkip = 0;
+        auto flushSkip = [&] {
+            if (pendingSkip) {
+                plan.steps.push_back({StepKind::Skip, DW::Form{}, Column{}, pendingSkip});
+                pendingSkip = 0;
+            }
+        };
+        while (true) {
+            auto attribute = static_cast<DW::Attribute>(cursor.ReadULEB128());
+            auto form = static_cast<DW::Form>(cursor.ReadULEB128());
+            if (attribute == 0 && form == 0) {
+                break;
+            }
+            if (form == DW::DW_FORM_implicit_const) {
+                // The value lives in the abbreviation, the DIE holds no bytes
+                cursor.SkipLEB128();
+            }
+            if (auto column = GetColumn(fields_, attribute)) {
+                flushSkip();
+                plan.steps.push_back({StepKind::Read, form, *column, 0});
+            } else if (auto size = DW::getFixedFormByteSize(form, params)) {
+                pendingSkip += *size;
+            } else {
+                flushSkip();
+                plan.steps.push_back({StepKind::SkipForm, form, Column{}, 0});
+            }
+        }
+        flushSkip();
+
+        if (code == newTable->dense.size() + 1) {
+            newTable->dense.push_back(std::move(plan));
+        } else {
+            newTable->sparse.emplace(code, std::move(plan));
+        }
+    }
+
+    table = std::move(newTable);
+    return table.get();
+}
+
+
+/// Scanner
+
+namespace {
+
+void SkipForm(Cursor &cursor, DW::Form form, const DW::FormParams &params) {
+    switch (form) {
+        case DW::DW_FORM_udata:
+        case DW::DW_FORM_sdata:
+        case DW::DW_FORM_ref_udata:
+        case DW::DW_FORM_strx:
+        case DW::DW_FORM_addrx:
+        case DW::DW_FORM_loclistx:
+        case DW::DW_FORM_rnglistx:
+        case DW::DW_FORM_GNU_addr_index:
+        case DW::DW_FORM_GNU_str_index:
+            cursor.SkipLEB128();
+            return;
+        case DW::DW_FORM_string:
+            cursor.SkipCString();
+            return;
+        case DW::DW_FORM_block1:
+            cursor.Skip(cursor.ReadUInt(1));
+            return;
+        case DW::DW_FORM_block2:
+            cursor.Skip(cursor.ReadUInt(2));
+            return;
+        case DW::DW_FORM_block4:
+            cursor.Skip(cursor.ReadUInt(4));
+            return;
+        case DW::DW_FORM_block:
+        case DW::DW_FORM_exprloc:
+            cursor.Skip(cursor.ReadULEB128());
+            return;
+        case DW::DW_FORM_indirect:
+            SkipForm(cursor, static_cast<DW::Form>(cursor.ReadULEB128()), params);
+            return;
+        default:
+            break;
+    }
+    if (auto size = DW::getFixedFormByteSize(form, params)) {
+        cursor.Skip(*size);
+        return;
+    }
+    throw ScanError{"unsupported form {:#x}", static_cast<uint32_t>(form)};
+}
+
+std::optional<uint64_t> ReadBlockLength(Cursor &cursor, DW::Form form) {
+    switch (form) {
+        case DW::DW_FORM_block1:
+            return cursor.ReadUInt(1);
+        case DW::DW_FORM_block2:
+            return cursor.ReadUInt(2);
+        case DW::DW_FORM_block4:
+            return cursor.ReadUInt(4);
+        case DW::DW_FORM_block:
+        case DW::DW_FORM_exprloc:
+            return cursor.ReadULEB128();
+        default:
+            return std::nullopt;
+    }
+}
+
+class DieDecoder {
+public:
+    DieDecoder(llvm::DWARFUnit &unit, Cursor &cursor)
+        : unit_{unit}, params_{unit.getFormParams()}, cursor_{cursor} {}
+
+    std::string_view ReadString(DW::Form form) {
+        switch (form) {
+            case DW::DW_FORM_string: {
+                uint64_t begin = cursor_.Offset();
+                cursor_.SkipCString();
+                llvm::StringRef info = unit_.getDebugInfoExtractor().getData();
+                return std::string_view{info.data() + begin, cursor_.Offset() - begin - 1};
+            }
+            case DW::DW_FORM_strp:
+                return ReadCString(unit_.getStringExtractor().getData(),
+                                   cursor_.ReadUInt(params_.getDwarfOffsetByteSize()));
+            case DW::DW_FORM_line_strp:
+                return ReadCString(unit_.getContext().getDWARFObj().getLineStrSection(),
+                                   cursor_.ReadUInt(params_.getDwarfOffsetByteSize()));
+            case DW::DW_FORM_strx:
+            case DW::DW_FORM_GNU_str_index:
+                return ReadIndexedString(cursor_.ReadULEB128());
+            case DW::DW_FORM_strx1:
+                return ReadIndexedString(cursor_.ReadUInt(1));
+            case DW::DW_FORM_strx2:
+                return ReadIndexedString(cursor_.ReadUInt(2));
+            case DW::DW_FORM_strx3:
+                return ReadIndexedString(cursor_.ReadUInt(3));
+            case DW::DW_FORM_strx4:
+                return ReadIndexedString(cursor_.ReadUInt(4));
+            default:
+                throw ScanError{"unsupported string form {:#x}", static_cast<uint32_t>(form)};
+        }
+    }
+
+    uint64_t ReadReference(DW::Form form) {
+        switch (form) {
+            case DW::DW_FORM_ref1:
+                return unit_.getOffset() + cursor_.ReadUInt(1);
+            case DW::DW_FORM_ref2:
+                return unit_.getOffset() + cursor_.ReadUInt(2);
+            case DW::DW_FORM_ref4:
+                return unit_.getOffset() + cursor_.ReadUInt(4);
+            case DW::DW_FORM_ref8:
+                return unit_.getOffset() + cursor_.ReadUInt(8);
+            case DW::DW_FORM_ref_udata:
+                return unit_.getOffset() + cursor_.ReadULEB128();
+            case DW::DW_FORM_ref_addr:
+                return cursor_.ReadUInt(params_.getRefAddrByteSize());
+            default:
+                throw ScanError{"unsupported reference form {:#x}", static_cast<uint32_t>(form)};
+        }
+    }
+
+    uint64_t ReadAddress(DW::Form form) {
+        switch (form) {
+            case DW::DW_FORM_addr:
+                return cursor_.ReadUInt(params_.AddrSize);
+            case DW::DW_FORM_addrx:
+            case DW::DW_FORM_GNU_addr_index:
+                return ReadIndexedAddress(cursor_.ReadULEB128());
+            case DW::DW_FORM_addrx1:
+                return ReadIndexedAddress(cursor_.ReadUInt(1));
+            case DW::DW_FORM_addrx2:
+                return ReadIndexedAddress(cursor_.ReadUInt(2));
+            case DW::DW_FORM_addrx3:
+                return ReadIndexedAddress(cursor_.ReadUInt(3));
+            case DW::DW_FORM_addrx4:
+                return ReadIndexedAddress(cursor_.ReadUInt(4));
+            default:
+                throw ScanError{"unsupported address form {:#x}", static_cast<uint32_t>(form)};
+        }
+    }
+
+    /// Mirrors AttributeReader::ReadLocationAddress, only a block whose
+    /// first operation is DW_OP_addr yields an address
+    uint64_t ReadLocationAddress(DW::Form form) {
+        auto length = ReadBlockLength(cursor_, form);
+        if (!length) {
+            // Location lists
+            SkipForm(cursor_, form, params_);
+            return ScannedUnit::kNone;
+        }
+        uint64_t end = cursor_.Offset() + *length;
+        uint64_t address = ScannedUnit::kNone;
+        if (*length >= 1u + params_.AddrSize && cursor_.ReadUInt(1) == DW::DW_OP_addr) {
+            address = cursor_.ReadUInt(params_.AddrSize);
+        }
+        cursor_.Skip(end - cursor_.Offset());
+        return address;
+    }
+
+private:
+    std::string_view ReadIndexedString(uint64_t index) {
+        auto offset = unit_.getStringOffsetSectionItem(static_cast<uint32_t>(index));
+        if (!offset) {
+            llvm::consumeError(offset.takeError());
+            throw ScanError{"invalid string index {}", index};
+        }
+        return ReadCString(unit_.getStringExtractor().getData(), *offset);
+    }
+
+    uint64_t ReadIndexedAddress(uint64_t index) {
+        auto address = unit_.getAddrOffsetSectionItem(static_cast<uint32_t>(index));
+        if (!address) {
+            throw ScanError{"invalid address index {}", index};
+        }
+        return address->Address;
+    }
+
+    llvm::DWARFUnit &unit_;
+    DW::FormParams params_;
+    Cursor &cursor_;
+};
+
+}// namespace
+
+std::optional<ScannedUnit> DwarfScanner::Scan(const DwarfUnitWrapper &unit) {
+    llvm::DWARFUnit &llvmUnit = unit.GetUnit();
+    if (!llvmUnit.getContext().isLittleEndian()) {
+        return std::nullopt;
+    }
+
+    ScannedUnit result;
+    result.binaryId = unit.GetBinaryId();
+    try {
+        const AbbreviationTable *table = GetAbbreviationTable(unit);
+        ScanDies(unit, *table, result);
+    } catch (const ScanError &e) {
+        BDLogDebug("falling back to llvm DIEs for unit at {:#x} of binary {}, error: {}",
+                   llvmUnit.getOffset(), unit.GetBinaryId(), e.what());
+        return std::nullopt;
+    }
+    return result;
+}
+
+void DwarfScanner::ScanDies(const DwarfUnitWrapper &unit, const AbbreviationTable &table, ScannedUnit &result) {
+    using StepKind = AbbreviationPlan::StepKind;
+    llvm::DWARFUnit &llvmUnit = unit.GetUnit();
+    DW::FormParams params = llvmUnit.getFormParams();
+    Cursor cursor{llvmUnit.getDebugInfoExtractor().getData(),
+                  llvmUnit.getOffset() + llvmUnit.getHeaderSize(),
+                  llvmUnit.getNextUnitOffset()};
+    DieDecoder decoder{llvmUnit, cursor};
+
+    // Indexes of the DIEs whose children are being scanned
+    std::vector<uint32_t> parents;
+    while (!cursor.AtEnd()) {
+        auto index = static_cast<uint32_t>(result.Size());
+        result.offsets.push_back(cursor.Offset());
+        result.parents.push_back(parents.empty() ? ScannedUnit::kNoParent : parents.back());
+        if (fields_.name) {
+            result.names.emplace_back();
+        }
+        if (fields_.references) {
+            result.specifications.push_back(ScannedUnit::kNone);
+            result.abstractOrigins.push_back(ScannedUnit::kNone);
+        }
+        if (fields_.entryPoint) {
+            result.lowPCs.push_back(ScannedUnit::kNone);
+            result.flags.push_back(0);
+        }
+        if (fields_.locationAddress) {
+            result.locationAddresses.push_back(ScannedUnit::kNone);
+        }
+
+        uint64_t code = cursor.ReadULEB128();
+        if (code == 0) {
+            result.tags.push_back(DW::DW_TAG_null);
+            if (parents.empty()) {
+                break;
+            }
+            parents.pop_back();
+            if (parents.empty()) {
+                break;
+            }
+            continue;
+        }
+
+        const AbbreviationPlan &plan = table.Find(code);
+        result.tags.push_back(plan.tag);
+        for (const auto &step: plan.steps) {
+            switch (step.kind) {
+                case StepKind::Skip:
+                    cursor.Skip(step.size);
+                    break;
+                case StepKind::SkipForm:
+                    SkipForm(cursor, step.form, params);
+                    break;
+                case StepKind::Read: {
+                    if (step.form == DW::DW_FORM_indirect) {
+                        throw ScanError{"indirect form in a scanned attribute"};
+                    }
+                    switch (step.column) {
+                        case Column::Name:
+                            result.names[index] = decoder.ReadString(step.form);
+                            break;
+                        case Column::Specification:
+                            result.specifications[index] = decoder.ReadReference(step.form);
+                            break;
+                        case Column::AbstractOrigin:
+                            result.abstractOrigins[index] = decoder.ReadReference(step.form);
+                            break;
+                        case Column::LowPC:
+                            result.lowPCs[index] = decoder.ReadAddress(step.form);
+                            break;
+                        case Column::Ranges:
+                            result.flags[index] |= ScannedUnit::HasRanges;
+                            SkipForm(cursor, step.form, params);
+                            break;
+                        case Column::EntryPC:
+                            result.flags[index] |= ScannedUnit::HasEntryPC;
+                            SkipForm(cursor, step.form, params);
+                            break;
+                        case Column::LocationAddress:
+                            result.locationAddresses[index] = decoder.ReadLocationAddress(step.form);
+                            break;
+                    }
+                    break;
+                }
+            }
+        }
+
+        if (plan.hasChildren) {
+            parents.push_back(index);
+        } else if (parents.empty()) {
+            // Unit DIE without children
+            break;
+        }
+    }
+}
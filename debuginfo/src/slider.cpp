@@ -22,6 +22,7 @@
 #include <binja/utils/debug.h>
 #include <binja/utils/log.h>
 
+#include "diagnostics.h"
 #include "slider.h"
 
 using namespace Binja;
@@ -45,7 +46,8 @@ std::optional<uint64_t> AddressSlider::SlideAddress(uint64_t address) {
 }
 
 AddressSlider AddressSlider::CreateFromMachOSegments(const std::vector<MachO::Segment> &from,
-                                                     const std::vector<MachO::Segment> &to) {
+                                                     const std::vector<MachO::Segment> &to,
+                                                     Diagnostics *diagnostics) {
     AddressSlider slider;
     for (const auto &targetSegment: to) {
         if (!targetSegment.vaLength) {
@@ -70,9 +72,12 @@ AddressSlider AddressSlider::CreateFromMachOSegments(const std::vector<MachO::Se
         AddressSlider::Interval destAddressRange{
             targetSegment.vaStart, targetSegment.vaStart + vaLength};
         if (sourceSegmentIt->vaLength != targetSegment.vaLength) {
-            BDLogWarn("va range trimmed due to length mismatch at segment {} [{:#016x}, {:#016x})->[{:#016x}, {:#016x})",
-                      targetSegment.name, sourceAddressRange.lower(), sourceAddressRange.upper(),
-                      destAddressRange.lower(), destAddressRange.upper());
+            if (diagnostics) {
+                diagnostics->Report(DiagnosticKind::SegmentLengthMismatch, targetSegment.vaStart);
+            }
+            BDLogDebug("va range trimmed due to length mismatch at segment {} [{:#016x}, {:#016x})->[{:#016x}, {:#016x})",
+                       targetSegment.name, sourceAddressRange.lower(), sourceAddressRange.upper(),
+                       destAddressRange.lower(), destAddressRange.upper());
         }
         BDLogDebug("mapping segment {}", targetSegment.name);
         slider.Map(sourceAddressRange, destAddressRange);
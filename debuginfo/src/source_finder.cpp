@@ -20,14 +20,22 @@
 
 
 #include <arpa/inet.h>
-#include <fstream>
+#include <array>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/stat.h>
+#include <unistd.h>
 
-#include <mio/mmap.hpp>
 #include <llvm/Object/MachO.h>
+#include <llvm/Support/Endian.h>
+#include <taskflow/taskflow.hpp>
 
 #include <binja/macho/macho.h>
 #include <binja/utils/debug.h>
+#include <binja/utils/executor.h>
 #include <binja/utils/log.h>
+#include <binja/utils/metrics.h>
 #include <binja/utils/span_reader.h>
 
 #include "dsym.h"
@@ -85,31 +93,138 @@ static bool IsSupportedMachO(std::span<const char> data) {
     return true;
 }
 
-static bool IsSupportedFat(std::span<const char> data) {
-    Utils::SpanReader reader{data};
+/// Number of bytes read from the start of every file to classify it.
+/// Mach-O headers and fat arch tables of the objects in a KDK fit well
+/// within a single page.
+static constexpr size_t kProbeSize = 4096;
+
+template<typename FatArch>
+static bool IsSupportedFatArch(int fd, off_t fileSize, const FatArch &arch) {
+    if (!kCPUTypes.contains(ntohl(arch.cputype))) {
+        return false;
+    }
+    uint64_t offset;
+    uint64_t size;
+    if constexpr (std::is_same_v<FatArch, llvm::MachO::fat_arch_64>) {
+        offset = llvm::support::endian::read64be(&arch.offset);
+        size = llvm::support::endian::read64be(&arch.size);
+    } else {
+        offset = ntohl(arch.offset);
+        size = ntohl(arch.size);
+    }
+    if (offset + size > static_cast<uint64_t>(fileSize)) {
+        return false;
+    }
+
+    llvm::MachO::mach_header_64 header{};
+    if (pread(fd, &header, sizeof(header), static_cast<off_t>(offset)) != sizeof(header)) {
+        return false;
+    }
+    return IsSupportedMachO({reinterpret_cast<const char *>(&header), sizeof(header)});
+}
+
+static bool IsSupportedFat(int fd, off_t fileSize, std::span<const char> page) {
+    Utils::SpanReader reader{page};
     const auto *header = reader.Read<llvm::MachO::fat_header>();
 
     if (!kFATMagics.contains(header->magic)) {
         return false;
     }
 
-    std::vector<llvm::MachO::fat_arch> supportedArchs;
+    bool is64 = header->magic == llvm::MachO::FAT_MAGIC_64 || header->magic == llvm::MachO::FAT_CIGAM_64;
     for (uint32_t i = 0; i < ntohl(header->nfat_arch); ++i) {
-        const auto *arch = reader.Read<llvm::MachO::fat_arch>();
-        if (!kCPUTypes.contains(ntohl(arch->cputype))) {
-            continue;
+        bool supported = is64
+                             ? IsSupportedFatArch(fd, fileSize, *reader.Read<llvm::MachO::fat_arch_64>())
+                             : IsSupportedFatArch(fd, fileSize, *reader.Read<llvm::MachO::fat_arch>());
+        if (supported) {
+            return true;
         }
-        auto size = ntohl(arch->size);
-        auto offset = ntohl(arch->offset);
-        if (offset + size > data.size()) {
+    }
+
+    return false;
+}
+
+static bool IsSupportedObject(const fs::path &path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        BDLogWarn("failed to open file at path {}, error: {}", path.string(), strerror(errno));
+        return false;
+    }
+
+    bool result = false;
+    try {
+        struct stat st {};
+        std::array<char, kProbeSize> page{};
+        ssize_t size = fstat(fd, &st) == 0 ? pread(fd, page.data(), page.size(), 0) : -1;
+        if (size >= static_cast<ssize_t>(sizeof(uint32_t))) {
+            std::span<const char> data{page.data(), static_cast<size_t>(size)};
+            uint32_t magic = *Utils::SpanReader{data}.Read<uint32_t>();
+            if (kFATMagics.contains(magic)) {
+                result = IsSupportedFat(fd, st.st_size, data);
+            } else if (kMachOMagics.contains(magic)) {
+                result = IsSupportedMachO(data);
+            }
+        }
+    } catch (const Utils::SpanReader::ReadError &e) {
+        BDLogWarn("failed to verify file at path {}, error: {}", path.string(), e.what());
+    }
+
+    close(fd);
+    return result;
+}
+
+struct ScanState {
+    std::mutex mutex;
+    KDKContents contents;
+};
+
+static void ScanDirectory(tf::Subflow &subflow, const fs::path &directory, ScanState &state) {
+    Utils::ScopedPhase phase{"source_finder.scan_directory"};
+    std::vector<fs::path> dsymObjects;
+    std::vector<fs::path> machoObjects;
+    std::vector<fs::path> kernelExtensions;
+
+    // Errors of single entries only skip the entry, errors of the iterator end the scan
+    std::error_code scanError;
+    fs::directory_iterator it{directory, fs::directory_options::skip_permission_denied, scanError};
+    for (; !scanError && it != fs::directory_iterator{}; it.increment(scanError)) {
+        const fs::directory_entry &dirent = *it;
+        const fs::path &path = dirent.path();
+        std::error_code entryError;
+        if (dirent.is_directory(entryError)) {
+            if (path.extension() == ".dSYM") {
+                dsymObjects.push_back(path);
+                continue;
+            }
+            if (path.extension() == ".kext") {
+                kernelExtensions.push_back(path);
+            }
+            if (!dirent.is_symlink(entryError)) {
+                subflow.emplace([&state, path](tf::Subflow &child) {
+                    ScanDirectory(child, path, state);
+                });
+            }
             continue;
         }
-        if (IsSupportedMachO(data.subspan(offset, size))) {
-            return true;
+
+        if (dirent.is_regular_file(entryError) && IsSupportedObject(path)) {
+            machoObjects.push_back(path);
         }
     }
+    if (scanError) {
+        BDLogWarn("failed to scan directory {}, error: {}", directory.string(), scanError.message());
+    }
+    std::error_code timeError;
+    auto directoryTime = fs::last_write_time(directory, timeError);
 
-    return false;
+    std::lock_guard lock{state.mutex};
+    // Directories without a modification time are not tracked for changes
+    if (!timeError) {
+        state.contents.directoryTimes[directory] = directoryTime.time_since_epoch().count();
+    }
+    state.contents.dsymObjects.insert(dsymObjects.begin(), dsymObjects.end());
+    state.contents.machoObjects.insert(machoObjects.begin(), machoObjects.end());
+    state.contents.kernelExtensions.insert(kernelExtensions.begin(), kernelExtensions.end());
 }
 
 }// namespace
@@ -123,66 +238,39 @@ void SymbolSourceFinder::VerifyKDK() {
     }
 }
 
-std::set<fs::path> SymbolSourceFinder::FindAllDSYMObjects() {
-    std::set<fs::path> result;
-    if (fs::is_directory(path_) && path_.extension() == ".dSYM") {
-        result.insert(path_);
-    } else {
-        for (const auto &dirent: fs::recursive_directory_iterator(path_)) {
-            if (dirent.is_directory() && dirent.path().extension() == ".dSYM") {
-                auto [_, ok] = result.insert(dirent.path());
-                BDVerify(ok);
-            }
-        }
+const KDKContents &SymbolSourceFinder::Scan() {
+    if (contents_) {
+        return *contents_;
     }
-    BDLogDebug("found {} dSYM files {}", result.size(), path_.string());
-    return result;
-}
-
-std::set<fs::path> SymbolSourceFinder::FindAllMachoObjects() {
-    std::set<fs::path> result;
-    for (const auto &dirent: fs::recursive_directory_iterator(path_)) {
-        if (dirent.is_directory()) {
-            continue;
-        }
 
-        mio::mmap_source file{dirent.path().string()};
-        std::span<const char> data{file.data(), file.size()};
-        Utils::SpanReader reader{data};
-
-        auto magic = *reader.Read<uint32_t>();
+    if (path_.extension() == ".dSYM") {
+        contents_ = KDKContents{.dsymObjects = {path_}};
+        return *contents_;
+    }
 
-        bool isFat = kFATMagics.contains(magic);
-        bool isMacho = kMachOMagics.contains(magic);
-        if (!isFat && !isMacho) {
-            continue;
-        }
+    Utils::ScopedPhase phase{"source_finder.scan"};
+    ScanState state;
+    tf::Taskflow taskflow;
+    taskflow.emplace([&](tf::Subflow &subflow) {
+        ScanDirectory(subflow, path_, state);
+    });
+    Utils::RunAndWait(taskflow);
+
+    contents_ = std::move(state.contents);
+    BDLogDebug("found {} dSYM files, {} macho objects and {} kernel extensions at {}",
+               contents_->dsymObjects.size(), contents_->machoObjects.size(),
+               contents_->kernelExtensions.size(), path_.string());
+    return *contents_;
+}
 
-        try {
-            if (isFat && !IsSupportedFat(data)) {
-                continue;
-            }
-            if (isMacho && !IsSupportedMachO(data)) {
-                continue;
-            }
-        } catch (const Utils::SpanReader::ReadError &e) {
-            BDLogWarn("failed to verify file at path {}, error: {}", dirent.path().string(), e.what());
-            continue;
-        }
+std::set<fs::path> SymbolSourceFinder::FindAllDSYMObjects() {
+    return Scan().dsymObjects;
+}
 
-        auto [_, ok] = result.insert(dirent.path());
-        BDVerify(ok);
-    }
-    return result;
+std::set<fs::path> SymbolSourceFinder::FindAllMachoObjects() {
+    return Scan().machoObjects;
 }
 
 std::set<fs::path> SymbolSourceFinder::FindAllKernelExtensions() {
-    std::set<fs::path> result;
-    for (const auto &dirent: fs::recursive_directory_iterator(path_)) {
-        if (dirent.is_directory() && dirent.path().extension() == "kext") {
-            auto [_, ok] = result.insert(dirent.path());
-            BDVerify(ok);
-        }
-    }
-    return result;
+    return Scan().kernelExtensions;
 }
@@ -0,0 +1,113 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <bit>
+#include <functional>
+
+#include <binja/utils/debug.h>
+
+#include "errors.h"
+#include "symbol_registry.h"
+
+using namespace Binja;
+using namespace DebugInfo;
+
+
+/// Symbol name interner
+
+SymbolNameInterner::NameId SymbolNameInterner::Intern(std::string_view name) {
+    size_t hash = std::hash<std::string_view>{}(name);
+    size_t shardIndex = hash & (kShardCount - 1);
+    Shard &shard = shards_[shardIndex];
+
+    std::lock_guard lock{shard.mutex};
+    if (auto it = shard.index.find(name); it != shard.index.end()) {
+        return it->second;
+    }
+    NameId id = static_cast<NameId>((shard.names.size() << kShardBits) | shardIndex);
+    const std::string &stored = shard.names.emplace_back(name);
+    shard.index.emplace(stored, id);
+    return id;
+}
+
+std::string_view SymbolNameInterner::Get(NameId id) const {
+    const Shard &shard = shards_[id & (kShardCount - 1)];
+    std::lock_guard lock{shard.mutex};
+    return shard.names.at(id >> kShardBits);
+}
+
+
+/// Symbol registry
+
+SymbolRegistry::SymbolRegistry(size_t expectedSymbols) {
+    size_t capacity = std::bit_ceil(std::max<size_t>(expectedSymbols * 2, 16));
+    slots_ = std::make_unique<Slot[]>(capacity);
+    mask_ = capacity - 1;
+}
+
+size_t SymbolRegistry::SlotIndex(uint64_t address) const {
+    return static_cast<size_t>((address * 0x9e3779b97f4a7c15ULL) >> 32) & mask_;
+}
+
+SymbolRegistry::OwnerId SymbolRegistry::Claim(uint64_t address, OwnerId owner) {
+    BDVerify(address != kEmptyAddress);
+    BDVerify(owner != kNoOwner);
+
+    size_t index = SlotIndex(address);
+    for (size_t probe = 0; probe <= mask_; ++probe, index = (index + 1) & mask_) {
+        Slot &slot = slots_[index];
+        uint64_t current = slot.address.load(std::memory_order_acquire);
+        if (current == kEmptyAddress) {
+            if (!slot.address.compare_exchange_strong(current, address, std::memory_order_acq_rel)) {
+                if (current != address) {
+                    continue;
+                }
+            }
+        } else if (current != address) {
+            continue;
+        }
+
+        OwnerId winner = slot.owner.load(std::memory_order_acquire);
+        while (owner < winner) {
+            if (slot.owner.compare_exchange_weak(winner, owner, std::memory_order_acq_rel)) {
+                return owner;
+            }
+        }
+        return winner;
+    }
+    throw FatalError{"symbol registry with {} slots is full", mask_ + 1};
+}
+
+std::optional<SymbolRegistry::OwnerId> SymbolRegistry::Owner(uint64_t address) const {
+    size_t index = SlotIndex(address);
+    for (size_t probe = 0; probe <= mask_; ++probe, index = (index + 1) & mask_) {
+        const Slot &slot = slots_[index];
+        uint64_t current = slot.address.load(std::memory_order_acquire);
+        if (current == kEmptyAddress) {
+            return std::nullopt;
+        }
+        if (current == address) {
+            return slot.owner.load(std::memory_order_acquire);
+        }
+    }
+    return std::nullopt;
+}
@@ -0,0 +1,325 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include <taskflow/taskflow.hpp>
+
+#include <binja/utils/debug.h>
+#include <binja/utils/executor.h>
+#include <binja/utils/log.h>
+#include <binja/utils/metrics.h>
+
+#include "type_graph.h"
+#include "types.h"
+
+namespace DW = llvm::dwarf;
+using namespace Binja;
+using namespace DebugInfo;
+
+
+/// Type graph
+
+TypeGraph::NodeIndex TypeGraph::AddRoot(DwarfOffset die) {
+    BDVerify(nodes_.size() < kNoNode);
+    auto index = static_cast<NodeIndex>(nodes_.size());
+    nodes_.push_back(Node{.die = die, .component = 0, .root = true});
+    return index;
+}
+
+void TypeGraph::Schedule() {
+    dwarfContext_.PrepareConcurrentReads();
+    Expand();
+    ComputeComponents();
+
+    size_t numCyclic = std::count_if(components_.begin(), components_.end(), [](const Component &component) {
+        return component.cyclic;
+    });
+    BDLogInfo("scheduled {} type nodes in {} components and {} waves, {} cyclic components",
+              nodes_.size(), components_.size(), waves_.size(), numCyclic);
+}
+
+TypeGraph::NodeIndex TypeGraph::FindNode(const DwarfDieWrapper &die) const {
+    if (auto id = dwarfContext_.GetDieId(die)) {
+        return nodeIndices_.Get(*id);
+    }
+    return kNoNode;
+}
+
+void TypeGraph::Expand() {
+    // Explicit work list, type chains can be deeper than the native stack
+    std::vector<NodeIndex> pending(nodes_.size());
+    for (NodeIndex i = 0; i < pending.size(); ++i) {
+        pending[i] = static_cast<NodeIndex>(pending.size() - i - 1);
+    }
+
+    while (!pending.empty()) {
+        NodeIndex index = pending.back();
+        pending.pop_back();
+
+        DwarfDieWrapper die = dwarfContext_.GetDIEForOffset(nodes_[index].die);
+        DwarfDieWrapper resolved = nameIndex_.ResolveDie(die);
+        AddEdge(index, AttributeReader{resolved}.ReadReference(DW::DW_AT_type, true), pending);
+        for (auto &child: resolved.Children()) {
+            switch (child.GetTag()) {
+                case DW::DW_TAG_inheritance:
+                case DW::DW_TAG_member:
+                case DW::DW_TAG_variable:
+                case DW::DW_TAG_formal_parameter: {
+                    AttributeReader attributeReader{const_cast<DwarfDieWrapper &>(child)};
+                    AddEdge(index, attributeReader.ReadReference(DW::DW_AT_type, true), pending);
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+
+        auto &edges = nodes_[index].edges;
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    }
+}
+
+void TypeGraph::AddEdge(NodeIndex from, std::optional<DwarfDieWrapper> target, std::vector<NodeIndex> &pending) {
+    if (!target) {
+        return;
+    }
+
+    DwarfDieWrapper resolved = nameIndex_.ResolveDie(*target);
+    if (!IsInlineType(resolved)) {
+        return;
+    }
+
+    auto id = dwarfContext_.GetDieId(resolved);
+    if (!id) {
+        return;
+    }
+
+    NodeIndex to = nodeIndices_.Get(*id);
+    if (to == kNoNode) {
+        BDVerify(nodes_.size() < kNoNode);
+        to = static_cast<NodeIndex>(nodes_.size());
+        nodes_.push_back(Node{.die = resolved.GetOffset(), .component = 0, .root = false});
+        nodeIndices_.Set(*id, to);
+        pending.push_back(to);
+    }
+    nodes_[from].edges.push_back(to);
+}
+
+bool TypeGraph::IsInlineType(DwarfDieWrapper &die) {
+    auto tag = die.GetTag();
+    // Base types are leaves and unspecified types are always referenced by name
+    if (!TypeBuilder::IsTypeTag(tag) || tag == DW::DW_TAG_base_type || tag == DW::DW_TAG_unspecified_type) {
+        return false;
+    }
+    if (TypeModifierBuilder::IsTypeModifierTag(tag)) {
+        return true;
+    }
+    return AttributeReader{die}.ReadNameView("", true).empty();
+}
+
+void TypeGraph::ComputeComponents() {
+    // Iterative Tarjan, components are found after every component they
+    // depend on, so their wave can be assigned right away
+    constexpr uint32_t kUnvisited = std::numeric_limits<uint32_t>::max();
+
+    struct Frame {
+        NodeIndex node;
+        size_t edge;
+    };
+
+    std::vector<uint32_t> order(nodes_.size(), kUnvisited);
+    std::vector<uint32_t> lowLink(nodes_.size());
+    std::vector<bool> onStack(nodes_.size());
+    std::vector<NodeIndex> stack;
+    std::vector<Frame> frames;
+    uint32_t counter = 0;
+
+    auto visit = [&](NodeIndex node) {
+        order[node] = lowLink[node] = counter++;
+        stack.push_back(node);
+        onStack[node] = true;
+        frames.push_back(Frame{node, 0});
+    };
+
+    for (NodeIndex start = 0; start < nodes_.size(); ++start) {
+        if (order[start] != kUnvisited) {
+            continue;
+        }
+        visit(start);
+        while (!frames.empty()) {
+            Frame &frame = frames.back();
+            const auto &edges = nodes_[frame.node].edges;
+            if (frame.edge < edges.size()) {
+                NodeIndex next = edges[frame.edge++];
+                if (order[next] == kUnvisited) {
+                    visit(next);
+                } else if (onStack[next]) {
+                    lowLink[frame.node] = std::min(lowLink[frame.node], order[next]);
+                }
+                continue;
+            }
+
+            NodeIndex node = frame.node;
+            frames.pop_back();
+            if (!frames.empty()) {
+                NodeIndex parent = frames.back().node;
+                lowLink[parent] = std::min(lowLink[parent], lowLink[node]);
+            }
+            if (lowLink[node] != order[node]) {
+                continue;
+            }
+
+            std::vector<NodeIndex> members;
+            NodeIndex member;
+            do {
+                member = stack.back();
+                stack.pop_back();
+                onStack[member] = false;
+                members.push_back(member);
+            } while (member != node);
+            AddComponent(std::move(members));
+        }
+    }
+}
+
+void TypeGraph::AddComponent(std::vector<NodeIndex> members) {
+    auto componentIndex = static_cast<ComponentIndex>(components_.size());
+    std::sort(members.begin(), members.end(), [&](NodeIndex lhs, NodeIndex rhs) {
+        const DwarfOffset &l = nodes_[lhs].die;
+        const DwarfOffset &r = nodes_[rhs].die;
+        return std::pair<uint64_t, uint64_t>{l.binaryId, l.offset} < std::pair<uint64_t, uint64_t>{r.binaryId, r.offset};
+    });
+    for (NodeIndex member: members) {
+        nodes_[member].component = componentIndex;
+    }
+
+    Component component{.wave = 0, .cyclic = members.size() > 1};
+    for (NodeIndex member: members) {
+        for (NodeIndex next: nodes_[member].edges) {
+            ComponentIndex dependency = nodes_[next].component;
+            if (dependency == componentIndex) {
+                component.cyclic = true;
+            } else {
+                component.wave = std::max(component.wave, components_[dependency].wave + 1);
+            }
+        }
+    }
+    component.nodes = std::move(members);
+
+    if (waves_.size() <= component.wave) {
+        waves_.resize(component.wave + 1);
+    }
+    waves_[component.wave].push_back(componentIndex);
+    components_.push_back(std::move(component));
+}
+
+
+/// Parallel type builder
+
+namespace {
+
+/// Reuses the types of nodes from waves that completed before the current one
+class ScheduledTypeBuilderContext : public OrderedTypeBuilderContext {
+public:
+    ScheduledTypeBuilderContext(DwarfContextWrapper &dwarfContext, NameIndex &index, Diagnostics &diagnostics,
+                                const TypeGraph &graph, const std::vector<TypeRef> &types)
+        : OrderedTypeBuilderContext{dwarfContext, index, diagnostics}, graph_{graph}, types_{types} {}
+
+    TypeRef FindBuiltType(DwarfDieWrapper &die) override {
+        TypeGraph::NodeIndex node = graph_.FindNode(die);
+        if (node == TypeGraph::kNoNode) {
+            return nullptr;
+        }
+        if (graph_.GetComponent(graph_.GetNode(node).component).wave >= wave_) {
+            return nullptr;
+        }
+        return types_[node];
+    }
+
+    void SetWave(uint32_t wave) { wave_ = wave; }
+
+private:
+    const TypeGraph &graph_;
+    const std::vector<TypeRef> &types_;
+    uint32_t wave_ = 0;
+};
+
+}// namespace
+
+std::vector<ParallelTypeBuilder::TypeRef> ParallelTypeBuilder::Build(const WaveCallback &onWave) {
+    std::vector<TypeRef> types(graph_.GetNodeCount());
+
+    // Working sets of the builders are per context, so every worker gets one
+    tf::Executor &executor = Utils::GetSharedExecutor();
+    std::vector<std::unique_ptr<ScheduledTypeBuilderContext>> contexts;
+    for (size_t i = 0; i < executor.num_workers(); ++i) {
+        contexts.push_back(std::make_unique<ScheduledTypeBuilderContext>(
+            dwarfContext_, nameIndex_, diagnostics_, graph_, types));
+    }
+
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    size_t numBuilt = 0;
+    for (uint32_t wave = 0; wave < graph_.GetWaveCount() && !error; ++wave) {
+        for (auto &context: contexts) {
+            context->SetWave(wave);
+        }
+
+        const auto &components = graph_.GetWave(wave);
+        tf::Taskflow taskflow;
+        taskflow.for_each_index(size_t{0}, components.size(), size_t{1}, [&](size_t i) {
+            Utils::ScopedPhase phase{"dwarf.build_types"};
+            int worker = executor.this_worker_id();
+            BDVerify(worker >= 0);
+            ScheduledTypeBuilderContext &context = *contexts[worker];
+            try {
+                for (TypeGraph::NodeIndex index: graph_.GetComponent(components[i]).nodes) {
+                    const TypeGraph::Node &node = graph_.GetNode(index);
+                    DwarfDieWrapper die = dwarfContext_.GetDIEForOffset(node.die);
+                    types[index] = GenericTypeBuilder{context, die, node.root}.Build();
+                }
+            } catch (...) {
+                std::lock_guard lock{errorMutex};
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        });
+        Utils::RunAndWait(taskflow);
+
+        if (onWave) {
+            for (TypeGraph::ComponentIndex component: components) {
+                numBuilt += graph_.GetComponent(component).nodes.size();
+            }
+            onWave(numBuilt, graph_.GetNodeCount());
+        }
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return types;
+}
@@ -24,6 +24,7 @@
 #include <llvm/DebugInfo/DWARF/DWARFUnit.h>
 
 #include <binja/utils/log.h>
+#include <binja/utils/metrics.h>
 
 #include "debug.h"
 #include "types.h"
@@ -174,8 +175,9 @@ BinaryNinja::Ref<BinaryNinja::Type> TypeModifierBuilder::Build() {
                 structureBuilder.SetPacked(true);
                 return Type::StructureType(structureBuilder.Finalize());
             }
-            BDLogWarn("attempt to apply packed modifier on non struct type {}, DIE: {}",
-                      baseType->GetTypeName().GetString(), dieReader_.Dump());
+            ctx_.ReportDiagnostic(DiagnosticKind::UnsupportedTypeModifier, die_.GetOffset());
+            BDLogDebug("attempt to apply packed modifier on non struct type {}, DIE: {}",
+                       baseType->GetTypeName().GetString(), dieReader_.Dump());
             return baseType;
         case DW_TAG_APPLE_ptrauth_type:
             return baseType;
@@ -183,10 +185,12 @@ BinaryNinja::Ref<BinaryNinja::Type> TypeModifierBuilder::Build() {
         case DW::DW_TAG_immutable_type:
         case DW::DW_TAG_restrict_type:
         case DW::DW_TAG_shared_type:
-            BDLogWarn("encountered unsupported type modifier tag {}", DW::TagString(tag).str());
+            ctx_.ReportDiagnostic(DiagnosticKind::UnsupportedTypeModifier, die_.GetOffset());
+            BDLogDebug("encountered unsupported type modifier tag {}", DW::TagString(tag).str());
             return baseType;
         default:
-            BDLogWarn("encountered unknown type modifier tag {}", DW::TagString(tag).str());
+            ctx_.ReportDiagnostic(DiagnosticKind::UnsupportedTypeModifier, die_.GetOffset());
+            BDLogDebug("encountered unknown type modifier tag {}", DW::TagString(tag).str());
             return baseType;
     }
 
@@ -217,13 +221,15 @@ bool TypeModifierBuilder::IsTypeModifierTag(DW::Tag tag) {
 BinaryNinja::Ref<BinaryNinja::Type> TypedefBuilder::Build() {
     auto base = attributeReader_.ReadReference(DW::DW_AT_type);
     if (!base) {
-        BDLogWarn("typedef without DW_AT_type attribute, DIE: {}", dieReader_.Dump());
+        ctx_.ReportDiagnostic(DiagnosticKind::TypedefWithoutType, die_.GetOffset());
+        BDLogDebug("typedef without DW_AT_type attribute, DIE: {}", dieReader_.Dump());
         return nullptr;
     }
 
     auto name = attributeReader_.ReadName();
     if (name.empty()) {
-        BDLogWarn("typedef without DW_AT_name attribute, DIE: {}", dieReader_.Dump());
+        ctx_.ReportDiagnostic(DiagnosticKind::TypedefWithoutName, die_.GetOffset());
+        BDLogDebug("typedef without DW_AT_name attribute, DIE: {}", dieReader_.Dump());
         return nullptr;
     }
 
@@ -248,13 +254,15 @@ std::optional<DwarfDieWrapper> TypedefBuilder::Resolve(DwarfDieWrapper &die) {
 BinaryNinja::Ref<BinaryNinja::Type> ArrayTypeBuilder::Build() {
     auto name = attributeReader_.ReadName();
     if (!name.empty()) {
-        BDLogWarn("ignoring array with DW_AT_name not implemented, DIE: {}", dieReader_.Dump());
+        ctx_.ReportDiagnostic(DiagnosticKind::UnsupportedArray, die_.GetOffset());
+        BDLogDebug("ignoring array with DW_AT_name not implemented, DIE: {}", dieReader_.Dump());
         return nullptr;
     }
 
     auto elementType = attributeReader_.ReadReference(DW::DW_AT_type);
     if (!elementType) {
-        BDLogWarn("ignoring array with no DW_AT_type attribute, DIE: {}", dieReader_.Dump());
+        ctx_.ReportDiagnostic(DiagnosticKind::ArrayWithoutType, die_.GetOffset());
+        BDLogDebug("ignoring array with no DW_AT_type attribute, DIE: {}", dieReader_.Dump());
         return nullptr;
     }
 
@@ -268,14 +276,16 @@ BinaryNinja::Ref<BinaryNinja::Type> ArrayTypeBuilder::Build() {
 BinaryNinja::Ref<BinaryNinja::Type> ArrayTypeBuilder::BuildDynamic() {
     auto rank = attributeReader_.ReadUInt(DW::DW_AT_rank);
     if (!rank) {
-        BDLogWarn("ignoring array having DW_AT_rank value as DWARF expression, DIE: {}",
-                  dieReader_.Dump());
+        ctx_.ReportDiagnostic(DiagnosticKind::UnsupportedArray, die_.GetOffset());
+        BDLogDebug("ignoring array having DW_AT_rank value as DWARF expression, DIE: {}",
+                   dieReader_.Dump());
         return nullptr;
     }
 
     if (*rank == 0) {
-        BDLogWarn("ignoring array having DW_AT_rank value 0, DIE: {}",
-                  dieReader_.Dump());
+        ctx_.ReportDiagnostic(DiagnosticKind::UnsupportedArray, die_.GetOffset());
+        BDLogDebug("ignoring array having DW_AT_rank value 0, DIE: {}",
+                   dieReader_.Dump());
         return nullptr;
     }
 
@@ -328,7 +338,8 @@ std::optional<size_t> ArrayTypeBuilder::DecodeCountFromSubrange(DwarfDieWrapper
             lb = GetDefaultLowerBound();
         }
         if (*ub <= lb) {
-            BDLogWarn("ignoring array index with ub <= lb, die: {}", dieReader_.Dump());
+            ctx_.ReportDiagnostic(DiagnosticKind::InvalidArrayBounds, die.GetOffset());
+            BDLogDebug("ignoring array index with ub <= lb, die: {}", dieReader_.Dump());
             return std::nullopt;
         }
         return *ub - lb;
@@ -374,9 +385,10 @@ FunctionTypeBuilder::DecodeParametersResult FunctionTypeBuilder::DecodeParameter
         switch (tag) {
             case DW::DW_TAG_formal_parameter: {
                 if (result.hasVarArg) {
-                    BDLogWarn("encountered function with formal parameter "
-                              "after vararg, DIE: {}",
-                              dieReader_.Dump());
+                    ctx_.ReportDiagnostic(DiagnosticKind::InvalidFunctionParameter, child.GetOffset());
+                    BDLogDebug("encountered function with formal parameter "
+                               "after vararg, DIE: {}",
+                               dieReader_.Dump());
                 }
 
                 BN::FunctionParameter functionParameter;
@@ -402,9 +414,10 @@ BinaryNinja::Ref<BinaryNinja::Type> FunctionTypeBuilder::DecodeParameterType(Dwa
     AttributeReader attributeReader{die};
     auto type = attributeReader.ReadReference(DW::DW_AT_type, true);
     if (!type) {
-        BDLogWarn("encountered function formal parameter with no DW_AT_type "
-                  "attribute, DIE: {}",
-                  DieReader{die}.Dump());
+        ctx_.ReportDiagnostic(DiagnosticKind::InvalidFunctionParameter, die.GetOffset());
+        BDLogDebug("encountered function formal parameter with no DW_AT_type "
+                   "attribute, DIE: {}",
+                   DieReader{die}.Dump());
         return Type::VoidType();
     }
     return GenericTypeBuilder{ctx_, *type}.Build();
@@ -417,9 +430,10 @@ BinaryNinja::Ref<BinaryNinja::Type> FunctionTypeBuilder::ApplyParameterTypeModif
     bool isReferenceType = attributeReader.HasAttribute(DW::DW_AT_reference, true);
     bool isRValueReferenceType = attributeReader.HasAttribute(DW::DW_AT_rvalue_reference, true);
     if (isRValueReferenceType && isReferenceType) {
-        BDLogWarn("function parameter have both DW_AT_reference and DW_AT_rvalue_reference "
-                  "tags, DIE: {}",
-                  DieReader{die}.Dump());
+        ctx_.ReportDiagnostic(DiagnosticKind::InvalidFunctionParameter, die.GetOffset());
+        BDLogDebug("function parameter have both DW_AT_reference and DW_AT_rvalue_reference "
+                   "tags, DIE: {}",
+                   DieReader{die}.Dump());
         return type;
     }
     if (isRValueReferenceType) {
@@ -439,13 +453,15 @@ BinaryNinja::Ref<BinaryNinja::Type> FunctionTypeBuilder::ApplyParameterTypeModif
 BinaryNinja::Ref<BinaryNinja::Type> EnumTypeBuilder::Build() {
     auto type = ResolveBaseType();
     if (!type) {
-        BDLogWarn("ignoring enum with no / invalid DW_AT_type attribute, DIE: {}", dieReader_.Dump());
+        ctx_.ReportDiagnostic(DiagnosticKind::InvalidEnumBaseType, die_.GetOffset());
+        BDLogDebug("ignoring enum with no / invalid DW_AT_type attribute, DIE: {}", dieReader_.Dump());
         return nullptr;
     }
 
     if (type->GetTag() != DW::DW_TAG_base_type) {
-        BDLogWarn("ignoring enum having base type with tag != DW_TAG_base_type, DIE: {}",
-                  dieReader_.Dump());
+        ctx_.ReportDiagnostic(DiagnosticKind::InvalidEnumBaseType, die_.GetOffset());
+        BDLogDebug("ignoring enum having base type with tag != DW_TAG_base_type, DIE: {}",
+                   dieReader_.Dump());
         return nullptr;
     }
 
@@ -468,27 +484,31 @@ BinaryNinja::Ref<BinaryNinja::Type> EnumTypeBuilder::Build() {
             AttributeReader attributeReader{enumerator};
             std::string name = attributeReader.ReadName();
             if (name.empty()) {
-                BDLogWarn("ignoring enum entry with no name, DIE: {}", DieReader{enumerator}.Dump());
+                ctx_.ReportDiagnostic(DiagnosticKind::InvalidEnumerator, enumerator.GetOffset());
+                BDLogDebug("ignoring enum entry with no name, DIE: {}", DieReader{enumerator}.Dump());
                 continue;
             }
             if (baseType->IsSigned()) {
                 auto value = attributeReader.ReadInt(DW::DW_AT_const_value);
                 if (!value) {
-                    BDLogWarn("ignoring enum entry with no value, DIE: {}", DieReader{enumerator}.Dump());
+                    ctx_.ReportDiagnostic(DiagnosticKind::InvalidEnumerator, enumerator.GetOffset());
+                    BDLogDebug("ignoring enum entry with no value, DIE: {}", DieReader{enumerator}.Dump());
                     continue;
                 }
                 builder.AddMemberWithValue(name, *value);
             } else {
                 auto value = attributeReader.ReadUInt(DW::DW_AT_const_value);
                 if (!value) {
-                    BDLogWarn("ignoring enum entry with no value, DIE: {}", DieReader{enumerator}.Dump());
+                    ctx_.ReportDiagnostic(DiagnosticKind::InvalidEnumerator, enumerator.GetOffset());
+                    BDLogDebug("ignoring enum entry with no value, DIE: {}", DieReader{enumerator}.Dump());
                     continue;
                 }
                 builder.AddMemberWithValue(name, *value);
             }
         } else {
-            BDLogWarn("ignoring unexpected tag {} inside enum, DIE: {}",
-                      DW::TagString(tag).str(), dieReader_.Dump());
+            ctx_.ReportDiagnostic(DiagnosticKind::UnexpectedChildTag, die_.GetOffset());
+            BDLogDebug("ignoring unexpected tag {} inside enum, DIE: {}",
+                       DW::TagString(tag).str(), dieReader_.Dump());
         }
     }
 
@@ -545,8 +565,9 @@ BinaryNinja::Ref<BinaryNinja::Type> CompositeTypeBuilder::Build() {
                 // Already handled in member access / index DB iteration
                 break;
             default: {
-                BDLogInfo("Ignoring unexpected tag {} of DIE {}", DW::TagString(child.GetTag()).str(),
-                          DieReader{const_cast<DwarfDieWrapper &>(child)}.Dump());
+                ctx_.ReportDiagnostic(DiagnosticKind::UnexpectedChildTag, child.GetOffset());
+                BDLogDebug("Ignoring unexpected tag {} of DIE {}", DW::TagString(child.GetTag()).str(),
+                           DieReader{const_cast<DwarfDieWrapper &>(child)}.Dump());
                 break;
             }
         }
@@ -594,7 +615,8 @@ size_t CompositeTypeBuilder::DecodeWidth() {
     }
     auto isDeclaration = attributeReader_.HasAttribute(DW::DW_AT_declaration);
     if (!isDeclaration) {
-        BDLogWarn("Container does not have DW_AT_byte_size attribute, DIE: {}", dieReader_.Dump());
+        ctx_.ReportDiagnostic(DiagnosticKind::ContainerWithoutSize, die_.GetOffset());
+        BDLogDebug("Container does not have DW_AT_byte_size attribute, DIE: {}", dieReader_.Dump());
     }
     return 0;
 }
@@ -621,9 +643,10 @@ std::optional<CompositeTypeBuilder::DecodeMemberResult> CompositeTypeBuilder::De
 
     auto type = attributeReader.ReadReference(DW::DW_AT_type);
     if (!type) {
-        BDLogInfo("Skipping member DIE without DW_AT_type attribute, "
-                  "DIE: {}",
-                  dieReader.Dump());
+        ctx_.ReportDiagnostic(DiagnosticKind::MemberWithoutType, die.GetOffset());
+        BDLogDebug("Skipping member DIE without DW_AT_type attribute, "
+                   "DIE: {}",
+                   dieReader.Dump());
         return std::nullopt;
     }
 
@@ -635,8 +658,9 @@ std::optional<CompositeTypeBuilder::DecodeMemberResult> CompositeTypeBuilder::De
 
     auto offset = attributeReader.ReadUInt(DW::DW_AT_data_member_location);
     if (!offset) {
-        BDLogWarn("composite type member without DW_AT_data_member_location, DIE: {}",
-                  DieReader{die}.Dump());
+        ctx_.ReportDiagnostic(DiagnosticKind::MemberWithoutLocation, die.GetOffset());
+        BDLogDebug("composite type member without DW_AT_data_member_location, DIE: {}",
+                   DieReader{die}.Dump());
         return std::nullopt;
     }
 
@@ -646,7 +670,7 @@ std::optional<CompositeTypeBuilder::DecodeMemberResult> CompositeTypeBuilder::De
 
     AttributeReader typeAttributeReader{*type};
 
-    if ((isAnonymous && !isInheritance) && !typeAttributeReader.HasAttribute(DW::DW_AT_export_symbols) && !typeAttributeReader.ReadName("").empty()) {
+    if ((isAnonymous && !isInheritance) && !typeAttributeReader.HasAttribute(DW::DW_AT_export_symbols) && !typeAttributeReader.ReadNameView().empty()) {
         BDLogDebug("Anonymous member of container does not have DW_AT_export_symbols "
                    "attribute and member type has name, DIE: {}",
                    dieReader.Dump());
@@ -691,9 +715,10 @@ BNMemberAccess CompositeTypeBuilder::DecodeMemberAccess(std::optional<uint64_t>
         case DW::DW_ACCESS_public:
             return BNMemberAccess::PublicAccess;
     }
-    BDLogWarn("encountered struct having member invalid DW_AT_accessibility "
-              "value, DIE: {}",
-              dieReader_.Dump());
+    ctx_.ReportDiagnostic(DiagnosticKind::InvalidAccessibility, die_.GetOffset());
+    BDLogDebug("encountered struct having member invalid DW_AT_accessibility "
+               "value, DIE: {}",
+               dieReader_.Dump());
     return NoAccess;
 }
 
@@ -707,7 +732,8 @@ void CompositeTypeBuilder::ProcessBitfields(BN::StructureBuilder &builder) {
                 if (auto next = ProcessBitfield(builder, child)) {
                     child = *next;
                 } else {
-                    BDLogWarn("failed processing of bitfields in DIE {}", dieReader_.Dump());
+                    ctx_.ReportDiagnostic(DiagnosticKind::BitfieldLayout, die_.GetOffset());
+                    BDLogDebug("failed processing of bitfields in DIE {}", dieReader_.Dump());
                     return;
                 }
                 continue;
@@ -728,7 +754,7 @@ std::optional<DwarfDieWrapper> CompositeTypeBuilder::ProcessBitfield(
     }
 
     if (startBit % 8 != 0) {
-        BDLogWarn("unexpected alignment of start bit in DIE offset: {}", start.GetOffset());
+        BDLogDebug("unexpected alignment of start bit in DIE offset: {}", start.GetOffset());
         return std::nullopt;
     }
 
@@ -752,7 +778,7 @@ std::optional<DwarfDieWrapper> CompositeTypeBuilder::ProcessBitfield(
 
         int maxBit = *bitOffset + *bitSize;
         if (maxBit < previousMaxBit) {
-            BDLogWarn("unexpected order of bitfields in DIE offset: {}", end.GetOffset());
+            BDLogDebug("unexpected order of bitfields in DIE offset: {}", end.GetOffset());
             return std::nullopt;
         }
 
@@ -795,15 +821,17 @@ std::optional<DwarfDieWrapper> CompositeTypeBuilder::ProcessBitfield(
 BinaryNinja::Ref<BinaryNinja::Type> PointerToMemberTypeBuilder::Build() {
     auto memberType = attributeReader_.ReadReference(DW::DW_AT_type);
     if (!memberType) {
-        BDLogWarn("encountered pointer to member type with no DW_AT_type, DIE: {}",
-                  dieReader_.Dump());
+        ctx_.ReportDiagnostic(DiagnosticKind::InvalidPointerToMember, die_.GetOffset());
+        BDLogDebug("encountered pointer to member type with no DW_AT_type, DIE: {}",
+                   dieReader_.Dump());
         return nullptr;
     }
 
     auto containerType = attributeReader_.ReadReference(DW::DW_AT_containing_type);
     if (!containerType) {
-        BDLogWarn("encountered pointer to member type with no DW_AT_containing_type, DIE: {}",
-                  dieReader_.Dump());
+        ctx_.ReportDiagnostic(DiagnosticKind::InvalidPointerToMember, die_.GetOffset());
+        BDLogDebug("encountered pointer to member type with no DW_AT_containing_type, DIE: {}",
+                   dieReader_.Dump());
         return nullptr;
     }
 
@@ -828,6 +856,10 @@ BinaryNinja::Ref<BinaryNinja::Type> GenericTypeBuilder::Build() {
         return BaseTypeBuilder{ctx_, resolvedDie_}.Build();
     }
 
+    if (TypeRef type = ctx_.FindBuiltType(resolvedDie_)) {
+        return type;
+    }
+
     if (TypeModifierBuilder::IsTypeModifierTag(tag)) {
         return TypeModifierBuilder{ctx_, resolvedDie_}.Build();
     }
@@ -840,13 +872,14 @@ BinaryNinja::Ref<BinaryNinja::Type> GenericTypeBuilder::Build() {
         return NamedTypeReferenceBuilder{ctx_, resolvedDie_}.Build();
     }
 
-    bool isAnonymous = resolvedDieReader_.AttrReader().ReadName("", true).empty();
+    bool isAnonymous = resolvedDieReader_.AttrReader().ReadNameView("", true).empty();
     if (!isAnonymous && !decodeNamedTypes_) {
         ctx_.UntagDieAsProcessing(resolvedDie_);
         return NamedTypeReferenceBuilder{ctx_, resolvedDie_}.Build();
     }
 
     auto type = DoBuild();
+    Utils::CountMetric(Utils::Counter::TypesBuilt);
     if (!type) {
         BinaryNinja::NamedTypeReference ref{
             BNNamedTypeReferenceClass::TypedefNamedTypeClass,
@@ -886,7 +919,8 @@ BinaryNinja::Ref<BinaryNinja::Type> GenericTypeBuilder::DoBuild() {
         return PointerToMemberTypeBuilder{ctx_, resolvedDie_}.Build();
     }
 
-    BDLogWarn("encountered type die with unknown tag, DIE: {}", resolvedDieReader_.Dump());
+    ctx_.ReportDiagnostic(DiagnosticKind::UnknownTypeTag, resolvedDie_.GetOffset());
+    BDLogDebug("encountered type die with unknown tag, DIE: {}", resolvedDieReader_.Dump());
     return nullptr;
 }
 
@@ -894,12 +928,15 @@ BinaryNinja::Ref<BinaryNinja::Type> GenericTypeBuilder::DoBuild() {
 /// Abstract type builder context
 
 bool TypeBuilderContext::TagDieAsProcessing(DwarfDieWrapper &die) {
-    auto [_, inserted] = workingSet_.insert(die.GetOffset());
-    return inserted;
+    auto id = dwarfContext_.GetDieId(die);
+    Verify(id, FatalError);
+    return workingSet_.Set(*id);
 }
 
 void TypeBuilderContext::UntagDieAsProcessing(DwarfDieWrapper &die) {
-    bool ok = workingSet_.erase(die.GetOffset());
+    auto id = dwarfContext_.GetDieId(die);
+    Verify(id, FatalError);
+    bool ok = workingSet_.Reset(*id);
     Verify(ok, FatalError);
 }
 
@@ -930,7 +967,8 @@ BNNamedTypeReferenceClass NamedTypeReferenceBuilder::DecodeTypeClass() {
         case DW::DW_TAG_union_type:
             return BNNamedTypeReferenceClass::UnionNamedTypeClass;
         default:
-            BDLogWarn("encountered die with unexpected tag, DIE: {}", dieReader_.Dump());
+            ctx_.ReportDiagnostic(DiagnosticKind::UnknownTypeTag, die_.GetOffset());
+            BDLogDebug("encountered die with unexpected tag, DIE: {}", dieReader_.Dump());
             return BNNamedTypeReferenceClass::UnknownNamedTypeClass;
     }
 }
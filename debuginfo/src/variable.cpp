@@ -46,12 +46,14 @@ std::optional<DwarfVariableInfo> VariableDecoder::Decode() {
     if (auto slidLocation = ctx_.SlideAddress(die_.GetOffset(), info.location)) {
         info.location = *slidLocation;
     } else {
+        ctx_.ReportDiagnostic(DiagnosticKind::VariableAddressNotSlid, die_.GetOffset());
         BDLogDebug("cannot slide data symbol address {}", info.location);
         return std::nullopt;
     }
 
     std::string name = attributeReader.ReadName("", true);
     if (name.empty()) {
+        ctx_.ReportDiagnostic(DiagnosticKind::VariableWithoutName, die_.GetOffset());
         BDLogDebug("ignoring variable with no name, DIE: {}", dieReader_.Dump());
         return std::nullopt;
     }
@@ -61,7 +63,8 @@ std::optional<DwarfVariableInfo> VariableDecoder::Decode() {
     if (valueType) {
         info.type = GenericTypeBuilder{ctx_, *valueType}.Build();
     } else {
-        BDLogWarn("encountered variable with no type, DIE: {}", dieReader_.Dump());
+        ctx_.ReportDiagnostic(DiagnosticKind::VariableWithoutType, die_.GetOffset());
+        BDLogDebug("encountered variable with no type, DIE: {}", dieReader_.Dump());
         info.type = BN::Type::VoidType();
     }
     return info;
@@ -0,0 +1,44 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+namespace Binja::KCView {
+
+/// Returns the kernel address signed into value, or nullopt if value does
+/// not look like a PAC signed kernel pointer. Signed pointers carry a
+/// non canonical signature in the top 20 bits and keep 0xe in bits 40-43
+inline std::optional<uint64_t> StripPointerAuth(uint64_t value) {
+    uint32_t signature = value >> 44;
+    if (signature == 0 || signature == 0xfffff) {
+        return std::nullopt;
+    }
+    uint8_t checkField = (value >> 40) & 0xf;
+    if (checkField != 0xe) {
+        return std::nullopt;
+    }
+    return value | 0xfffff00000000000ULL;
+}
+
+}// namespace Binja::KCView
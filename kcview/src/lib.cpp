@@ -30,11 +30,15 @@
 #include <binja/macho/macho.h>
 #include <binja/utils/binary_view.h>
 #include <binja/utils/debug.h>
+#include <binja/utils/executor.h>
 #include <binja/utils/log.h>
+#include <binja/utils/metrics.h>
 #include <binja/utils/settings.h>
+#include <binja/utils/trace.h>
 
 #include "errors.h"
 #include "lib.h"
+#include "pac.h"
 #include "range.h"
 
 using namespace Binja;
@@ -87,7 +91,13 @@ public:
     }
 
     bool Init() override {
+        Utils::ReloadLogLevel();
+        Utils::Metrics::Instance().Reset();
+        Utils::TraceRecorder::Instance().Reset();
         ProcessKC();
+        Utils::WriteMetricsReport(*this);
+        Utils::WriteTraceEvents();
+        Utils::FlushSuppressedLogs();
         return true;
     }
 
@@ -179,6 +189,8 @@ public:
 
 private:
     void ProcessKC() {
+        Utils::ScopedPhase phase{"kcview.process_kc"};
+        Utils::ScopedTrace trace{"kcview", "process_kc"};
         VerifyKC();
         FindVAStart();
         ProcessBaseSegments();
@@ -199,10 +211,13 @@ private:
         }
 
         if (applyDyldChainedFixups_) {
+            Utils::ScopedPhase fixupsPhase{"kcview.apply_dyld_chained_fixups"};
+            Utils::ScopedTrace fixupsTrace{"kcview", "apply_dyld_chained_fixups"};
             std::vector<char> buffer{};
             buffer.resize(base_->GetLength());
             size_t read = base_->Read(buffer.data(), 0, buffer.size());
             BDVerify(read == buffer.size());
+            fixupsPhase.Add(Utils::Counter::BytesRead, read);
             ApplyDyldChainedFixups(std::span<char>{buffer.data(), buffer.size()});
             size_t wrote = base_->Write(0, buffer.data(), buffer.size());
             BDVerify(wrote == buffer.size());
@@ -286,6 +301,8 @@ private:
     }
 
     void ProcessFileset(const Fileset &fileset) {
+        Utils::ScopedPhase phase{"kcview.process_fileset"};
+        Utils::ScopedTrace trace{"kcview", "fileset {}", fileset.name};
         BDLogInfo("Adding fileset {}", fileset.name.c_str());
         auto segments = DecodeSegments(fileset.fileOffset);
         for (const auto &segment: segments) {
@@ -330,6 +347,7 @@ private:
     }
 
     void AddFilesetDataVariables(const Fileset &fileset) {
+        Utils::CountMetric(Utils::Counter::SymbolsAdded);
         NamedTypeReference ref{
             BNNamedTypeReferenceClass::StructNamedTypeClass,
             "", QualifiedName{"mach_header_64"}};
@@ -341,7 +359,8 @@ private:
     }
 
     void StripPAC() {
-        tf::Executor executor;
+        Utils::ScopedPhase phase{"kcview.strip_pac"};
+        Utils::ScopedTrace trace{"kcview", "strip_pac"};
         tf::Taskflow taskflow;
 
         std::atomic<size_t> totalXPACs = 0;
@@ -355,10 +374,13 @@ private:
                 return;
             }
 
+            Utils::ScopedPhase segmentPhase{"kcview.strip_pac_segment"};
+            Utils::ScopedTrace segmentTrace{"kcview", "strip_pac {} {:#016x}", segment.name, segment.vaStart};
             std::vector<uint64_t> data{};
             data.resize(segment.dataLength / 8);
             size_t dataSize = data.size() * 8;
             auto read = base_->Read(data.data(), segment.dataStart, dataSize);
+            segmentPhase.Add(Utils::Counter::BytesRead, read);
             if (read < dataSize) {
                 data.resize(read / 8);
                 dataSize = data.size() * 8;
@@ -366,16 +388,11 @@ private:
 
             size_t numXPAC = 0;
             for (auto it = data.begin(), end = data.end(); it != end; ++it) {
-                uint64_t value = *it;
-                uint32_t signature = value >> 44;
-                if (signature == 0 || signature == 0xfffff) {
+                auto stripped = KCView::StripPointerAuth(*it);
+                if (!stripped) {
                     continue;
                 }
-                uint8_t checkField = (value >> 40) & 0xf;
-                if (checkField != 0xe) {
-                    continue;
-                }
-                uint64_t address = value | 0xfffff00000000000ULL;
+                uint64_t address = *stripped;
                 if (address < vaStart_ || address >= vaStart_ + vaLength_ || va2RawMap_.Query(address) == nullptr) {
                     continue;
                 }
@@ -391,11 +408,13 @@ private:
             }
         });
 
-        executor.run(taskflow).wait();
+        Utils::RunAndWait(taskflow);
         BDLogInfo("XPACed total {} pointers", totalXPACs.load());
     }
 
     void DefineKallocTypeSymbols() {
+        Utils::ScopedPhase phase{"kcview.define_kalloc_type_symbols"};
+        Utils::ScopedTrace trace{"kcview", "define_kalloc_type_symbols"};
         const auto &segments = va2RawMap_.Values();
 
         NamedTypeReference kallocTypeRef{
@@ -437,6 +456,7 @@ private:
             }
         }
         EndBulkModifySymbols();
+        phase.Add(Utils::Counter::SymbolsAdded, totalSymbols);
         BDLogInfo("defined {} kalloc type (var) view symbols", totalSymbols);
     }
 
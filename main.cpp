@@ -22,10 +22,12 @@
 #include <binaryninjacore.h>
 
 #include <binja/utils/settings.h>
+#include <binja/debuginfo/plugin_combined.h>
 #include <binja/debuginfo/plugin_dsym.h>
 #include <binja/debuginfo/plugin_macho.h>
 #include <binja/debuginfo/plugin_symtab.h>
 #include <binja/debuginfo/plugin_function_starts.h>
+#include <binja/debuginfo/plugin_source_lines.h>
 #include <binja/kcview/lib.h>
 
 using namespace Binja;
@@ -39,6 +41,8 @@ BINARYNINJAPLUGIN bool CorePluginInit() {
     DebugInfo::PluginMacho::RegisterPlugin();
     DebugInfo::PluginSymtab::RegisterPlugin();
     DebugInfo::PluginFunctionStarts::RegisterPlugin();
+    DebugInfo::PluginCombined::RegisterPlugin();
+    DebugInfo::PluginSourceLines::RegisterPlugin();
     KCView::CorePluginInit();
     return true;
 }
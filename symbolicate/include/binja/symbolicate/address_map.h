@@ -0,0 +1,123 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <binja/utils/mapped_image.h>
+
+#include <binja/macho/macho.h>
+#include <binja/types/uuid.h>
+
+namespace Binja::Symbolicate {
+
+struct FilesetInfo {
+    std::string name;
+    // Address of the Mach-O header, offsets in panic logs are relative to it
+    uint64_t base;
+    Types::UUID uuid;
+    std::vector<MachO::Segment> segments;
+};
+
+struct FunctionInfo {
+    uint64_t start;
+    uint64_t end;
+    std::string name;
+    // DWARF ranges take precedence over the extents derived from the symtab
+    bool fromDebugInfo;
+};
+
+struct FilesetLocation {
+    // Points into the map, valid for as long as the map is alive
+    std::string_view name;
+    uint64_t base;
+};
+
+struct FunctionLocation {
+    std::string_view name;
+    uint64_t start;
+};
+
+/// Unslid address -> fileset and function of a kernel collection. Segments
+/// and functions are flat sorted range tables and a lookup is a binary
+/// search in each. Like the DWARF indexes, the serialized form is used as
+/// is and a saved map is memory mapped.
+class AddressMap {
+public:
+    static constexpr uint32_t kVersion = 1;
+
+    /// Serialized fileset, sorted by name
+    struct FilesetRecord {
+        uint64_t base;
+        // Offset into the string table
+        uint32_t name;
+        uint32_t reserved;
+        uint8_t uuid[16];
+    };
+
+    /// Serialized segment, sorted by address
+    struct SegmentRecord {
+        uint64_t start;
+        uint64_t end;
+        uint32_t fileset;
+        uint32_t reserved;
+    };
+
+public:
+    /// Overlapping functions are resolved in favour of DWARF ranges, then
+    /// of the function starting first
+    static AddressMap Build(const std::vector<FilesetInfo> &filesets, std::vector<FunctionInfo> functions);
+    static AddressMap Open(const std::filesystem::path &path);
+    /// Returns false when the map could not be written
+    bool Save(const std::filesystem::path &path) const;
+
+    [[nodiscard]] std::optional<FilesetLocation> FindFileset(uint64_t address) const;
+    [[nodiscard]] std::optional<FilesetLocation> FindFileset(std::string_view name) const;
+    [[nodiscard]] std::optional<FunctionLocation> FindFunction(uint64_t address) const;
+
+    [[nodiscard]] size_t GetFilesetCount() const { return filesets_.size(); }
+    [[nodiscard]] size_t GetFunctionCount() const { return functionStarts_.size(); }
+    [[nodiscard]] size_t GetSizeInBytes() const { return image_.GetSize(); }
+
+private:
+    AddressMap() = default;
+
+    void Attach(Utils::MappedImage image);
+    [[nodiscard]] FilesetLocation MakeFilesetLocation(const FilesetRecord &record) const;
+    [[nodiscard]] std::string_view GetString(uint32_t offset) const;
+
+private:
+    Utils::MappedImage image_;
+    std::span<const FilesetRecord> filesets_;
+    std::span<const SegmentRecord> segments_;
+    std::span<const uint64_t> functionStarts_;
+    std::span<const uint64_t> functionEnds_;
+    std::span<const uint32_t> functionNames_;
+    std::span<const char> strings_;
+};
+
+}// namespace Binja::Symbolicate
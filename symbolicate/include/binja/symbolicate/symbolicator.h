@@ -0,0 +1,80 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <binja/debuginfo/inline_index.h>
+#include <binja/debuginfo/line_index.h>
+
+#include "address_map.h"
+
+namespace Binja::Symbolicate {
+
+struct MapBuildOptions {
+    std::filesystem::path binary;
+    std::filesystem::path symbols;
+    std::filesystem::path manifestDirectory;
+};
+
+/// Decodes the filesets of `options.binary` and the dSYMs matching them in
+/// the KDK at `options.symbols`, and saves the address map, line index and
+/// inline index to `mapDirectory`. Nothing is loaded through Binary Ninja.
+void BuildSymbolMap(const MapBuildOptions &options, const std::filesystem::path &mapDirectory);
+
+/// Symbolicates addresses against the maps saved by BuildSymbolMap. All
+/// lookups are const, so a single instance is shared by every worker.
+class Symbolicator {
+public:
+    static Symbolicator Open(const std::filesystem::path &mapDirectory);
+
+    /// Parses "<fileset>+<offset>" or a hexadecimal address, which is slid by
+    /// `slide` and unslid by subtracting it
+    [[nodiscard]] std::optional<uint64_t> ResolveAddress(std::string_view input, uint64_t slide) const;
+    /// Appends one tab separated line describing `address` to `output`:
+    /// fileset and offset, function and offset, source line and the
+    /// inlined functions covering the address, innermost first
+    void Symbolicate(std::string_view input, uint64_t address, std::string &output,
+                     std::vector<DebugInfo::InlineFrame> &frames) const;
+    /// Symbolicates `inputs` in order on the shared executor and returns the
+    /// number of inputs resolved to an address
+    size_t SymbolicateBatch(std::span<const std::string_view> inputs, uint64_t slide, std::string &output) const;
+
+    [[nodiscard]] const AddressMap &GetAddressMap() const { return addressMap_; }
+
+private:
+    Symbolicator(AddressMap addressMap, DebugInfo::LineIndex lineIndex, DebugInfo::InlineIndex inlineIndex)
+        : addressMap_{std::move(addressMap)}, lineIndex_{std::move(lineIndex)},
+          inlineIndex_{std::move(inlineIndex)} {}
+
+private:
+    AddressMap addressMap_;
+    DebugInfo::LineIndex lineIndex_;
+    DebugInfo::InlineIndex inlineIndex_;
+};
+
+}// namespace Binja::Symbolicate
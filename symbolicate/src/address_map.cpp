@@ -0,0 +1,263 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+#include <binja/utils/log.h>
+
+#include "address_map.h"
+#include "errors.h"
+
+using namespace Binja;
+using namespace Symbolicate;
+
+namespace fs = std::filesystem;
+
+
+/// Encoding
+
+namespace {
+
+constexpr char kMagic[8] = {'B', 'K', 'C', 'A', 'D', 'M', 'A', 'P'};
+
+struct AddressMapHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t filesetCount;
+    uint64_t segmentCount;
+    uint64_t functionCount;
+    uint64_t stringsSize;
+};
+
+class StringTable {
+public:
+    uint32_t Intern(const std::string &value) {
+        auto [it, inserted] = offsets_.try_emplace(value, static_cast<uint32_t>(strings_.size()));
+        if (inserted) {
+            strings_.append(value);
+            strings_.push_back('\0');
+            if (strings_.size() >= UINT32_MAX) {
+                throw SymbolicateError{"address map string table too large"};
+            }
+        }
+        return it->second;
+    }
+
+    const std::string &GetStrings() const {
+        return strings_;
+    }
+
+private:
+    std::string strings_;
+    std::unordered_map<std::string, uint32_t> offsets_;
+};
+
+// Sorts by start and drops the functions overlapping an earlier one,
+// except DWARF ranges which cut a symtab extent short
+std::vector<FunctionInfo> ResolveOverlaps(std::vector<FunctionInfo> functions) {
+    std::sort(functions.begin(), functions.end(), [](const FunctionInfo &lhs, const FunctionInfo &rhs) {
+        if (lhs.start != rhs.start) {
+            return lhs.start < rhs.start;
+        }
+        return lhs.fromDebugInfo > rhs.fromDebugInfo;
+    });
+    std::vector<FunctionInfo> result;
+    result.reserve(functions.size());
+    for (auto &function: functions) {
+        if (function.start >= function.end) {
+            continue;
+        }
+        if (!result.empty() && function.start < result.back().end) {
+            FunctionInfo &previous = result.back();
+            if (!function.fromDebugInfo || previous.fromDebugInfo || previous.start == function.start) {
+                continue;
+            }
+            previous.end = function.start;
+        }
+        result.push_back(std::move(function));
+    }
+    return result;
+}
+
+}// namespace
+
+
+/// Address map
+
+AddressMap AddressMap::Build(const std::vector<FilesetInfo> &filesets, std::vector<FunctionInfo> functions) {
+    StringTable strings;
+
+    std::vector<const FilesetInfo *> sortedFilesets;
+    for (const auto &fileset: filesets) {
+        sortedFilesets.push_back(&fileset);
+    }
+    std::sort(sortedFilesets.begin(), sortedFilesets.end(), [](const FilesetInfo *lhs, const FilesetInfo *rhs) {
+        return lhs->name < rhs->name;
+    });
+
+    std::vector<FilesetRecord> filesetRecords;
+    std::vector<SegmentRecord> segmentRecords;
+    for (const FilesetInfo *fileset: sortedFilesets) {
+        auto index = static_cast<uint32_t>(filesetRecords.size());
+        FilesetRecord record{.base = fileset->base, .name = strings.Intern(fileset->name), .reserved = 0};
+        memcpy(record.uuid, fileset->uuid.data, sizeof(record.uuid));
+        filesetRecords.push_back(record);
+        for (const auto &segment: fileset->segments) {
+            if (segment.vaLength == 0) {
+                continue;
+            }
+            segmentRecords.push_back(SegmentRecord{
+                .start = segment.vaStart,
+                .end = segment.vaStart + segment.vaLength,
+                .fileset = index,
+                .reserved = 0});
+        }
+    }
+
+    // Filesets of a kernel collection share __LINKEDIT, the segment found first keeps it
+    std::sort(segmentRecords.begin(), segmentRecords.end(), [](const SegmentRecord &lhs, const SegmentRecord &rhs) {
+        return lhs.start < rhs.start;
+    });
+    std::vector<SegmentRecord> segments;
+    for (const auto &segment: segmentRecords) {
+        if (segments.empty() || segment.start >= segments.back().end) {
+            segments.push_back(segment);
+        }
+    }
+
+    std::vector<FunctionInfo> resolved = ResolveOverlaps(std::move(functions));
+    std::vector<uint64_t> functionStarts;
+    std::vector<uint64_t> functionEnds;
+    std::vector<uint32_t> functionNames;
+    functionStarts.reserve(resolved.size());
+    functionEnds.reserve(resolved.size());
+    functionNames.reserve(resolved.size());
+    for (const auto &function: resolved) {
+        functionStarts.push_back(function.start);
+        functionEnds.push_back(function.end);
+        functionNames.push_back(strings.Intern(function.name));
+    }
+
+    AddressMapHeader header{};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.filesetCount = filesetRecords.size();
+    header.segmentCount = segments.size();
+    header.functionCount = resolved.size();
+    header.stringsSize = strings.GetStrings().size();
+
+    Utils::MappedImage::Writer writer{header};
+    writer.AppendSection(filesetRecords);
+    writer.AppendSection(segments);
+    writer.AppendSection(functionStarts);
+    writer.AppendSection(functionEnds);
+    writer.AppendSection(functionNames);
+    writer.AppendSection(strings.GetStrings());
+
+    AddressMap map;
+    map.Attach(std::move(writer).Finish());
+    BDLogInfo("built address map with {} filesets, {} segments and {} functions, {} bytes",
+              filesetRecords.size(), segments.size(), resolved.size(), map.GetSizeInBytes());
+    return map;
+}
+
+AddressMap AddressMap::Open(const fs::path &path) {
+    AddressMap map;
+    map.Attach(Utils::MappedImage::Open(path, "address map"));
+    return map;
+}
+
+bool AddressMap::Save(const fs::path &path) const {
+    return image_.Save(path, "address map");
+}
+
+void AddressMap::Attach(Utils::MappedImage image) {
+    image_ = std::move(image);
+    Utils::MappedImage::Reader reader{image_.GetImage(), "address map"};
+    auto header = reader.ReadHeader<AddressMapHeader>(kMagic, kVersion);
+    filesets_ = reader.ReadSection<FilesetRecord>(header.filesetCount);
+    segments_ = reader.ReadSection<SegmentRecord>(header.segmentCount);
+    functionStarts_ = reader.ReadSection<uint64_t>(header.functionCount);
+    functionEnds_ = reader.ReadSection<uint64_t>(header.functionCount);
+    functionNames_ = reader.ReadSection<uint32_t>(header.functionCount);
+    strings_ = reader.ReadSection<char>(header.stringsSize);
+
+    if (!strings_.empty() && strings_.back() != '\0') {
+        throw SymbolicateError{"unterminated address map string table"};
+    }
+    for (const auto &fileset: filesets_) {
+        if (fileset.name >= strings_.size()) {
+            throw SymbolicateError{"address map fileset name {} out of bounds", fileset.name};
+        }
+    }
+    for (const auto &segment: segments_) {
+        if (segment.fileset >= filesets_.size()) {
+            throw SymbolicateError{"address map segment fileset {} out of bounds", segment.fileset};
+        }
+    }
+    for (uint32_t name: functionNames_) {
+        if (name >= strings_.size()) {
+            throw SymbolicateError{"address map function name {} out of bounds", name};
+        }
+    }
+}
+
+std::string_view AddressMap::GetString(uint32_t offset) const {
+    return std::string_view{strings_.data() + offset};
+}
+
+FilesetLocation AddressMap::MakeFilesetLocation(const FilesetRecord &record) const {
+    return FilesetLocation{.name = GetString(record.name), .base = record.base};
+}
+
+std::optional<FilesetLocation> AddressMap::FindFileset(uint64_t address) const {
+    auto it = std::upper_bound(segments_.begin(), segments_.end(), address, [](uint64_t address, const SegmentRecord &segment) {
+        return address < segment.start;
+    });
+    if (it == segments_.begin() || address >= std::prev(it)->end) {
+        return std::nullopt;
+    }
+    return MakeFilesetLocation(filesets_[std::prev(it)->fileset]);
+}
+
+std::optional<FilesetLocation> AddressMap::FindFileset(std::string_view name) const {
+    auto it = std::lower_bound(filesets_.begin(), filesets_.end(), name, [this](const FilesetRecord &fileset, std::string_view name) {
+        return GetString(fileset.name) < name;
+    });
+    if (it == filesets_.end() || GetString(it->name) != name) {
+        return std::nullopt;
+    }
+    return MakeFilesetLocation(*it);
+}
+
+std::optional<FunctionLocation> AddressMap::FindFunction(uint64_t address) const {
+    auto it = std::upper_bound(functionStarts_.begin(), functionStarts_.end(), address);
+    if (it == functionStarts_.begin()) {
+        return std::nullopt;
+    }
+    size_t index = it - functionStarts_.begin() - 1;
+    if (address >= functionEnds_[index]) {
+        return std::nullopt;
+    }
+    return FunctionLocation{.name = GetString(functionNames_[index]), .start = functionStarts_[index]};
+}
@@ -0,0 +1,421 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+#include <map>
+
+#include <fmt/format.h>
+#include <llvm/DebugInfo/DIContext.h>
+#include <llvm/DebugInfo/DWARF/DWARFDie.h>
+#include <llvm/DebugInfo/DWARF/DWARFUnit.h>
+#include <taskflow/taskflow.hpp>
+
+#include <binja/debuginfo/dwarf_task.h>
+#include <binja/debuginfo/manifest.h>
+#include <binja/utils/demangle.h>
+#include <binja/utils/executor.h>
+#include <binja/utils/log.h>
+#include <binja/utils/metrics.h>
+#include <binja/utils/segment_table.h>
+#include <binja/utils/trace.h>
+
+#include "errors.h"
+#include "symbolicator.h"
+
+using namespace Binja;
+using namespace Symbolicate;
+
+using DebugInfo::DwarfContextWrapper;
+using DebugInfo::InlineFrame;
+using DebugInfo::InlineIndex;
+using DebugInfo::LineIndex;
+
+namespace DW = llvm::dwarf;
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr const char *kAddressMapFileName = "addresses.bin";
+constexpr const char *kLineIndexFileName = "lines.bin";
+constexpr const char *kInlineIndexFileName = "inlines.bin";
+
+// Inputs symbolicated by one task of a batch
+constexpr size_t kBatchChunkSize = 4096;
+
+std::string DemangleShortName(std::string_view name, Utils::DemangleCache &demangleCache) {
+    if (name.starts_with("_Z")) {
+        if (auto demangled = Utils::DemangleName(name, &demangleCache)) {
+            return demangled->shortName;
+        }
+    }
+    return std::string{name};
+}
+
+std::string_view Trim(std::string_view value) {
+    size_t begin = value.find_first_not_of(" \t\r");
+    if (begin == std::string_view::npos) {
+        return {};
+    }
+    size_t end = value.find_last_not_of(" \t\r");
+    return value.substr(begin, end - begin + 1);
+}
+
+std::optional<uint64_t> ParseHex(std::string_view value) {
+    if (value.starts_with("0x") || value.starts_with("0X")) {
+        value.remove_prefix(2);
+    }
+    uint64_t result = 0;
+    auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), result, 16);
+    if (value.empty() || error != std::errc{} || end != value.data() + value.size()) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+}// namespace
+
+
+/// Fileset decoding
+
+namespace {
+
+struct MachHeaderLocation {
+    std::string name;
+    uint64_t offset;
+    // Unset for a binary without filesets, which is based at its __TEXT
+    std::optional<uint64_t> base;
+};
+
+struct DecodedFileset {
+    std::optional<FilesetInfo> fileset;
+    std::vector<FunctionInfo> functions;
+};
+
+// Symbols in code sections extend up to the next symbol or function start
+// within their section
+std::vector<FunctionInfo> DecodeSymtabFunctions(MachO::MachHeaderParser &parser,
+                                                const std::vector<MachO::Segment> &segments,
+                                                Utils::DemangleCache &demangleCache) {
+    std::vector<Utils::SegmentRange> codeSections;
+    for (const auto &segment: segments) {
+        for (const auto &section: segment.sections) {
+            if (section.semantics == BNSectionSemantics::ReadOnlyCodeSectionSemantics && section.vaLength > 0) {
+                codeSections.push_back({section.vaStart, section.vaStart + section.vaLength, segment.flags});
+            }
+        }
+    }
+    Utils::SegmentTable codeTable{std::move(codeSections)};
+
+    std::vector<MachO::Symbol> symbols = parser.DecodeSymbols();
+    std::erase_if(symbols, [&](const MachO::Symbol &symbol) {
+        return !codeTable.Find(symbol.addr);
+    });
+    std::stable_sort(symbols.begin(), symbols.end(), [](const MachO::Symbol &lhs, const MachO::Symbol &rhs) {
+        return lhs.addr < rhs.addr;
+    });
+
+    std::vector<uint64_t> boundaries = parser.DecodeFunctionStarts();
+    for (const auto &symbol: symbols) {
+        boundaries.push_back(symbol.addr);
+    }
+    std::sort(boundaries.begin(), boundaries.end());
+    boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+
+    std::vector<FunctionInfo> functions;
+    for (size_t i = 0; i < symbols.size(); ++i) {
+        // Aliases keep the name found first in the symtab
+        if (i > 0 && symbols[i].addr == symbols[i - 1].addr) {
+            continue;
+        }
+        uint64_t start = symbols[i].addr;
+        uint64_t end = codeTable.Find(start)->end;
+        auto next = std::upper_bound(boundaries.begin(), boundaries.end(), start);
+        if (next != boundaries.end()) {
+            end = std::min(end, *next);
+        }
+        functions.push_back(FunctionInfo{
+            .start = start,
+            .end = end,
+            .name = DemangleShortName(symbols[i].name, demangleCache),
+            .fromDebugInfo = false});
+    }
+    return functions;
+}
+
+DecodedFileset DecodeFileset(const MachO::MachDataBackend &backend, const MachHeaderLocation &location,
+                             Utils::DemangleCache &demangleCache) {
+    MachO::MachHeaderParser parser{backend, location.offset};
+    auto uuid = parser.DecodeUUID();
+    if (!uuid) {
+        BDLogWarn("mach header of {} does not have LC_UUID command, it won't be symbolicated", location.name);
+        return {};
+    }
+
+    std::vector<MachO::Segment> segments = parser.DecodeSegments();
+    uint64_t base = 0;
+    if (location.base) {
+        base = *location.base;
+    } else {
+        auto text = std::find_if(segments.begin(), segments.end(), [](const MachO::Segment &segment) {
+            return segment.name == "__TEXT";
+        });
+        base = text != segments.end() ? text->vaStart : 0;
+    }
+
+    DecodedFileset result;
+    result.functions = DecodeSymtabFunctions(parser, segments, demangleCache);
+    result.fileset = FilesetInfo{
+        .name = location.name,
+        .base = base,
+        .uuid = *uuid,
+        .segments = std::move(segments)};
+    return result;
+}
+
+}// namespace
+
+
+/// DWARF function decoding
+
+namespace {
+
+std::vector<FunctionInfo> DecodeDwarfFunctions(DwarfContextWrapper &dwarfContext, Utils::DemangleCache &demangleCache) {
+    Utils::ScopedPhase phase{"symbolicate.dwarf_functions"};
+    Utils::ScopedTrace trace{"symbolicate", "dwarf_functions"};
+    std::vector<DebugInfo::DwarfUnitWrapper> units = dwarfContext.GetNormalUnitsVector();
+
+    dwarfContext.PrepareConcurrentReads();
+
+    std::vector<std::vector<FunctionInfo>> unitFunctions(units.size());
+    tf::Taskflow taskflow;
+    taskflow.for_each_index(size_t{0}, units.size(), size_t{1}, [&](size_t i) {
+        Utils::ScopedPhase unitPhase{"symbolicate.dwarf_unit"};
+        llvm::DWARFUnit &unit = units[i].GetUnit();
+        DebugInfo::DwarfOffset binary{.binaryId = units[i].GetBinaryId(), .offset = 0};
+        for (const llvm::DWARFDebugInfoEntry &entry: unit.dies()) {
+            if (entry.getTag() != DW::DW_TAG_subprogram) {
+                continue;
+            }
+            llvm::DWARFDie die{&unit, &entry};
+            auto ranges = die.getAddressRanges();
+            if (!ranges) {
+                llvm::consumeError(ranges.takeError());
+                continue;
+            }
+            if (ranges->empty()) {
+                continue;
+            }
+            const char *name = die.getSubroutineName(llvm::DINameKind::LinkageName);
+            if (!name) {
+                continue;
+            }
+            std::string shortName = DemangleShortName(name, demangleCache);
+            for (const auto &range: *ranges) {
+                if (range.LowPC >= range.HighPC) {
+                    continue;
+                }
+                auto begin = dwarfContext.GetSlidAddress(binary, range.LowPC);
+                auto last = dwarfContext.GetSlidAddress(binary, range.HighPC - 1);
+                if (!begin || !last || *last - *begin != range.HighPC - 1 - range.LowPC) {
+                    continue;
+                }
+                unitFunctions[i].push_back(FunctionInfo{
+                    .start = *begin,
+                    .end = *last + 1,
+                    .name = shortName,
+                    .fromDebugInfo = true});
+            }
+        }
+    });
+    Utils::RunAndWait(taskflow);
+
+    std::vector<FunctionInfo> functions;
+    for (auto &unit: unitFunctions) {
+        std::move(unit.begin(), unit.end(), std::back_inserter(functions));
+    }
+    phase.Add(Utils::Counter::SymbolsAdded, functions.size());
+    BDLogInfo("decoded {} dwarf function ranges from {} units", functions.size(), units.size());
+    return functions;
+}
+
+}// namespace
+
+
+/// Symbol map
+
+void Symbolicate::BuildSymbolMap(const MapBuildOptions &options, const fs::path &mapDirectory) {
+    Utils::ScopedPhase phase{"symbolicate.build_map"};
+    Utils::ScopedTrace trace{"symbolicate", "build_map"};
+
+    std::error_code ec;
+    mio::mmap_source binary;
+    binary.map(options.binary.string(), ec);
+    if (ec) {
+        throw SymbolicateError{"failed to open {}, error: {}", options.binary.string(), ec.message()};
+    }
+    phase.Add(Utils::Counter::BytesRead, binary.size());
+    MachO::MachSpanDataBackend backend{{binary.data(), binary.size()}};
+
+    std::vector<MachHeaderLocation> headers;
+    for (const auto &fileset: MachO::MachHeaderParser{backend, 0}.DecodeFilesets()) {
+        headers.push_back(MachHeaderLocation{.name = fileset.name, .offset = fileset.fileOffset, .base = fileset.vmAddr});
+    }
+    if (headers.empty()) {
+        headers.push_back(MachHeaderLocation{.name = options.binary.filename().string(), .offset = 0});
+    }
+
+    // Headers only read the mapped file, so filesets are decoded concurrently
+    Utils::DemangleCache demangleCache;
+    std::vector<DecodedFileset> decoded(headers.size());
+    tf::Taskflow taskflow;
+    taskflow.for_each_index(size_t{0}, headers.size(), size_t{1}, [&](size_t i) {
+        Utils::ScopedPhase filesetPhase{"symbolicate.decode_fileset"};
+        try {
+            decoded[i] = DecodeFileset(backend, headers[i], demangleCache);
+        } catch (const Types::DecodeError &e) {
+            BDLogWarn("failed to decode mach header of {}, error: {}", headers[i].name, e.what());
+        }
+    });
+    Utils::RunAndWait(taskflow);
+
+    std::vector<FilesetInfo> filesets;
+    std::vector<FunctionInfo> functions;
+    std::map<Types::UUID, std::vector<MachO::Segment>> targets;
+    for (auto &entry: decoded) {
+        if (!entry.fileset) {
+            continue;
+        }
+        targets[entry.fileset->uuid] = entry.fileset->segments;
+        filesets.push_back(std::move(*entry.fileset));
+        std::move(entry.functions.begin(), entry.functions.end(), std::back_inserter(functions));
+    }
+    BDLogInfo("decoded {} filesets with {} symtab functions", filesets.size(), functions.size());
+
+    auto manifest = DebugInfo::KDKManifest::Open(options.symbols, options.manifestDirectory);
+    auto dwarfObjects = manifest.ResolveObjects(DebugInfo::KDKObjectKind::DwarfObject, targets);
+    BDLogInfo("found {} dwarf objects matching the filesets at {}", dwarfObjects.size(), options.symbols.string());
+
+    DwarfContextWrapper dwarfContext = DebugInfo::DwarfImportTask::BuildDwarfContext(dwarfObjects, targets);
+    auto dwarfFunctions = DecodeDwarfFunctions(dwarfContext, demangleCache);
+    std::move(dwarfFunctions.begin(), dwarfFunctions.end(), std::back_inserter(functions));
+    LineIndex lineIndex = LineIndex::Build(dwarfContext);
+    InlineIndex inlineIndex = InlineIndex::Build(dwarfContext);
+    AddressMap addressMap = AddressMap::Build(filesets, std::move(functions));
+
+    fs::create_directories(mapDirectory);
+    bool saved = addressMap.Save(mapDirectory / kAddressMapFileName) &&
+                 lineIndex.Save(mapDirectory / kLineIndexFileName) &&
+                 inlineIndex.Save(mapDirectory / kInlineIndexFileName);
+    if (!saved) {
+        throw SymbolicateError{"failed to save symbol map to {}", mapDirectory.string()};
+    }
+}
+
+
+/// Symbolicator
+
+Symbolicator Symbolicator::Open(const fs::path &mapDirectory) {
+    return Symbolicator{
+        AddressMap::Open(mapDirectory / kAddressMapFileName),
+        LineIndex::Open(mapDirectory / kLineIndexFileName),
+        InlineIndex::Open(mapDirectory / kInlineIndexFileName)};
+}
+
+std::optional<uint64_t> Symbolicator::ResolveAddress(std::string_view input, uint64_t slide) const {
+    input = Trim(input);
+    size_t plus = input.rfind('+');
+    if (plus == std::string_view::npos) {
+        auto address = ParseHex(input);
+        if (!address) {
+            return std::nullopt;
+        }
+        return *address - slide;
+    }
+
+    auto fileset = addressMap_.FindFileset(Trim(input.substr(0, plus)));
+    auto offset = ParseHex(Trim(input.substr(plus + 1)));
+    if (!fileset || !offset) {
+        return std::nullopt;
+    }
+    return fileset->base + *offset;
+}
+
+void Symbolicator::Symbolicate(std::string_view input, uint64_t address, std::string &output,
+                               std::vector<InlineFrame> &frames) const {
+    auto out = std::back_inserter(output);
+    fmt::format_to(out, "{}\t{:#016x}", input, address);
+    if (auto fileset = addressMap_.FindFileset(address)) {
+        fmt::format_to(out, "\t{}+{:#x}", fileset->name, address - fileset->base);
+    } else {
+        output.append("\t??");
+    }
+    if (auto function = addressMap_.FindFunction(address)) {
+        fmt::format_to(out, "\t{}+{:#x}", function->name, address - function->start);
+    } else {
+        output.append("\t??");
+    }
+    if (auto location = lineIndex_.Lookup(address)) {
+        fmt::format_to(out, "\t{}:{}", location->file, location->line);
+    } else {
+        output.append("\t??");
+    }
+    inlineIndex_.Lookup(address, frames);
+    for (const auto &frame: frames) {
+        if (frame.callFile.empty()) {
+            fmt::format_to(out, "\tinlined {}", frame.function);
+        } else {
+            fmt::format_to(out, "\tinlined {} at {}:{}", frame.function, frame.callFile, frame.callLine);
+        }
+    }
+    output.push_back('\n');
+}
+
+size_t Symbolicator::SymbolicateBatch(std::span<const std::string_view> inputs, uint64_t slide,
+                                      std::string &output) const {
+    size_t numChunks = (inputs.size() + kBatchChunkSize - 1) / kBatchChunkSize;
+    std::vector<std::string> chunkOutputs(numChunks);
+    std::vector<size_t> chunkResolved(numChunks);
+    tf::Taskflow taskflow;
+    taskflow.for_each_index(size_t{0}, numChunks, size_t{1}, [&](size_t chunk) {
+        std::vector<InlineFrame> frames;
+        std::string &chunkOutput = chunkOutputs[chunk];
+        size_t end = std::min(inputs.size(), (chunk + 1) * kBatchChunkSize);
+        for (size_t i = chunk * kBatchChunkSize; i < end; ++i) {
+            std::string_view input = Trim(inputs[i]);
+            if (auto address = ResolveAddress(input, slide)) {
+                Symbolicate(input, *address, chunkOutput, frames);
+                ++chunkResolved[chunk];
+            } else {
+                chunkOutput.append(input);
+                chunkOutput.append("\t??\n");
+            }
+        }
+    });
+    Utils::RunAndWait(taskflow);
+
+    size_t numResolved = 0;
+    for (size_t chunk = 0; chunk < numChunks; ++chunk) {
+        output.append(chunkOutputs[chunk]);
+        numResolved += chunkResolved[chunk];
+    }
+    return numResolved;
+}
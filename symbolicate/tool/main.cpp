@@ -0,0 +1,233 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <binaryninjaapi.h>
+#include <fmt/format.h>
+
+#include <binja/debuginfo/errors.h>
+#include <binja/debuginfo/manifest.h>
+#include <binja/symbolicate/symbolicator.h>
+#include <binja/types/errors.h>
+#include <binja/utils/executor.h>
+#include <binja/utils/log.h>
+
+using namespace Binja;
+namespace fs = std::filesystem;
+
+namespace {
+
+// Input lines read and symbolicated at a time
+constexpr size_t kReadBatchLines = size_t{1} << 18;
+
+// Invalid command line, reported together with the usage
+class ArgumentError : public Types::GenericException {
+    using Types::GenericException::GenericException;
+};
+
+struct ToolOptions {
+    std::string_view command;
+    fs::path binary;
+    fs::path symbols;
+    fs::path manifestDirectory = DebugInfo::KDKManifest::DefaultDirectory();
+    fs::path map;
+    fs::path input;
+    fs::path output;
+    uint64_t slide = 0;
+    size_t numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+};
+
+void PrintUsage(const char *program) {
+    std::cerr << "USAGE: " << program << " build --binary <kernelcache> --symbols <KDK> --map <directory> [--<option> <value>]...\n"
+              << "       " << program << " lookup --map <directory> [--<option> <value>]...\n"
+              << "options:\n"
+              << "  --manifest-dir <directory>  KDK manifest directory, default " << DebugInfo::KDKManifest::DefaultDirectory().string() << "\n"
+              << "  --threads <n>               worker threads, default the core count\n"
+              << "  --slide <hex>               slide subtracted from addresses in the input, default 0\n"
+              << "  --input <file>              addresses, one per line as <fileset>+<offset> or <address>, default stdin\n"
+              << "  --output <file>             symbolicated addresses, default stdout\n";
+}
+
+uint64_t ParseNumber(std::string_view option, std::string_view value, int base) {
+    if (base == 16 && (value.starts_with("0x") || value.starts_with("0X"))) {
+        value.remove_prefix(2);
+    }
+    uint64_t result = 0;
+    auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), result, base);
+    if (error != std::errc{} || end != value.data() + value.size()) {
+        throw ArgumentError{"invalid value {} for option {}", value, option};
+    }
+    return result;
+}
+
+ToolOptions ParseArguments(int argc, const char **argv) {
+    if (argc < 2) {
+        throw ArgumentError{"missing command"};
+    }
+    ToolOptions options;
+    options.command = argv[1];
+    if (options.command != "build" && options.command != "lookup") {
+        throw ArgumentError{"unknown command {}", options.command};
+    }
+    for (int i = 2; i < argc; ++i) {
+        std::string_view option = argv[i];
+        if (i + 1 >= argc) {
+            throw ArgumentError{"missing value for option {}", option};
+        }
+        std::string_view value = argv[++i];
+        if (option == "--binary") {
+            options.binary = value;
+        } else if (option == "--symbols") {
+            options.symbols = value;
+        } else if (option == "--manifest-dir") {
+            options.manifestDirectory = value;
+        } else if (option == "--map") {
+            options.map = value;
+        } else if (option == "--input") {
+            options.input = value;
+        } else if (option == "--output") {
+            options.output = value;
+        } else if (option == "--slide") {
+            options.slide = ParseNumber(option, value, 16);
+        } else if (option == "--threads") {
+            options.numThreads = std::max<uint64_t>(ParseNumber(option, value, 10), 1);
+        } else {
+            throw ArgumentError{"unknown option {}", option};
+        }
+    }
+
+    if (options.map.empty()) {
+        throw ArgumentError{"missing option --map"};
+    }
+    if (options.command == "build" && (options.binary.empty() || options.symbols.empty())) {
+        throw ArgumentError{"missing option --binary or --symbols"};
+    }
+    return options;
+}
+
+int RunBuild(const ToolOptions &options) {
+    auto start = std::chrono::steady_clock::now();
+    Symbolicate::BuildSymbolMap(
+        Symbolicate::MapBuildOptions{
+            .binary = options.binary,
+            .symbols = options.symbols,
+            .manifestDirectory = options.manifestDirectory},
+        options.map);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << fmt::format("built symbol map {} in {:.3f} s\n", options.map.string(), seconds);
+    return 0;
+}
+
+int RunLookup(const ToolOptions &options) {
+    auto symbolicator = Symbolicate::Symbolicator::Open(options.map);
+
+    std::ifstream inputFile;
+    std::istream *input = &std::cin;
+    if (!options.input.empty()) {
+        inputFile.open(options.input);
+        if (!inputFile) {
+            throw Types::GenericException{"failed to open {}", options.input.string()};
+        }
+        input = &inputFile;
+    }
+    std::ofstream outputFile;
+    std::ostream *output = &std::cout;
+    if (!options.output.empty()) {
+        outputFile.open(options.output, std::ios::trunc);
+        if (!outputFile) {
+            throw Types::GenericException{"failed to open {}", options.output.string()};
+        }
+        output = &outputFile;
+    }
+
+    std::vector<std::string> lines;
+    std::vector<std::string_view> inputs;
+    std::string text;
+    size_t numInputs = 0;
+    size_t numResolved = 0;
+    double lookupSeconds = 0;
+    while (true) {
+        lines.clear();
+        std::string line;
+        while (lines.size() < kReadBatchLines && std::getline(*input, line)) {
+            lines.push_back(std::move(line));
+        }
+        if (lines.empty()) {
+            break;
+        }
+
+        // Reading and writing the streams is not part of the lookup rate
+        inputs.assign(lines.begin(), lines.end());
+        text.clear();
+        auto start = std::chrono::steady_clock::now();
+        numResolved += symbolicator.SymbolicateBatch(inputs, options.slide, text);
+        lookupSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        numInputs += lines.size();
+        output->write(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+    output->flush();
+
+    double lookupsPerSecond = lookupSeconds > 0 ? numInputs / lookupSeconds : 0;
+    std::cerr << fmt::format("symbolicated {} of {} addresses with {} threads in {:.3f} s, {:.0f} lookups/s\n",
+                             numResolved, numInputs, options.numThreads, lookupSeconds, lookupsPerSecond);
+    return *output ? 0 : 1;
+}
+
+}// namespace
+
+int main(int argc, const char **argv) {
+    ToolOptions options;
+    try {
+        options = ParseArguments(argc, argv);
+    } catch (const ArgumentError &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    try {
+        // Binary Ninja is not initialized, messages only go to stderr
+        BNLogLevel logLevel = options.command == "build" ? BNLogLevel::InfoLog : BNLogLevel::WarningLog;
+        Utils::gLogLevel.store(logLevel);
+        BinaryNinja::LogToStderr(logLevel);
+        Utils::SetSharedExecutorThreadCount(options.numThreads);
+
+        if (options.command == "build") {
+            return RunBuild(options);
+        }
+        return RunLookup(options);
+    } catch (const Types::GenericException &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    } catch (const DebugInfo::GenericException &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    } catch (const fs::filesystem_error &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
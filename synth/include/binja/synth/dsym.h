@@ -0,0 +1,81 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <binja/types/uuid.h>
+
+#include "kernelcache.h"
+
+namespace Binja::Synth {
+
+/// Shape of the DWARF in the dSYMs generated for a kernelcache. Counts
+/// are per compile unit unless stated otherwise
+struct DSYMOptions {
+    size_t unitsPerObject = 4;
+    size_t namespaceDepth = 3;
+    size_t structsPerUnit = 32;
+    size_t membersPerStruct = 8;
+    size_t bitfieldsPerStruct = 2;
+    size_t enumsPerUnit = 8;
+    size_t enumeratorsPerEnum = 8;
+    size_t forwardDeclarationsPerUnit = 8;
+    size_t functionsPerUnit = 16;
+    size_t globalsPerUnit = 16;
+    // Percentage of the structs of a unit named from a pool shared by all
+    // units of all objects. Duplicates have the same layout everywhere,
+    // conflicts have a layout that differs between units
+    size_t duplicatePercent = 40;
+    size_t conflictPercent = 10;
+    // Addresses in the dSYM are unslid kernelcache addresses minus slide
+    uint64_t slide = 0;
+    uint64_t seed = 0;
+};
+
+struct SyntheticDSYM {
+    std::string name;
+    Types::UUID uuid;
+    std::vector<char> data;
+    size_t numUnits;
+    size_t numTypes;
+    size_t numFunctions;
+    size_t numGlobals;
+};
+
+/// Emits one arm64 MH_DSYM per fileset of kc carrying its LC_UUID and
+/// segments, and a __DWARF segment with DWARF v4 __debug_abbrev,
+/// __debug_info and __debug_str sections. Units nest their types in
+/// namespaces namespaceDepth deep, a namespace chain shared by all units
+/// holds the duplicate, conflicting and forward declared structs.
+/// Functions are emitted for the fileset symbols and globals are placed
+/// in the last data segment of the fileset
+std::vector<SyntheticDSYM> GenerateDSYMs(const SyntheticKernelCache &kc, const DSYMOptions &options);
+
+/// Writes dsym as directory/<name>.dSYM/Contents/Resources/DWARF/<name>,
+/// the layout of the dSYM bundles in a KDK, and returns the bundle path
+std::filesystem::path WriteDSYMBundle(const std::filesystem::path &directory, const SyntheticDSYM &dsym);
+
+}// namespace Binja::Synth
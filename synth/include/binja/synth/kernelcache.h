@@ -0,0 +1,91 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <binja/types/uuid.h>
+
+namespace Binja::Synth {
+
+/// Shape of a generated kernelcache. Counts of pointers are per page of
+/// every data segment, so they scale with the size of the image
+struct KernelCacheOptions {
+    size_t numFilesets = 4;
+    size_t dataSegmentsPerFileset = 2;
+    size_t sectionsPerSegment = 2;
+    size_t pagesPerSegment = 4;
+    size_t symbolsPerFileset = 64;
+    size_t functionStartsPerFileset = 64;
+    size_t chainedPointersPerPage = 16;
+    size_t pacPointersPerPage = 16;
+    bool kallocTypeSection = false;
+    uint64_t vmBase = 0xfffffe0007004000ULL;
+    uint64_t seed = 0;
+};
+
+struct SyntheticSymbol {
+    std::string name;
+    uint64_t addr;
+};
+
+struct SyntheticSegment {
+    std::string name;
+    uint64_t vmAddr;
+    uint64_t vmSize;
+};
+
+struct SyntheticFileset {
+    std::string name;
+    Types::UUID uuid;
+    uint64_t vmAddr;
+    uint64_t fileOffset;
+    uint64_t textStart;
+    uint64_t textLength;
+    std::vector<SyntheticSegment> segments;
+    std::vector<SyntheticSymbol> symbols;
+    std::vector<uint64_t> functionStarts;
+};
+
+struct SyntheticKernelCache {
+    std::vector<char> data;
+    std::vector<SyntheticFileset> filesets;
+    uint64_t vmBase;
+    uint64_t entryPoint;
+    size_t numChainedPointers;
+    size_t numPACPointers;
+};
+
+/// Emits an arm64e MH_FILESET image laid out like a release kernelcache:
+/// a top level header with one LC_FILESET_ENTRY per fileset, per fileset
+/// Mach-O headers grouped in __PRELINK_TEXT, segments grouped by kind and
+/// a shared __LINKEDIT holding DYLD_CHAINED_PTR_64_KERNEL_CACHE fixups,
+/// symbol tables and function starts. File offsets equal VM offsets.
+/// Output only depends on the options, the seed included
+SyntheticKernelCache GenerateKernelCache(const KernelCacheOptions &options);
+
+void WriteImage(const std::filesystem::path &path, const std::vector<char> &data);
+
+}// namespace Binja::Synth
@@ -0,0 +1,126 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include <llvm/BinaryFormat/MachO.h>
+
+#include <binja/types/uuid.h>
+#include <binja/utils/debug.h>
+
+namespace Binja::Synth {
+
+inline uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+/// Appends little endian values to a byte vector, growing it as needed.
+/// Writes at offsets before the end overwrite the existing bytes
+class ByteWriter {
+public:
+    ByteWriter(std::vector<char> &data, uint64_t offset)
+        : data_{data}, offset_{offset} {}
+
+    template<class T>
+    void Write(const T &value) {
+        WriteBytes(&value, sizeof(T));
+    }
+
+    template<class T>
+    void Patch(uint64_t offset, const T &value) {
+        BDVerify(offset + sizeof(T) <= data_.size());
+        memcpy(data_.data() + offset, &value, sizeof(T));
+    }
+
+    void WriteBytes(const void *bytes, size_t length) {
+        if (offset_ + length > data_.size()) {
+            data_.resize(offset_ + length);
+        }
+        memcpy(data_.data() + offset_, bytes, length);
+        offset_ += length;
+    }
+
+    void WriteString(std::string_view value) {
+        WriteBytes(value.data(), value.size());
+        Write<char>('\0');
+    }
+
+    void WriteULEB128(uint64_t value) {
+        do {
+            uint8_t byte = value & 0x7f;
+            value >>= 7;
+            if (value != 0) {
+                byte |= 0x80;
+            }
+            Write(byte);
+        } while (value != 0);
+    }
+
+    void WriteSLEB128(int64_t value) {
+        bool more;
+        do {
+            uint8_t byte = value & 0x7f;
+            value >>= 7;
+            more = !((value == 0 && !(byte & 0x40)) || (value == -1 && (byte & 0x40)));
+            if (more) {
+                byte |= 0x80;
+            }
+            Write(byte);
+        } while (more);
+    }
+
+    void Align(uint64_t alignment) {
+        uint64_t aligned = AlignUp(offset_, alignment);
+        if (aligned > data_.size()) {
+            data_.resize(aligned);
+        }
+        offset_ = aligned;
+    }
+
+    [[nodiscard]] uint64_t Offset() const { return offset_; }
+
+private:
+    std::vector<char> &data_;
+    uint64_t offset_;
+};
+
+template<size_t N>
+void CopyName(char (&dest)[N], std::string_view name) {
+    BDVerify(name.size() <= N);
+    memset(dest, 0, N);
+    memcpy(dest, name.data(), name.size());
+}
+
+inline void WriteUUIDCommand(ByteWriter &writer, const Types::UUID &uuid) {
+    llvm::MachO::uuid_command cmd{};
+    cmd.cmd = llvm::MachO::LC_UUID;
+    cmd.cmdsize = sizeof(cmd);
+    static_assert(sizeof(cmd.uuid) == sizeof(uuid.data));
+    memcpy(cmd.uuid, uuid.data, sizeof(cmd.uuid));
+    writer.Write(cmd);
+}
+
+}// namespace Binja::Synth
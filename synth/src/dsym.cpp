@@ -0,0 +1,744 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <map>
+#include <optional>
+#include <random>
+#include <string_view>
+
+#include <fmt/format.h>
+#include <llvm/BinaryFormat/Dwarf.h>
+#include <llvm/BinaryFormat/MachO.h>
+
+#include <binja/utils/debug.h>
+
+#include "dsym.h"
+#include "errors.h"
+#include "kernelcache.h"
+#include "writer.h"
+
+using namespace Binja;
+using namespace Synth;
+
+namespace DW = llvm::dwarf;
+namespace MachO = llvm::MachO;
+namespace fs = std::filesystem;
+
+namespace {
+
+/// Abbreviations
+
+enum AbbrevCode : uint8_t {
+    kAbbrevCompileUnit = 1,
+    kAbbrevBaseType,
+    kAbbrevPointerType,
+    kAbbrevNamespace,
+    kAbbrevStructure,
+    kAbbrevStructureDeclaration,
+    kAbbrevMember,
+    kAbbrevBitfieldMember,
+    kAbbrevEnumeration,
+    kAbbrevEnumerator,
+    kAbbrevSubprogram,
+    kAbbrevFormalParameter,
+    kAbbrevVariable,
+};
+
+struct AbbrevSpec {
+    AbbrevCode code;
+    DW::Tag tag;
+    bool hasChildren;
+    std::vector<std::pair<DW::Attribute, DW::Form>> attributes;
+};
+
+const std::vector<AbbrevSpec> kAbbrevs{
+    {kAbbrevCompileUnit, DW::DW_TAG_compile_unit, true, {
+        {DW::DW_AT_producer, DW::DW_FORM_strp},
+        {DW::DW_AT_language, DW::DW_FORM_data2},
+        {DW::DW_AT_name, DW::DW_FORM_strp},
+        {DW::DW_AT_low_pc, DW::DW_FORM_addr},
+        {DW::DW_AT_high_pc, DW::DW_FORM_data4},
+    }},
+    {kAbbrevBaseType, DW::DW_TAG_base_type, false, {
+        {DW::DW_AT_name, DW::DW_FORM_strp},
+        {DW::DW_AT_encoding, DW::DW_FORM_data1},
+        {DW::DW_AT_byte_size, DW::DW_FORM_data1},
+    }},
+    {kAbbrevPointerType, DW::DW_TAG_pointer_type, false, {
+        {DW::DW_AT_type, DW::DW_FORM_ref4},
+    }},
+    {kAbbrevNamespace, DW::DW_TAG_namespace, true, {
+        {DW::DW_AT_name, DW::DW_FORM_strp},
+    }},
+    {kAbbrevStructure, DW::DW_TAG_structure_type, true, {
+        {DW::DW_AT_name, DW::DW_FORM_strp},
+        {DW::DW_AT_byte_size, DW::DW_FORM_data4},
+    }},
+    {kAbbrevStructureDeclaration, DW::DW_TAG_structure_type, false, {
+        {DW::DW_AT_name, DW::DW_FORM_strp},
+        {DW::DW_AT_declaration, DW::DW_FORM_flag_present},
+    }},
+    {kAbbrevMember, DW::DW_TAG_member, false, {
+        {DW::DW_AT_name, DW::DW_FORM_strp},
+        {DW::DW_AT_type, DW::DW_FORM_ref4},
+        {DW::DW_AT_data_member_location, DW::DW_FORM_data4},
+    }},
+    {kAbbrevBitfieldMember, DW::DW_TAG_member, false, {
+        {DW::DW_AT_name, DW::DW_FORM_strp},
+        {DW::DW_AT_type, DW::DW_FORM_ref4},
+        {DW::DW_AT_byte_size, DW::DW_FORM_data1},
+        {DW::DW_AT_bit_size, DW::DW_FORM_data1},
+        {DW::DW_AT_data_bit_offset, DW::DW_FORM_data4},
+    }},
+    {kAbbrevEnumeration, DW::DW_TAG_enumeration_type, true, {
+        {DW::DW_AT_name, DW::DW_FORM_strp},
+        {DW::DW_AT_type, DW::DW_FORM_ref4},
+        {DW::DW_AT_byte_size, DW::DW_FORM_data1},
+    }},
+    {kAbbrevEnumerator, DW::DW_TAG_enumerator, false, {
+        {DW::DW_AT_name, DW::DW_FORM_strp},
+        {DW::DW_AT_const_value, DW::DW_FORM_sdata},
+    }},
+    {kAbbrevSubprogram, DW::DW_TAG_subprogram, true, {
+        {DW::DW_AT_name, DW::DW_FORM_strp},
+        {DW::DW_AT_low_pc, DW::DW_FORM_addr},
+        {DW::DW_AT_high_pc, DW::DW_FORM_data4},
+        {DW::DW_AT_type, DW::DW_FORM_ref4},
+        {DW::DW_AT_external, DW::DW_FORM_flag_present},
+    }},
+    {kAbbrevFormalParameter, DW::DW_TAG_formal_parameter, false, {
+        {DW::DW_AT_name, DW::DW_FORM_strp},
+        {DW::DW_AT_type, DW::DW_FORM_ref4},
+    }},
+    {kAbbrevVariable, DW::DW_TAG_variable, false, {
+        {DW::DW_AT_name, DW::DW_FORM_strp},
+        {DW::DW_AT_type, DW::DW_FORM_ref4},
+        {DW::DW_AT_external, DW::DW_FORM_flag_present},
+        {DW::DW_AT_location, DW::DW_FORM_exprloc},
+    }},
+};
+
+std::vector<char> BuildAbbrevTable() {
+    std::vector<char> data;
+    ByteWriter writer{data, 0};
+    for (const auto &abbrev: kAbbrevs) {
+        writer.WriteULEB128(abbrev.code);
+        writer.WriteULEB128(abbrev.tag);
+        writer.Write<uint8_t>(abbrev.hasChildren ? DW::DW_CHILDREN_yes : DW::DW_CHILDREN_no);
+        for (const auto &[attribute, form]: abbrev.attributes) {
+            writer.WriteULEB128(attribute);
+            writer.WriteULEB128(form);
+        }
+        writer.WriteULEB128(0);
+        writer.WriteULEB128(0);
+    }
+    writer.WriteULEB128(0);
+    return data;
+}
+
+
+/// Type model
+
+struct BaseTypeSpec {
+    std::string_view name;
+    uint8_t size;
+    uint8_t encoding;
+};
+
+const std::vector<BaseTypeSpec> kBaseTypes{
+    {"char", 1, DW::DW_ATE_signed_char},
+    {"_Bool", 1, DW::DW_ATE_boolean},
+    {"unsigned short", 2, DW::DW_ATE_unsigned},
+    {"int", 4, DW::DW_ATE_signed},
+    {"unsigned int", 4, DW::DW_ATE_unsigned},
+    {"long", 8, DW::DW_ATE_signed},
+    {"unsigned long", 8, DW::DW_ATE_unsigned},
+};
+
+constexpr size_t kIntType = 3;
+constexpr size_t kUnsignedIntType = 4;
+constexpr uint32_t kBitfieldStorageBits = 32;
+constexpr uint64_t kPointerSize = 8;
+
+using Label = size_t;
+
+struct TypeRef {
+    Label label;
+    uint64_t size;
+};
+
+struct MemberSpec {
+    std::string name;
+    Label type;
+    uint64_t offset;
+    uint8_t bitSize;
+};
+
+struct StructSpec {
+    std::string name;
+    uint64_t size;
+    std::vector<MemberSpec> members;
+};
+
+uint64_t MixSeed(uint64_t seed, std::initializer_list<uint64_t> values) {
+    // splitmix64 finalizer over the seed and every value
+    uint64_t state = seed;
+    for (uint64_t value: values) {
+        state += 0x9e3779b97f4a7c15ULL + value;
+        state = (state ^ (state >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        state = (state ^ (state >> 27)) * 0x94d049bb133111ebULL;
+        state ^= state >> 31;
+    }
+    return state;
+}
+
+/// Draws a struct with bitfields packed in a leading unsigned int followed
+/// by naturally aligned members of base types or of the given references
+StructSpec DrawStruct(std::string name, std::mt19937_64 &random, const std::vector<TypeRef> &baseTypes,
+                      const std::vector<TypeRef> &references, size_t numMembers, size_t numBitfields) {
+    StructSpec result{std::move(name), 0, {}};
+    uint64_t alignment = 1;
+    if (numBitfields) {
+        uint32_t maxBits = std::max<uint32_t>(1, kBitfieldStorageBits / numBitfields);
+        for (size_t i = 0; i < numBitfields; ++i) {
+            result.members.push_back(MemberSpec{
+                fmt::format("flag_{}", i), baseTypes[kUnsignedIntType].label, 0,
+                static_cast<uint8_t>(1 + random() % maxBits)});
+        }
+        result.size = kBitfieldStorageBits / 8;
+        alignment = kBitfieldStorageBits / 8;
+    }
+    for (size_t i = 0; i < numMembers; ++i) {
+        // Roughly a quarter of the members reference other types
+        bool useReference = !references.empty() && random() % 4 == 0;
+        const TypeRef &type = useReference ? references[random() % references.size()]
+                                           : baseTypes[random() % baseTypes.size()];
+        uint64_t typeAlignment = std::min<uint64_t>(type.size, kPointerSize);
+        result.size = AlignUp(result.size, typeAlignment);
+        result.members.push_back(MemberSpec{fmt::format("field_{}", i), type.label, result.size, 0});
+        result.size += type.size;
+        alignment = std::max(alignment, typeAlignment);
+    }
+    result.size = AlignUp(result.size, alignment);
+    return result;
+}
+
+
+/// String table
+
+class StringTable {
+public:
+    uint32_t Add(std::string_view value) {
+        auto it = offsets_.find(value);
+        if (it != offsets_.end()) {
+            return it->second;
+        }
+        auto offset = static_cast<uint32_t>(data_.size());
+        ByteWriter{data_, offset}.WriteString(value);
+        offsets_.emplace(std::string{value}, offset);
+        return offset;
+    }
+
+    [[nodiscard]] const std::vector<char> &Data() const { return data_; }
+
+private:
+    std::vector<char> data_;
+    std::map<std::string, uint32_t, std::less<>> offsets_;
+};
+
+
+/// Compile unit writer
+
+/// Writes the DIEs of one compile unit. References are emitted against
+/// labels and patched once the unit is complete, so DIEs may refer to
+/// types that are written later in the unit
+class UnitWriter {
+public:
+    UnitWriter(std::vector<char> &info, StringTable &strings)
+        : writer_{info, info.size()}, strings_{strings}, unitStart_{info.size()} {
+        writer_.Write<uint32_t>(0);
+        writer_.Write<uint16_t>(4);
+        writer_.Write<uint32_t>(0);
+        writer_.Write<uint8_t>(kPointerSize);
+    }
+
+    Label NewLabel() {
+        labels_.push_back(std::nullopt);
+        return labels_.size() - 1;
+    }
+
+    void Bind(Label label) {
+        BDVerify(!labels_[label]);
+        labels_[label] = writer_.Offset() - unitStart_;
+    }
+
+    void Abbrev(AbbrevCode code) { writer_.WriteULEB128(code); }
+    void String(std::string_view value) { writer_.Write(strings_.Add(value)); }
+    void Reference(Label label) {
+        fixups_.emplace_back(writer_.Offset(), label);
+        writer_.Write<uint32_t>(0);
+    }
+    void EndChildren() { writer_.Write<uint8_t>(0); }
+
+    template<class T>
+    void Write(const T &value) { writer_.Write(value); }
+
+    void WriteSLEB128(int64_t value) { writer_.WriteSLEB128(value); }
+    void WriteULEB128(uint64_t value) { writer_.WriteULEB128(value); }
+
+    void Finish() {
+        for (const auto &[offset, label]: fixups_) {
+            BDVerify(labels_[label]);
+            writer_.Patch<uint32_t>(offset, *labels_[label]);
+        }
+        writer_.Patch<uint32_t>(unitStart_, writer_.Offset() - unitStart_ - sizeof(uint32_t));
+    }
+
+private:
+    ByteWriter writer_;
+    StringTable &strings_;
+    uint64_t unitStart_;
+    std::vector<std::optional<uint32_t>> labels_;
+    std::vector<std::pair<uint64_t, Label>> fixups_;
+};
+
+
+/// dSYM generator
+
+std::string ObjectName(const SyntheticFileset &fileset) {
+    auto separator = fileset.name.find_last_of('.');
+    return separator == std::string::npos ? fileset.name : fileset.name.substr(separator + 1);
+}
+
+class DSYMGenerator {
+public:
+    DSYMGenerator(const SyntheticKernelCache &kc, const DSYMOptions &options)
+        : kc_{kc}, options_{options} {
+        VerifyOptions();
+        numDuplicates_ = options_.structsPerUnit * options_.duplicatePercent / 100;
+        numConflicts_ = options_.structsPerUnit * options_.conflictPercent / 100;
+        numUnique_ = options_.structsPerUnit - numDuplicates_ - numConflicts_;
+        numTotalUnits_ = kc_.filesets.size() * options_.unitsPerObject;
+    }
+
+    std::vector<SyntheticDSYM> Generate() {
+        std::vector<SyntheticDSYM> result;
+        for (size_t i = 0; i < kc_.filesets.size(); ++i) {
+            result.push_back(GenerateObject(i));
+        }
+        return result;
+    }
+
+private:
+    void VerifyOptions() const {
+        if (options_.unitsPerObject == 0) {
+            throw GeneratorError{"at least one compile unit per object is required"};
+        }
+        if (options_.bitfieldsPerStruct > kBitfieldStorageBits) {
+            throw GeneratorError{"at most {} bitfields fit in a struct", kBitfieldStorageBits};
+        }
+        if (options_.duplicatePercent + options_.conflictPercent > 100) {
+            throw GeneratorError{"duplicate and conflicting structs exceed 100 percent"};
+        }
+        for (const auto &fileset: kc_.filesets) {
+            if (fileset.textStart < options_.slide) {
+                throw GeneratorError{"slide {:#x} exceeds the text address of {}", options_.slide, fileset.name};
+            }
+        }
+    }
+
+    SyntheticDSYM GenerateObject(size_t objectIndex) {
+        const SyntheticFileset &fileset = kc_.filesets[objectIndex];
+        SyntheticDSYM dsym{};
+        dsym.name = ObjectName(fileset);
+        dsym.uuid = fileset.uuid;
+
+        const SyntheticSegment *dataSegment = nullptr;
+        for (const auto &segment: fileset.segments) {
+            if (segment.name.starts_with("__DATA")) {
+                dataSegment = &segment;
+            }
+        }
+        if (!dataSegment && options_.globalsPerUnit) {
+            throw GeneratorError{"fileset {} has no data segment for globals", fileset.name};
+        }
+        globalCursor_ = dataSegment ? dataSegment->vmAddr : 0;
+        globalEnd_ = dataSegment ? dataSegment->vmAddr + dataSegment->vmSize : 0;
+
+        StringTable strings;
+        std::vector<char> info;
+        for (size_t unitIndex = 0; unitIndex < options_.unitsPerObject; ++unitIndex) {
+            GenerateUnit(dsym, strings, info, objectIndex, unitIndex);
+        }
+        dsym.numUnits = options_.unitsPerObject;
+        dsym.data = BuildObject(fileset, info, strings.Data());
+        return dsym;
+    }
+
+    void WriteNamespaces(UnitWriter &unit, std::string_view root) const {
+        for (size_t depth = 0; depth < options_.namespaceDepth; ++depth) {
+            unit.Abbrev(kAbbrevNamespace);
+            unit.String(depth == 0 ? std::string{root} : fmt::format("level{}", depth));
+        }
+    }
+
+    void EndNamespaces(UnitWriter &unit) const {
+        for (size_t depth = 0; depth < options_.namespaceDepth; ++depth) {
+            unit.EndChildren();
+        }
+    }
+
+    static void WriteStruct(UnitWriter &unit, Label label, const StructSpec &spec, const TypeRef &bitfieldType) {
+        unit.Bind(label);
+        unit.Abbrev(kAbbrevStructure);
+        unit.String(spec.name);
+        unit.Write<uint32_t>(spec.size);
+        uint32_t bitOffset = 0;
+        for (const auto &member: spec.members) {
+            if (member.bitSize) {
+                unit.Abbrev(kAbbrevBitfieldMember);
+                unit.String(member.name);
+                unit.Reference(member.type);
+                unit.Write<uint8_t>(bitfieldType.size);
+                unit.Write<uint8_t>(member.bitSize);
+                unit.Write<uint32_t>(bitOffset);
+                bitOffset += member.bitSize;
+            } else {
+                unit.Abbrev(kAbbrevMember);
+                unit.String(member.name);
+                unit.Reference(member.type);
+                unit.Write<uint32_t>(member.offset);
+            }
+        }
+        unit.EndChildren();
+    }
+
+    void GenerateUnit(SyntheticDSYM &dsym, StringTable &strings, std::vector<char> &info,
+                      size_t objectIndex, size_t unitIndex) {
+        const SyntheticFileset &fileset = kc_.filesets[objectIndex];
+        size_t globalUnitIndex = objectIndex * options_.unitsPerObject + unitIndex;
+        std::string tag = fmt::format("{}_cu{}", dsym.name, unitIndex);
+        std::mt19937_64 random{MixSeed(options_.seed, {0, globalUnitIndex})};
+        UnitWriter unit{info, strings};
+
+        // Labels of every type of the unit are allocated up front, in the
+        // same order in every unit, so that shared structs pick the same
+        // members everywhere
+        std::vector<TypeRef> baseTypes;
+        for (const auto &base: kBaseTypes) {
+            baseTypes.push_back(TypeRef{unit.NewLabel(), base.size});
+        }
+        auto newLabels = [&unit](size_t count) {
+            std::vector<Label> labels;
+            for (size_t i = 0; i < count; ++i) {
+                labels.push_back(unit.NewLabel());
+            }
+            return labels;
+        };
+        std::vector<Label> duplicates = newLabels(numDuplicates_);
+        std::vector<Label> conflicts = newLabels(numConflicts_);
+        std::vector<Label> forwards = newLabels(options_.forwardDeclarationsPerUnit);
+        std::vector<Label> uniques = newLabels(numUnique_);
+        std::vector<Label> enums = newLabels(options_.enumsPerUnit);
+
+        std::vector<std::pair<Label, Label>> pointers;
+        auto pointerTo = [&](Label target) {
+            Label pointer = unit.NewLabel();
+            pointers.emplace_back(pointer, target);
+            return TypeRef{pointer, kPointerSize};
+        };
+        std::vector<TypeRef> sharedReferences;
+        for (Label label: duplicates) {
+            sharedReferences.push_back(pointerTo(label));
+        }
+        for (Label label: forwards) {
+            sharedReferences.push_back(pointerTo(label));
+        }
+        std::vector<TypeRef> localReferences = sharedReferences;
+        for (Label label: conflicts) {
+            localReferences.push_back(pointerTo(label));
+        }
+        for (Label label: uniques) {
+            localReferences.push_back(pointerTo(label));
+        }
+        for (Label label: enums) {
+            localReferences.push_back(TypeRef{label, 4});
+        }
+
+        // Functions cover a slice of the fileset symbols
+        size_t firstFunction = std::min(unitIndex * options_.functionsPerUnit, fileset.symbols.size());
+        size_t lastFunction = std::min(firstFunction + options_.functionsPerUnit, fileset.symbols.size());
+        auto functionLength = [&fileset](size_t index) -> uint32_t {
+            if (index + 1 < fileset.symbols.size()) {
+                return fileset.symbols[index + 1].addr - fileset.symbols[index].addr;
+            }
+            return sizeof(uint32_t);
+        };
+
+        unit.Abbrev(kAbbrevCompileUnit);
+        unit.String("binja_kc_synth");
+        unit.Write<uint16_t>(DW::DW_LANG_C_plus_plus_14);
+        unit.String(fmt::format("{}/unit{}.cpp", dsym.name, unitIndex));
+        if (firstFunction < lastFunction) {
+            uint64_t low = fileset.symbols[firstFunction].addr;
+            uint64_t high = fileset.symbols[lastFunction - 1].addr + functionLength(lastFunction - 1);
+            unit.Write<uint64_t>(low - options_.slide);
+            unit.Write<uint32_t>(high - low);
+        } else {
+            unit.Write<uint64_t>(0);
+            unit.Write<uint32_t>(0);
+        }
+
+        for (size_t i = 0; i < kBaseTypes.size(); ++i) {
+            unit.Bind(baseTypes[i].label);
+            unit.Abbrev(kAbbrevBaseType);
+            unit.String(kBaseTypes[i].name);
+            unit.Write<uint8_t>(kBaseTypes[i].encoding);
+            unit.Write<uint8_t>(kBaseTypes[i].size);
+        }
+        for (const auto &[pointer, target]: pointers) {
+            unit.Bind(pointer);
+            unit.Abbrev(kAbbrevPointerType);
+            unit.Reference(target);
+        }
+
+        // Shared namespace: duplicates, conflicts and forward declarations
+        std::vector<TypeRef> structTypes;
+        WriteNamespaces(unit, "synth");
+        for (size_t i = 0; i < duplicates.size(); ++i) {
+            std::mt19937_64 structRandom{MixSeed(options_.seed, {1, i})};
+            auto spec = DrawStruct(fmt::format("dup_struct_{}", i), structRandom, baseTypes, sharedReferences,
+                                   options_.membersPerStruct, options_.bitfieldsPerStruct);
+            WriteStruct(unit, duplicates[i], spec, baseTypes[kUnsignedIntType]);
+            structTypes.push_back(TypeRef{duplicates[i], spec.size});
+            ++dsym.numTypes;
+        }
+        for (size_t i = 0; i < conflicts.size(); ++i) {
+            std::mt19937_64 structRandom{MixSeed(options_.seed, {2, i, globalUnitIndex})};
+            size_t numMembers = 1 + structRandom() % std::max<size_t>(1, options_.membersPerStruct);
+            auto spec = DrawStruct(fmt::format("conflict_struct_{}", i), structRandom, baseTypes, {},
+                                   numMembers, options_.bitfieldsPerStruct);
+            WriteStruct(unit, conflicts[i], spec, baseTypes[kUnsignedIntType]);
+            structTypes.push_back(TypeRef{conflicts[i], spec.size});
+            ++dsym.numTypes;
+        }
+        for (size_t i = 0; i < forwards.size(); ++i) {
+            // Every forward declared struct is defined in exactly one unit
+            std::string name = fmt::format("fwd_struct_{}", i);
+            if (i % numTotalUnits_ == globalUnitIndex) {
+                std::mt19937_64 structRandom{MixSeed(options_.seed, {3, i})};
+                auto spec = DrawStruct(std::move(name), structRandom, baseTypes, {},
+                                       options_.membersPerStruct, options_.bitfieldsPerStruct);
+                WriteStruct(unit, forwards[i], spec, baseTypes[kUnsignedIntType]);
+            } else {
+                unit.Bind(forwards[i]);
+                unit.Abbrev(kAbbrevStructureDeclaration);
+                unit.String(name);
+            }
+            ++dsym.numTypes;
+        }
+        EndNamespaces(unit);
+
+        // Unit namespace: enums, unique structs and globals
+        WriteNamespaces(unit, tag);
+        for (size_t i = 0; i < enums.size(); ++i) {
+            unit.Bind(enums[i]);
+            unit.Abbrev(kAbbrevEnumeration);
+            unit.String(fmt::format("{}_enum_{}", tag, i));
+            unit.Reference(baseTypes[kUnsignedIntType].label);
+            unit.Write<uint8_t>(baseTypes[kUnsignedIntType].size);
+            for (size_t j = 0; j < options_.enumeratorsPerEnum; ++j) {
+                unit.Abbrev(kAbbrevEnumerator);
+                unit.String(fmt::format("{}_ENUM_{}_{}", tag, i, j));
+                unit.WriteSLEB128(j);
+            }
+            unit.EndChildren();
+            ++dsym.numTypes;
+        }
+        for (size_t i = 0; i < uniques.size(); ++i) {
+            auto spec = DrawStruct(fmt::format("{}_struct_{}", tag, i), random, baseTypes, localReferences,
+                                   options_.membersPerStruct, options_.bitfieldsPerStruct);
+            WriteStruct(unit, uniques[i], spec, baseTypes[kUnsignedIntType]);
+            structTypes.push_back(TypeRef{uniques[i], spec.size});
+            ++dsym.numTypes;
+        }
+        for (size_t i = 0; i < options_.globalsPerUnit; ++i) {
+            const TypeRef &type = structTypes.empty() ? baseTypes[random() % baseTypes.size()]
+                                                      : structTypes[random() % structTypes.size()];
+            uint64_t address = AlignUp(globalCursor_, kPointerSize);
+            if (address + type.size > globalEnd_) {
+                throw GeneratorError{"globals of {} do not fit in its data segment", fileset.name};
+            }
+            globalCursor_ = address + type.size;
+
+            unit.Abbrev(kAbbrevVariable);
+            unit.String(fmt::format("{}_global_{}", tag, i));
+            unit.Reference(type.label);
+            unit.WriteULEB128(1 + sizeof(uint64_t));
+            unit.Write<uint8_t>(DW::DW_OP_addr);
+            unit.Write<uint64_t>(address - options_.slide);
+            ++dsym.numGlobals;
+        }
+        EndNamespaces(unit);
+
+        // Functions are C symbols at the top level of the unit
+        for (size_t i = firstFunction; i < lastFunction; ++i) {
+            const auto &symbol = fileset.symbols[i];
+            unit.Abbrev(kAbbrevSubprogram);
+            unit.String(symbol.name);
+            unit.Write<uint64_t>(symbol.addr - options_.slide);
+            unit.Write<uint32_t>(functionLength(i));
+            unit.Reference(localReferences.empty() || random() % 2 ? baseTypes[kIntType].label
+                                                                   : localReferences[random() % localReferences.size()].label);
+            size_t numParameters = random() % 4;
+            for (size_t j = 0; j < numParameters; ++j) {
+                unit.Abbrev(kAbbrevFormalParameter);
+                unit.String(fmt::format("arg{}", j));
+                unit.Reference(localReferences.empty() ? baseTypes[random() % baseTypes.size()].label
+                                                       : localReferences[random() % localReferences.size()].label);
+            }
+            unit.EndChildren();
+            ++dsym.numFunctions;
+        }
+
+        unit.EndChildren();
+        unit.Finish();
+    }
+
+    std::vector<char> BuildObject(const SyntheticFileset &fileset, const std::vector<char> &info,
+                                  const std::vector<char> &strings) const {
+        struct SectionData {
+            std::string_view name;
+            std::vector<char> data;
+        };
+        std::vector<SectionData> sections{
+            {"__debug_abbrev", BuildAbbrevTable()},
+            {"__debug_info", info},
+            {"__debug_str", strings},
+        };
+
+        size_t numSegments = fileset.segments.size() + 1;
+        uint64_t commandsSize = sizeof(MachO::uuid_command) + sizeof(MachO::segment_command_64) * numSegments + sizeof(MachO::section_64) * sections.size();
+        uint64_t dataStart = AlignUp(sizeof(MachO::mach_header_64) + commandsSize, kPageSize);
+
+        // __DWARF is mapped past the end of the fileset segments, like
+        // dsymutil does
+        uint64_t dwarfVmAddr = 0;
+        for (const auto &segment: fileset.segments) {
+            dwarfVmAddr = std::max(dwarfVmAddr, AlignUp(segment.vmAddr + segment.vmSize - options_.slide, kPageSize));
+        }
+
+        std::vector<char> data;
+        ByteWriter writer{data, sizeof(MachO::mach_header_64)};
+        WriteUUIDCommand(writer, fileset.uuid);
+        for (const auto &segment: fileset.segments) {
+            MachO::segment_command_64 cmd{};
+            cmd.cmd = MachO::LC_SEGMENT_64;
+            cmd.cmdsize = sizeof(cmd);
+            CopyName(cmd.segname, segment.name);
+            cmd.vmaddr = segment.vmAddr - options_.slide;
+            cmd.vmsize = segment.vmSize;
+            cmd.maxprot = MachO::VM_PROT_READ;
+            cmd.initprot = MachO::VM_PROT_READ;
+            writer.Write(cmd);
+        }
+
+        uint64_t dataSize = 0;
+        for (const auto &section: sections) {
+            dataSize = AlignUp(dataSize, 8) + section.data.size();
+        }
+        MachO::segment_command_64 dwarf{};
+        dwarf.cmd = MachO::LC_SEGMENT_64;
+        dwarf.cmdsize = sizeof(dwarf) + sizeof(MachO::section_64) * sections.size();
+        CopyName(dwarf.segname, "__DWARF");
+        dwarf.vmaddr = dwarfVmAddr;
+        dwarf.vmsize = AlignUp(dataSize, kPageSize);
+        dwarf.fileoff = dataStart;
+        dwarf.filesize = dataSize;
+        dwarf.maxprot = MachO::VM_PROT_READ | MachO::VM_PROT_WRITE | MachO::VM_PROT_EXECUTE;
+        dwarf.initprot = MachO::VM_PROT_READ | MachO::VM_PROT_WRITE;
+        dwarf.nsects = sections.size();
+        writer.Write(dwarf);
+
+        uint64_t sectionOffset = 0;
+        for (const auto &section: sections) {
+            sectionOffset = AlignUp(sectionOffset, 8);
+            MachO::section_64 sect{};
+            CopyName(sect.sectname, section.name);
+            CopyName(sect.segname, "__DWARF");
+            sect.addr = dwarfVmAddr + sectionOffset;
+            sect.size = section.data.size();
+            sect.offset = dataStart + sectionOffset;
+            sect.align = 0;
+            sect.flags = MachO::S_ATTR_DEBUG;
+            writer.Write(sect);
+            ByteWriter{data, dataStart + sectionOffset}.WriteBytes(section.data.data(), section.data.size());
+            sectionOffset += section.data.size();
+        }
+        BDVerify(writer.Offset() == sizeof(MachO::mach_header_64) + commandsSize);
+
+        ByteWriter{data, 0}.Write(MachO::mach_header_64{
+            .magic = MachO::MH_MAGIC_64,
+            .cputype = MachO::CPU_TYPE_ARM64,
+            .cpusubtype = MachO::CPU_SUBTYPE_ARM64E,
+            .filetype = MachO::MH_DSYM,
+            .ncmds = (uint32_t) (numSegments + 1),
+            .sizeofcmds = (uint32_t) commandsSize,
+            .flags = 0,
+            .reserved = 0,
+        });
+        return data;
+    }
+
+private:
+    static constexpr uint64_t kPageSize = 0x4000;
+
+    const SyntheticKernelCache &kc_;
+    const DSYMOptions &options_;
+    size_t numDuplicates_;
+    size_t numConflicts_;
+    size_t numUnique_;
+    size_t numTotalUnits_;
+    uint64_t globalCursor_ = 0;
+    uint64_t globalEnd_ = 0;
+};
+
+}// namespace
+
+
+/// dSYM generator
+
+std::vector<SyntheticDSYM> Synth::GenerateDSYMs(const SyntheticKernelCache &kc, const DSYMOptions &options) {
+    return DSYMGenerator{kc, options}.Generate();
+}
+
+fs::path Synth::WriteDSYMBundle(const fs::path &directory, const SyntheticDSYM &dsym) {
+    fs::path bundle = directory / fmt::format("{}.dSYM", dsym.name);
+    fs::path dwarfDirectory = bundle / "Contents" / "Resources" / "DWARF";
+    std::error_code ec;
+    fs::create_directories(dwarfDirectory, ec);
+    if (ec) {
+        throw GeneratorError{"failed to create directory {}, error: {}", dwarfDirectory.string(), ec.message()};
+    }
+    WriteImage(dwarfDirectory / dsym.name, dsym.data);
+    return bundle;
+}
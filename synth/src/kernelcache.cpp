@@ -0,0 +1,591 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string_view>
+
+#include <fmt/format.h>
+#include <llvm/BinaryFormat/MachO.h>
+
+#include <binja/utils/debug.h>
+
+#include "errors.h"
+#include "kernelcache.h"
+#include "writer.h"
+
+using namespace Binja;
+using namespace Synth;
+
+namespace MachO = llvm::MachO;
+
+namespace {
+
+/// Mach-O definitions missing in LLVM
+
+constexpr uint32_t kMHFileset = 0xc;
+constexpr uint32_t kLCFilesetEntry = 0x35 | MachO::LC_REQ_DYLD;
+constexpr uint16_t kDyldChainedPtr64KernelCache = 8;
+constexpr uint16_t kDyldChainedPtrStartNone = 0xFFFF;
+constexpr uint32_t kDyldChainedImportFormat = 1;
+
+struct fileset_entry_command {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint64_t vmaddr;
+    uint64_t fileoff;
+    uint32_t entry_id;
+    uint32_t reserved;
+};
+
+struct dyld_chained_fixups_header {
+    uint32_t fixups_version;
+    uint32_t starts_offset;
+    uint32_t imports_offset;
+    uint32_t symbols_offset;
+    uint32_t imports_count;
+    uint32_t imports_format;
+    uint32_t symbols_format;
+};
+
+// dyld_chained_starts_in_segment up to page_start, written field by field
+// since the C layout pads the trailing page_start array
+constexpr uint32_t kChainedStartsInSegmentHeaderSize = 22;
+
+
+/// Image constants
+
+constexpr uint64_t kPageSize = 0x4000;
+constexpr size_t kSlotsPerPage = kPageSize / sizeof(uint64_t);
+constexpr uint64_t kMaxChainTarget = 1ULL << 30;
+constexpr uint32_t kInstructionRet = 0xd65f03c0;
+
+
+/// Layout
+
+struct SectionSpec {
+    std::string name;
+    uint64_t vmOffset;
+    uint64_t size;
+    uint32_t flags;
+};
+
+struct SegmentSpec {
+    std::string name;
+    uint64_t vmOffset;
+    uint64_t size;
+    int32_t prot;
+    std::vector<SectionSpec> sections;
+};
+
+struct FilesetLinkedit {
+    uint64_t symbolsOffset;
+    uint64_t functionStartsOffset;
+    uint64_t functionStartsSize;
+};
+
+uint32_t SegmentCommandSize(size_t numSections) {
+    return sizeof(MachO::segment_command_64) + numSections * sizeof(MachO::section_64);
+}
+
+uint32_t FilesetEntryCommandSize(std::string_view name) {
+    return AlignUp(sizeof(fileset_entry_command) + name.size() + 1, 8);
+}
+
+constexpr uint32_t kThreadCommandSize = sizeof(MachO::thread_command) + 2 * sizeof(uint32_t) + sizeof(MachO::arm_thread_state64_t);
+
+std::string DataSegmentName(size_t index) {
+    switch (index) {
+        case 0:
+            return "__DATA_CONST";
+        case 1:
+            return "__DATA";
+        default:
+            return fmt::format("__DATA_{}", index);
+    }
+}
+
+std::string FilesetName(size_t index) {
+    if (index == 0) {
+        return "com.apple.kernel";
+    }
+    return fmt::format("com.apple.synth.kext{}", index);
+}
+
+std::string SymbolPrefix(size_t index) {
+    if (index == 0) {
+        return "kernel";
+    }
+    return fmt::format("kext{}", index);
+}
+
+class KernelCacheGenerator {
+public:
+    explicit KernelCacheGenerator(const KernelCacheOptions &options)
+        : options_{options}, random_{options.seed} {
+        VerifyOptions();
+        ComputeLayout();
+    }
+
+    SyntheticKernelCache Generate() {
+        SyntheticKernelCache result{};
+        result.vmBase = options_.vmBase;
+        result.entryPoint = options_.vmBase + textExecStart_;
+        for (size_t i = 0; i < options_.numFilesets; ++i) {
+            result.filesets.push_back(DescribeFileset(i));
+        }
+
+        std::vector<char> linkedit = BuildLinkedit(result.filesets);
+        linkeditSize_ = AlignUp(linkedit.size(), kPageSize);
+        BDVerify(linkeditStart_ + linkeditSize_ <= kMaxChainTarget);
+
+        result.data.resize(linkeditStart_ + linkeditSize_);
+        memcpy(result.data.data() + linkeditStart_, linkedit.data(), linkedit.size());
+        WriteTopHeader(result);
+        for (size_t i = 0; i < options_.numFilesets; ++i) {
+            WriteFilesetHeader(result.data, i, result.filesets[i]);
+        }
+        WriteCode(result.data);
+        WriteData(result);
+        return result;
+    }
+
+private:
+    void VerifyOptions() {
+        if (options_.numFilesets == 0) {
+            throw GeneratorError{"at least one fileset is required"};
+        }
+        if (options_.pagesPerSegment == 0 || options_.sectionsPerSegment == 0) {
+            throw GeneratorError{"segments must have at least one page and one section"};
+        }
+        if (options_.sectionsPerSegment * 16 > options_.pagesPerSegment * kPageSize) {
+            throw GeneratorError{"{} sections do not fit in a segment of {} pages",
+                                 options_.sectionsPerSegment, options_.pagesPerSegment};
+        }
+        size_t maxFunctions = options_.pagesPerSegment * kPageSize / sizeof(uint32_t);
+        if (options_.symbolsPerFileset > maxFunctions || options_.functionStartsPerFileset > maxFunctions) {
+            throw GeneratorError{"at most {} functions fit in a code segment of {} pages",
+                                 maxFunctions, options_.pagesPerSegment};
+        }
+        if (options_.chainedPointersPerPage + options_.pacPointersPerPage > kSlotsPerPage) {
+            throw GeneratorError{"at most {} chained and PAC pointers fit in a page", kSlotsPerPage};
+        }
+        if (options_.vmBase % kPageSize != 0 || ((options_.vmBase >> 40) & 0xf) != 0xe) {
+            throw GeneratorError{"vm base {:#x} is not a page aligned kernel address", options_.vmBase};
+        }
+    }
+
+    void ComputeLayout() {
+        size_t numFilesets = options_.numFilesets;
+        size_t numDataSegments = options_.dataSegmentsPerFileset;
+        segmentSize_ = options_.pagesPerSegment * kPageSize;
+
+        uint64_t topCommandsSize = SegmentCommandSize(0) * (4 + numDataSegments) + kThreadCommandSize + sizeof(MachO::linkedit_data_command) + sizeof(MachO::uuid_command);
+        for (size_t i = 0; i < numFilesets; ++i) {
+            topCommandsSize += FilesetEntryCommandSize(FilesetName(i));
+        }
+        topHeaderSize_ = AlignUp(sizeof(MachO::mach_header_64) + topCommandsSize, kPageSize);
+
+        uint64_t filesetCommandsSize = SegmentCommandSize(0) * 2 + SegmentCommandSize(1) + SegmentCommandSize(options_.sectionsPerSegment) * numDataSegments + sizeof(MachO::symtab_command) + sizeof(MachO::linkedit_data_command) + sizeof(MachO::uuid_command);
+        filesetHeaderSize_ = AlignUp(sizeof(MachO::mach_header_64) + filesetCommandsSize, kPageSize);
+
+        prelinkTextStart_ = topHeaderSize_;
+        textExecStart_ = prelinkTextStart_ + filesetHeaderSize_ * numFilesets;
+        uint64_t cursor = textExecStart_ + segmentSize_ * numFilesets;
+        for (size_t k = 0; k < numDataSegments; ++k) {
+            dataStarts_.push_back(cursor);
+            cursor += segmentSize_ * numFilesets;
+        }
+        linkeditStart_ = cursor;
+        if (linkeditStart_ >= kMaxChainTarget) {
+            throw GeneratorError{"image of {:#x} bytes exceeds the {:#x} bytes addressable by chained pointers",
+                                 linkeditStart_, kMaxChainTarget};
+        }
+    }
+
+    std::vector<SegmentSpec> FilesetSegments(size_t index) const {
+        std::vector<SegmentSpec> result;
+        result.push_back(SegmentSpec{"__TEXT", prelinkTextStart_ + index * filesetHeaderSize_, filesetHeaderSize_, MachO::VM_PROT_READ, {}});
+
+        uint64_t text = textExecStart_ + index * segmentSize_;
+        result.push_back(SegmentSpec{
+            "__TEXT_EXEC", text, segmentSize_, MachO::VM_PROT_READ | MachO::VM_PROT_EXECUTE,
+            {SectionSpec{"__text", text, segmentSize_, MachO::S_ATTR_PURE_INSTRUCTIONS | MachO::S_ATTR_SOME_INSTRUCTIONS}}});
+
+        size_t numSections = options_.sectionsPerSegment;
+        uint64_t sectionSize = segmentSize_ / numSections / 16 * 16;
+        for (size_t k = 0; k < dataStarts_.size(); ++k) {
+            uint64_t start = dataStarts_[k] + index * segmentSize_;
+            SegmentSpec segment{
+                DataSegmentName(k), start, segmentSize_,
+                k == 0 ? MachO::VM_PROT_READ : MachO::VM_PROT_READ | MachO::VM_PROT_WRITE, {}};
+            std::string base = k == 0 ? "__const" : "__data";
+            for (size_t j = 0; j < numSections; ++j) {
+                bool last = j + 1 == numSections;
+                std::string name = j == 0 ? base : fmt::format("{}{}", base, j);
+                if (k == 0 && last && options_.kallocTypeSection) {
+                    name = "__kalloc_type";
+                }
+                uint64_t size = last ? segmentSize_ - sectionSize * j : sectionSize;
+                segment.sections.push_back(SectionSpec{name, start + sectionSize * j, size, MachO::S_REGULAR});
+            }
+            result.push_back(std::move(segment));
+        }
+        return result;
+    }
+
+    SyntheticFileset DescribeFileset(size_t index) {
+        SyntheticFileset fileset{};
+        fileset.name = FilesetName(index);
+        for (auto &byte: fileset.uuid.data) {
+            byte = random_() & 0xff;
+        }
+        fileset.uuid.data[6] = (fileset.uuid.data[6] & 0x0f) | 0x40;
+        fileset.uuid.data[8] = (fileset.uuid.data[8] & 0x3f) | 0x80;
+        fileset.fileOffset = prelinkTextStart_ + index * filesetHeaderSize_;
+        fileset.vmAddr = options_.vmBase + fileset.fileOffset;
+        fileset.textStart = options_.vmBase + textExecStart_ + index * segmentSize_;
+        fileset.textLength = segmentSize_;
+        for (const auto &segment: FilesetSegments(index)) {
+            fileset.segments.push_back(SyntheticSegment{segment.name, options_.vmBase + segment.vmOffset, segment.size});
+        }
+
+        std::string prefix = SymbolPrefix(index);
+        size_t numInstructions = segmentSize_ / sizeof(uint32_t);
+        for (size_t j = 0; j < options_.symbolsPerFileset; ++j) {
+            uint64_t slot = j * (numInstructions / options_.symbolsPerFileset);
+            fileset.symbols.push_back(SyntheticSymbol{
+                fmt::format("{}_func_{}", prefix, j),
+                fileset.textStart + slot * sizeof(uint32_t)});
+        }
+        for (size_t j = 0; j < options_.functionStartsPerFileset; ++j) {
+            uint64_t slot = j * (numInstructions / options_.functionStartsPerFileset);
+            fileset.functionStarts.push_back(fileset.textStart + slot * sizeof(uint32_t));
+        }
+        return fileset;
+    }
+
+    std::vector<char> BuildLinkedit(const std::vector<SyntheticFileset> &filesets) {
+        std::vector<char> linkedit;
+        ByteWriter writer{linkedit, 0};
+
+        // Chained fixups, one starts_in_segment per data segment kind
+        size_t numTopSegments = 4 + dataStarts_.size();
+        size_t numChainedSegments = options_.chainedPointersPerPage ? dataStarts_.size() : 0;
+        uint32_t startsOffset = AlignUp(sizeof(dyld_chained_fixups_header), 8);
+        uint32_t imageStartsSize = sizeof(uint32_t) * (1 + numTopSegments);
+        size_t pagesPerRegion = options_.pagesPerSegment * filesets.size();
+        uint32_t segmentStartsSize = AlignUp(kChainedStartsInSegmentHeaderSize + sizeof(uint16_t) * pagesPerRegion, 8);
+        uint32_t firstSegmentStarts = AlignUp(imageStartsSize, 8);
+        uint32_t importsOffset = startsOffset + firstSegmentStarts + segmentStartsSize * numChainedSegments;
+
+        writer.Write(dyld_chained_fixups_header{
+            .fixups_version = 0,
+            .starts_offset = startsOffset,
+            .imports_offset = importsOffset,
+            .symbols_offset = importsOffset,
+            .imports_count = 0,
+            .imports_format = kDyldChainedImportFormat,
+            .symbols_format = 0,
+        });
+        writer.Align(8);
+        writer.Write<uint32_t>(numTopSegments);
+        for (size_t i = 0; i < numTopSegments; ++i) {
+            // Top level segments are __TEXT, __PRELINK_TEXT, __TEXT_EXEC,
+            // the data segments and __LINKEDIT
+            bool chained = i >= 3 && i - 3 < numChainedSegments;
+            writer.Write<uint32_t>(chained ? firstSegmentStarts + segmentStartsSize * (i - 3) : 0);
+        }
+        writer.Align(8);
+        for (size_t k = 0; k < numChainedSegments; ++k) {
+            writer.Write<uint32_t>(kChainedStartsInSegmentHeaderSize + sizeof(uint16_t) * pagesPerRegion);
+            writer.Write<uint16_t>(kPageSize);
+            writer.Write<uint16_t>(kDyldChainedPtr64KernelCache);
+            writer.Write<uint64_t>(dataStarts_[k]);
+            writer.Write<uint32_t>(0);
+            writer.Write<uint16_t>(pagesPerRegion);
+            for (size_t page = 0; page < pagesPerRegion; ++page) {
+                writer.Write<uint16_t>(0);
+            }
+            writer.Align(8);
+        }
+        fixupsSize_ = writer.Offset();
+
+        // Symbol tables of all filesets share one string table
+        std::vector<char> strings{'\0'};
+        ByteWriter stringWriter{strings, 1};
+        for (const auto &fileset: filesets) {
+            filesetLinkedit_.push_back(FilesetLinkedit{.symbolsOffset = linkeditStart_ + writer.Offset()});
+            for (const auto &symbol: fileset.symbols) {
+                writer.Write(MachO::nlist_64{
+                    .n_strx = (uint32_t) stringWriter.Offset(),
+                    .n_type = static_cast<uint8_t>(MachO::N_SECT) | MachO::N_EXT,
+                    .n_sect = 1,
+                    .n_desc = 0,
+                    .n_value = symbol.addr,
+                });
+                stringWriter.WriteString("_" + symbol.name);
+            }
+        }
+        stringWriter.Align(8);
+        stringsOffset_ = linkeditStart_ + writer.Offset();
+        stringsSize_ = strings.size();
+        writer.WriteBytes(strings.data(), strings.size());
+
+        // Function starts are encoded relative to the fileset __TEXT
+        for (size_t i = 0; i < filesets.size(); ++i) {
+            auto &info = filesetLinkedit_[i];
+            info.functionStartsOffset = linkeditStart_ + writer.Offset();
+            uint64_t cursor = filesets[i].vmAddr;
+            for (uint64_t start: filesets[i].functionStarts) {
+                writer.WriteULEB128(start - cursor);
+                cursor = start;
+            }
+            info.functionStartsSize = linkeditStart_ + writer.Offset() - info.functionStartsOffset;
+            writer.Write<uint8_t>(0);
+            writer.Align(8);
+        }
+        return linkedit;
+    }
+
+    static void WriteSegmentCommand(ByteWriter &writer, const SegmentSpec &segment, uint64_t vmBase) {
+        MachO::segment_command_64 cmd{};
+        cmd.cmd = MachO::LC_SEGMENT_64;
+        cmd.cmdsize = SegmentCommandSize(segment.sections.size());
+        CopyName(cmd.segname, segment.name);
+        cmd.vmaddr = vmBase + segment.vmOffset;
+        cmd.vmsize = segment.size;
+        cmd.fileoff = segment.vmOffset;
+        cmd.filesize = segment.size;
+        cmd.maxprot = segment.prot;
+        cmd.initprot = segment.prot;
+        cmd.nsects = segment.sections.size();
+        writer.Write(cmd);
+        for (const auto &section: segment.sections) {
+            MachO::section_64 sect{};
+            CopyName(sect.sectname, section.name);
+            CopyName(sect.segname, segment.name);
+            sect.addr = vmBase + section.vmOffset;
+            sect.size = section.size;
+            sect.offset = section.vmOffset;
+            sect.align = 4;
+            sect.flags = section.flags;
+            writer.Write(sect);
+        }
+    }
+
+    void WriteTopHeader(SyntheticKernelCache &kc) {
+        uint64_t vmBase = options_.vmBase;
+        std::vector<SegmentSpec> segments{
+            SegmentSpec{"__TEXT", 0, topHeaderSize_, MachO::VM_PROT_READ, {}},
+            SegmentSpec{"__PRELINK_TEXT", prelinkTextStart_, textExecStart_ - prelinkTextStart_, MachO::VM_PROT_READ, {}},
+            SegmentSpec{"__TEXT_EXEC", textExecStart_, segmentSize_ * options_.numFilesets, MachO::VM_PROT_READ | MachO::VM_PROT_EXECUTE, {}},
+        };
+        for (size_t k = 0; k < dataStarts_.size(); ++k) {
+            segments.push_back(SegmentSpec{
+                DataSegmentName(k), dataStarts_[k], segmentSize_ * options_.numFilesets,
+                k == 0 ? MachO::VM_PROT_READ : MachO::VM_PROT_READ | MachO::VM_PROT_WRITE, {}});
+        }
+        segments.push_back(SegmentSpec{"__LINKEDIT", linkeditStart_, linkeditSize_, MachO::VM_PROT_READ, {}});
+
+        ByteWriter writer{kc.data, sizeof(MachO::mach_header_64)};
+        for (const auto &segment: segments) {
+            WriteSegmentCommand(writer, segment, vmBase);
+        }
+        for (const auto &fileset: kc.filesets) {
+            uint32_t cmdsize = FilesetEntryCommandSize(fileset.name);
+            uint64_t start = writer.Offset();
+            writer.Write(fileset_entry_command{
+                .cmd = kLCFilesetEntry,
+                .cmdsize = cmdsize,
+                .vmaddr = fileset.vmAddr,
+                .fileoff = fileset.fileOffset,
+                .entry_id = sizeof(fileset_entry_command),
+                .reserved = 0,
+            });
+            writer.WriteString(fileset.name);
+            writer.Align(8);
+            BDVerify(writer.Offset() == start + cmdsize);
+        }
+
+        writer.Write(MachO::thread_command{MachO::LC_UNIXTHREAD, kThreadCommandSize});
+        writer.Write<uint32_t>(MachO::ARM_THREAD_STATE64);
+        writer.Write<uint32_t>(MachO::ARM_THREAD_STATE64_COUNT);
+        MachO::arm_thread_state64_t state{};
+        state.pc = kc.entryPoint;
+        writer.Write(state);
+
+        writer.Write(MachO::linkedit_data_command{
+            MachO::LC_DYLD_CHAINED_FIXUPS, sizeof(MachO::linkedit_data_command),
+            (uint32_t) linkeditStart_, (uint32_t) fixupsSize_});
+
+        Types::UUID uuid;
+        for (auto &byte: uuid.data) {
+            byte = random_() & 0xff;
+        }
+        WriteUUIDCommand(writer, uuid);
+
+        uint64_t commandsSize = writer.Offset() - sizeof(MachO::mach_header_64);
+        BDVerify(writer.Offset() <= topHeaderSize_);
+        ByteWriter{kc.data, 0}.Write(MachO::mach_header_64{
+            .magic = MachO::MH_MAGIC_64,
+            .cputype = MachO::CPU_TYPE_ARM64,
+            .cpusubtype = MachO::CPU_SUBTYPE_ARM64E,
+            .filetype = kMHFileset,
+            .ncmds = (uint32_t) (segments.size() + kc.filesets.size() + 3),
+            .sizeofcmds = (uint32_t) commandsSize,
+            .flags = MachO::MH_NOUNDEFS | MachO::MH_PIE,
+            .reserved = 0,
+        });
+    }
+
+    void WriteFilesetHeader(std::vector<char> &data, size_t index, const SyntheticFileset &fileset) {
+        std::vector<SegmentSpec> segments = FilesetSegments(index);
+        // All filesets map the shared __LINKEDIT
+        segments.push_back(SegmentSpec{"__LINKEDIT", linkeditStart_, linkeditSize_, MachO::VM_PROT_READ, {}});
+
+        ByteWriter writer{data, fileset.fileOffset + sizeof(MachO::mach_header_64)};
+        for (const auto &segment: segments) {
+            WriteSegmentCommand(writer, segment, options_.vmBase);
+        }
+
+        const auto &linkedit = filesetLinkedit_[index];
+        writer.Write(MachO::symtab_command{
+            MachO::LC_SYMTAB, sizeof(MachO::symtab_command),
+            (uint32_t) linkedit.symbolsOffset, (uint32_t) fileset.symbols.size(),
+            (uint32_t) stringsOffset_, (uint32_t) stringsSize_});
+        writer.Write(MachO::linkedit_data_command{
+            MachO::LC_FUNCTION_STARTS, sizeof(MachO::linkedit_data_command),
+            (uint32_t) linkedit.functionStartsOffset, (uint32_t) linkedit.functionStartsSize});
+        WriteUUIDCommand(writer, fileset.uuid);
+
+        uint64_t commandsSize = writer.Offset() - fileset.fileOffset - sizeof(MachO::mach_header_64);
+        BDVerify(writer.Offset() <= fileset.fileOffset + filesetHeaderSize_);
+        ByteWriter{data, fileset.fileOffset}.Write(MachO::mach_header_64{
+            .magic = MachO::MH_MAGIC_64,
+            .cputype = MachO::CPU_TYPE_ARM64,
+            .cpusubtype = MachO::CPU_SUBTYPE_ARM64E,
+            .filetype = index == 0 ? (uint32_t) MachO::MH_EXECUTE : (uint32_t) MachO::MH_KEXT_BUNDLE,
+            .ncmds = (uint32_t) (segments.size() + 3),
+            .sizeofcmds = (uint32_t) commandsSize,
+            .flags = MachO::MH_DYLIB_IN_CACHE | MachO::MH_NOUNDEFS | MachO::MH_PIE,
+            .reserved = 0,
+        });
+    }
+
+    void WriteCode(std::vector<char> &data) const {
+        uint64_t end = textExecStart_ + segmentSize_ * options_.numFilesets;
+        for (uint64_t cursor = textExecStart_; cursor < end; cursor += sizeof(kInstructionRet)) {
+            memcpy(data.data() + cursor, &kInstructionRet, sizeof(kInstructionRet));
+        }
+    }
+
+    uint64_t RandomCodeTarget() {
+        uint64_t codeSize = segmentSize_ * options_.numFilesets;
+        return textExecStart_ + (random_() % (codeSize / sizeof(uint32_t))) * sizeof(uint32_t);
+    }
+
+    void WriteData(SyntheticKernelCache &kc) {
+        size_t numChained = options_.chainedPointersPerPage;
+        size_t numPAC = options_.pacPointersPerPage;
+        // Chains spread over the whole page, so links use the full 12 bit
+        // next field. PAC pointers take the slots between the links
+        size_t chainStride = numChained ? kSlotsPerPage / numChained : 0;
+        size_t numFree = kSlotsPerPage - numChained;
+        size_t pacStride = numPAC ? numFree / numPAC : 0;
+        auto freeSlot = [&](size_t index) {
+            size_t gap = chainStride ? chainStride - 1 : 0;
+            if (index < numChained * gap) {
+                return index / gap * chainStride + 1 + index % gap;
+            }
+            return numChained * chainStride + index - numChained * gap;
+        };
+        size_t pagesPerRegion = options_.pagesPerSegment * options_.numFilesets;
+
+        for (uint64_t regionStart: dataStarts_) {
+            for (size_t page = 0; page < pagesPerRegion; ++page) {
+                char *pageData = kc.data.data() + regionStart + page * kPageSize;
+                auto store = [pageData](size_t slot, uint64_t value) {
+                    memcpy(pageData + slot * sizeof(uint64_t), &value, sizeof(value));
+                };
+                for (size_t j = 0; j < numChained; ++j) {
+                    uint64_t next = j + 1 < numChained ? chainStride * sizeof(uint64_t) / 4 : 0;
+                    uint64_t target = RandomCodeTarget();
+                    uint64_t value = target | (next << 51);
+                    if (j % 2) {
+                        uint64_t diversity = random_() & 0xffff;
+                        uint64_t addrDiv = random_() & 1;
+                        uint64_t key = random_() & 3;
+                        value |= (diversity << 32) | (addrDiv << 48) | (key << 49) | (1ULL << 63);
+                    }
+                    store(j * chainStride, value);
+                }
+                for (size_t j = 0; j < numPAC; ++j) {
+                    uint64_t address = options_.vmBase + RandomCodeTarget();
+                    uint64_t signature = 1 + random_() % 0xffffe;
+                    store(freeSlot(j * pacStride), (signature << 44) | (address & 0xfffffffffffULL));
+                }
+                kc.numChainedPointers += numChained;
+                kc.numPACPointers += numPAC;
+            }
+        }
+    }
+
+private:
+    const KernelCacheOptions &options_;
+    std::mt19937_64 random_;
+
+    uint64_t segmentSize_;
+    uint64_t topHeaderSize_;
+    uint64_t filesetHeaderSize_;
+    uint64_t prelinkTextStart_;
+    uint64_t textExecStart_;
+    std::vector<uint64_t> dataStarts_;
+    uint64_t linkeditStart_;
+    uint64_t linkeditSize_ = 0;
+
+    uint64_t fixupsSize_ = 0;
+    uint64_t stringsOffset_ = 0;
+    uint64_t stringsSize_ = 0;
+    std::vector<FilesetLinkedit> filesetLinkedit_;
+};
+
+}// namespace
+
+
+/// Kernel cache generator
+
+SyntheticKernelCache Synth::GenerateKernelCache(const KernelCacheOptions &options) {
+    return KernelCacheGenerator{options}.Generate();
+}
+
+void Synth::WriteImage(const std::filesystem::path &path, const std::vector<char> &data) {
+    std::ofstream stream{path, std::ios::binary | std::ios::trunc};
+    if (!stream) {
+        throw GeneratorError{"failed to open {} for writing", path.string()};
+    }
+    stream.write(data.data(), data.size());
+    if (!stream) {
+        throw GeneratorError{"failed to write {} bytes to {}", data.size(), path.string()};
+    }
+}
@@ -0,0 +1,213 @@
+// Copyright (c) skr0x1c0 2022.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <charconv>
+#include <iostream>
+#include <map>
+#include <string_view>
+
+#include <fmt/format.h>
+
+#include <binja/synth/dsym.h>
+#include <binja/synth/errors.h>
+#include <binja/synth/kernelcache.h>
+
+using namespace Binja;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void PrintUsage(const char *program) {
+    std::cerr << "USAGE: " << program << " kc [--<option> <value>]... <output>\n"
+              << "       " << program << " kdk [--<option> <value>]... <output directory>\n"
+              << "\n"
+              << "kc options:\n"
+              << "  --filesets, --data-segments, --sections, --pages, --symbols,\n"
+              << "  --function-starts, --chained-pointers, --pac-pointers, --seed,\n"
+              << "  --kalloc-type (flag)\n"
+              << "\n"
+              << "kdk writes a kernelcache and a dSYM per fileset, it takes the kc options and:\n"
+              << "  --units, --namespace-depth, --structs, --members, --bitfields, --enums,\n"
+              << "  --enumerators, --forward-declarations, --functions, --globals,\n"
+              << "  --duplicate-percent, --conflict-percent, --slide\n";
+}
+
+uint64_t ParseNumber(std::string_view option, std::string_view value) {
+    uint64_t result = 0;
+    int base = 10;
+    if (value.starts_with("0x")) {
+        value.remove_prefix(2);
+        base = 16;
+    }
+    auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), result, base);
+    if (error != std::errc{} || end != value.data() + value.size()) {
+        throw Synth::GeneratorError{"invalid value {} for option {}", value, option};
+    }
+    return result;
+}
+
+struct OptionTable {
+    std::map<std::string_view, size_t *> sizes;
+    std::map<std::string_view, std::vector<uint64_t *>> numbers;
+    std::map<std::string_view, bool *> flags;
+};
+
+void AddKernelCacheOptions(OptionTable &table, Synth::KernelCacheOptions &options) {
+    table.sizes.insert({
+        {"--filesets", &options.numFilesets},
+        {"--data-segments", &options.dataSegmentsPerFileset},
+        {"--sections", &options.sectionsPerSegment},
+        {"--pages", &options.pagesPerSegment},
+        {"--symbols", &options.symbolsPerFileset},
+        {"--function-starts", &options.functionStartsPerFileset},
+        {"--chained-pointers", &options.chainedPointersPerPage},
+        {"--pac-pointers", &options.pacPointersPerPage},
+    });
+    table.numbers["--seed"].push_back(&options.seed);
+    table.flags["--kalloc-type"] = &options.kallocTypeSection;
+}
+
+void AddDSYMOptions(OptionTable &table, Synth::DSYMOptions &options) {
+    table.sizes.insert({
+        {"--units", &options.unitsPerObject},
+        {"--namespace-depth", &options.namespaceDepth},
+        {"--structs", &options.structsPerUnit},
+        {"--members", &options.membersPerStruct},
+        {"--bitfields", &options.bitfieldsPerStruct},
+        {"--enums", &options.enumsPerUnit},
+        {"--enumerators", &options.enumeratorsPerEnum},
+        {"--forward-declarations", &options.forwardDeclarationsPerUnit},
+        {"--functions", &options.functionsPerUnit},
+        {"--globals", &options.globalsPerUnit},
+        {"--duplicate-percent", &options.duplicatePercent},
+        {"--conflict-percent", &options.conflictPercent},
+    });
+    table.numbers["--seed"].push_back(&options.seed);
+    table.numbers["--slide"].push_back(&options.slide);
+}
+
+/// Applies the options in argv to table and returns the output path
+std::string_view ParseArguments(int argc, const char **argv, const OptionTable &table) {
+    std::string_view output;
+    for (int i = 0; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (auto it = table.flags.find(arg); it != table.flags.end()) {
+            *it->second = true;
+        } else if (arg.starts_with("--")) {
+            if (i + 1 >= argc) {
+                throw Synth::GeneratorError{"missing value for option {}", arg};
+            }
+            std::string_view value = argv[++i];
+            if (auto sizeIt = table.sizes.find(arg); sizeIt != table.sizes.end()) {
+                *sizeIt->second = ParseNumber(arg, value);
+            } else if (auto numberIt = table.numbers.find(arg); numberIt != table.numbers.end()) {
+                for (uint64_t *number: numberIt->second) {
+                    *number = ParseNumber(arg, value);
+                }
+            } else {
+                throw Synth::GeneratorError{"unknown option {}", arg};
+            }
+        } else if (output.empty()) {
+            output = arg;
+        } else {
+            throw Synth::GeneratorError{"unexpected argument {}", arg};
+        }
+    }
+    if (output.empty()) {
+        throw Synth::GeneratorError{"missing output path"};
+    }
+    return output;
+}
+
+void PrintKernelCache(const Synth::SyntheticKernelCache &kc, const fs::path &output) {
+    fmt::print("wrote {} bytes to {}\n", kc.data.size(), output.string());
+    fmt::print("filesets: {}, chained pointers: {}, PAC pointers: {}, entry point: {:#016x}\n",
+               kc.filesets.size(), kc.numChainedPointers, kc.numPACPointers, kc.entryPoint);
+}
+
+int GenerateKernelCache(int argc, const char **argv) {
+    Synth::KernelCacheOptions options;
+    OptionTable table;
+    AddKernelCacheOptions(table, options);
+    fs::path output = ParseArguments(argc, argv, table);
+
+    auto kc = Synth::GenerateKernelCache(options);
+    Synth::WriteImage(output, kc.data);
+    PrintKernelCache(kc, output);
+    return 0;
+}
+
+int GenerateKDK(int argc, const char **argv) {
+    Synth::KernelCacheOptions kcOptions;
+    Synth::DSYMOptions dsymOptions;
+    OptionTable table;
+    AddKernelCacheOptions(table, kcOptions);
+    AddDSYMOptions(table, dsymOptions);
+    fs::path output = ParseArguments(argc, argv, table);
+
+    std::error_code ec;
+    fs::create_directories(output / "KDK", ec);
+    if (ec) {
+        throw Synth::GeneratorError{"failed to create directory {}, error: {}", output.string(), ec.message()};
+    }
+
+    auto kc = Synth::GenerateKernelCache(kcOptions);
+    Synth::WriteImage(output / "kernelcache", kc.data);
+    PrintKernelCache(kc, output / "kernelcache");
+
+    size_t numTypes = 0;
+    size_t numFunctions = 0;
+    size_t numGlobals = 0;
+    for (const auto &dsym: Synth::GenerateDSYMs(kc, dsymOptions)) {
+        Synth::WriteDSYMBundle(output / "KDK", dsym);
+        numTypes += dsym.numTypes;
+        numFunctions += dsym.numFunctions;
+        numGlobals += dsym.numGlobals;
+    }
+    fmt::print("wrote {} dSYMs to {}\n", kc.filesets.size(), (output / "KDK").string());
+    fmt::print("types: {}, functions: {}, globals: {}\n", numTypes, numFunctions, numGlobals);
+    return 0;
+}
+
+}// namespace
+
+int main(int argc, const char **argv) {
+    if (argc < 2) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    std::string_view command = argv[1];
+    try {
+        if (command == "kc") {
+            return GenerateKernelCache(argc - 2, argv + 2);
+        }
+        if (command == "kdk") {
+            return GenerateKDK(argc - 2, argv + 2);
+        }
+    } catch (const Types::GenericException &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    PrintUsage(argv[0]);
+    return 1;
+}